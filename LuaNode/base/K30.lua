@@ -9,16 +9,9 @@ _G[modname] = M
 
 local co2 = 0
 
-uart.on("data", "]", 
-  function(data)
-    if data:sub(1,1) == "[" then 
-      data = data:sub(2) 
-    end
-
-    local index = data:find("]")
-    if index ~= nil then 
-      co2 = tonumber(data:sub(1, index - 1)) 
-    end
+uart.on("frame", { start = "[", stop = "]", number = true },
+  function(value)
+    co2 = value
   end,
 0)
 
@@ -0,0 +1,244 @@
+#!/usr/bin/env python
+#
+# ESP8266 file server loopback harness
+#
+# Emulates the node side of the file_server protocol on localhost and
+# measures the upload throughput of wireless_file.py for v1 and v2.
+# Every acknowledge is delayed by the given latency to model the WiFi
+# round-trip; v2 acknowledges are coalesced the same way the node does it.
+# A delta upload of a slightly edited copy of the file is checked as well.
+#
+
+import os
+import sys
+import socket, threading
+import argparse
+import struct
+import zlib
+from time import sleep, time
+
+import wireless_file
+
+ACK_V1      = 1 # Echoed v1 acknowledge
+ACK_V2      = 2 # Cumulative v2 acknowledge
+REPLY       = 3 # v2 signature reply
+
+# Emulated node - parses frames and keeps the uploaded file in memory
+class Node(threading.Thread):
+    def __init__(self, latency, files = {}):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.latency = latency
+        self.files = dict(files)
+        self.file_name = None
+        self.data = ""
+        self.base = None
+        self.stream = ""
+        self.executed = []
+        self.pending = []
+        self.lock = threading.Condition()
+        self.server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.server.bind(("127.0.0.1", 0))
+        self.server.listen(1)
+        self.port = self.server.getsockname()[1]
+
+    # Delay and send acknowledges, only the latest v2 ack is sent
+    def sender(self, client):
+        while True:
+            self.lock.acquire()
+            while len(self.pending) == 0:
+                self.lock.wait()
+            self.lock.release()
+
+            sleep(self.latency)
+
+            self.lock.acquire()
+            pending = self.pending
+            self.pending = []
+            self.lock.release()
+
+            # A v2 ack followed by another one is not sent
+            output = []
+            for i in range(len(pending)):
+                if pending[i][0] == ACK_V2 and i + 1 < len(pending) and pending[i + 1][0] == ACK_V2:
+                    continue
+                output.append(pending[i][1])
+            client.sendall("".join(output))
+
+    def reply(self, version, data):
+        self.lock.acquire()
+        self.pending.append((version, data))
+        self.lock.notify()
+        self.lock.release()
+
+    # Block signature the same way the node builds it
+    def signature(self, name):
+        data = self.files.get(name, "")
+        result = struct.pack("<I", len(data))
+        for offset in range(0, len(data), wireless_file.block_size):
+            block = data[offset:offset + wireless_file.block_size]
+            result += struct.pack("<II", wireless_file.weak_sum(block), zlib.crc32(block) & 0xFFFFFFFF)
+        return result
+
+    def execute(self, command, version, payload):
+        if command == "O":
+            self.file_name = payload
+            self.data = ""
+            self.base = None
+        elif command == "D":
+            self.file_name = payload
+            self.data = ""
+            self.base = self.files.get(payload, "")
+        elif command == "K":
+            if self.base is None:
+                return False
+            first, count = [int(x) for x in payload.split(",")]
+            block = self.base[first * wireless_file.block_size:(first + count) * wireless_file.block_size]
+            if len(block) == 0:
+                return False
+            self.data = self.data + block
+        elif command == "W":
+            self.data = self.data + payload
+        elif command == "X":
+            self.stream = self.stream + payload
+        elif command == "E":
+            self.executed.append(self.stream)
+            self.stream = ""
+        elif command == "C":
+            if version == 2 and int(payload, 16) != zlib.crc32(self.data) & 0xFFFFFFFF:
+                return False
+            self.files[self.file_name] = self.data
+        return True
+
+    def run(self):
+        client, address = self.server.accept()
+        worker = threading.Thread(target = self.sender, args = (client,))
+        worker.daemon = True
+        worker.start()
+
+        buffer = ""
+        while True:
+            data = client.recv(4096)
+            if not data:
+                break
+            buffer = buffer + data
+
+            while True:
+                first = buffer.find("|")
+                second = buffer.find("|", first + 1)
+                if first == -1 or second == -1:
+                    break
+
+                size = int(buffer[first + 1:second])
+                if len(buffer) < second + 1 + size:
+                    break
+
+                header = buffer[:second + 1]
+                payload = buffer[second + 1:second + 1 + size]
+                buffer = buffer[second + 1 + size:]
+
+                version = 1 if first == 1 else 2
+                if header[0] == "S":
+                    data = self.signature(payload)
+                    self.reply(REPLY, "S%s|%d|%s" % (header[1:first], len(data), data))
+                    continue
+
+                success = self.execute(header[0], version, payload)
+
+                if version == 1:
+                    self.reply(ACK_V1, ("Y|" if success else "N|") + header + payload)
+                else:
+                    self.reply(ACK_V2, "%s%s|" % ("Y" if success else "N", header[1:first]))
+        client.close()
+
+# Reset the client state
+def reset(protocol, window):
+    wireless_file.commands = []
+    wireless_file.buffer = ""
+    wireless_file.allow_send = True
+    wireless_file.sequence = 0
+    wireless_file.signature = None
+    wireless_file.protocol = protocol
+    wireless_file.window = window
+
+# Upload a file to a fresh emulated node and return the elapsed time
+def measure(path, protocol, packet, window, latency):
+    node = Node(latency)
+    node.start()
+
+    reset(protocol, window)
+    wireless_file.prepare_file(path, packet)
+
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.connect(("127.0.0.1", node.port))
+
+    start = time()
+    wireless_file.transfer(s, True)
+    elapsed = time() - start
+
+    s.close()
+
+    with open(path, 'r') as f:
+        if node.files.get(os.path.basename(path)) != f.read():
+            raise Exception("File content mismatch (v%d)" % protocol)
+
+    return elapsed
+
+# Delta upload a file to a node holding an edited copy of it,
+# return the number of bytes sent and the elapsed time
+def measure_delta(path, packet, window, latency):
+    with open(path, 'r') as f:
+        full_text = f.read()
+    name = os.path.basename(path)
+
+    # Previous version: a line changed in the middle, a few bytes less at the start
+    middle = len(full_text) // 2
+    previous = full_text[10:middle] + "-- old line\n" + full_text[middle + 20:]
+
+    node = Node(latency, { name : previous })
+    node.start()
+
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.connect(("127.0.0.1", node.port))
+
+    start = time()
+    reset(2, window)
+    wireless_file.enqueue("S", name)
+    wireless_file.transfer(s, True)
+    sent = sum(len(item["T"]) for item in wireless_file.commands)
+
+    del wireless_file.commands[:]
+    wireless_file.prepare_delta(path, packet)
+    wireless_file.transfer(s, True)
+    sent += sum(len(item["T"]) for item in wireless_file.commands)
+    elapsed = time() - start
+
+    s.close()
+
+    if node.files.get(name) != full_text:
+        raise Exception("File content mismatch (delta)")
+
+    return sent, elapsed
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='ESP8266 file server loopback throughput test.')
+    parser.add_argument('-s', '--src',     required = True,             help='Source file to be transfered.')
+    parser.add_argument('-l', '--latency', default = 10, type = float,  help='Acknowledge latency in ms, default 10.')
+    parser.add_argument('-z', '--packet',  default = 1024, type = int,  help='v2 data packet size, default 1024.')
+    parser.add_argument('-w', '--window',  default = 8, type = int,     help='v2 window size, default 8.')
+    args = parser.parse_args()
+
+    size = os.path.getsize(args.src)
+    latency = args.latency / 1000.0
+
+    try:
+        for protocol, packet in ((1, 50), (2, args.packet)):
+            elapsed = measure(args.src, protocol, packet, args.window, latency)
+            print "v%d: %d bytes in %.3f s, %.1f KB/s" % (protocol, size, elapsed, size / elapsed / 1024)
+
+        sent, elapsed = measure_delta(args.src, args.packet, args.window, latency)
+        print "delta: %d of %d bytes sent in %.3f s" % (sent, size, elapsed)
+    except Exception as details:
+        print "Test failed: %s" % details
+        sys.exit(1)
@@ -7,6 +7,8 @@ import os
 import sys
 import socket, select, string
 import argparse
+import struct
+import zlib
 from time import sleep
 
 QUEUED      = 0 # Command enqueued but still not sent
@@ -18,11 +20,25 @@ commands = []
 buffer = ""
 last_print = ""
 allow_send = True
-packet_size = 50
+protocol = 2        # Frame protocol version
+packet_size = 1024  # Maximal WRITE payload (v1 node accepts 60 bytes at most)
+window = 8          # Maximal number of unconfirmed v2 frames
+sequence = 0        # Last v2 sequence number used
+signature = None    # Block signature received from the node (delta upload)
+block_size = 256    # Delta upload block size, fixed by the node
+max_command = 128   # Maximal v2 RUN payload, longer commands are streamed
 
 # Enqueue a command into send queue
-def enqueue(data):
-    commands.append({ "T" : data, "+" : "Y|%s" % data, "-" : "N|%s" % data, "?" : QUEUED})
+def enqueue(command, payload):
+    global sequence
+    
+    if protocol == 1:
+        data = "%s|%d|%s" % (command, len(payload), payload)
+        commands.append({ "T" : data, "+" : "Y|%s" % data, "-" : "N|%s" % data, "?" : QUEUED})
+    else:
+        sequence = sequence + 1
+        data = "%s%d|%d|%s" % (command, sequence, len(payload), payload)
+        commands.append({ "T" : data, "#" : sequence, "?" : QUEUED})
 
 # Break a file into chunks and schedule send
 def prepare_file(path, chunk):
@@ -32,11 +48,15 @@ def prepare_file(path, chunk):
     
     # Prepare open file packet
     base_name = os.path.basename(path)
-    enqueue("O|%d|%s" % (len(base_name), base_name))
+    enqueue("O", base_name)
+    
+    # v2 node compiles the file on close and keeps the .lc file up to date
+    if protocol == 1:
+        compiled_name = base_name[:-3:] + "lc"
+        command = 'file.remove("%s")' % compiled_name
+        enqueue("G", command)
     
-    compiled_name = base_name[:-3:] + "lc"
-    command = 'file.remove("%s")' % compiled_name
-    enqueue("G|%d|%s" % (len(command), command))
+    crc = zlib.crc32(full_text) & 0xFFFFFFFF
     
     # Prepare open data packets
     while len(full_text) != 0:
@@ -44,17 +64,155 @@ def prepare_file(path, chunk):
         data = full_text[:size]
         full_text = full_text[size:]
         
-        enqueue("W|%d|%s" % (len(data), data))
-        
-    enqueue("C|%d|%s" % (len(base_name), base_name))
+        enqueue("W", data)
+    
+    # v2 node verifies the whole file on close
+    if protocol == 1:
+        enqueue("C", base_name)
+    else:
+        enqueue("C", "%08x" % crc)
     
     # If not initial script - compile it and remove the original
     if base_name != "init.lua" and False:
         command = 'node.compile("%s")' % base_name
-        enqueue("G|%d|%s" % (len(command), command))
+        enqueue("G", command)
         
         command = 'file.remove("%s")' % base_name
-        enqueue("G|%d|%s" % (len(command), command))
+        enqueue("G", command)
+
+# Stream a Lua chunk to the node and run it without storing it (v2 only)
+def prepare_stream(text, chunk):
+    while len(text) != 0:
+        enqueue("X", text[:chunk])
+        text = text[chunk:]
+    
+    enqueue("E", "")
+
+# Block checksum (rsync style) as computed by the node
+def weak_sum(data):
+    a = b = 0
+    for c in data:
+        a += ord(c)
+        b += a
+    return (a & 0xFFFF) | ((b & 0xFFFF) << 16)
+
+# Enqueue a delta upload of a file using the block signature of the
+# version stored on the node: matching blocks are copied on the node,
+# everything else is sent as WRITE payload
+def prepare_delta(path, chunk):
+    full_text = "" 
+    with open(path, 'r') as f:
+        full_text = f.read()
+    
+    base_name = os.path.basename(path)
+    enqueue("D", base_name)
+    
+    # Index full blocks of the old version by the weak checksum
+    blocks = {}
+    size = struct.unpack("<I", signature[:4])[0]
+    for i in range(size // block_size):
+        weak, strong = struct.unpack("<II", signature[4 + 8 * i:12 + 8 * i])
+        blocks.setdefault(weak, []).append((strong, i))
+    
+    literal = []
+    copy = [0, 0]
+    
+    def flush_literal():
+        data = "".join(literal)
+        del literal[:]
+        while len(data) != 0:
+            enqueue("W", data[:chunk])
+            data = data[chunk:]
+    
+    def flush_copy():
+        if copy[1] != 0:
+            enqueue("K", "%d,%d" % (copy[0], copy[1]))
+            copy[1] = 0
+    
+    # Roll the checksum over the new file looking for old blocks
+    pos = 0
+    a = b = 0
+    if len(full_text) >= block_size:
+        weak = weak_sum(full_text[:block_size])
+        a, b = weak & 0xFFFF, weak >> 16
+    
+    while pos + block_size <= len(full_text):
+        match = None
+        weak = (a & 0xFFFF) | ((b & 0xFFFF) << 16)
+        if weak in blocks:
+            strong = zlib.crc32(full_text[pos:pos + block_size]) & 0xFFFFFFFF
+            for candidate, index in blocks[weak]:
+                if candidate == strong:
+                    match = index
+                    break
+        
+        if match is not None:
+            flush_literal()
+            if copy[1] == 0 or copy[0] + copy[1] != match:
+                flush_copy()
+                copy[0] = match
+            copy[1] += 1
+            
+            pos += block_size
+            if pos + block_size <= len(full_text):
+                weak = weak_sum(full_text[pos:pos + block_size])
+                a, b = weak & 0xFFFF, weak >> 16
+        else:
+            flush_copy()
+            literal.append(full_text[pos])
+            
+            if pos + block_size < len(full_text):
+                a = a - ord(full_text[pos]) + ord(full_text[pos + block_size])
+                b = b - block_size * ord(full_text[pos]) + a
+            pos += 1
+    
+    literal.append(full_text[pos:])
+    flush_copy()
+    flush_literal()
+    
+    enqueue("C", "%08x" % (zlib.crc32(full_text) & 0xFFFFFFFF))
+
+# Process received v2 data - acknowledges are cumulative "Y<sequence>|",
+# a failure is reported as "N<sequence>|". A signature reply
+# "S<sequence>|<size>|<data>" acknowledges the frame as well.
+def process_ack(data):
+    global buffer
+    global signature
+    
+    buffer = buffer + data
+    
+    while True:
+        index = string.find(buffer, "|")
+        if index == -1:
+            break
+        
+        ack = buffer[:index + 1]
+        number = int(ack[1:-1])
+        
+        if ack[0] == "S":
+            end = string.find(buffer, "|", index + 1)
+            if end == -1:
+                break
+            size = int(buffer[index + 1:end])
+            if len(buffer) < end + 1 + size:
+                break
+            signature = buffer[end + 1:end + 1 + size]
+            buffer = buffer[end + 1 + size:]
+        else:
+            buffer = buffer[index + 1:]
+            if ack[0] != "Y":
+                raise Exception("Transport failure: %s" % ack)
+        
+        for command in commands:
+            if command["?"] == SENT and command["#"] <= number:
+                command["?"] = CONFIRMED
+
+# Check if another command may be sent
+def can_send():
+    if protocol == 1:
+        return allow_send
+    
+    return sum(item["?"] == SENT for item in commands) < window
 
 # Process received data - mark packets as transfered of failed
 def process_packet(data):
@@ -106,27 +264,100 @@ def check_completion():
     
     return confirmed == total 
 
+# Send all enqueued commands over a connected socket
+def transfer(s, quiet = False):
+    global allow_send
+    
+    send_num = 0
+    spin = True
+    
+    # Wait until transfer finished
+    while spin:
+        socket_list = [s]
+        
+        # Get the list sockets which are readable
+        read_sockets, write_sockets, error_sockets = select.select(socket_list , socket_list, [])
+
+        # Receive data
+        for sock in read_sockets:
+            #incoming message from remote server
+            if sock == s:
+                data = sock.recv(4096)
+                if not data:
+                    raise Exception("Connection closed by MCU")
+                else :
+                    # Handle commands
+                    if protocol == 1:
+                        process_packet(data)
+                    else:
+                        process_ack(data)
+                    
+                    if quiet:
+                        spin = any(item["?"] != CONFIRMED for item in commands)
+                    else:
+                        spin = not check_completion()
+        
+        # Transfer data
+        for sock in write_sockets:
+            if send_num >= len(commands):
+                break
+            
+            if commands[send_num]["?"] == QUEUED and can_send():
+                sock.sendall(commands[send_num]["T"])
+                commands[send_num]["?"] = SENT
+                send_num = send_num + 1
+                allow_send = False
+
 if __name__ == '__main__':
     # parse arguments or use defaults
     parser = argparse.ArgumentParser(description='ESP8266 Lua wireless scripts uploader.')
     parser.add_argument('-a', '--address', required = True,     help='Node IP Address.')
     parser.add_argument('-p', '--port',    default  = 20123,    help='Node port.')
     parser.add_argument('-s', '--src',     required = False,     help='Source file to be transfered.')
-    # parser.add_argument('-z', '--packet',  default  = 50,       help='Maximal data packet size.')
+    parser.add_argument('-z', '--packet',  default  = 0, type = int, help='Maximal data packet size (default 50 for v1, 1024 for v2).')
+    parser.add_argument('-w', '--window',  default  = 8, type = int, help='Maximal number of unconfirmed packets (v2 only).')
+    parser.add_argument('-1', '--v1',      action='store_true', help="Use the v1 protocol (one packet at a time, echoed acks)")
+    parser.add_argument('-d', '--delta',   action='store_true', help="Send only the blocks changed since the previous upload (v2 only)")
     parser.add_argument('-r', '--restart', action='store_true', help="Restart node on transfer finish")
     parser.add_argument('-e', '--execute', action='store_true', help="Execute the uploaded file")
     parser.add_argument('-c', '--command', default='',          help="Run a given command")
+    parser.add_argument('-x', '--stream',  action='store_true', help="Run the source file without storing it (v2 only)")
     args = parser.parse_args()
 
+    s = None
     try:
-        # packet_size = args.packet
+        if args.v1:
+            protocol = 1
+            packet_size = 50
+        window = args.window
+        if args.packet > 0:
+            packet_size = args.packet
+        
         if len(args.command) > 0:
-            enqueue("G|%d|%s" % (len(args.command), args.command))
+            if protocol == 2 and len(args.command) > max_command:
+                prepare_stream(args.command, packet_size)
+            else:
+                enqueue("G", args.command)
+        elif args.stream and protocol == 2 and len(args.src) > 0:
+            with open(args.src, 'r') as f:
+                prepare_stream(f.read(), packet_size)
         elif  len(args.src) > 0:
-            prepare_file(args.src, packet_size)
+            if args.delta and protocol == 2:
+                # Fetch the signature of the stored version first
+                s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+                s.settimeout(2)
+                s.connect((args.address, args.port))
+                
+                enqueue("S", os.path.basename(args.src))
+                transfer(s, True)
+                del commands[:]
+                
+                prepare_delta(args.src, packet_size)
+            else:
+                prepare_file(args.src, packet_size)
             if args.restart:
                 command = "tmr.alarm(5, 2000, 0, function() node.restart() end)"
-                enqueue("G|%d|%s" % (len(command), command))
+                enqueue("G", command)
             elif args.execute:
                 if args.src[-3:] != 'lua':
                     print ".lua file expected, got " + args.src[-3:]
@@ -135,7 +366,7 @@ if __name__ == '__main__':
                     if base_name != "init.lua":
                         base_name = os.path.basename(args.src)[:-3:] + "lc"
                     command = "dofile(%s)" % base_name
-                    enqueue("G|%d|%s" % (len(command), command))
+                    enqueue("G", command)
         else:
             print "Nothing to do!"
             exit(0)
@@ -144,45 +375,14 @@ if __name__ == '__main__':
             print "Nothing to do!"
             exit(0)
         
-        s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-        s.settimeout(2)
-        s.connect((args.address, args.port))
-        
-        send_num = 0
-        spin = True
+        if s is None:
+            s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            s.settimeout(2)
+            s.connect((args.address, args.port))
         
         print "Transfering data [ confirmed | sent | total ]"
+        transfer(s)
         
-        # Wait until transfer finished
-        while spin:
-            socket_list = [s]
-            
-            # Get the list sockets which are readable
-            read_sockets, write_sockets, error_sockets = select.select(socket_list , socket_list, [])
-
-            # Receive data
-            for sock in read_sockets:
-                #incoming message from remote server
-                if sock == s:
-                    data = sock.recv(4096)
-                    if not data:
-                        raise Exception("Connection closed by MCU")
-                    else :
-                        # Handle commands
-                        process_packet(data)
-                        spin = not check_completion()
-            
-            # Transfer data
-            for sock in write_sockets:
-                if send_num >= len(commands):
-                    break
-                
-                if commands[send_num]["?"] == QUEUED and allow_send:
-                    sock.send(commands[send_num]["T"])
-                    commands[send_num]["?"] = SENT
-                    send_num = send_num + 1
-                    allow_send = False
-
         s.shutdown(socket.SHUT_RDWR)
         s.close()
         print "\nFile transfer done!"
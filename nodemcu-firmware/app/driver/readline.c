@@ -19,7 +19,7 @@ bool uart_getc(char *c){
     // ETS_UART_INTR_DISABLE();
     ETS_INTR_LOCK();
     *c = (char)*(pRxBuff->pReadPos);
-    if (pRxBuff->pReadPos == (pRxBuff->pRcvMsgBuff + RX_BUFF_SIZE)) {
+    if (pRxBuff->pReadPos == (pRxBuff->pRcvMsgBuff + pRxBuff->RcvBuffSize - 1)) {
         pRxBuff->pReadPos = pRxBuff->pRcvMsgBuff ; 
     } else {
         pRxBuff->pReadPos++;
@@ -142,6 +142,53 @@ void spi_mast_byte_write(uint8 spi_no, uint8 *data)
     *data = (uint8)(READ_PERI_REG(SPI_W0(spi_no))&0xff);
 }  
 
+/******************************************************************************
+ * FunctionName : spi_mast_blk_write
+ * Description  : SPI master block transmission function, data is sent in bursts
+ *			of up to SPI_BUFFER_SIZE bytes through the SPI_W0~SPI_W15 buffer.
+ *			Interrupts are not blocked, the CPU only waits for the previous
+ *			burst to finish before filling the buffer again.
+ * Parameters   : 	uint8 spi_no - SPI module number, Only "SPI" and "HSPI" are valid
+ *				const uint8 *data - transmitted data
+ *				uint32 length - number of bytes to be transmitted
+*******************************************************************************/
+void spi_mast_blk_write(uint8 spi_no, const uint8 *data, uint32 length)
+{
+    uint32 burst, i, word;
+
+    if(spi_no>1) 		return; //handle invalid input number
+
+    while(length){
+        burst = length > SPI_BUFFER_SIZE ? SPI_BUFFER_SIZE : length;
+
+        while(READ_PERI_REG(SPI_CMD(spi_no))&SPI_USR);
+
+        //the first byte of the buffer is the low byte of SPI_W0
+        for(i = 0; i < burst; i += 4){
+            word = data[i];
+            if(i + 1 < burst) word |= (uint32)data[i + 1] << 8;
+            if(i + 2 < burst) word |= (uint32)data[i + 2] << 16;
+            if(i + 3 < burst) word |= (uint32)data[i + 3] << 24;
+            WRITE_PERI_REG(SPI_W0(spi_no) + i, word);
+        }
+
+        WRITE_PERI_REG(SPI_USER1(spi_no),
+                        (((burst * 8 - 1)&SPI_USR_MOSI_BITLEN)<<SPI_USR_MOSI_BITLEN_S)|
+                        ((7&SPI_USR_MISO_BITLEN)<<SPI_USR_MISO_BITLEN_S));
+        SET_PERI_REG_MASK(SPI_CMD(spi_no), SPI_USR);
+
+        data += burst;
+        length -= burst;
+    }
+
+    while(READ_PERI_REG(SPI_CMD(spi_no))&SPI_USR);
+
+    //restore 8bit output buffer length used by spi_mast_byte_write
+    WRITE_PERI_REG(SPI_USER1(spi_no),
+                    ((7&SPI_USR_MOSI_BITLEN)<<SPI_USR_MOSI_BITLEN_S)|
+                    ((7&SPI_USR_MISO_BITLEN)<<SPI_USR_MISO_BITLEN_S));
+}
+
 /******************************************************************************
  * FunctionName : spi_byte_write_espslave
  * Description  : SPI master 1 byte transmission function for esp8266 slave,
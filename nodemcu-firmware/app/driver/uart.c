@@ -11,6 +11,7 @@
 *******************************************************************************/
 #include "ets_sys.h"
 #include "osapi.h"
+#include "mem.h"
 #include "driver/uart.h"
 #include "user_config.h"
 
@@ -23,6 +24,16 @@ extern UartDevice UartDev;
 LOCAL void ICACHE_RAM_ATTR
 uart0_rx_intr_handler(void *para);
 
+// UART1 TX FIFO empty handler, called from the interrupt context
+LOCAL uart_tx_empty_handler uart1_tx_empty = NULL;
+
+// UART0 RX notification, called from the interrupt context once bytes were received
+LOCAL uart_rx_handler uart0_rx_notify = NULL;
+
+// UART0 RX ring allocated by uart0_rx_buffer_resize(), NULL while the rom buffer is used
+LOCAL uint8 *uart0_rx_buff = NULL;
+LOCAL uint8 *uart0_rom_rx_buff = NULL;
+
 /******************************************************************************
  * FunctionName : uart_config
  * Description  : Internal used function
@@ -183,6 +194,13 @@ uart0_rx_intr_handler(void *para)
      */
     RcvMsgBuff *pRxBuff = (RcvMsgBuff *)para;
     uint8 RcvChar;
+    bool received = false;
+
+    if (uart1_tx_empty && (READ_PERI_REG(UART_INT_ST(UART1)) & UART_TXFIFO_EMPTY_INT_ST)) {
+        // handler refills the fifo or disables the interrupt
+        uart1_tx_empty();
+        WRITE_PERI_REG(UART_INT_CLR(UART1), UART_TXFIFO_EMPTY_INT_CLR);
+    }
 
     if (UART_RXFIFO_FULL_INT_ST != (READ_PERI_REG(UART_INT_ST(UART0)) & UART_RXFIFO_FULL_INT_ST)) {
         return;
@@ -192,6 +210,7 @@ uart0_rx_intr_handler(void *para)
 
     while (READ_PERI_REG(UART_STATUS(UART0)) & (UART_RXFIFO_CNT << UART_RXFIFO_CNT_S)) {
         RcvChar = READ_PERI_REG(UART_FIFO(UART0)) & 0xFF;
+        received = true;
 
         /* you can add your handle code below.*/
 
@@ -202,7 +221,7 @@ uart0_rx_intr_handler(void *para)
             pRxBuff->BuffState = WRITE_OVER;
         }
         
-        if (pRxBuff->pWritePos == (pRxBuff->pRcvMsgBuff + RX_BUFF_SIZE)) {
+        if (pRxBuff->pWritePos == (pRxBuff->pRcvMsgBuff + pRxBuff->RcvBuffSize - 1)) {
             // overflow ...we may need more error handle here.
             pRxBuff->pWritePos = pRxBuff->pRcvMsgBuff ;
         } else {
@@ -210,13 +229,17 @@ uart0_rx_intr_handler(void *para)
         }
 
         if (pRxBuff->pWritePos == pRxBuff->pReadPos){   // overflow one byte, need push pReadPos one byte ahead
-            if (pRxBuff->pReadPos == (pRxBuff->pRcvMsgBuff + RX_BUFF_SIZE)) {
+            if (pRxBuff->pReadPos == (pRxBuff->pRcvMsgBuff + pRxBuff->RcvBuffSize - 1)) {
                 pRxBuff->pReadPos = pRxBuff->pRcvMsgBuff ; 
             } else {
                 pRxBuff->pReadPos++;
             }
         }
     }
+
+    if (received && uart0_rx_notify) {
+        uart0_rx_notify();
+    }
 }
 
 /******************************************************************************
@@ -230,6 +253,7 @@ void ICACHE_FLASH_ATTR
 uart_init(UartBautRate uart0_br, UartBautRate uart1_br)
 {
     // rom use 74880 baut_rate, here reinitialize
+    UartDev.rcv_buff.RcvBuffSize = RX_BUFF_SIZE;
     UartDev.baut_rate = uart0_br;
     uart_config(UART0);
     UartDev.baut_rate = uart1_br;
@@ -242,6 +266,85 @@ uart_init(UartBautRate uart0_br, UartBautRate uart1_br)
 #endif
 }
 
+/******************************************************************************
+ * FunctionName : uart1_tx_empty_attach
+ * Description  : install UART1 TX FIFO empty interrupt handler. The handler
+ *                runs in the interrupt context, it is responsible for
+ *                enabling and disabling the UART_TXFIFO_EMPTY_INT_ENA bit
+ * Parameters   : uart_tx_empty_handler handler - handler, NULL to remove
+ * Returns      : NONE
+*******************************************************************************/
+void ICACHE_FLASH_ATTR
+uart1_tx_empty_attach(uart_tx_empty_handler handler)
+{
+    ETS_UART_INTR_DISABLE();
+    uart1_tx_empty = handler;
+    ETS_UART_INTR_ENABLE();
+}
+
+/******************************************************************************
+ * FunctionName : uart0_rx_attach
+ * Description  : install UART0 RX notification. The handler runs in the
+ *                interrupt context after received bytes were put into the
+ *                RX ring, it should only post a task event
+ * Parameters   : uart_rx_handler handler - handler, NULL to remove
+ * Returns      : NONE
+*******************************************************************************/
+void ICACHE_FLASH_ATTR
+uart0_rx_attach(uart_rx_handler handler)
+{
+    ETS_UART_INTR_DISABLE();
+    uart0_rx_notify = handler;
+    ETS_UART_INTR_ENABLE();
+}
+
+/******************************************************************************
+ * FunctionName : uart0_rx_buffer_resize
+ * Description  : replace the UART0 RX ring, pending bytes are dropped
+ * Parameters   : uint32 size - ring size in bytes, RX_BUFF_SIZE or less
+ *                              goes back to the rom buffer
+ * Returns      : true on success, false if the ring can't be allocated
+*******************************************************************************/
+bool ICACHE_FLASH_ATTR
+uart0_rx_buffer_resize(uint32 size)
+{
+    RcvMsgBuff *pRxBuff = &(UartDev.rcv_buff);
+    uint8 *buff = NULL;
+    uint8 *old;
+
+    if (size > RX_BUFF_SIZE) {
+        buff = (uint8 *)os_malloc(size);
+        if (buff == NULL) {
+            return false;
+        }
+    }
+
+    ETS_UART_INTR_DISABLE();
+    old = uart0_rx_buff;
+    if (buff == NULL) {
+        // the rom buffer is kept in pRcvMsgBuff while our ring is in use
+        if (old != NULL) {
+            pRxBuff->pRcvMsgBuff = uart0_rom_rx_buff;
+        }
+        pRxBuff->RcvBuffSize = RX_BUFF_SIZE;
+    } else {
+        if (old == NULL) {
+            uart0_rom_rx_buff = pRxBuff->pRcvMsgBuff;
+        }
+        pRxBuff->pRcvMsgBuff = buff;
+        pRxBuff->RcvBuffSize = size;
+    }
+    uart0_rx_buff = buff;
+    pRxBuff->pWritePos = pRxBuff->pRcvMsgBuff;
+    pRxBuff->pReadPos = pRxBuff->pRcvMsgBuff;
+    ETS_UART_INTR_ENABLE();
+
+    if (old != NULL) {
+        os_free(old);
+    }
+    return true;
+}
+
 void ICACHE_FLASH_ATTR
 uart_setup(uint8 uart_no)
 {
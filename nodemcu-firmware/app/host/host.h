@@ -0,0 +1,72 @@
+/*
+ * Host platform internals.
+ *
+ * The SDK and the ROM are replaced by the host_*.c backends, everything
+ * runs in a single thread: the event loop of host_os.c calls the timers,
+ * the tasks and the "interrupt handlers" of the devices, the latter only
+ * while their interrupt is unmasked. The SPI masters of host_spi.c are
+ * the exception, the firmware spins on their registers.
+ */
+
+#ifndef __HOST_H__
+#define __HOST_H__
+
+#include "c_types.h"
+
+// Target addresses the flash and the peripheral registers are mapped at
+#define HOST_FLASH_BASE         0x40200000
+#define HOST_PERI_BASE          0x60000000
+#define HOST_PERI_SIZE          0x2000
+#define HOST_DPORT_BASE         0x3ff00000
+#define HOST_DPORT_SIZE         0x1000
+
+#define HOST_NO_INUM            -1
+
+typedef void (*host_fd_fn)(int fd, short revents, void *arg);
+typedef void (*host_gpio_probe_t)(uint32 old, uint32 now);
+typedef void (*host_spi_sink_t)(unsigned id, const uint8 *data, unsigned len);
+
+// host_main.c
+void host_request_restart(uint32 delay_us);
+
+// host_os.c
+extern uint32 host_time_offset;
+uint64_t host_time_us(void);
+bool host_map_registers(void);
+void host_os_init(uint32 heap_size);
+void host_init_done(void);
+void host_watch(int fd, short events, int inum, host_fd_fn fn, void *arg);
+void host_unwatch(int fd);
+bool host_isr_enabled(int inum);
+void host_isr_call(int inum);
+void host_run(uint32 max_us);
+void host_stop(void);
+void host_exit_when_idle(void);
+
+// host_flash.c
+bool host_flash_open(const char *path);
+void host_flash_close(void);
+
+// host_uart.c
+void host_uart_open(bool exit_on_eof);
+void host_uart_close(void);
+void host_uart_flush(void);
+
+// host_gpio.c
+void host_gpio_init(void);
+void host_gpio_drive(unsigned gpio, unsigned level);
+void host_gpio_probe(host_gpio_probe_t probe);
+void host_gpio_serve(void);
+uint32 host_gpio_storms(void);
+
+// host_spi.c
+void host_spi_attach(unsigned id, host_spi_sink_t sink);
+
+// host_wifi.c
+void host_wifi_init(void);
+
+// host_net.c
+extern int host_port_offset;
+void host_net_init(void);
+
+#endif /* __HOST_H__ */
@@ -0,0 +1,128 @@
+/*
+ * Host flash: a file mapped at the flash address of the target.
+ *
+ * Reads through the mapping work like the cached flash of the target, the
+ * spi_flash_* calls behave like NOR flash: writing only clears bits, an
+ * erase sets a sector back to 0xff. A new image is erased and gets the boot
+ * header of a 4 MB flash, so flash_get_info() knows the size. Without a file
+ * the flash is kept in memory, as the tests do.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "spi_flash.h"
+#include "flash_api.h"
+#include "cpu_esp8266.h"
+#include "host.h"
+
+#define HOST_FLASH_SIZE         (FLASH_SEC_NUM * SPI_FLASH_SEC_SIZE)
+
+static uint8 *flash;
+
+// Map the image file at path, or a flash in memory if path is NULL
+bool host_flash_open(const char *path)
+{
+  struct stat st;
+  bool fresh = true;
+  int fd;
+
+  if (path == NULL)
+  {
+    flash = mmap((void *)HOST_FLASH_BASE, HOST_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  }
+  else
+  {
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+      perror(path);
+      return false;
+    }
+    fresh = st.st_size == 0;
+    if (st.st_size < HOST_FLASH_SIZE && ftruncate(fd, HOST_FLASH_SIZE) < 0)
+    {
+      perror(path);
+      close(fd);
+      return false;
+    }
+
+    flash = mmap((void *)HOST_FLASH_BASE, HOST_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    close(fd);
+  }
+  if (flash != (uint8 *)HOST_FLASH_BASE)
+  {
+    perror("host: can't map the flash");
+    return false;
+  }
+
+  if (fresh)
+  {
+    memset(flash, 0xff, HOST_FLASH_SIZE);
+    // esptool image header: magic, segments, QIO, 40 MHz / 32 Mbit
+    flash[0] = 0xe9;
+    flash[1] = 0;
+    flash[2] = MODE_QIO;
+    flash[3] = (SIZE_32MBIT << 4) | SPEED_40MHZ;
+  }
+  return true;
+}
+
+void host_flash_close(void)
+{
+  if (flash == NULL)
+    return;
+  msync(flash, HOST_FLASH_SIZE, MS_SYNC);
+  munmap(flash, HOST_FLASH_SIZE);
+  flash = NULL;
+}
+
+static bool host_flash_range(uint32 addr, uint32 size)
+{
+  return addr < HOST_FLASH_SIZE && size <= HOST_FLASH_SIZE - addr;
+}
+
+uint32 spi_flash_get_id(void)
+{
+  // GigaDevice GD25Q32
+  return 0x1640c8;
+}
+
+SpiFlashOpResult spi_flash_erase_sector(uint16 sec)
+{
+  if (sec >= FLASH_SEC_NUM)
+    return SPI_FLASH_RESULT_ERR;
+  memset(flash + sec * SPI_FLASH_SEC_SIZE, 0xff, SPI_FLASH_SEC_SIZE);
+  return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult spi_flash_write(uint32 des_addr, uint32 *src_addr, uint32 size)
+{
+  const uint8 *src = (const uint8 *)src_addr;
+  uint8 *dst = flash + des_addr;
+  uint32 i;
+
+  if (!host_flash_range(des_addr, size))
+    return SPI_FLASH_RESULT_ERR;
+  for (i = 0; i < size; i++)
+    dst[i] &= src[i];
+  return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult spi_flash_read(uint32 src_addr, uint32 *des_addr, uint32 size)
+{
+  if (!host_flash_range(src_addr, size))
+    return SPI_FLASH_RESULT_ERR;
+  memcpy(des_addr, flash + src_addr, size);
+  return SPI_FLASH_RESULT_OK;
+}
+
+void SPIEraseChip(void)
+{
+  memset(flash, 0xff, HOST_FLASH_SIZE);
+}
@@ -0,0 +1,178 @@
+/*
+ * Host GPIO: the ROM gpio_* calls on top of the mapped GPIO registers.
+ *
+ * An output pin reads back its output level, an input pin the level it is
+ * driven to with host_gpio_drive(). Edges and levels set the GPIO_STATUS bits
+ * the pin interrupt type asks for, the GPIO interrupt handler runs while they
+ * are pending and the interrupt is unmasked. Writes to GPIO_STATUS_W1TC are
+ * plain memory writes, they are applied around every handler call. As on the
+ * chip, the handler is called again as long as a status bit is pending: a
+ * level interrupt it enables again while the level holds is taken at once.
+ * After HOST_GPIO_STORM calls in a row the storm is reported, where the chip
+ * would be reset by its watchdog.
+ * GPIO16 is the RTC GPIO, it has no interrupt.
+ */
+
+#include <stdio.h>
+
+#include "ets_sys.h"
+#include "gpio.h"
+#include "host.h"
+
+#define HOST_GPIO_STORM         10000
+
+static uint32 driven;                   // input levels, one bit per GPIO
+static bool in_isr;
+static host_gpio_probe_t probe;
+static uint32 storms;
+
+// Apply the status bits the firmware cleared
+static void host_gpio_ack(void)
+{
+  uint32 w1tc = GPIO_REG_READ(GPIO_STATUS_W1TC_ADDRESS);
+  uint32 w1ts = GPIO_REG_READ(GPIO_STATUS_W1TS_ADDRESS);
+
+  if (w1tc | w1ts)
+  {
+    GPIO_REG_WRITE(GPIO_STATUS_ADDRESS, (GPIO_REG_READ(GPIO_STATUS_ADDRESS) | w1ts) & ~w1tc);
+    GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, 0);
+    GPIO_REG_WRITE(GPIO_STATUS_W1TS_ADDRESS, 0);
+  }
+}
+
+// Raise the interrupt of the pins the levels and edges from old to now trigger
+static void host_gpio_trigger(uint32 old, uint32 now)
+{
+  uint32 status = 0;
+  unsigned i;
+
+  for (i = 0; i < GPIO_PIN_COUNT; i++)
+  {
+    uint32 bit = BIT(i);
+    bool rise = !(old & bit) && (now & bit);
+    bool fall = (old & bit) && !(now & bit);
+
+    switch (GPIO_PIN_INT_TYPE_GET(GPIO_REG_READ(GPIO_PIN_ADDR(i))))
+    {
+      case GPIO_PIN_INTR_POSEDGE: if (rise) status |= bit; break;
+      case GPIO_PIN_INTR_NEGEDGE: if (fall) status |= bit; break;
+      case GPIO_PIN_INTR_ANYEGDE: if (rise || fall) status |= bit; break;
+      case GPIO_PIN_INTR_LOLEVEL: if (!(now & bit)) status |= bit; break;
+      case GPIO_PIN_INTR_HILEVEL: if (now & bit) status |= bit; break;
+      default: break;
+    }
+  }
+
+  host_gpio_ack();
+  if (status)
+    GPIO_REG_WRITE(GPIO_STATUS_ADDRESS, GPIO_REG_READ(GPIO_STATUS_ADDRESS) | status);
+  host_gpio_serve();
+}
+
+// Call the interrupt handler while a status bit is pending, no nesting
+void host_gpio_serve(void)
+{
+  unsigned calls;
+
+  host_gpio_ack();
+  for (calls = 0; !in_isr && host_isr_enabled(ETS_GPIO_INUM) &&
+       (GPIO_REG_READ(GPIO_STATUS_ADDRESS) & GPIO_STATUS_INTERRUPT_MASK); calls++)
+  {
+    if (calls == HOST_GPIO_STORM)
+    {
+      if (storms++ == 0)
+        fprintf(stderr, "host: GPIO interrupt storm, status 0x%x\n",
+                (unsigned)GPIO_REG_READ(GPIO_STATUS_ADDRESS));
+      break;
+    }
+    in_isr = true;
+    host_isr_call(ETS_GPIO_INUM);
+    in_isr = false;
+    host_gpio_ack();
+  }
+}
+
+// Number of interrupt storms so far
+uint32 host_gpio_storms(void)
+{
+  return storms;
+}
+
+// Recompute GPIO_IN from the outputs and the driven levels
+static void host_gpio_update(void)
+{
+  uint32 enable = GPIO_REG_READ(GPIO_ENABLE_ADDRESS);
+  uint32 old = GPIO_REG_READ(GPIO_IN_ADDRESS);
+  uint32 now = (GPIO_REG_READ(GPIO_OUT_ADDRESS) & enable) | (driven & ~enable);
+
+  GPIO_REG_WRITE(GPIO_IN_ADDRESS, now);
+  if (probe && now != old)
+    probe(old, now);
+  host_gpio_trigger(old, now);
+}
+
+// Drive an input pin from outside, e.g. a test harness
+void host_gpio_drive(unsigned gpio, unsigned level)
+{
+  if (gpio == 16)
+  {
+    WRITE_PERI_REG(RTC_GPIO_IN_DATA, (READ_PERI_REG(RTC_GPIO_IN_DATA) & ~1) | (level & 1));
+    return;
+  }
+  if (gpio >= GPIO_PIN_COUNT)
+    return;
+  if (level)
+    driven |= BIT(gpio);
+  else
+    driven &= ~BIT(gpio);
+  host_gpio_update();
+}
+
+// Watch the pin levels from outside, probe gets GPIO_IN before and after a change
+void host_gpio_probe(host_gpio_probe_t fn)
+{
+  probe = fn;
+}
+
+void host_gpio_init(void)
+{
+  driven = 0;
+  storms = 0;
+  GPIO_REG_WRITE(GPIO_IN_ADDRESS, 0);
+}
+
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask)
+{
+  GPIO_REG_WRITE(GPIO_OUT_ADDRESS, (GPIO_REG_READ(GPIO_OUT_ADDRESS) | set_mask) & ~clear_mask);
+  GPIO_REG_WRITE(GPIO_ENABLE_ADDRESS, (GPIO_REG_READ(GPIO_ENABLE_ADDRESS) | enable_mask) & ~disable_mask);
+  host_gpio_update();
+}
+
+uint32 gpio_input_get(void)
+{
+  host_gpio_ack();
+  return GPIO_REG_READ(GPIO_IN_ADDRESS);
+}
+
+void gpio_register_set(uint32 reg_id, uint32 value)
+{
+  GPIO_REG_WRITE(reg_id, value);
+}
+
+uint32 gpio_register_get(uint32 reg_id)
+{
+  return GPIO_REG_READ(reg_id);
+}
+
+// A level interrupt triggers as soon as it is enabled
+void gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state)
+{
+  uint32 in = GPIO_REG_READ(GPIO_IN_ADDRESS);
+
+  if (i >= GPIO_PIN_COUNT)
+    return;
+  GPIO_REG_WRITE(GPIO_PIN_ADDR(i), (GPIO_REG_READ(GPIO_PIN_ADDR(i)) & ~GPIO_PIN_INT_TYPE_MASK)
+                 | GPIO_PIN_INT_TYPE_SET(intr_state));
+  if (intr_state == GPIO_PIN_INTR_LOLEVEL || intr_state == GPIO_PIN_INTR_HILEVEL)
+    host_gpio_trigger(in, in);
+}
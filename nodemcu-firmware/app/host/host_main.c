@@ -0,0 +1,114 @@
+/*
+ * nodemcu-host: the firmware as a Linux process.
+ *
+ *   nodemcu-host [-f flash.img] [-m heap] [-p port_offset] [-t seconds] [-k]
+ *
+ *   -f  flash image, made and formatted by the firmware if it doesn't exist
+ *   -m  heap size in bytes, the host needs more than the target for the
+ *       same Lua state, pointers are twice the size
+ *   -p  added to the ports the firmware listens on
+ *   -t  run for the given time and exit
+ *   -k  keep running after the end of the input, stdin that isn't a
+ *       terminal otherwise ends the process once the input is handled
+ *
+ * The console is stdin / stdout. The flash image and the peripheral
+ * registers are mapped at their target addresses, so the firmware's own
+ * pointers into them work unchanged. node.restart() and node.dsleep()
+ * start the process over with the same arguments.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "host.h"
+
+#define HOST_DEFAULT_HEAP       (40 * 1024)
+
+extern void user_init(void);
+
+static os_timer_t restart_timer;
+static bool restart;
+
+static void host_restart_now(void *arg)
+{
+  host_stop();
+}
+
+// Restarts the process from host_run(), after delay_us
+void host_request_restart(uint32 delay_us)
+{
+  restart = true;
+  os_timer_disarm(&restart_timer);
+  os_timer_setfn(&restart_timer, host_restart_now, NULL);
+  os_timer_arm(&restart_timer, delay_us / 1000, 0);
+}
+
+static void host_signal(int sig)
+{
+  host_uart_close();
+  _exit(128 + sig);
+}
+
+static void host_usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-f flash.img] [-m heap] [-p port_offset] [-t seconds] [-k]\n", name);
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  const char *flash = "flash.img";
+  uint32 heap = HOST_DEFAULT_HEAP;
+  uint32 run_us = 0;
+  bool keep = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:m:p:t:k")) != -1)
+  {
+    switch (opt)
+    {
+      case 'f': flash = optarg; break;
+      case 'm': heap = strtoul(optarg, NULL, 0); break;
+      case 'p': host_port_offset = atoi(optarg); break;
+      case 't': run_us = strtoul(optarg, NULL, 0) * 1000000; break;
+      case 'k': keep = true; break;
+      default: host_usage(argv[0]);
+    }
+  }
+  if (optind != argc)
+    host_usage(argv[0]);
+
+  if (!host_map_registers())
+    return 1;
+  host_os_init(heap);
+  if (!host_flash_open(flash))
+    return 1;
+  host_gpio_init();
+  host_wifi_init();
+  host_net_init();
+
+  signal(SIGINT, host_signal);
+  signal(SIGTERM, host_signal);
+  signal(SIGPIPE, SIG_IGN);
+  host_uart_open(!keep);
+
+  user_init();
+  host_init_done();
+
+  host_run(run_us);
+
+  host_uart_close();
+  host_flash_close();
+  if (restart)
+  {
+    execv("/proc/self/exe", argv);
+    perror("host: restart");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,737 @@
+/*
+ * Host espconn: the SDK socket API on top of non-blocking host sockets.
+ *
+ * Follows what the firmware expects of the SDK:
+ * - a listening espconn gets a new espconn for every client, made and freed
+ *   here, its callbacks are registered by the connect callback;
+ * - callbacks never run from within an espconn_* call, a send is reported
+ *   by a sent callback per espconn_sent() once the data went out, a
+ *   disconnect by the disconnect callback once it is done;
+ * - received TCP data is handed over in segments of at most TCP_MSS bytes.
+ * Listening ports are moved by host_port_offset, several instances can run
+ * side by side on one machine.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "mem.h"
+#include "user_interface.h"
+#include "espconn.h"
+#include "host.h"
+
+#define HOST_TCP_MSS            1460
+#define HOST_UDP_MAX            1472
+
+typedef struct host_chunk
+{
+  struct host_chunk *next;
+  uint32 len;
+  uint32 off;
+  uint8 data[];
+} host_chunk_t;
+
+typedef struct host_conn
+{
+  struct host_conn *next;
+  struct espconn *esp;
+  int fd;
+  bool listener;
+  bool accepted;        // made by a listener, the espconn is ours
+  bool connecting;
+  bool closing;         // espconn_disconnect(), close once the output is out
+  bool hold;
+  int error;            // of a connect() that failed right away
+  uint32 sent_pending;  // UDP sends not yet reported
+  uint32 timeout;       // s without traffic a client of a listener may stay
+  uint64_t active_us;
+  host_chunk_t *out;
+} host_conn_t;
+
+typedef struct
+{
+  os_timer_t timer;
+  dns_found_callback found;
+  void *arg;
+  ip_addr_t ip;
+  bool ok;
+  char name[];
+} host_dns_t;
+
+int host_port_offset;
+
+static host_conn_t *conns;
+static os_timer_t idle_timer;
+static bool idle_armed;
+static uint32 next_port = 49152;
+
+static void host_conn_ready(int fd, short revents, void *arg);
+
+/******************************************************************************
+ * Connections
+ */
+
+static host_conn_t *host_conn_find(struct espconn *esp)
+{
+  host_conn_t *c;
+
+  for (c = conns; c; c = c->next)
+    if (c->esp == esp)
+      return c;
+  return NULL;
+}
+
+// Callbacks may close any connection, the pointer has to be checked after each
+static bool host_conn_alive(host_conn_t *c)
+{
+  host_conn_t *p;
+
+  for (p = conns; p; p = p->next)
+    if (p == c)
+      return true;
+  return false;
+}
+
+static host_conn_t *host_conn_new(struct espconn *esp, int fd)
+{
+  host_conn_t *c = calloc(1, sizeof(host_conn_t));
+
+  if (c == NULL)
+    return NULL;
+  c->esp = esp;
+  c->fd = fd;
+  c->active_us = host_time_us();
+  c->next = conns;
+  conns = c;
+  return c;
+}
+
+static void host_conn_update(host_conn_t *c)
+{
+  short events = 0;
+
+  if (!c->hold && !c->connecting)
+    events |= POLLIN;
+  if (c->connecting || c->out || c->closing || c->sent_pending)
+    events |= POLLOUT;
+  host_watch(c->fd, events, HOST_NO_INUM, host_conn_ready, c);
+}
+
+// Drop a connection, the callbacks are up to the caller
+static void host_conn_free(host_conn_t *c)
+{
+  host_conn_t **pp;
+  host_chunk_t *k;
+
+  for (pp = &conns; *pp; pp = &(*pp)->next)
+  {
+    if (*pp == c)
+    {
+      *pp = c->next;
+      break;
+    }
+  }
+  host_unwatch(c->fd);
+  close(c->fd);
+  while ((k = c->out) != NULL)
+  {
+    c->out = k->next;
+    free(k);
+  }
+  free(c);
+}
+
+// The connection is gone, err is ESPCONN_OK for an orderly close
+static void host_conn_closed(host_conn_t *c, sint8 err)
+{
+  struct espconn *esp = c->esp;
+  bool accepted = c->accepted;
+  esp_tcp *tcp = esp->proto.tcp;
+
+  host_conn_free(c);
+  if (err == ESPCONN_OK)
+  {
+    if (tcp->disconnect_callback)
+      tcp->disconnect_callback(esp);
+  }
+  else if (tcp->reconnect_callback)
+    tcp->reconnect_callback(esp, err);
+
+  if (accepted)
+  {
+    os_free(tcp);
+    os_free(esp);
+  }
+}
+
+static sint8 host_net_error(int err)
+{
+  switch (err)
+  {
+    case ECONNREFUSED:
+    case ECONNRESET:
+    case EPIPE:
+      return ESPCONN_RST;
+    case ETIMEDOUT:
+      return ESPCONN_TIMEOUT;
+    case ENETUNREACH:
+    case EHOSTUNREACH:
+      return ESPCONN_RTE;
+    default:
+      return ESPCONN_ABRT;
+  }
+}
+
+static void host_sockaddr(struct sockaddr_in *sa, const uint8 *ip, int port)
+{
+  memset(sa, 0, sizeof(*sa));
+  sa->sin_family = AF_INET;
+  sa->sin_port = htons(port);
+  memcpy(&sa->sin_addr, ip, 4);
+}
+
+static int host_socket(int type)
+{
+  int fd = socket(AF_INET, type, 0);
+
+  if (fd >= 0)
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+/******************************************************************************
+ * Idle timeout of the clients of a listener
+ */
+
+static void host_net_idle(void *arg)
+{
+  uint64_t now = host_time_us();
+  host_conn_t *c, *next;
+  bool any = false;
+
+  for (c = conns; c; c = next)
+  {
+    next = c->next;
+    if (!c->accepted || c->timeout == 0)
+      continue;
+    if (now - c->active_us >= (uint64_t)c->timeout * 1000000)
+    {
+      host_conn_closed(c, ESPCONN_OK);
+      // The callbacks may have closed others
+      next = conns;
+      continue;
+    }
+    any = true;
+  }
+  if (!any)
+  {
+    os_timer_disarm(&idle_timer);
+    idle_armed = false;
+  }
+}
+
+static void host_net_idle_start(void)
+{
+  if (idle_armed)
+    return;
+  idle_armed = true;
+  os_timer_disarm(&idle_timer);
+  os_timer_setfn(&idle_timer, host_net_idle, NULL);
+  os_timer_arm(&idle_timer, 1000, 1);
+}
+
+/******************************************************************************
+ * Event handling
+ */
+
+static void host_tcp_accept(host_conn_t *server)
+{
+  struct espconn *listen = server->esp;
+  struct sockaddr_in sa;
+  socklen_t len = sizeof(sa);
+  struct espconn *esp;
+  esp_tcp *tcp;
+  host_conn_t *c;
+  int fd;
+
+  fd = accept(server->fd, (struct sockaddr *)&sa, &len);
+  if (fd < 0)
+    return;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  esp = (struct espconn *)os_zalloc(sizeof(struct espconn));
+  tcp = (esp_tcp *)os_zalloc(sizeof(esp_tcp));
+  if (esp == NULL || tcp == NULL || (c = host_conn_new(esp, fd)) == NULL)
+  {
+    os_free(tcp);
+    os_free(esp);
+    close(fd);
+    return;
+  }
+
+  // The client starts out with the callbacks of the listener
+  *esp = *listen;
+  *tcp = *listen->proto.tcp;
+  esp->proto.tcp = tcp;
+  esp->state = ESPCONN_CONNECT;
+  memcpy(esp->proto.tcp->remote_ip, &sa.sin_addr, 4);
+  esp->proto.tcp->remote_port = ntohs(sa.sin_port);
+  memcpy(esp->proto.tcp->local_ip, "\x7f\0\0\x01", 4);
+
+  c->accepted = true;
+  c->timeout = server->timeout;
+  if (c->timeout)
+    host_net_idle_start();
+  host_conn_update(c);
+
+  if (esp->proto.tcp->connect_callback)
+    esp->proto.tcp->connect_callback(esp);
+}
+
+static void host_tcp_connected(host_conn_t *c)
+{
+  struct espconn *esp = c->esp;
+  socklen_t len = sizeof(int);
+  int err = c->error;
+
+  if (err == 0)
+    getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+  if (err)
+  {
+    esp->state = ESPCONN_CLOSE;
+    host_conn_closed(c, host_net_error(err));
+    return;
+  }
+  c->connecting = false;
+  esp->state = ESPCONN_CONNECT;
+  host_conn_update(c);
+  if (esp->proto.tcp->connect_callback)
+    esp->proto.tcp->connect_callback(esp);
+}
+
+static void host_tcp_read(host_conn_t *c)
+{
+  char buf[HOST_TCP_MSS];
+  int len;
+
+  len = recv(c->fd, buf, sizeof(buf), 0);
+  if (len < 0 && (errno == EAGAIN || errno == EINTR))
+    return;
+  if (len <= 0)
+  {
+    c->esp->state = ESPCONN_CLOSE;
+    host_conn_closed(c, len == 0 ? ESPCONN_OK : host_net_error(errno));
+    return;
+  }
+  c->active_us = host_time_us();
+  c->esp->state = ESPCONN_READ;
+  if (c->esp->recv_callback)
+    c->esp->recv_callback(c->esp, buf, len);
+}
+
+static void host_tcp_write(host_conn_t *c)
+{
+  host_chunk_t *k;
+  int len;
+
+  while ((k = c->out) != NULL)
+  {
+    len = send(c->fd, k->data + k->off, k->len - k->off, MSG_NOSIGNAL);
+    if (len < 0)
+    {
+      if (errno == EAGAIN || errno == EINTR)
+        return;
+      host_conn_closed(c, host_net_error(errno));
+      return;
+    }
+    c->active_us = host_time_us();
+    k->off += len;
+    if (k->off < k->len)
+      return;
+
+    c->out = k->next;
+    free(k);
+    c->esp->state = ESPCONN_WRITE;
+    host_conn_update(c);
+    if (c->esp->sent_callback)
+    {
+      c->esp->sent_callback(c->esp);
+      if (!host_conn_alive(c))
+        return;
+    }
+  }
+
+  if (c->closing)
+  {
+    c->esp->state = ESPCONN_CLOSE;
+    shutdown(c->fd, SHUT_RDWR);
+    host_conn_closed(c, ESPCONN_OK);
+  }
+}
+
+static void host_udp_read(host_conn_t *c)
+{
+  char buf[HOST_UDP_MAX];
+  struct sockaddr_in sa;
+  socklen_t salen = sizeof(sa);
+  esp_udp *udp = c->esp->proto.udp;
+  int len;
+
+  len = recvfrom(c->fd, buf, sizeof(buf), 0, (struct sockaddr *)&sa, &salen);
+  if (len < 0)
+    return;
+  memcpy(udp->remote_ip, &sa.sin_addr, 4);
+  udp->remote_port = ntohs(sa.sin_port);
+  if (c->esp->recv_callback)
+    c->esp->recv_callback(c->esp, buf, len);
+}
+
+static void host_udp_sent(host_conn_t *c)
+{
+  while (c->sent_pending)
+  {
+    c->sent_pending--;
+    host_conn_update(c);
+    if (c->esp->sent_callback)
+    {
+      c->esp->sent_callback(c->esp);
+      if (!host_conn_alive(c))
+        return;
+    }
+  }
+}
+
+static void host_conn_ready(int fd, short revents, void *arg)
+{
+  host_conn_t *c = arg;
+
+  if (c->listener)
+  {
+    host_tcp_accept(c);
+    return;
+  }
+  if (c->esp->type == ESPCONN_UDP)
+  {
+    if (revents & POLLIN)
+      host_udp_read(c);
+    if (host_conn_alive(c) && (revents & POLLOUT))
+      host_udp_sent(c);
+    return;
+  }
+  if (c->connecting)
+  {
+    host_tcp_connected(c);
+    return;
+  }
+  if (revents & (POLLIN | POLLHUP | POLLERR))
+  {
+    host_tcp_read(c);
+    if (!host_conn_alive(c))
+      return;
+  }
+  if (revents & POLLOUT)
+    host_tcp_write(c);
+}
+
+/******************************************************************************
+ * espconn
+ */
+
+void host_net_init(void)
+{
+  conns = NULL;
+  idle_armed = false;
+}
+
+uint32 espconn_port(void)
+{
+  if (next_port == 65535)
+    next_port = 49152;
+  return next_port++;
+}
+
+sint8 espconn_connect(struct espconn *espconn)
+{
+  esp_tcp *tcp = espconn->proto.tcp;
+  struct sockaddr_in sa;
+  host_conn_t *c;
+  int fd, err = 0;
+
+  if (espconn->type != ESPCONN_TCP || tcp == NULL)
+    return ESPCONN_ARG;
+  if (host_conn_find(espconn))
+    return ESPCONN_ISCONN;
+
+  fd = host_socket(SOCK_STREAM);
+  if (fd < 0)
+    return ESPCONN_MEM;
+  host_sockaddr(&sa, tcp->remote_ip, tcp->remote_port);
+  // A failure is reported through the reconnect callback, like a timeout
+  if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 && errno != EINPROGRESS)
+    err = errno;
+
+  c = host_conn_new(espconn, fd);
+  if (c == NULL)
+  {
+    close(fd);
+    return ESPCONN_MEM;
+  }
+  c->connecting = true;
+  c->error = err;
+  espconn->state = ESPCONN_WAIT;
+  host_conn_update(c);
+  return ESPCONN_OK;
+}
+
+sint8 espconn_accept(struct espconn *espconn)
+{
+  esp_tcp *tcp = espconn->proto.tcp;
+  struct sockaddr_in sa;
+  host_conn_t *c;
+  int fd, on = 1;
+
+  if (espconn->type != ESPCONN_TCP || tcp == NULL)
+    return ESPCONN_ARG;
+  if (host_conn_find(espconn))
+    return ESPCONN_ISCONN;
+
+  fd = host_socket(SOCK_STREAM);
+  if (fd < 0)
+    return ESPCONN_MEM;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  host_sockaddr(&sa, (const uint8 *)"\x7f\0\0\x01", tcp->local_port + host_port_offset);
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, 5) < 0 ||
+      (c = host_conn_new(espconn, fd)) == NULL)
+  {
+    perror("host: espconn_accept");
+    close(fd);
+    return ESPCONN_ISCONN;
+  }
+  c->listener = true;
+  espconn->state = ESPCONN_LISTEN;
+  host_watch(fd, POLLIN, HOST_NO_INUM, host_conn_ready, c);
+  return ESPCONN_OK;
+}
+
+sint8 espconn_create(struct espconn *espconn)
+{
+  esp_udp *udp = espconn->proto.udp;
+  struct sockaddr_in sa;
+  host_conn_t *c;
+  int fd, on = 1;
+
+  if (espconn->type != ESPCONN_UDP || udp == NULL)
+    return ESPCONN_ARG;
+  if (host_conn_find(espconn))
+    return ESPCONN_ISCONN;
+
+  fd = host_socket(SOCK_DGRAM);
+  if (fd < 0)
+    return ESPCONN_MEM;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+  host_sockaddr(&sa, (const uint8 *)"\0\0\0\0", udp->local_port ? udp->local_port + host_port_offset : 0);
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || (c = host_conn_new(espconn, fd)) == NULL)
+  {
+    perror("host: espconn_create");
+    close(fd);
+    return ESPCONN_ISCONN;
+  }
+  host_conn_update(c);
+  return ESPCONN_OK;
+}
+
+sint8 espconn_sent(struct espconn *espconn, uint8 *psent, uint16 length)
+{
+  host_conn_t *c = host_conn_find(espconn);
+  host_chunk_t *k, **pp;
+  struct sockaddr_in sa;
+
+  if (c == NULL || c->listener || c->connecting || c->closing)
+    return ESPCONN_ARG;
+
+  if (espconn->type == ESPCONN_UDP)
+  {
+    host_sockaddr(&sa, espconn->proto.udp->remote_ip, espconn->proto.udp->remote_port);
+    if (sendto(c->fd, psent, length, 0, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+      return ESPCONN_ARG;
+    c->sent_pending++;
+    host_conn_update(c);
+    return ESPCONN_OK;
+  }
+
+  k = malloc(sizeof(host_chunk_t) + length);
+  if (k == NULL)
+    return ESPCONN_MEM;
+  k->next = NULL;
+  k->len = length;
+  k->off = 0;
+  memcpy(k->data, psent, length);
+  for (pp = &c->out; *pp; pp = &(*pp)->next)
+    ;
+  *pp = k;
+  host_conn_update(c);
+  return ESPCONN_OK;
+}
+
+sint8 espconn_disconnect(struct espconn *espconn)
+{
+  host_conn_t *c = host_conn_find(espconn);
+
+  if (c == NULL || espconn->type != ESPCONN_TCP || c->listener)
+    return ESPCONN_ARG;
+  if (c->connecting)
+  {
+    // Nothing was established, nothing to report
+    host_conn_free(c);
+    espconn->state = ESPCONN_CLOSE;
+    return ESPCONN_OK;
+  }
+  c->closing = true;
+  host_conn_update(c);
+  return ESPCONN_OK;
+}
+
+sint8 espconn_delete(struct espconn *espconn)
+{
+  host_conn_t *c = host_conn_find(espconn);
+
+  if (c == NULL)
+    return ESPCONN_ARG;
+  host_conn_free(c);
+  espconn->state = ESPCONN_CLOSE;
+  return ESPCONN_OK;
+}
+
+sint8 espconn_regist_time(struct espconn *espconn, uint32 interval, uint8 type_flag)
+{
+  host_conn_t *c = host_conn_find(espconn);
+
+  if (c == NULL)
+    return ESPCONN_ARG;
+  c->timeout = interval;
+  return ESPCONN_OK;
+}
+
+sint8 espconn_regist_sentcb(struct espconn *espconn, espconn_sent_callback sent_cb)
+{
+  espconn->sent_callback = sent_cb;
+  return ESPCONN_OK;
+}
+
+sint8 espconn_regist_recvcb(struct espconn *espconn, espconn_recv_callback recv_cb)
+{
+  espconn->recv_callback = recv_cb;
+  return ESPCONN_OK;
+}
+
+sint8 espconn_regist_connectcb(struct espconn *espconn, espconn_connect_callback connect_cb)
+{
+  if (espconn->type != ESPCONN_TCP || espconn->proto.tcp == NULL)
+    return ESPCONN_ARG;
+  espconn->proto.tcp->connect_callback = connect_cb;
+  return ESPCONN_OK;
+}
+
+sint8 espconn_regist_reconcb(struct espconn *espconn, espconn_reconnect_callback recon_cb)
+{
+  if (espconn->type != ESPCONN_TCP || espconn->proto.tcp == NULL)
+    return ESPCONN_ARG;
+  espconn->proto.tcp->reconnect_callback = recon_cb;
+  return ESPCONN_OK;
+}
+
+sint8 espconn_regist_disconcb(struct espconn *espconn, espconn_connect_callback discon_cb)
+{
+  if (espconn->type != ESPCONN_TCP || espconn->proto.tcp == NULL)
+    return ESPCONN_ARG;
+  espconn->proto.tcp->disconnect_callback = discon_cb;
+  return ESPCONN_OK;
+}
+
+sint8 espconn_recv_hold(struct espconn *espconn)
+{
+  host_conn_t *c = host_conn_find(espconn);
+
+  if (c == NULL)
+    return ESPCONN_ARG;
+  c->hold = true;
+  host_conn_update(c);
+  return ESPCONN_OK;
+}
+
+sint8 espconn_recv_unhold(struct espconn *espconn)
+{
+  host_conn_t *c = host_conn_find(espconn);
+
+  if (c == NULL)
+    return ESPCONN_ARG;
+  c->hold = false;
+  host_conn_update(c);
+  return ESPCONN_OK;
+}
+
+/******************************************************************************
+ * DNS
+ */
+
+u32_t ipaddr_addr(const char *cp)
+{
+  struct in_addr in;
+
+  if (inet_aton(cp, &in) == 0)
+    return IPADDR_NONE;
+  return in.s_addr;
+}
+
+static void host_dns_done(void *arg)
+{
+  host_dns_t *q = arg;
+
+  q->found(q->name, q->ok ? &q->ip : NULL, q->arg);
+  free(q);
+}
+
+// Numeric names resolve right away, others are looked up on the host and
+// reported a bit later, like the answer of a DNS server would be
+err_t espconn_gethostbyname(struct espconn *pespconn, const char *hostname, ip_addr_t *addr, dns_found_callback found)
+{
+  struct addrinfo hints, *res = NULL;
+  host_dns_t *q;
+
+  if (hostname == NULL || addr == NULL)
+    return ESPCONN_ARG;
+  addr->addr = ipaddr_addr(hostname);
+  if (addr->addr != IPADDR_NONE)
+    return ESPCONN_OK;
+
+  q = malloc(sizeof(host_dns_t) + strlen(hostname) + 1);
+  if (q == NULL)
+    return ESPCONN_MEM;
+  strcpy(q->name, hostname);
+  q->found = found;
+  q->arg = pespconn;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  q->ok = getaddrinfo(hostname, NULL, &hints, &res) == 0 && res;
+  if (q->ok)
+    q->ip.addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+  if (res)
+    freeaddrinfo(res);
+
+  os_timer_disarm(&q->timer);
+  os_timer_setfn(&q->timer, host_dns_done, q);
+  os_timer_arm(&q->timer, 10, 0);
+  return ESPCONN_INPROGRESS;
+}
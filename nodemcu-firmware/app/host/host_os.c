@@ -0,0 +1,606 @@
+/*
+ * Host replacement of the SDK scheduler: the tasks, the os_timers, the
+ * interrupt masks, the heap and the system_* calls.
+ *
+ * host_run() is the ets_run() of the host. A pass runs the due timers, polls
+ * the watched file descriptors, which stand in for the interrupt sources, and
+ * then runs a batch of task events, highest priority first. Like on the
+ * target nothing preempts a task, a device is only served between two events
+ * and only while its interrupt is unmasked.
+ */
+
+#include <errno.h>
+#include <malloc.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "ets_sys.h"
+#include "os_type.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "host.h"
+
+#define HOST_MAX_WATCH          32
+#define HOST_TASK_BATCH         16      // events between two polls
+
+typedef struct
+{
+  os_task_t task;
+  os_event_t *queue;
+  uint8 qlen;
+  uint8 head;
+  uint8 count;
+} host_task_t;
+
+typedef struct
+{
+  int fd;
+  short events;
+  int inum;
+  host_fd_fn fn;
+  void *arg;
+} host_watch_t;
+
+static uint64_t start_us;
+static host_task_t tasks[ USER_TASK_PRIO_MAX ];
+static ETSTimer *timers;                // armed, sorted by expiry
+static host_watch_t watches[ HOST_MAX_WATCH ];
+static unsigned watch_num;
+
+static void (*isr_fn[ 32 ])(void *);
+static void *isr_arg[ 32 ];
+static uint32 isr_masked = 0xffffffff;
+static unsigned intr_lock;
+
+static uint32 heap_size;
+static uint32 heap_used;
+
+static bool stop;
+static bool exit_when_idle;
+static init_done_cb_t init_done;
+
+/******************************************************************************
+ * Clock
+ */
+
+static uint64_t host_clock_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Microseconds since the start of the process
+uint64_t host_time_us(void)
+{
+  return host_clock_us() - start_us;
+}
+
+// Added to system_get_time(), a test can have the counter wrap when it likes
+uint32 host_time_offset;
+
+uint32 system_get_time(void)
+{
+  return (uint32)host_time_us() + host_time_offset;
+}
+
+// The RTC runs at the nominal 5.75 us per tick, see system_rtc_clock_cali_proc()
+uint32 system_get_rtc_time(void)
+{
+  return (uint32)(host_time_us() * 4 / 23);
+}
+
+uint32 system_rtc_clock_cali_proc(void)
+{
+  return (23 << 12) / 4;
+}
+
+void ets_delay_us(uint32_t us)
+{
+  uint64_t end = host_clock_us() + us;
+
+  while (host_clock_us() < end)
+    ;
+}
+
+/******************************************************************************
+ * Tasks
+ */
+
+bool system_os_task(os_task_t task, uint8 prio, os_event_t *queue, uint8 qlen)
+{
+  if (prio >= USER_TASK_PRIO_MAX || queue == NULL || qlen == 0)
+    return false;
+  tasks[prio].task = task;
+  tasks[prio].queue = queue;
+  tasks[prio].qlen = qlen;
+  tasks[prio].head = 0;
+  tasks[prio].count = 0;
+  return true;
+}
+
+bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par)
+{
+  host_task_t *t;
+  os_event_t *e;
+
+  if (prio >= USER_TASK_PRIO_MAX)
+    return false;
+  t = &tasks[prio];
+  if (t->task == NULL || t->count == t->qlen)
+    return false;
+  e = &t->queue[(t->head + t->count) % t->qlen];
+  e->sig = sig;
+  e->par = par;
+  t->count++;
+  return true;
+}
+
+static bool host_tasks_pending(void)
+{
+  int prio;
+
+  for (prio = 0; prio < USER_TASK_PRIO_MAX; prio++)
+    if (tasks[prio].count)
+      return true;
+  return false;
+}
+
+// Run the oldest event of the highest priority task, false if there is none
+static bool host_task_run(void)
+{
+  host_task_t *t;
+  os_event_t e;
+  int prio;
+
+  for (prio = USER_TASK_PRIO_MAX - 1; prio >= 0; prio--)
+  {
+    t = &tasks[prio];
+    if (t->count == 0)
+      continue;
+    // The task may post to its own queue
+    e = t->queue[t->head];
+    t->head = (t->head + 1) % t->qlen;
+    t->count--;
+    t->task(&e);
+    return true;
+  }
+  return false;
+}
+
+/******************************************************************************
+ * os_timer
+ *
+ * The timers are kept in a list sorted by expiry, the ETSTimer fields hold
+ * ms: the expiry in the host_time_us() / 1000 clock and the period.
+ */
+
+#define HOST_MS_DIFF(a, b)      ((int32_t)((a) - (b)))
+
+static uint32 host_now_ms(void)
+{
+  return (uint32)(host_time_us() / 1000);
+}
+
+static void host_timer_insert(ETSTimer *ptimer)
+{
+  ETSTimer **pp = &timers;
+
+  while (*pp && HOST_MS_DIFF((*pp)->timer_expire, ptimer->timer_expire) <= 0)
+    pp = &(*pp)->timer_next;
+  ptimer->timer_next = *pp;
+  *pp = ptimer;
+}
+
+void ets_timer_disarm(ETSTimer *ptimer)
+{
+  ETSTimer **pp;
+
+  for (pp = &timers; *pp; pp = &(*pp)->timer_next)
+  {
+    if (*pp == ptimer)
+    {
+      *pp = ptimer->timer_next;
+      break;
+    }
+  }
+  ptimer->timer_next = NULL;
+}
+
+void ets_timer_setfn(ETSTimer *ptimer, void *pfunction, void *parg)
+{
+  ptimer->timer_func = (ETSTimerFunc *)pfunction;
+  ptimer->timer_arg = parg;
+}
+
+void ets_timer_arm_new(ETSTimer *ptimer, uint32_t time, uint8_t repeat_flag, int ms_flag)
+{
+  uint32 ms = ms_flag ? time : (time + 999) / 1000;
+
+  ets_timer_disarm(ptimer);
+  if (repeat_flag && ms == 0)
+    ms = 1;
+  ptimer->timer_period = repeat_flag ? ms : 0;
+  ptimer->timer_expire = host_now_ms() + ms;
+  host_timer_insert(ptimer);
+}
+
+static void host_timers_run(void)
+{
+  uint32 now = host_now_ms();
+  ETSTimer *t;
+
+  while ((t = timers) != NULL && HOST_MS_DIFF(t->timer_expire, now) <= 0)
+  {
+    timers = t->timer_next;
+    t->timer_next = NULL;
+    if (t->timer_period)
+    {
+      t->timer_expire += t->timer_period;
+      if (HOST_MS_DIFF(t->timer_expire, now) <= 0)
+        t->timer_expire = now + t->timer_period;
+      host_timer_insert(t);
+    }
+    if (t->timer_func)
+      t->timer_func(t->timer_arg);
+    if (stop)
+      break;
+  }
+}
+
+// ms until the first timer expires, -1 if none is armed
+static int host_timers_wait(void)
+{
+  int32_t wait;
+
+  if (timers == NULL)
+    return -1;
+  wait = HOST_MS_DIFF(timers->timer_expire, host_now_ms());
+  return wait < 0 ? 0 : wait;
+}
+
+/******************************************************************************
+ * Interrupts
+ */
+
+void ets_isr_attach(int intr, void *handler, void *arg)
+{
+  if (intr < 0 || intr >= 32)
+    return;
+  isr_fn[intr] = (void (*)(void *))handler;
+  isr_arg[intr] = arg;
+}
+
+void ets_isr_mask(uint32_t mask)
+{
+  isr_masked |= mask;
+}
+
+void ets_isr_unmask(uint32_t mask)
+{
+  isr_masked &= ~mask;
+  // GPIO status bits raised while masked
+  if (mask & (1UL << ETS_GPIO_INUM))
+    host_gpio_serve();
+}
+
+void ets_intr_lock(void)
+{
+  intr_lock++;
+}
+
+void ets_intr_unlock(void)
+{
+  if (intr_lock && --intr_lock == 0)
+    host_gpio_serve();
+}
+
+bool host_isr_enabled(int inum)
+{
+  if (inum == HOST_NO_INUM)
+    return true;
+  return intr_lock == 0 && !(isr_masked & (1UL << inum));
+}
+
+// Raise an interrupt, the handler runs right away unless it is masked
+void host_isr_call(int inum)
+{
+  if (host_isr_enabled(inum) && isr_fn[inum])
+    isr_fn[inum](isr_arg[inum]);
+}
+
+/******************************************************************************
+ * File descriptors
+ */
+
+// Watch fd for events, the watch is suspended while interrupt inum is masked
+void host_watch(int fd, short events, int inum, host_fd_fn fn, void *arg)
+{
+  unsigned i;
+
+  for (i = 0; i < watch_num; i++)
+    if (watches[i].fd == fd)
+      break;
+  if (i == watch_num)
+  {
+    if (watch_num == HOST_MAX_WATCH)
+    {
+      fprintf(stderr, "host: too many watched descriptors\n");
+      abort();
+    }
+    watch_num++;
+  }
+  watches[i].fd = fd;
+  watches[i].events = events;
+  watches[i].inum = inum;
+  watches[i].fn = fn;
+  watches[i].arg = arg;
+}
+
+void host_unwatch(int fd)
+{
+  unsigned i;
+
+  for (i = 0; i < watch_num; i++)
+  {
+    if (watches[i].fd == fd)
+    {
+      watches[i] = watches[--watch_num];
+      return;
+    }
+  }
+}
+
+static void host_poll(int timeout)
+{
+  struct pollfd fds[HOST_MAX_WATCH];
+  host_watch_t *w;
+  unsigned i, j, n = 0;
+
+  for (i = 0; i < watch_num; i++)
+  {
+    if (watches[i].events == 0 || !host_isr_enabled(watches[i].inum))
+      continue;
+    fds[n].fd = watches[i].fd;
+    fds[n].events = watches[i].events;
+    fds[n].revents = 0;
+    n++;
+  }
+  if (poll(fds, n, timeout) <= 0)
+    return;
+
+  // A handler may change the watches of any descriptor
+  for (i = 0; i < n; i++)
+  {
+    if (fds[i].revents == 0)
+      continue;
+    for (j = 0, w = NULL; j < watch_num; j++)
+      if (watches[j].fd == fds[i].fd)
+        w = &watches[j];
+    if (w && (w->events & fds[i].revents || fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)))
+      w->fn(w->fd, fds[i].revents, w->arg);
+  }
+}
+
+/******************************************************************************
+ * Peripheral registers, plain memory at their target addresses
+ */
+
+static bool host_map(uint32 base, uint32 size)
+{
+  void *p = mmap((void *)(uintptr_t)base, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+  if (p != (void *)(uintptr_t)base)
+  {
+    perror("host: can't map the registers");
+    return false;
+  }
+  return true;
+}
+
+bool host_map_registers(void)
+{
+  return host_map(HOST_PERI_BASE, HOST_PERI_SIZE) && host_map(HOST_DPORT_BASE, HOST_DPORT_SIZE);
+}
+
+/******************************************************************************
+ * Event loop
+ */
+
+void host_os_init(uint32 size)
+{
+  start_us = host_clock_us();
+  heap_size = size;
+}
+
+void system_init_done_cb(init_done_cb_t cb)
+{
+  init_done = cb;
+}
+
+// The SDK calls back once user_init() returned
+void host_init_done(void)
+{
+  if (init_done)
+    init_done();
+}
+
+void host_stop(void)
+{
+  stop = true;
+}
+
+// Leave host_run() once all task events are handled, e.g. at the end of the input
+void host_exit_when_idle(void)
+{
+  exit_when_idle = true;
+}
+
+// Run until host_stop(), the loop goes idle or max_us passed, 0 runs forever
+void host_run(uint32 max_us)
+{
+  uint64_t end = host_time_us() + max_us;
+  uint64_t now;
+  int timeout, left, n;
+
+  stop = false;
+  while (!stop)
+  {
+    host_timers_run();
+    if (stop)
+      break;
+
+    now = host_time_us();
+    if (max_us && now >= end)
+      break;
+    if (host_tasks_pending())
+      timeout = 0;
+    else if (exit_when_idle)
+      break;
+    else
+    {
+      timeout = host_timers_wait();
+      if (max_us)
+      {
+        left = (int)((end - now + 999) / 1000);
+        if (timeout < 0 || timeout > left)
+          timeout = left;
+      }
+      // The output is written out before the process blocks
+      host_uart_flush();
+    }
+    host_poll(timeout);
+
+    for (n = 0; n < HOST_TASK_BATCH && !stop && host_task_run(); n++)
+      ;
+  }
+  host_uart_flush();
+}
+
+/******************************************************************************
+ * Heap, limited to the size of the target heap
+ */
+
+void *pvPortMalloc(size_t size)
+{
+  void *p;
+
+  if (size > heap_size - heap_used)
+    return NULL;
+  p = malloc(size);
+  if (p)
+    heap_used += malloc_usable_size(p);
+  return p;
+}
+
+void *pvPortZalloc(size_t size)
+{
+  void *p = pvPortMalloc(size);
+
+  if (p)
+    memset(p, 0, size);
+  return p;
+}
+
+void *pvPortRealloc(void *ptr, size_t size)
+{
+  size_t old = ptr ? malloc_usable_size(ptr) : 0;
+  void *p;
+
+  if (size > old && size - old > heap_size - heap_used)
+    return NULL;
+  p = realloc(ptr, size);
+  if (p || size == 0)
+  {
+    heap_used -= old;
+    if (p)
+      heap_used += malloc_usable_size(p);
+  }
+  return p;
+}
+
+void vPortFree(void *ptr)
+{
+  if (ptr == NULL)
+    return;
+  heap_used -= malloc_usable_size(ptr);
+  free(ptr);
+}
+
+uint32 system_get_free_heap_size(void)
+{
+  return heap_size - heap_used;
+}
+
+/******************************************************************************
+ * System
+ */
+
+static uint8 os_print = 1;
+
+void system_set_os_print(uint8 onoff)
+{
+  os_print = onoff;
+}
+
+uint8 system_get_os_print(void)
+{
+  return os_print;
+}
+
+// SDK messages go to stderr, the console output stays clean
+int os_printf_plus(const char *format, ...)
+{
+  va_list ap;
+  int n;
+
+  if (!os_print)
+    return 0;
+  va_start(ap, format);
+  n = vfprintf(stderr, format, ap);
+  va_end(ap);
+  return n;
+}
+
+uint32 system_get_chip_id(void)
+{
+  return 0x00c0ffee;
+}
+
+const char *system_get_sdk_version(void)
+{
+  return "host";
+}
+
+// ADC reading of VDD33 in mV
+uint16 readvdd33(void)
+{
+  return 3300;
+}
+
+void system_restart(void)
+{
+  host_request_restart(0);
+}
+
+bool deep_sleep_set_option(uint8 option)
+{
+  return option <= 4;
+}
+
+bool system_deep_sleep_set_option(uint8 option)
+{
+  return deep_sleep_set_option(option);
+}
+
+// Sleeping is waiting, the wakeup is a reset
+void system_deep_sleep(uint32 time_in_us)
+{
+  host_request_restart(time_in_us);
+}
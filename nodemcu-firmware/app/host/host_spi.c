@@ -0,0 +1,91 @@
+/*
+ * Host SPI: the SPI and HSPI masters as a device on the mapped registers.
+ *
+ * driver/spi.c starts a transfer by setting SPI_USR in SPI_CMD and spins
+ * until the bit clears. With a sink attached, a thread of its own plays the
+ * master: it hands the SPI_USER1 MOSI bit length worth of SPI_W0.. bytes to
+ * the sink and clears SPI_USR. The sink runs in that thread while the
+ * firmware waits. Without a sink the registers stay plain memory and a
+ * transfer never ends, the firmware of the host build doesn't use SPI.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "ets_sys.h"
+#include "driver/spi_register.h"
+#include "host.h"
+
+#define HOST_SPI_NUM            2
+
+static host_spi_sink_t sinks[ HOST_SPI_NUM ];
+static pthread_t thread;
+static volatile bool running;
+
+static uint32 host_spi_reg(uint32 addr)
+{
+  return __atomic_load_n((volatile uint32 *)addr, __ATOMIC_ACQUIRE);
+}
+
+// Run the transfer pending on SPI id
+static void host_spi_transfer(unsigned id, host_spi_sink_t sink)
+{
+  uint8 data[ 64 ];
+  uint32 bits = ((host_spi_reg(SPI_USER1(id)) >> SPI_USR_MOSI_BITLEN_S) & SPI_USR_MOSI_BITLEN) + 1;
+  uint32 len = bits / 8, i;
+
+  // the first byte is the low byte of SPI_W0
+  for (i = 0; i < len && i < sizeof(data); i++)
+    data[i] = host_spi_reg(SPI_W0(id) + (i & ~3)) >> ((i & 3) * 8);
+  sink(id, data, i);
+  __atomic_and_fetch((volatile uint32 *)SPI_CMD(id), ~SPI_USR, __ATOMIC_RELEASE);
+}
+
+static void *host_spi_thread(void *arg)
+{
+  host_spi_sink_t sink;
+  unsigned id;
+  bool busy;
+
+  while (running)
+  {
+    busy = false;
+    for (id = 0; id < HOST_SPI_NUM; id++)
+    {
+      sink = sinks[id];
+      if (sink && (host_spi_reg(SPI_CMD(id)) & SPI_USR))
+      {
+        host_spi_transfer(id, sink);
+        busy = true;
+      }
+    }
+    if (!busy)
+      sched_yield();
+  }
+  return NULL;
+}
+
+// Receive what SPI id sends, NULL detaches. The first sink starts the thread.
+void host_spi_attach(unsigned id, host_spi_sink_t sink)
+{
+  bool any = false;
+  unsigned i;
+
+  if (id >= HOST_SPI_NUM)
+    return;
+  sinks[id] = sink;
+  for (i = 0; i < HOST_SPI_NUM; i++)
+    any |= sinks[i] != NULL;
+
+  if (any && !running)
+  {
+    running = true;
+    if (pthread_create(&thread, NULL, host_spi_thread, NULL) != 0)
+      running = false;
+  }
+  else if (!any && running)
+  {
+    running = false;
+    pthread_join(thread, NULL);
+  }
+}
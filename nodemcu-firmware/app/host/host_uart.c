@@ -0,0 +1,313 @@
+/*
+ * Host UART: replaces driver/uart.c.
+ *
+ * UART0 is the console on stdin / stdout, UART1, the debug output, goes to
+ * stderr. Input is taken while the UART interrupt is unmasked and put into
+ * the RX ring by the same code the RX interrupt handler of the target runs,
+ * up to a FIFO worth of bytes per "interrupt". Unlike a terminal a pipe can
+ * be faster than the console, stdin is only read as far as the ring has
+ * room, a script piped in is not cut. A terminal on stdin is put into raw
+ * mode for the time the firmware runs.
+ *
+ * The UART1 TX FIFO empties at once. While a TX FIFO empty handler is
+ * attached, it is called every millisecond the interrupt is enabled with
+ * a threshold above the (empty) FIFO.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "mem.h"
+#include "driver/uart.h"
+#include "host.h"
+
+#define UART0   0
+#define UART1   1
+
+// Initialized by the rom on the target
+static uint8 rom_rx_buff[RX_BUFF_SIZE];
+UartDevice UartDev = {
+    .baut_rate = BIT_RATE_74880,
+    .data_bits = EIGHT_BITS,
+    .rcv_buff = {
+        .RcvBuffSize = RX_BUFF_SIZE,
+        .pRcvMsgBuff = rom_rx_buff,
+        .pWritePos = rom_rx_buff,
+        .pReadPos = rom_rx_buff,
+        .TrigLvl = 1,
+        .BuffState = EMPTY,
+    },
+};
+
+LOCAL uart_tx_empty_handler uart1_tx_empty = NULL;
+LOCAL ETSTimer uart1_tx_timer;
+LOCAL uart_rx_handler uart0_rx_notify = NULL;
+LOCAL uint8 *uart0_rx_buff = NULL;
+LOCAL uint8 *uart0_rom_rx_buff = NULL;
+
+LOCAL bool exit_on_eof = true;
+LOCAL bool raw_mode = false;
+LOCAL struct termios saved_termios;
+
+/******************************************************************************
+ * TX
+ */
+
+STATUS uart_tx_one_char(uint8 uart, uint8 TxChar)
+{
+    putc(TxChar, uart == UART1 ? stderr : stdout);
+    return OK;
+}
+
+LOCAL void
+uart1_write_char(char c)
+{
+    if (c == '\n') {
+        uart_tx_one_char(UART1, '\r');
+        uart_tx_one_char(UART1, '\n');
+    } else if (c == '\r') {
+    } else {
+        uart_tx_one_char(UART1, c);
+    }
+}
+
+void uart0_tx_buffer(uint8 *buf, uint16 len)
+{
+    fwrite(buf, 1, len, stdout);
+}
+
+void uart0_sendStr(const char *str)
+{
+    while (*str) {
+        uart0_putc(*str++);
+    }
+}
+
+void uart0_putc(const char c)
+{
+    if (c == '\n') {
+        uart_tx_one_char(UART0, '\r');
+        uart_tx_one_char(UART0, '\n');
+    } else if (c == '\r') {
+    } else {
+        uart_tx_one_char(UART0, c);
+    }
+}
+
+// Hand the output to the terminal, stdout is fully buffered
+void host_uart_flush(void)
+{
+    fflush(stdout);
+}
+
+/******************************************************************************
+ * RX
+ */
+
+// The receive part of uart0_rx_intr_handler()
+LOCAL void
+uart0_rx_bytes(RcvMsgBuff *pRxBuff, const uint8 *data, int len)
+{
+    uint8 RcvChar;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        RcvChar = data[i];
+        *(pRxBuff->pWritePos) = RcvChar;
+
+        if (RcvChar == '\r' || RcvChar == '\n' ) {
+            pRxBuff->BuffState = WRITE_OVER;
+        }
+
+        if (pRxBuff->pWritePos == (pRxBuff->pRcvMsgBuff + pRxBuff->RcvBuffSize - 1)) {
+            pRxBuff->pWritePos = pRxBuff->pRcvMsgBuff ;
+        } else {
+            pRxBuff->pWritePos++;
+        }
+
+        if (pRxBuff->pWritePos == pRxBuff->pReadPos){
+            if (pRxBuff->pReadPos == (pRxBuff->pRcvMsgBuff + pRxBuff->RcvBuffSize - 1)) {
+                pRxBuff->pReadPos = pRxBuff->pRcvMsgBuff ;
+            } else {
+                pRxBuff->pReadPos++;
+            }
+        }
+    }
+}
+
+// Bytes the RX ring takes before it overwrites unread ones
+LOCAL int
+uart0_rx_room(RcvMsgBuff *pRxBuff)
+{
+    int used = pRxBuff->pWritePos - pRxBuff->pReadPos;
+
+    if (used < 0) {
+        used += pRxBuff->RcvBuffSize;
+    }
+    return pRxBuff->RcvBuffSize - 1 - used;
+}
+
+// stdin is readable and the UART interrupt enabled
+LOCAL void
+uart0_rx_ready(int fd, short revents, void *arg)
+{
+    uint8 fifo[UART_FIFO_LEN];
+    int len = sizeof(fifo);
+    int room = uart0_rx_room(&(UartDev.rcv_buff));
+
+    // A full ring without a line in it takes the bytes all the same
+    if (room > 0 && room < len) {
+        len = room;
+    }
+    len = read(fd, fifo, len);
+    if (len < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+    if (len <= 0) {
+        // End of the input, the firmware is done once it handled what it got
+        host_unwatch(fd);
+        if (exit_on_eof) {
+            host_exit_when_idle();
+        }
+        return;
+    }
+
+    uart0_rx_bytes(&(UartDev.rcv_buff), fifo, len);
+    if (uart0_rx_notify) {
+        uart0_rx_notify();
+    }
+}
+
+/******************************************************************************
+ * Driver interface
+ */
+
+void uart_setup(uint8 uart_no)
+{
+}
+
+void uart_init(UartBautRate uart0_br, UartBautRate uart1_br)
+{
+    UartDev.rcv_buff.RcvBuffSize = RX_BUFF_SIZE;
+    UartDev.baut_rate = uart0_br;
+    ETS_UART_INTR_ENABLE();
+
+#ifndef NODE_DEBUG
+    os_install_putc1((void *)uart1_write_char);
+#endif
+}
+
+LOCAL void uart1_tx_tick(void *arg)
+{
+    uint32 thrhd = (READ_PERI_REG(UART_CONF1(UART1)) >> UART_TXFIFO_EMPTY_THRHD_S) & UART_TXFIFO_EMPTY_THRHD;
+
+    if (uart1_tx_empty && host_isr_enabled(ETS_UART_INUM) && thrhd > 0
+        && (READ_PERI_REG(UART_INT_ENA(UART1)) & UART_TXFIFO_EMPTY_INT_ENA)) {
+        uart1_tx_empty();
+    }
+}
+
+void uart1_tx_empty_attach(uart_tx_empty_handler handler)
+{
+    uart1_tx_empty = handler;
+    os_timer_disarm(&uart1_tx_timer);
+    if (handler) {
+        os_timer_setfn(&uart1_tx_timer, uart1_tx_tick, NULL);
+        os_timer_arm(&uart1_tx_timer, 1, 1);
+    }
+}
+
+void uart0_rx_attach(uart_rx_handler handler)
+{
+    ETS_UART_INTR_DISABLE();
+    uart0_rx_notify = handler;
+    ETS_UART_INTR_ENABLE();
+}
+
+bool uart0_rx_buffer_resize(uint32 size)
+{
+    RcvMsgBuff *pRxBuff = &(UartDev.rcv_buff);
+    uint8 *buff = NULL;
+    uint8 *old;
+
+    if (size > RX_BUFF_SIZE) {
+        buff = (uint8 *)os_malloc(size);
+        if (buff == NULL) {
+            return false;
+        }
+    }
+
+    ETS_UART_INTR_DISABLE();
+    old = uart0_rx_buff;
+    if (buff == NULL) {
+        if (old != NULL) {
+            pRxBuff->pRcvMsgBuff = uart0_rom_rx_buff;
+        }
+        pRxBuff->RcvBuffSize = RX_BUFF_SIZE;
+    } else {
+        if (old == NULL) {
+            uart0_rom_rx_buff = pRxBuff->pRcvMsgBuff;
+        }
+        pRxBuff->pRcvMsgBuff = buff;
+        pRxBuff->RcvBuffSize = size;
+    }
+    uart0_rx_buff = buff;
+    pRxBuff->pWritePos = pRxBuff->pRcvMsgBuff;
+    pRxBuff->pReadPos = pRxBuff->pRcvMsgBuff;
+    ETS_UART_INTR_ENABLE();
+
+    if (old != NULL) {
+        os_free(old);
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Console
+ */
+
+LOCAL void (*putc1)(char c);
+
+void ets_install_putc1(void *routine)
+{
+    putc1 = (void (*)(char))routine;
+}
+
+void ets_putc(char c)
+{
+    if (putc1) {
+        putc1(c);
+    }
+}
+
+void host_uart_open(bool exit_at_eof)
+{
+    struct termios raw;
+
+    exit_on_eof = exit_at_eof;
+    setvbuf(stdout, NULL, _IOFBF, 4096);
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved_termios) == 0) {
+        // Bytes as they come, ^C still ends the process
+        raw = saved_termios;
+        raw.c_iflag &= ~(ICRNL | IXON);
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        raw_mode = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+    host_watch(STDIN_FILENO, POLLIN, ETS_UART_INUM, uart0_rx_ready, NULL);
+}
+
+void host_uart_close(void)
+{
+    host_uart_flush();
+    if (raw_mode) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+        raw_mode = false;
+    }
+}
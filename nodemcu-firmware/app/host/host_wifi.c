@@ -0,0 +1,223 @@
+/*
+ * Host WiFi: the station is always associated, its address is the loopback
+ * one, so the net module reaches local services. The soft AP, sniffing and
+ * the scan are kept as state only, a scan finds the station's access point.
+ */
+
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "host.h"
+
+static uint8 opmode = STATION_MODE;
+static uint8 auto_connect = 1;
+static uint8 channel = 1;
+static uint8 connect_status = STATION_GOT_IP;
+static enum sleep_type sleep_type = MODEM_SLEEP_T;
+static struct station_config station_config;
+static struct softap_config softap_config = {
+    .ssid = "ESP_C0FFEE",
+    .ssid_len = 10,
+    .channel = 1,
+    .authmode = AUTH_OPEN,
+    .max_connection = 4,
+    .beacon_interval = 100,
+};
+static struct ip_info ip_info[2];
+static uint8 macaddr[2][6] = {
+    { 0x18, 0xfe, 0x34, 0xc0, 0xff, 0xee },
+    { 0x1a, 0xfe, 0x34, 0xc0, 0xff, 0xee },
+};
+
+static os_timer_t scan_timer;
+static scan_done_cb_t scan_cb;
+static struct bss_info scan_list[2];
+
+void host_wifi_init(void)
+{
+  IP4_ADDR(&ip_info[STATION_IF].ip, 127, 0, 0, 1);
+  IP4_ADDR(&ip_info[STATION_IF].netmask, 255, 0, 0, 0);
+  IP4_ADDR(&ip_info[STATION_IF].gw, 127, 0, 0, 1);
+  IP4_ADDR(&ip_info[SOFTAP_IF].ip, 192, 168, 4, 1);
+  IP4_ADDR(&ip_info[SOFTAP_IF].netmask, 255, 255, 255, 0);
+  IP4_ADDR(&ip_info[SOFTAP_IF].gw, 192, 168, 4, 1);
+}
+
+uint8 wifi_get_opmode(void)
+{
+  return opmode;
+}
+
+bool wifi_set_opmode(uint8 mode)
+{
+  if (mode > STATIONAP_MODE)
+    return false;
+  opmode = mode;
+  return true;
+}
+
+bool wifi_station_get_config(struct station_config *config)
+{
+  *config = station_config;
+  return true;
+}
+
+bool wifi_station_set_config(struct station_config *config)
+{
+  station_config = *config;
+  return true;
+}
+
+bool wifi_station_connect(void)
+{
+  connect_status = STATION_GOT_IP;
+  return true;
+}
+
+bool wifi_station_disconnect(void)
+{
+  connect_status = STATION_IDLE;
+  return true;
+}
+
+uint8 wifi_station_get_connect_status(void)
+{
+  return connect_status;
+}
+
+uint8 wifi_station_get_auto_connect(void)
+{
+  return auto_connect;
+}
+
+bool wifi_station_set_auto_connect(uint8 set)
+{
+  auto_connect = set;
+  return true;
+}
+
+bool wifi_station_dhcpc_start(void)
+{
+  return true;
+}
+
+bool wifi_station_dhcpc_stop(void)
+{
+  return true;
+}
+
+static void host_wifi_scan_done(void *arg)
+{
+  scan_done_cb_t cb = scan_cb;
+
+  // The first entry is the list head, see wifi_scan_done()
+  memset(scan_list, 0, sizeof(scan_list));
+  scan_list[0].next.stqe_next = &scan_list[1];
+  memcpy(scan_list[1].ssid, station_config.ssid, sizeof(scan_list[1].ssid));
+  memcpy(scan_list[1].bssid, macaddr[SOFTAP_IF], sizeof(scan_list[1].bssid));
+  scan_list[1].channel = channel;
+  scan_list[1].rssi = -40;
+  scan_list[1].authmode = station_config.password[0] ? AUTH_WPA2_PSK : AUTH_OPEN;
+
+  scan_cb = NULL;
+  if (cb)
+    cb(scan_list, OK);
+}
+
+bool wifi_station_scan(struct scan_config *config, scan_done_cb_t cb)
+{
+  if (scan_cb)
+    return false;
+  scan_cb = cb;
+  os_timer_disarm(&scan_timer);
+  os_timer_setfn(&scan_timer, host_wifi_scan_done, NULL);
+  os_timer_arm(&scan_timer, 100, 0);
+  return true;
+}
+
+bool wifi_softap_get_config(struct softap_config *config)
+{
+  *config = softap_config;
+  return true;
+}
+
+bool wifi_softap_set_config(struct softap_config *config)
+{
+  softap_config = *config;
+  return true;
+}
+
+bool wifi_softap_dhcps_start(void)
+{
+  return true;
+}
+
+bool wifi_softap_dhcps_stop(void)
+{
+  return true;
+}
+
+bool wifi_get_ip_info(uint8 if_index, struct ip_info *info)
+{
+  if (if_index > SOFTAP_IF)
+    return false;
+  *info = ip_info[if_index];
+  return true;
+}
+
+bool wifi_set_ip_info(uint8 if_index, struct ip_info *info)
+{
+  if (if_index > SOFTAP_IF)
+    return false;
+  ip_info[if_index] = *info;
+  return true;
+}
+
+bool wifi_get_macaddr(uint8 if_index, uint8 *mac)
+{
+  if (if_index > SOFTAP_IF)
+    return false;
+  memcpy(mac, macaddr[if_index], 6);
+  return true;
+}
+
+bool wifi_set_macaddr(uint8 if_index, uint8 *mac)
+{
+  if (if_index > SOFTAP_IF)
+    return false;
+  memcpy(macaddr[if_index], mac, 6);
+  return true;
+}
+
+uint8 wifi_get_channel(void)
+{
+  return channel;
+}
+
+bool wifi_set_channel(uint8 ch)
+{
+  if (ch < 1 || ch > 13)
+    return false;
+  channel = ch;
+  return true;
+}
+
+bool wifi_set_sleep_type(enum sleep_type type)
+{
+  sleep_type = type;
+  return true;
+}
+
+enum sleep_type wifi_get_sleep_type(void)
+{
+  return sleep_type;
+}
+
+// No radio, nothing is ever sniffed
+void wifi_promiscuous_enable(uint8 promiscuous)
+{
+}
+
+void wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t cb)
+{
+}
@@ -0,0 +1,4 @@
+/*
+ * Stands in for the newlib header libc/c_stdlib.c includes, it needs
+ * nothing from it.
+ */
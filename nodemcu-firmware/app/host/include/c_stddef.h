@@ -0,0 +1,11 @@
+/*
+ * Host build replacement of libc/c_stddef.h, included ahead of every source
+ * (see ../Makefile): size_t and ptrdiff_t have to be the host ones.
+ */
+
+#ifndef __c_stddef_h
+#define __c_stddef_h
+
+#include <stddef.h>
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Host build replacement of the SDK c_types.h, included ahead of every
+ * source (see ../Makefile) so that the SDK header is skipped. The target
+ * types keep their widths on a 64 bit host.
+ */
+
+#ifndef _C_TYPES_H_
+#define _C_TYPES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef signed char         sint8_t;
+typedef signed short        sint16_t;
+typedef signed int          sint32_t;
+typedef signed long long    sint64_t;
+typedef float               real32_t;
+typedef double              real64_t;
+
+typedef unsigned char       uint8;
+typedef unsigned char       u8;
+typedef signed char         sint8;
+typedef signed char         int8;
+typedef signed char         s8;
+typedef unsigned short      uint16;
+typedef unsigned short      u16;
+typedef signed short        sint16;
+typedef signed short        s16;
+typedef unsigned int        uint32;
+typedef unsigned int        u_int;
+typedef unsigned int        u32;
+typedef signed int          sint32;
+typedef signed int          s32;
+typedef int                 int32;
+typedef signed long long    sint64;
+typedef unsigned long long  uint64;
+typedef unsigned long long  u64;
+typedef float               real32;
+typedef double              real64;
+
+#define __le16      u16
+
+#define __packed        __attribute__((packed))
+
+#define LOCAL       static
+
+typedef enum {
+    OK = 0,
+    FAIL,
+    PENDING,
+    BUSY,
+    CANCEL,
+} STATUS;
+
+#define BIT(nr)                 (1UL << (nr))
+
+#define REG_SET_BIT(_r, _b)  (*(volatile uint32_t*)(_r) |= (_b))
+#define REG_CLR_BIT(_r, _b)  (*(volatile uint32_t*)(_r) &= ~(_b))
+
+#define DMEM_ATTR
+#define SHMEM_ATTR
+
+// Everything is in RAM on the host
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+
+#ifndef __cplusplus
+typedef unsigned char   bool;
+#define BOOL            bool
+#define true            (1)
+#define false           (0)
+#define TRUE            true
+#define FALSE           false
+#endif /* !__cplusplus */
+
+#endif /* _C_TYPES_H_ */
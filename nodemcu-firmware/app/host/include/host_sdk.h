@@ -0,0 +1,68 @@
+/*
+ * ROM and SDK functions the SDK headers don't declare, included ahead of
+ * every source of the host build (see ../Makefile). The firmware calls
+ * them implicitly declared, which would truncate pointer results on a
+ * 64 bit host. The ROM string functions are the C library ones.
+ */
+
+#ifndef __HOST_SDK_H__
+#define __HOST_SDK_H__
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#define ets_bzero       bzero
+#define ets_memcmp      memcmp
+#define ets_memcpy      memcpy
+#define ets_memmove     memmove
+#define ets_memset      memset
+#define ets_strcmp      strcmp
+#define ets_strcpy      strcpy
+#define ets_strlen      strlen
+#define ets_strncmp     strncmp
+#define ets_strncpy     strncpy
+#define ets_strstr      strstr
+#define ets_sprintf     sprintf
+
+struct _ETSTIMER_;
+
+void ets_delay_us(uint32_t us);
+void ets_install_putc1(void *routine);
+void ets_putc(char c);
+void ets_intr_lock(void);
+void ets_intr_unlock(void);
+void ets_isr_attach(int intr, void *handler, void *arg);
+void ets_isr_mask(uint32_t mask);
+void ets_isr_unmask(uint32_t mask);
+void ets_timer_arm_new(struct _ETSTIMER_ *ptimer, uint32_t time, uint8_t repeat_flag, int ms_flag);
+void ets_timer_disarm(struct _ETSTIMER_ *ptimer);
+void ets_timer_setfn(struct _ETSTIMER_ *ptimer, void *pfunction, void *parg);
+void SPIEraseChip(void);
+int os_printf_plus(const char *format, ...);
+
+void *pvPortMalloc(size_t size);
+void *pvPortZalloc(size_t size);
+void *pvPortRealloc(void *ptr, size_t size);
+void vPortFree(void *ptr);
+
+uint32_t system_get_free_heap_size(void);
+uint32_t system_get_time(void);
+uint32_t system_get_rtc_time(void);
+uint32_t system_rtc_clock_cali_proc(void);
+uint16_t readvdd33(void);
+bool deep_sleep_set_option(uint8_t option);
+
+// The C library ones the firmware's libc maps to
+int abs(int j);
+int atoi(const char *nptr);
+long strtol(const char *nptr, char **endptr, int base);
+unsigned long strtoul(const char *nptr, char **endptr, int base);
+int rand(void);
+void srand(unsigned int seed);
+
+void uart0_putc(const char c);
+void uart0_sendStr(const char *str);
+uint8_t uart_getc(char *c);
+
+#endif /* __HOST_SDK_H__ */
@@ -0,0 +1,50 @@
+/*
+ * Configuration of the host build, see ../Makefile.
+ * Mirrors the firmware configuration with the hardware-only parts left out.
+ */
+
+#ifndef __USER_CONFIG_H__
+#define __USER_CONFIG_H__
+
+#include "user_version.h"
+
+// Size of the flash image file, see host_flash.c
+#define FLASH_4M
+
+#define NODE_ERROR
+
+#ifdef NODE_DEBUG
+#define NODE_DBG c_printf
+#else
+#define NODE_DBG
+#endif  /* NODE_DEBUG */
+
+#ifdef NODE_ERROR
+#define NODE_ERR c_printf
+#else
+#define NODE_ERR
+#endif  /* NODE_ERROR */
+
+#define ICACHE_STORE_TYPEDEF_ATTR __attribute__((aligned(4),packed))
+#define ICACHE_STORE_ATTR __attribute__((aligned(4)))
+#define ICACHE_RAM_ATTR
+
+#define GPIO_INTERRUPT_ENABLE
+
+#define BUILD_SPIFFS	1
+
+#include "user_modules.h"
+
+#define LUA_OPTRAM
+#ifdef LUA_OPTRAM
+#define LUA_OPTIMIZE_MEMORY			2
+#else
+#define LUA_OPTIMIZE_MEMORY         0
+#endif	/* LUA_OPTRAM */
+
+#define READLINE_INTERVAL	80
+
+// Sectors of the Lua flash store, see node.flashstore()
+#define LUA_STORE_SEC_NUM	0x10
+
+#endif	/* __USER_CONFIG_H__ */
@@ -0,0 +1,29 @@
+/*
+ * Lua modules of the host build. Modules driving hardware through busy
+ * waits on peripheral registers (spi, i2c, ow, pwm, adc, dht) have no
+ * in-memory device behind them and are left out. The LED modules write
+ * to the GPIO model, the drivers in test/ look at what they send.
+ */
+
+#ifndef __USER_MODULES_H__
+#define __USER_MODULES_H__
+
+#define LUA_USE_MODULES
+
+#ifdef LUA_USE_MODULES
+#define LUA_USE_MODULES_NODE
+#define LUA_USE_MODULES_FILE
+#define LUA_USE_MODULES_GPIO
+#define LUA_USE_MODULES_WIFI
+#define LUA_USE_MODULES_NET
+#define LUA_USE_MODULES_TMR
+#define LUA_USE_MODULES_UART
+#define LUA_USE_MODULES_BIT
+#define LUA_USE_MODULES_FILE_SERVER
+#define LUA_USE_MODULES_LPD8806
+#define LUA_USE_MODULES_LPD_TICKER
+#define LUA_USE_MODULES_MATRIX
+#define LUA_USE_MODULES_WS2812
+#endif /* LUA_USE_MODULES */
+
+#endif	/* __USER_MODULES_H__ */
@@ -0,0 +1,85 @@
+/*
+ * file.read(), file.read(n) and file.readline() against the fs_getc() loop
+ * they replaced, time to read a 4080 byte file of 80 lines from spiffs.
+ *
+ * getc_read(f, n, end_char) is the old file_g_read(): one fs_getc(), that
+ * is a one byte SPIFFS_read(), per byte. Both read the same file object,
+ * the data they return is compared before the clock starts.
+ */
+
+#include "host_test.h"
+
+#include "lauxlib.h"
+#include "flash_fs.h"
+#include "host.h"
+
+#define ROUNDS          200
+
+// The file object of file.c, its first member is the descriptor
+static int getc_read(lua_State *L)
+{
+  int fd = *(int *)luaL_checkudata(L, 1, "file.obj");
+  int n = luaL_optinteger(L, 2, LUAL_BUFFERSIZE);
+  int ec = luaL_optinteger(L, 3, EOF);
+  luaL_Buffer b;
+  char *p;
+  int c, i = 0;
+
+  if (n < 0 || n > LUAL_BUFFERSIZE)
+    n = LUAL_BUFFERSIZE;
+  luaL_buffinit(L, &b);
+  p = luaL_prepbuffer(&b);
+  do {
+    c = fs_getc(fd);
+    if (c == EOF)
+      break;
+    p[i++] = (char)(0xFF & c);
+  } while (c != ec && i < n);
+
+  luaL_addsize(&b, i);
+  luaL_pushresult(&b);
+  return i > 0;
+}
+
+static const char bench[] =
+  "local f = file.open('bench.txt', 'w')\n"
+  "for i = 1, 80 do f:write(string.format('%03d ', i) .. string.rep(string.char(64 + i % 26), 46) .. '\\n') end\n"
+  "f:close()\n"
+  "local function all(read)\n"
+  "  local f = file.open('bench.txt', 'r') local t = {}\n"
+  "  for i = 1, 1000 do local s = read(f) if not s then break end t[i] = s end\n"
+  "  f:close() return table.concat(t), #t\n"
+  "end\n"
+  "local cases = {\n"
+  "  { 'read()', function(f) return f:read() end, function(f) return getc_read(f) end },\n"
+  "  { 'read(64)', function(f) return f:read(64) end, function(f) return getc_read(f, 64) end },\n"
+  "  { 'readline()', function(f) return f:readline() end, function(f) return getc_read(f, nil, 10) end },\n"
+  "}\n"
+  "print('us per file   fs_getc() loop   block read   reads')\n"
+  "for _, c in ipairs(cases) do\n"
+  "  local new, calls = all(c[2])\n"
+  "  assert(new == all(c[3]) and #new == 4080, c[1] .. ' returns other data')\n"
+  "  local t = tmr.now()\n"
+  "  for i = 1, ROUNDS do all(c[3]) end\n"
+  "  local old = tmr.now() - t\n"
+  "  t = tmr.now()\n"
+  "  for i = 1, ROUNDS do all(c[2]) end\n"
+  "  local block = tmr.now() - t\n"
+  "  print(string.format('%-12s %15d %12d %7d', c[1], old / ROUNDS, block / ROUNDS, calls))\n"
+  "end\n"
+  "file.remove('bench.txt')\n";
+
+int main(void)
+{
+  lua_State *L;
+
+  host_test_init(200000);
+  host_test_init_flash();
+  L = host_test_lua();
+  lua_pushinteger(L, ROUNDS);
+  lua_setglobal(L, "ROUNDS");
+  lua_register(L, "getc_read", getc_read);
+  host_test_dostring(L, bench);
+  host_uart_flush();
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Lua flash store: heap taken by a module loaded from its source, from its
+ * .lc file and from the store, in bytes.
+ *
+ * The modules are the ones of LuaNode and two of lua_modules, found through
+ * the LUANODE and LUA_MODULES variables the Makefile sets. They are copied
+ * to spiffs and compiled with node.compile(), the .lc files are stored with
+ * luaN_store(). A load is measured by collectgarbage("count") before and
+ * after, with the loaded function kept alive.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+
+#include "lflash.h"
+#include "host.h"
+
+static const char *const modules[][2] = {
+  { "LUANODE", "base/K30.lua" },
+  { "LUANODE", "base/config.lua" },
+  { "LUANODE", "base/user_script.lua" },
+  { "LUA_MODULES", "http/http.lua" },
+  { "LUA_MODULES", "redis/redis.lua" },
+};
+
+#define MODULES         (sizeof(modules) / sizeof(modules[0]))
+
+static const char bench[] =
+  "function ram(load)\n"
+  "  collectgarbage() collectgarbage()\n"
+  "  local m0 = collectgarbage('count')\n"
+  "  local f = load()\n"
+  "  collectgarbage() collectgarbage()\n"
+  "  local d = (collectgarbage('count') - m0) * 1024\n"
+  "  assert(f, 'nothing loaded')\n"
+  "  return d - d % 1\n"
+  "end\n"
+  "print('module        .lua source   .lc file   flash store')\n"
+  "for _, m in ipairs(MODULES) do\n"
+  "  print(string.format('%-12s %12d %10d %13d', m,\n"
+  "    ram(function() return loadfile(m .. '.lua') end),\n"
+  "    ram(function() return loadfile(m .. '.lc') end),\n"
+  "    ram(function() return node.flashindex(m) end)))\n"
+  "end\n";
+
+int main(void)
+{
+  const char *files[MODULES];
+  char path[256], name[64], lc[MODULES][64];
+  lua_State *L;
+  unsigned i;
+
+  host_test_init(200000);
+  host_test_init_flash();
+  L = host_test_lua();
+
+  lua_createtable(L, MODULES, 0);
+  for (i = 0; i < MODULES; i++)
+  {
+    const char *dir = getenv(modules[i][0]), *base = strrchr(modules[i][1], '/') + 1;
+
+    if (dir == NULL)
+    {
+      fprintf(stderr, "bench_flashstore: %s is not set\n", modules[i][0]);
+      return 1;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, modules[i][1]);
+    snprintf(name, sizeof(name), "%.*s", (int)(strlen(base) - 4), base);
+    snprintf(lc[i], sizeof(lc[i]), "%s.lc", name);
+    files[i] = lc[i];
+    if (!host_test_copy(path, base))
+      return 1;
+    lua_getglobal(L, "node");
+    lua_getfield(L, -1, "compile");
+    lua_pushstring(L, base);
+    lua_call(L, 1, 0);
+    lua_pop(L, 1);
+    lua_pushstring(L, name);
+    lua_rawseti(L, -2, i + 1);
+  }
+  lua_setglobal(L, "MODULES");
+
+  if (luaN_store(L, files, MODULES) != LUAN_OK)
+  {
+    fprintf(stderr, "bench_flashstore: %s\n", lua_tostring(L, -1));
+    return 1;
+  }
+  host_test_dostring(L, bench);
+  host_uart_flush();
+  return 0;
+}
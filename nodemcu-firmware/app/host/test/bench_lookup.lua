@@ -0,0 +1,15 @@
+-- ns per global module lookup, best of 3 with the empty loop taken off.
+-- The console runs every line as a chunk of its own, hence the globals.
+-- A build with HOST_CFLAGS="-O2 -g -DLUA_ROCACHE_SIZE=0" times them
+-- without the cache of lvm.c.
+n = 1000000
+function ns(f) local b for r = 1, 3 do local t = tmr.now() f() t = tmr.now() - t b = b and b < t and b or t end return b * 1000 / n end
+empty = ns(function() for i = 1, n do end end)
+function row(name, f) print(string.format("%-14s %5d ns", name, ns(f) - empty)) end
+gpio.mode(1, gpio.OUTPUT)
+row("gpio.write", function() for i = 1, n do gpio.write(1, 1) end end)
+row("call only", function() local w = gpio.write for i = 1, n do w(1, 1) end end)
+row("file.format", function() local f for i = 1, n do f = file.format end end)
+row("string.upper", function() local f for i = 1, n do f = string.upper end end)
+row("s.len", function() local s, f = "abc" for i = 1, n do f = s.len end end)
+row("o:state", function() local o = tmr.create() for i = 1, n do o:state() end end)
@@ -0,0 +1,96 @@
+/*
+ * luaR_findglobal() and luaR_findentry() against the linear scans they
+ * replaced, ns per lookup of a module and one of its keys.
+ *
+ * scan_findglobal() and scan_auxfind() are the lookups of lrotable.c before
+ * the rotables were sorted: strlen/strncmp over lua_rotable[], strcmp over
+ * the entries of a map. Both sides look up the same names in the same
+ * tables and have to find the same entries. Every string key of every
+ * module is looked up first, the key counts luaR_findentry() caches must
+ * not send it to the wrong map.
+ */
+
+#include "host_test.h"
+
+#include "c_string.h"
+#include "lrotable.h"
+#include "host.h"
+
+#define ROUNDS          1000000
+
+extern const luaR_table lua_rotable[];
+extern const unsigned lua_rotable_count;
+
+static void *scan_findglobal(const char *name, unsigned len)
+{
+  unsigned i;
+
+  if (c_strlen(name) > LUA_MAX_ROTABLE_NAME)
+    return NULL;
+  for (i = 0; lua_rotable[i].name; i++)
+    if (*lua_rotable[i].name != '\0' && c_strlen(lua_rotable[i].name) == len && !c_strncmp(lua_rotable[i].name, name, len))
+      return (void *)(lua_rotable[i].pentries);
+  return NULL;
+}
+
+static const TValue *scan_auxfind(const luaR_entry *pentry, const char *strkey)
+{
+  while (pentry->key.type != LUA_TNIL)
+  {
+    if (pentry->key.type == LUA_TSTRING && !c_strcmp(pentry->key.id.strkey, strkey))
+      return &pentry->value;
+    pentry++;
+  }
+  return NULL;
+}
+
+// Keep the compiler from dropping the lookups
+static const void *volatile sink;
+
+int main(void)
+{
+  static const char *lookups[][2] = {
+    { "gpio", "write" }, { "file", "format" }, { "string", "upper" },
+    { "tmr", "alarm" }, { "node", "heap" }, { "wifi", "nosuch" },
+  };
+  unsigned i, r, n = sizeof(lookups) / sizeof(lookups[0]);
+  uint64_t t, scan, bisect;
+  void *map;
+
+  for (i = 0, r = 0; i < lua_rotable_count; i++)
+  {
+    const luaR_entry *e;
+
+    for (e = lua_rotable[i].pentries; e->key.type != LUA_TNIL; e++)
+      if (e->key.type == LUA_TSTRING &&
+          luaR_findentry((void *)lua_rotable[i].pentries, e->key.id.strkey, 0, NULL) != &e->value)
+        r++;
+  }
+  CHECK(r == 0);
+
+  printf("ns per lookup      linear scan   bisect\n");
+  for (i = 0; i < n; i++)
+  {
+    const char *module = lookups[i][0], *key = lookups[i][1];
+    unsigned len = c_strlen(module);
+
+    map = luaR_findglobal(module, len);
+    if (!CHECK(map && map == scan_findglobal(module, len)) ||
+        !CHECK(luaR_findentry(map, key, 0, NULL) == scan_auxfind(map, key)))
+      continue;
+
+    t = host_test_ns();
+    for (r = 0; r < ROUNDS; r++)
+      sink = scan_auxfind(scan_findglobal(module, len), key);
+    scan = host_test_ns() - t;
+
+    t = host_test_ns();
+    for (r = 0; r < ROUNDS; r++)
+      sink = luaR_findentry(luaR_findglobal(module, len), key, 0, NULL);
+    bisect = host_test_ns() - t;
+
+    printf("%-6s %-10s %11u %8u\n", module, key, (unsigned)(scan / ROUNDS), (unsigned)(bisect / ROUNDS));
+  }
+  host_uart_flush();
+  return host_test_result();
+}
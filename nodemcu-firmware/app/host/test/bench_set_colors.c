@@ -0,0 +1,49 @@
+/*
+ * lpd:set_colors() against the table form of lpd:set_color(), time per
+ * frame for 60, 160 and 512 LEDs.
+ *
+ * Frames alternate between two color sets, every LED changes. The tables
+ * and strings are made before the clock starts, the update is not timed.
+ */
+
+#include "host_test.h"
+
+#include "host.h"
+
+#define FRAMES          1000
+
+static const char bench[] =
+  "local function frame(n, shift)\n"
+  "  local bytes, idx, r, g, b = {}, {}, {}, {}, {}\n"
+  "  for i = 1, n do\n"
+  "    idx[i] = i - 1 r[i] = (i * 4 + shift) % 256 g[i] = (i * 7) % 256 b[i] = (i * 13) % 256\n"
+  "    bytes[i] = string.char(r[i], g[i], b[i])\n"
+  "  end\n"
+  "  return { s = table.concat(bytes), idx = idx, r = r, g = g, b = b }\n"
+  "end\n"
+  "print('LEDs   set_color(tables)   set_colors(string)   ns per frame')\n"
+  "for _, n in ipairs({ 60, 160, 512 }) do\n"
+  "  local l = lpd8806.setup(1, 2, n, 0, 0)\n"
+  "  local f = { frame(n, 0), frame(n, 1) }\n"
+  "  local t = tmr.now()\n"
+  "  for i = 1, FRAMES do local c = f[i % 2 + 1] l:set_color(c.idx, c.r, c.g, c.b) end\n"
+  "  local tables = tmr.now() - t\n"
+  "  t = tmr.now()\n"
+  "  for i = 1, FRAMES do l:set_colors(f[i % 2 + 1].s) end\n"
+  "  local packed = tmr.now() - t\n"
+  "  print(string.format('%4d   %18d   %18d', n, tables * 1000 / FRAMES, packed * 1000 / FRAMES))\n"
+  "  l = nil f = nil collectgarbage()\n"
+  "end\n";
+
+int main(void)
+{
+  lua_State *L;
+
+  host_test_init(200000);
+  L = host_test_lua();
+  lua_pushinteger(L, FRAMES);
+  lua_setglobal(L, "FRAMES");
+  host_test_dostring(L, bench);
+  host_uart_flush();
+  return 0;
+}
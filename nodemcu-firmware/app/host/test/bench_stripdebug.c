@@ -0,0 +1,83 @@
+/*
+ * node.stripdebug(): heap taken by a module loaded at each strip level, in
+ * bytes, from its source / from a .lc file that keeps all debug info.
+ *
+ * The modules are the ones of LuaNode and two of lua_modules, found through
+ * the LUANODE and LUA_MODULES variables the Makefile sets. They are copied
+ * to spiffs and compiled with node.compile(f, 1) at level 1, compiling keeps
+ * no more than the runtime level does. A load is measured by
+ * collectgarbage("count") before and after, with the loaded function kept
+ * alive.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+
+#include "host.h"
+
+static const char *const modules[][2] = {
+  { "LUANODE", "base/K30.lua" },
+  { "LUANODE", "base/config.lua" },
+  { "LUANODE", "base/user_script.lua" },
+  { "LUA_MODULES", "http/http.lua" },
+  { "LUA_MODULES", "redis/redis.lua" },
+};
+
+#define MODULES         (sizeof(modules) / sizeof(modules[0]))
+
+static const char bench[] =
+  "function ram(load)\n"
+  "  collectgarbage() collectgarbage()\n"
+  "  local m0 = collectgarbage('count')\n"
+  "  local f = load()\n"
+  "  collectgarbage() collectgarbage()\n"
+  "  local d = (collectgarbage('count') - m0) * 1024\n"
+  "  assert(f, 'nothing loaded')\n"
+  "  return d - d % 1\n"
+  "end\n"
+  "print('module           level 1      level 2      level 3')\n"
+  "for _, m in ipairs(MODULES) do\n"
+  "  node.stripdebug(1) node.compile(m .. '.lua', 1)\n"
+  "  local s = string.format('%-12s', m)\n"
+  "  for level = 1, 3 do\n"
+  "    node.stripdebug(level)\n"
+  "    s = s .. string.format(' %12s', ram(function() return loadfile(m .. '.lua') end) .. '/' ..\n"
+  "                                     ram(function() return loadfile(m .. '.lc') end))\n"
+  "  end\n"
+  "  print(s)\n"
+  "end\n"
+  "node.stripdebug(1)\n";
+
+int main(void)
+{
+  char path[256];
+  lua_State *L;
+  unsigned i;
+
+  host_test_init(200000);
+  host_test_init_flash();
+  L = host_test_lua();
+
+  lua_createtable(L, MODULES, 0);
+  for (i = 0; i < MODULES; i++)
+  {
+    const char *dir = getenv(modules[i][0]), *base = strrchr(modules[i][1], '/') + 1;
+
+    if (dir == NULL)
+    {
+      fprintf(stderr, "bench_stripdebug: %s is not set\n", modules[i][0]);
+      return 1;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, modules[i][1]);
+    if (!host_test_copy(path, base))
+      return 1;
+    lua_pushlstring(L, base, strlen(base) - 4);
+    lua_rawseti(L, -2, i + 1);
+  }
+  lua_setglobal(L, "MODULES");
+
+  host_test_dostring(L, bench);
+  host_uart_flush();
+  return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * swtimer: dispatch jitter of 100 periodic timers on one os_timer.
+ *
+ * The wheel of platform/swtimer.c runs on a fake clock for a simulated
+ * minute. Periods are spread from 10 to 500 ms, every timer function costs
+ * 20 us and the os_timer fires up to 300 us late, as it does when other
+ * tasks run. A timer is late by the time from its ideal expiry, the arming
+ * time plus a whole number of periods, to its function being called. The
+ * host time spent in swtimer_run() is measured along.
+ */
+
+#include "host_test.h"
+
+#define SWTIMER_HOST_BUILD
+#include "swtimer.c"
+
+#define TIMERS          100
+#define SECONDS         60
+#define CALLBACK_US     20
+#define LATENCY_US      300
+#define BUCKET_US       100
+#define BUCKETS         100
+
+static uint32_t fake_us;
+static uint32_t hw_at;
+static bool hw_pending;
+
+static swtimer_t timers[ TIMERS ];
+static uint32_t period_ms[ TIMERS ];
+static uint32_t next_ideal_us[ TIMERS ];
+static uint32_t histogram[ BUCKETS + 1 ];
+static uint64_t late_total;
+static uint32_t late_max;
+static uint32_t calls;
+static uint32_t missed;
+
+uint32_t swtimer_host_time( void )
+{
+  return fake_us;
+}
+
+void swtimer_host_arm( uint32_t ms )
+{
+  hw_at = fake_us + ms * 1000 + rand() % ( LATENCY_US + 1 );
+  hw_pending = true;
+}
+
+static void tick( void *arg )
+{
+  unsigned i = ( unsigned )( uintptr_t )arg;
+  uint32_t late;
+
+  // Periods the timer fell behind by are skipped, not made up for
+  while( ( int32_t )( fake_us - next_ideal_us[ i ] ) >= ( int32_t )( period_ms[ i ] * 1000 ) )
+  {
+    next_ideal_us[ i ] += period_ms[ i ] * 1000;
+    missed ++;
+  }
+  late = fake_us - next_ideal_us[ i ];
+  next_ideal_us[ i ] += period_ms[ i ] * 1000;
+
+  late_total += late;
+  if( late > late_max )
+    late_max = late;
+  histogram[ late / BUCKET_US < BUCKETS ? late / BUCKET_US : BUCKETS ] ++;
+  calls ++;
+  fake_us += CALLBACK_US;
+}
+
+int main( void )
+{
+  uint32_t end, p99, seen;
+  uint64_t host_ns = 0, t0;
+  swtimer_stats_t s;
+  unsigned i;
+
+  srand( 1 );
+  fake_us = 1000;
+  swtimer_init();
+  for( i = 0; i < TIMERS; i ++ )
+  {
+    period_ms[ i ] = 10 + ( i * 37 ) % 491;
+    swtimer_setfn( &timers[ i ], tick, ( void * )( uintptr_t )i );
+    swtimer_arm( &timers[ i ], period_ms[ i ], true );
+    next_ideal_us[ i ] = fake_us + period_ms[ i ] * 1000;
+  }
+
+  end = fake_us + SECONDS * 1000000;
+  while( hw_pending && ( int32_t )( hw_at - end ) < 0 )
+  {
+    fake_us = hw_at;
+    hw_pending = false;
+    t0 = host_test_ns();
+    swtimer_host_run();
+    host_ns += host_test_ns() - t0;
+  }
+
+  for( i = 0, seen = 0, p99 = 0; i <= BUCKETS; i ++ )
+  {
+    seen += histogram[ i ];
+    if( seen * 100ULL >= calls * 99ULL )
+    {
+      p99 = ( i + 1 ) * BUCKET_US;
+      break;
+    }
+  }
+
+  swtimer_get_stats( &s );
+  printf( "%u periodic timers, %u s, timer functions %u us, os_timer up to %u us late\n",
+          TIMERS, SECONDS, CALLBACK_US, LATENCY_US );
+  printf( "fired %u, wakeups %u (%u per s, a 1 ms tick would take 1000), %.2f timers per wakeup\n",
+          s.fired, s.wakeups, s.wakeups / SECONDS, ( double )s.fired / s.wakeups );
+  printf( "late: mean %u us, 99%% < %u us, max %u us, missed periods %u\n",
+          ( unsigned )( late_total / calls ), p99, late_max, missed );
+  printf( "swtimer_run() on the host: %u ns per timer fired\n",
+          ( unsigned )( host_ns / s.fired ) );
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Cycles per ticker frame, the per-pixel renderer of the first ticker
+ * against the encoded frame buffer of lpd_ticker.c.
+ *
+ * Both draw the same text at half brightness onto a 60 LED strip of their
+ * own, bit-banged with no delay. The old renderer is copied from the first
+ * lpd_ticker.c: three modulo indexes, three double multiplies and a gamma
+ * lookup per pixel, then a full update(). After every frame the two strips
+ * have to hold the same bytes. The transfer is timed apart from the render,
+ * on the host the GPIO model costs far more than the pins do.
+ */
+
+#include "host_test.h"
+
+// The ticker shows its frames through ticker_show()
+#define matrix_show ticker_show
+#include "lpd_ticker.c"
+#undef matrix_show
+
+void matrix_show(matrix_t *pMatrix);
+
+#define FRAMES          2000
+#define HEAP            100000
+
+static const uint8_t led_mapping[] = {
+    50, 51, 52, 53, 54, 55, 56, 57, 58, 59,
+    49, 48, 47, 46, 45, 44, 43, 42, 41, 40,
+    30, 31, 32, 33, 34, 35, 36, 37, 38, 39,
+    29, 28, 27, 26, 25, 24, 23, 22, 21, 20,
+    10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+     9,  8,  7,  6,  5,  4,  3,  2,  1,  0
+};
+
+// The scroll callback of the first ticker, reading the cached RGB values
+static void old_render(const ticker_t *pTicker, unsigned position, double brightness, lpd_userdata *pStrip) {
+   unsigned column, row, r, g, b;
+   for (row = 0; row < 6; ++row) {
+      for (column = 0; column < 10; ++column) {
+         r = pTicker->m_OutputBuffer[(((position + column) * 3 + 0) % pTicker->m_Used) + row * pTicker->m_Length];
+         g = pTicker->m_OutputBuffer[(((position + column) * 3 + 1) % pTicker->m_Used) + row * pTicker->m_Length];
+         b = pTicker->m_OutputBuffer[(((position + column) * 3 + 2) % pTicker->m_Used) + row * pTicker->m_Length];
+
+         r = ((double)r * brightness);
+         g = ((double)g * brightness);
+         b = ((double)b * brightness);
+
+         set_color(pStrip, led_mapping[column + row * 10], r, g, b);
+      }
+   }
+}
+
+static uint64_t update_cycles;
+
+void ticker_show(matrix_t *pMatrix) {
+   uint64_t start = host_test_cycles();
+
+   matrix_show(pMatrix);
+   update_cycles += host_test_cycles() - start;
+}
+
+static void *global_udata(lua_State *L, const char *name)
+{
+  void *p;
+
+  lua_getglobal(L, name);
+  p = lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  return p;
+}
+
+int main(void)
+{
+  lua_State *L;
+  ticker_t *pTicker;
+  lpd_userdata *pNew, *pOld;
+  uint64_t start, old_cycles = 0, new_cycles = 0, old_update = 0, new_update;
+  unsigned frame, position, mismatches = 0;
+
+  host_test_init(HEAP);
+  L = host_test_lua();
+  if (!host_test_dostring(L,
+        "new = lpd8806.setup(1, 2, 60, 0, 0) old = lpd8806.setup(3, 4, 60, 0, 0)\n"
+        "t = ticker.setup(new, 1000000) t:stop()\n"
+        "t:set_text('Hello, ticker 12:30', 255, 128, 64) t:stop()\n"
+        "t:set_brightness(0.5)"))
+    return host_test_result();
+
+  pTicker = global_udata(L, "t");
+  pNew = global_udata(L, "new");
+  pOld = global_udata(L, "old");
+
+  for (frame = 0; frame < FRAMES; frame++)
+  {
+    position = pTicker->m_Position;
+
+    new_update = update_cycles;
+    start = host_test_cycles();
+    ticker_scroll_cb(pTicker);
+    new_cycles += host_test_cycles() - start - (update_cycles - new_update);
+
+    start = host_test_cycles();
+    old_render(pTicker, position, 0.5, pOld);
+    old_cycles += host_test_cycles() - start;
+
+    if (c_memcmp(pNew->m_OutputBuffer, pOld->m_OutputBuffer, 60 * 3) != 0)
+      mismatches++;
+
+    start = host_test_cycles();
+    update(pOld, 1);
+    old_update += host_test_cycles() - start;
+  }
+  new_update = update_cycles;
+
+  printf("%u frames of a %u column text, cycles per frame\n", FRAMES, pTicker->m_Used / 3);
+  printf("  old render                 %8llu\n", (unsigned long long)(old_cycles / FRAMES));
+  printf("  new render                 %8llu\n", (unsigned long long)(new_cycles / FRAMES));
+  printf("  old update, whole strip    %8llu\n", (unsigned long long)(old_update / FRAMES));
+  printf("  new update, changed LEDs   %8llu\n", (unsigned long long)(new_update / FRAMES));
+  printf("  frames that differ         %8u\n", mismatches);
+  return mismatches ? 1 : 0;
+}
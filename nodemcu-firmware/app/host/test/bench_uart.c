@@ -0,0 +1,137 @@
+/*
+ * Discrete-time model of the console input, polled against event driven.
+ *
+ * The clock advances in steps of 1 us over 60 s of an idle console, with
+ * one line typed in the middle at a key every TYPE_GAP_US. A received byte
+ * is in the RX ring once its stop bit is in, at 115200 baud 8N1.
+ *
+ *   polled:  readline_timer drains the ring every READLINE_INTERVAL and
+ *            re-arms itself, a complete line goes to dojob() through
+ *            lua_timer one more interval later (lua.c before the change)
+ *   event:   the RX interrupt, with the FIFO threshold at 1 byte, posts
+ *            SIG_UART unless one is pending; the Lua task drains the ring
+ *            and runs a complete line right away (lua.c, user_main.c)
+ *
+ * A wakeup is a timer callback or task run on an otherwise idle CPU, it is
+ * idle if it finds neither a byte to read nor a line to run.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+
+#include "user_config.h"
+
+#define MODEL_US        (60 * 1000000u)
+#define BYTE_US         (10 * 1000000u / 115200)   // start, 8 data, stop bit
+#define TYPE_AT_US      (30 * 1000000u)
+#define TYPE_GAP_US     150000u
+#define INTERVAL_US     (READLINE_INTERVAL * 1000u)
+
+static const char typed[] = "print(node.heap())\r";
+
+typedef struct
+{
+  unsigned wakeups;
+  unsigned idle_wakeups;
+  uint32 enter_us;              // stop bit of the '\r'
+  uint32 run_us;                // dojob() ran the line
+} result_t;
+
+// Time the stop bit of byte i is in, the keys start at TYPE_AT_US
+static uint32 byte_time(unsigned i)
+{
+  return TYPE_AT_US + i * TYPE_GAP_US + BYTE_US;
+}
+
+static void wakeup(result_t *r, bool idle)
+{
+  r->wakeups++;
+  if (idle)
+    r->idle_wakeups++;
+}
+
+static void model_polled(result_t *r)
+{
+  uint32 readline_at = INTERVAL_US;     // lua_main() arms both
+  uint32 dojob_at = INTERVAL_US;
+  unsigned received = 0, read = 0;
+  uint32 now;
+
+  memset(r, 0, sizeof(*r));
+  for (now = 0; now < MODEL_US; now++)
+  {
+    while (received < sizeof(typed) - 1 && byte_time(received) == now)
+      received++;
+
+    if (now == dojob_at)
+    {
+      wakeup(r, read < sizeof(typed) - 1 || r->run_us != 0);
+      if (read == sizeof(typed) - 1 && r->run_us == 0)
+        r->run_us = now;
+      dojob_at = 0;
+      readline_at = now + INTERVAL_US;
+    }
+    if (now == readline_at)
+    {
+      wakeup(r, read == received);
+      for (; read < received; read++)
+      {
+        if (typed[read] == '\r')
+          dojob_at = now + INTERVAL_US;
+      }
+      readline_at = now + INTERVAL_US;
+    }
+  }
+  r->enter_us = byte_time(sizeof(typed) - 2);
+}
+
+static void model_event(result_t *r)
+{
+  bool posted = false;
+  unsigned received = 0, read = 0;
+  uint32 now;
+
+  memset(r, 0, sizeof(*r));
+  for (now = 0; now < MODEL_US; now++)
+  {
+    // RX interrupt, task_uart_notify()
+    while (received < sizeof(typed) - 1 && byte_time(received) == now)
+    {
+      received++;
+      posted = true;
+    }
+
+    // The task runs once the interrupt returned, the CPU is idle otherwise
+    if (posted)
+    {
+      posted = false;
+      wakeup(r, read == received);
+      for (; read < received; read++)
+      {
+        if (typed[read] == '\r' && r->run_us == 0)
+          r->run_us = now;
+      }
+    }
+  }
+  r->enter_us = byte_time(sizeof(typed) - 2);
+}
+
+static void report(const char *name, const result_t *r)
+{
+  printf("%-8s %6u wakeups %6u idle   line runs %6u us after Enter\n",
+         name, r->wakeups, r->idle_wakeups, r->run_us - r->enter_us);
+}
+
+int main(void)
+{
+  result_t polled, event;
+
+  printf("60 s console, %u chars typed at %u s, READLINE_INTERVAL %u ms\n",
+         (unsigned)sizeof(typed) - 1, TYPE_AT_US / 1000000, READLINE_INTERVAL);
+  model_polled(&polled);
+  model_event(&event);
+  report("polled", &polled);
+  report("event", &event);
+  return 0;
+}
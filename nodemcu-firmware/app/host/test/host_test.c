@@ -0,0 +1,141 @@
+/*
+ * Helpers of the host tests and benchmarks, see host_test.h.
+ */
+
+#include "host_test.h"
+
+#include <time.h>
+
+#include "lauxlib.h"
+#include "lualib.h"
+#include "flash_fs.h"
+#include "host.h"
+
+static unsigned checks;
+static unsigned failed;
+
+bool host_test_check(bool ok, const char *what, const char *file, int line)
+{
+  checks++;
+  if (!ok)
+  {
+    failed++;
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+  }
+  return ok;
+}
+
+// Exit status of the test, 0 if every check held
+int host_test_result(void)
+{
+  host_uart_flush();
+  printf("%u checks, %u failed\n", checks, failed);
+  return failed ? 1 : 0;
+}
+
+// There is no process to start over, see host_main.c
+void host_request_restart(uint32 delay_us)
+{
+  host_stop();
+}
+
+void host_test_init(uint32 heap)
+{
+  extern void task_init(void);
+
+  if (!host_map_registers())
+    exit(1);
+  host_os_init(heap);
+  host_gpio_init();
+  // The task of the deferred callbacks, see user_main.c
+  task_init();
+}
+
+void host_test_init_flash(void)
+{
+  extern void spiffs_mount(void);
+
+  if (!host_flash_open(NULL))
+    exit(1);
+  spiffs_mount();
+  if (!fs_format())
+  {
+    fprintf(stderr, "host_test: can't format spiffs\n");
+    exit(1);
+  }
+}
+
+lua_State *host_test_lua(void)
+{
+  lua_State *L = lua_open();
+
+  if (L == NULL)
+  {
+    fprintf(stderr, "host_test: can't create a Lua state\n");
+    exit(1);
+  }
+  luaL_openlibs(L);
+  return L;
+}
+
+bool host_test_dostring(lua_State *L, const char *chunk)
+{
+  if (luaL_dostring(L, chunk) != 0)
+  {
+    host_uart_flush();
+    host_test_check(false, lua_tostring(L, -1), "lua", 0);
+    lua_pop(L, 1);
+    return false;
+  }
+  return true;
+}
+
+bool host_test_copy(const char *path, const char *name)
+{
+  char buff[256];
+  size_t n;
+  FILE *in = fopen(path, "rb");
+  int fd;
+
+  if (in == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  fd = fs_open(name, FS_WRONLY | FS_CREAT | FS_TRUNC);
+  if (fd < FS_OPEN_OK)
+  {
+    fclose(in);
+    return false;
+  }
+  while ((n = fread(buff, 1, sizeof(buff), in)) > 0)
+  {
+    if (fs_write(fd, buff, n) != n)
+      break;
+  }
+  fs_close(fd);
+  fclose(in);
+  return n == 0;
+}
+
+void host_test_run(uint32 us)
+{
+  host_run(us);
+}
+
+uint64_t host_test_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t host_test_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return host_test_ns();
+#endif
+}
@@ -0,0 +1,53 @@
+/*
+ * Tests and benchmarks of the host build, see ../Makefile.
+ *
+ * Every test_*.c and bench_*.c of this directory is a program of its own,
+ * linked against the firmware of the host build: a driver calls into the
+ * module it checks or measures, C code through its header, or through the
+ * Lua API of a state made by host_test_lua(). Drivers that need the static
+ * parts of a source include the .c itself. A test exits with 0 if all its
+ * CHECK()s held, a benchmark prints its figures.
+ *
+ * Include this header first: it brings the stdio and stdlib of the host,
+ * the firmware headers that follow keep their own BUFSIZ and RAND_MAX.
+ */
+
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#undef BUFSIZ
+#undef RAND_MAX
+
+#include "c_types.h"
+#include "lua.h"
+
+// Count and report a failed condition, evaluates to the condition
+#define CHECK(cond)     host_test_check(!!(cond), #cond, __FILE__, __LINE__)
+
+bool host_test_check(bool ok, const char *what, const char *file, int line);
+int host_test_result(void);
+
+// Map the registers, limit the heap, start the task that runs the deferred
+// callbacks (timers, GPIO triggers) and mount a formatted spiffs on a flash
+// kept in memory. Drivers that don't touch the flash can skip the latter.
+void host_test_init(uint32 heap);
+void host_test_init_flash(void);
+
+// A Lua state with the libraries of the host build
+lua_State *host_test_lua(void);
+// Run a chunk, errors are printed and make the test fail
+bool host_test_dostring(lua_State *L, const char *chunk);
+// Copy a file of the host into spiffs
+bool host_test_copy(const char *path, const char *name);
+
+// Run the event loop for the given time, the timers and tasks included
+void host_test_run(uint32 us);
+
+// Monotonic clock, and the cycle counter of the host CPU where there is one
+uint64_t host_test_ns(void);
+uint64_t host_test_cycles(void);
+
+#endif /* __HOST_TEST_H__ */
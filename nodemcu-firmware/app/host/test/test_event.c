@@ -0,0 +1,196 @@
+/*
+ * event: the queue of platform/event.c, built with EVENT_HOST_BUILD.
+ *
+ * The first checks post and dispatch by hand: notification, coalescing,
+ * drops, cancelling and the batch limit. The last one runs the queue
+ * against a fake timer source. Three timers post every 2, 3 and 5 ms of
+ * a simulated second, and the dispatcher only gets to run every 25 ms,
+ * like a Lua task held up by slow callbacks.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+
+#define EVENT_HOST_BUILD
+#include "event.c"
+
+static unsigned notifications;
+static unsigned calls[ EVENT_TYPE_NUM ];
+static unsigned last_id;
+static uint32_t last_arg;
+static void *last_data;
+
+static void notify(void)
+{
+  notifications++;
+}
+
+static void handler(unsigned id, uint32_t arg, void *data)
+{
+  calls[ EVENT_TMR_ALARM ]++;
+  last_id = id;
+  last_arg = arg;
+  last_data = data;
+}
+
+static void scroll_handler(unsigned id, uint32_t arg, void *data)
+{
+  calls[ EVENT_TICKER_SCROLL ]++;
+  last_id = id;
+  last_arg = arg;
+  last_data = data;
+}
+
+// Empty the queue and forget the counters
+static void reset(void)
+{
+  while (event_dispatch(EVENT_QUEUE_LEN))
+    ;
+  memset(&stats, 0, sizeof(stats));
+  memset(calls, 0, sizeof(calls));
+  notifications = 0;
+}
+
+static void check_post(void)
+{
+  event_stats_t s;
+  int a, b;
+
+  reset();
+  CHECK(event_post(EVENT_TMR_ALARM, 3, 42, &a));
+  CHECK(event_post(EVENT_TMR_ALARM, 4, 43, &b));
+  // Only the first event of an empty queue notifies
+  CHECK(notifications == 1);
+  event_get_stats(&s);
+  CHECK(s.depth == 2 && s.posted == 2 && s.max_depth == 2);
+
+  CHECK(event_dispatch(1) == 1);
+  CHECK(calls[ EVENT_TMR_ALARM ] == 1 && last_id == 3 && last_arg == 42 && last_data == &a);
+  // Still pending, a post doesn't notify again
+  CHECK(event_post(EVENT_TMR_ALARM, 5, 44, &a));
+  CHECK(notifications == 1);
+  CHECK(event_dispatch(EVENT_DISPATCH_BATCH) == 0);
+  CHECK(calls[ EVENT_TMR_ALARM ] == 3 && last_id == 5);
+
+  CHECK(event_post(EVENT_TMR_ALARM, 6, 45, &a));
+  CHECK(notifications == 2);
+  CHECK(!event_post(EVENT_TYPE_NUM, 0, 0, NULL));
+}
+
+static void check_coalesce(void)
+{
+  event_stats_t s;
+  int a, b;
+
+  reset();
+  // The oldest event is never merged into
+  event_post(EVENT_TICKER_SCROLL, 0, 1, &a);
+  event_post(EVENT_TICKER_SCROLL, 0, 2, &a);
+  event_post(EVENT_TICKER_SCROLL, 0, 3, &a);
+  event_post(EVENT_TICKER_SCROLL, 0, 4, &b);
+  event_post(EVENT_TICKER_SCROLL, 1, 5, &a);
+  event_get_stats(&s);
+  CHECK(s.depth == 4 && s.posted == 4 && s.coalesced == 1);
+
+  CHECK(event_dispatch(2) == 2);
+  CHECK(calls[ EVENT_TICKER_SCROLL ] == 2 && last_arg == 3 && last_data == &a);
+  event_dispatch(EVENT_QUEUE_LEN);
+  CHECK(calls[ EVENT_TICKER_SCROLL ] == 4 && last_id == 1);
+}
+
+static void check_drop(void)
+{
+  event_stats_t s;
+  unsigned i, queued = 0;
+
+  reset();
+  for (i = 0; i < EVENT_QUEUE_LEN + 8; i++)
+    queued += event_post(EVENT_TMR_ALARM, i, 0, NULL);
+  event_get_stats(&s);
+  CHECK(queued == EVENT_QUEUE_LEN);
+  CHECK(s.depth == EVENT_QUEUE_LEN && s.max_depth == EVENT_QUEUE_LEN && s.dropped == 8);
+
+  // The batch limit, the oldest first
+  CHECK(event_dispatch(EVENT_DISPATCH_BATCH) == EVENT_QUEUE_LEN - EVENT_DISPATCH_BATCH);
+  CHECK(last_id == EVENT_DISPATCH_BATCH - 1);
+  event_dispatch(EVENT_QUEUE_LEN);
+  CHECK(calls[ EVENT_TMR_ALARM ] == EVENT_QUEUE_LEN && last_id == EVENT_QUEUE_LEN - 1);
+}
+
+static void check_cancel(void)
+{
+  int a, b;
+
+  reset();
+  event_post(EVENT_TICKER_SCROLL, 0, 1, &a);
+  event_post(EVENT_TICKER_SCROLL, 0, 2, &b);
+  event_post(EVENT_TMR_ALARM, 0, 3, &a);
+  event_post(EVENT_TICKER_SCROLL, 1, 4, &a);
+  event_cancel(EVENT_TICKER_SCROLL, &a);
+  event_dispatch(EVENT_QUEUE_LEN);
+  CHECK(calls[ EVENT_TICKER_SCROLL ] == 1 && calls[ EVENT_TMR_ALARM ] == 1);
+}
+
+// One second in 1 ms steps, returns the handler calls
+static unsigned run_fake_timers(unsigned type, event_stats_t *s)
+{
+  static const unsigned periods[] = { 2, 3, 5 };
+  static int sources[ 3 ];
+  unsigned ms, i;
+
+  reset();
+  for (ms = 1; ms <= 1000; ms++)
+  {
+    for (i = 0; i < 3; i++)
+    {
+      if (ms % periods[i] == 0)
+        event_post(type, i, ms, &sources[i]);
+    }
+    // The Lua task runs a batch, and is notified again while events are left
+    if (ms % 25 == 0 && notifications)
+    {
+      notifications = 0;
+      if (event_dispatch(EVENT_DISPATCH_BATCH))
+        notifications = 1;
+    }
+  }
+  event_get_stats(s);
+  return calls[ type ];
+}
+
+static void check_fake_timers(void)
+{
+  event_stats_t s;
+  unsigned handled;
+
+  // Merged, at most one event per source is pending besides the oldest
+  handled = run_fake_timers(EVENT_TICKER_SCROLL, &s);
+  CHECK(s.dropped == 0 && s.max_depth <= 4);
+  CHECK(handled == s.posted - s.depth);
+  CHECK(s.posted + s.coalesced == 500 + 333 + 200);
+  printf("coalesced: %u posts, %u merged, %u handled, depth <= %u, %u dropped\n",
+         s.posted + s.coalesced, s.coalesced, handled, s.max_depth, s.dropped);
+
+  // Not merged, the queue overflows and counts what it loses
+  handled = run_fake_timers(EVENT_TMR_ALARM, &s);
+  CHECK(s.dropped > 0 && s.max_depth == EVENT_QUEUE_LEN);
+  CHECK(s.posted + s.dropped == 500 + 333 + 200);
+  CHECK(handled == s.posted - s.depth);
+  printf("queued:    %u posts, %u dropped, %u handled, depth <= %u\n",
+         s.posted + s.dropped, s.dropped, handled, s.max_depth);
+}
+
+int main(void)
+{
+  event_init(notify);
+  event_register(EVENT_TMR_ALARM, handler, 0);
+  event_register(EVENT_TICKER_SCROLL, scroll_handler, EVENT_COALESCE);
+
+  check_post();
+  check_coalesce();
+  check_drop();
+  check_cancel();
+  check_fake_timers();
+  return host_test_result();
+}
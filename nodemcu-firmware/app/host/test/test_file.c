@@ -0,0 +1,46 @@
+/*
+ * file.open() no longer closes the file opened before it. Descriptors of
+ * file objects nobody references are given back by the collector when
+ * spiffs runs out of them, to whoever opens a file: file.open(), require(),
+ * node.compile().
+ */
+
+#include "host_test.h"
+
+#include "spiffs_config.h"
+#include "host.h"
+
+static bool lua_true(lua_State *L, const char *chunk)
+{
+  bool ok = host_test_dostring(L, chunk) && (lua_getglobal(L, "ok"), lua_toboolean(L, -1));
+
+  lua_settop(L, 0);
+  return ok;
+}
+
+int main(void)
+{
+  lua_State *L;
+
+  host_test_init(100000);
+  host_test_init_flash();
+  L = host_test_lua();
+
+  lua_pushinteger(L, SPIFFS_MAX_OPEN_FILES);
+  lua_setglobal(L, "MAX");
+  host_test_dostring(L,
+    "file.open('m.lua', 'w') file.write('return 1') file.close()\n"
+    "function fill() for i = 1, MAX do file.open('f' .. i, 'w') end end\n");
+
+  // Legacy scripts drop what file.open() returns
+  CHECK(lua_true(L, "fill() ok = file.open('m.lua') ~= nil"));
+  CHECK(lua_true(L, "fill() package.loaded.m = nil ok = require('m') == 1"));
+  CHECK(lua_true(L, "fill() ok = pcall(node.compile, 'm.lua')"));
+
+  // Files still referenced stay open
+  CHECK(lua_true(L, "t = {} for i = 1, MAX do t[i] = file.open('f' .. i, 'w') end\n"
+                    "ok = file.open('m.lua') == nil and t[1]:write('x')"));
+  CHECK(lua_true(L, "t = nil ok = file.open('m.lua') ~= nil"));
+
+  return host_test_result();
+}
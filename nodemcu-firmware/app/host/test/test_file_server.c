@@ -0,0 +1,438 @@
+/*
+ * file_server: a delta upload over TCP, into the spiffs of the host.
+ *
+ * A client on a host socket uploads a file, asks for its block signature
+ * and checks it against its own. It then sends a new version the way an
+ * rsync client would: the rolling checksum is slid over the new data a
+ * byte at a time, blocks found in the old file are copied on the device,
+ * everything else is written. The file has to end up as the new version,
+ * for less than the upload of the whole file, and a delta with the wrong
+ * CRC has to leave the previous version in place. A session must not get
+ * to a third open file by streaming a chunk during an upload.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "flash_fs.h"
+#include "host.h"
+
+#define PORT            20123
+#define BLOCK           256
+#define OLD_SIZE        2000            // 7 blocks and a short one
+#define MAX_SIZE        4096
+#define MAX_BLOCKS      (MAX_SIZE / BLOCK)
+#define FILE_NAME       "data.txt"
+
+typedef struct
+{
+  uint32_t weak;
+  uint32_t crc;
+} block_sig_t;
+
+static int client = -1;
+static unsigned sequence;
+static unsigned sent_bytes;
+static char reply[ 1024 ];
+static unsigned reply_len;
+
+static uint32_t crc32(uint32_t crc, const uint8 *data, unsigned len)
+{
+  unsigned i;
+
+  crc = ~crc;
+  while (len--)
+  {
+    crc ^= *data++;
+    for (i = 0; i < 8; i++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static uint32_t weak_sum(const uint8 *data, unsigned len)
+{
+  uint32_t a = 0, b = 0;
+
+  while (len--)
+  {
+    a += *data++;
+    b += a;
+  }
+  return (a & 0xFFFF) | (b << 16);
+}
+
+static bool client_connect(void)
+{
+  struct sockaddr_in sa;
+
+  client = socket(AF_INET, SOCK_STREAM, 0);
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(PORT + host_port_offset);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(client, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+  {
+    perror("test_file_server: connect");
+    return false;
+  }
+  host_test_run(10000);
+  return true;
+}
+
+// Send a v2 frame, returns its sequence number
+static unsigned frame(char command, const void *payload, unsigned len)
+{
+  char header[ 32 ];
+  int n;
+
+  n = sprintf(header, "%c%u|%u|", command, ++sequence, len);
+  CHECK(send(client, header, n, 0) == n);
+  CHECK(len == 0 || send(client, payload, len, 0) == (ssize_t)len);
+  sent_bytes += n + len;
+  return sequence;
+}
+
+static unsigned frame_str(char command, const char *payload)
+{
+  return frame(command, payload, strlen(payload));
+}
+
+static bool contains(const char *data, unsigned len, const char *what)
+{
+  unsigned n = strlen(what), i;
+
+  for (i = 0; i + n <= len; i++)
+  {
+    if (memcmp(data + i, what, n) == 0)
+      return true;
+  }
+  return false;
+}
+
+// Let the server run until the reply holds what, or the connection closed
+static bool wait_reply(const char *what)
+{
+  unsigned tries;
+  ssize_t n;
+
+  reply_len = 0;
+  for (tries = 0; tries < 100; tries++)
+  {
+    host_test_run(5000);
+    n = recv(client, reply + reply_len, sizeof(reply) - 1 - reply_len, MSG_DONTWAIT);
+    if (n == 0)
+      break;
+    if (n > 0)
+    {
+      reply_len += n;
+      reply[reply_len] = 0;
+      if (contains(reply, reply_len, what))
+        return true;
+    }
+  }
+  return false;
+}
+
+static void client_close(void)
+{
+  close(client);
+  client = -1;
+  host_test_run(10000);
+}
+
+static unsigned read_file(const char *name, uint8 *data)
+{
+  int fd = fs_open(name, fs_mode2flag("r"));
+  int n;
+
+  if (fd < FS_OPEN_OK)
+    return 0;
+  n = fs_read(fd, data, MAX_SIZE);
+  fs_close(fd);
+  return n > 0 ? n : 0;
+}
+
+static bool file_is(const uint8 *data, unsigned len)
+{
+  uint8 stored[ MAX_SIZE ];
+
+  return read_file(FILE_NAME, stored) == len && memcmp(stored, data, len) == 0;
+}
+
+static void upload(const uint8 *data, unsigned len)
+{
+  char crc[ 16 ], ack[ 16 ];
+
+  frame_str('O', FILE_NAME);
+  frame('W', data, len);
+  sprintf(crc, "%08x", crc32(0, data, len));
+  sprintf(ack, "Y%u|", frame_str('C', crc));
+  CHECK(wait_reply(ack));
+  CHECK(!memchr(reply, 'N', reply_len));
+}
+
+// Fetch and check the signature of the file, returns the block count
+static unsigned signature(const uint8 *data, unsigned len, block_sig_t *sig)
+{
+  char head[ 32 ];
+  uint32_t size;
+  unsigned blocks = (len + BLOCK - 1) / BLOCK, i, n;
+  const char *payload;
+
+  n = sprintf(head, "S%u|%u|", frame_str('S', FILE_NAME), 4 + 8 * blocks);
+  if (!CHECK(wait_reply(head)))
+    return 0;
+  // The whole reply, the signature has no '|' of its own to wait for
+  for (i = 0; i < 20 && reply_len < n + 4 + 8 * blocks; i++)
+  {
+    ssize_t got;
+
+    host_test_run(5000);
+    got = recv(client, reply + reply_len, sizeof(reply) - reply_len, MSG_DONTWAIT);
+    if (got > 0)
+      reply_len += got;
+  }
+  if (!CHECK(reply_len == n + 4 + 8 * blocks))
+    return 0;
+
+  payload = reply + n;
+  memcpy(&size, payload, 4);
+  CHECK(size == len);
+  for (i = 0; i < blocks; i++)
+  {
+    memcpy(&sig[i].weak, payload + 4 + 8 * i, 4);
+    memcpy(&sig[i].crc, payload + 8 + 8 * i, 4);
+    n = len - i * BLOCK < BLOCK ? len - i * BLOCK : BLOCK;
+    CHECK(sig[i].weak == weak_sum(data + i * BLOCK, n));
+    CHECK(sig[i].crc == crc32(0, data + i * BLOCK, n));
+  }
+  return blocks;
+}
+
+// Block of the old file the window matches, or -1
+static int find_block(const block_sig_t *sig, unsigned blocks, unsigned old_len,
+                      uint32_t weak, const uint8 *window, unsigned len)
+{
+  unsigned i, size;
+
+  for (i = 0; i < blocks; i++)
+  {
+    size = old_len - i * BLOCK < BLOCK ? old_len - i * BLOCK : BLOCK;
+    if (size == len && sig[i].weak == weak && sig[i].crc == crc32(0, window, len))
+      return i;
+  }
+  return -1;
+}
+
+static void flush_literal(const uint8 *data, unsigned *start, unsigned end, unsigned *written)
+{
+  if (end > *start)
+  {
+    frame('W', data + *start, end - *start);
+    *written += end - *start;
+  }
+}
+
+static void flush_copy(int *first, unsigned *count, unsigned *copied)
+{
+  char range[ 16 ];
+
+  if (*count)
+  {
+    sprintf(range, "%d,%u", *first, *count);
+    frame_str('K', range);
+    *copied += *count;
+  }
+  *count = 0;
+}
+
+// Send data as a delta against the old file, with the CRC given
+static void delta(const uint8 *data, unsigned len, const block_sig_t *sig, unsigned blocks,
+                  unsigned old_len, uint32_t crc, unsigned *written, unsigned *copied)
+{
+  uint32_t a = 0, b = 0;
+  unsigned i = 0, literal = 0, run = 0, tail = old_len % BLOCK, k;
+  int first = -1, found;
+  char text[ 16 ];
+
+  *written = *copied = 0;
+  frame_str('D', FILE_NAME);
+
+  // The sums of the window at i, rolled along while nothing matches
+  for (k = 0; k < BLOCK && k < len; k++)
+  {
+    a += data[k];
+    b += a;
+  }
+  while (i < len)
+  {
+    found = -1;
+    if (len - i >= BLOCK)
+      found = find_block(sig, blocks, old_len, (a & 0xFFFF) | (b << 16), data + i, BLOCK);
+    else if (tail && len - i == tail)
+      found = find_block(sig, blocks, old_len, weak_sum(data + i, tail), data + i, tail);
+
+    if (found >= 0)
+    {
+      flush_literal(data, &literal, i, written);
+      if (run && found != first + (int)run)
+        flush_copy(&first, &run, copied);
+      if (!run)
+        first = found;
+      run++;
+      i += BLOCK;
+      literal = i;
+      a = b = 0;
+      for (k = i; k < i + BLOCK && k < len; k++)
+      {
+        a += data[k];
+        b += a;
+      }
+      continue;
+    }
+
+    flush_copy(&first, &run, copied);
+    if (i + BLOCK < len)
+    {
+      a += data[i + BLOCK] - data[i];
+      b += a - BLOCK * data[i];
+    }
+    i++;
+  }
+  flush_literal(data, &literal, len, written);
+  flush_copy(&first, &run, copied);
+
+  sprintf(text, "%08x", crc);
+  frame_str('C', text);
+}
+
+int main(void)
+{
+  static uint8 old[ MAX_SIZE ], new[ MAX_SIZE ], stored[ MAX_SIZE ];
+  block_sig_t sig[ MAX_BLOCKS ];
+  unsigned i, new_len, blocks, written, copied, full;
+  char ack[ 16 ];
+  lua_State *L;
+
+  host_port_offset = getpid() % 10000 + 10000;
+  host_test_init(100000);
+  host_test_init_flash();
+  L = host_test_lua();
+  if (!host_test_dostring(L, "srv = file_server.start(20123)") || !client_connect())
+    return host_test_result();
+
+  srand(1);
+  for (i = 0; i < OLD_SIZE; i++)
+    old[i] = rand();
+
+  sequence = 0;
+  upload(old, OLD_SIZE);
+  CHECK(file_is(old, OLD_SIZE));
+  blocks = signature(old, OLD_SIZE, sig);
+  CHECK(blocks == 8);
+
+  // 37 bytes inserted into block 1, block 5 changed, 100 bytes appended
+  memcpy(new, old, 300);
+  for (i = 0; i < 37; i++)
+    new[300 + i] = i;
+  memcpy(new + 337, old + 300, OLD_SIZE - 300);
+  new[337 + 5 * BLOCK - 300 + 10] ^= 0xFF;
+  for (i = 0; i < 100; i++)
+    new[OLD_SIZE + 37 + i] = 'a' + i % 26;
+  new_len = OLD_SIZE + 37 + 100;
+
+  sent_bytes = 0;
+  delta(new, new_len, sig, blocks, OLD_SIZE, crc32(0, new, new_len), &written, &copied);
+  sprintf(ack, "Y%u|", sequence);
+  CHECK(wait_reply(ack));
+  CHECK(!memchr(reply, 'N', reply_len));
+  CHECK(file_is(new, new_len));
+  CHECK(read_file("~fs0.tmp", stored) == 0);
+
+  // Blocks 0, 2-4 and 6, the short tail is followed by new data
+  CHECK(copied == 5);
+  full = new_len + 2 * 16 + 10;
+  CHECK(sent_bytes < full / 2);
+  printf("delta: %u of %u bytes written, %u blocks copied, %u bytes sent for a %u byte file\n",
+         written, new_len, copied, sent_bytes, new_len);
+
+  // A wrong CRC keeps the previous version
+  blocks = signature(new, new_len, sig);
+  new[0] ^= 0xFF;
+  delta(new, new_len, sig, blocks, new_len, 0x12345678, &written, &copied);
+  new[0] ^= 0xFF;
+  sprintf(ack, "N%u|", sequence);
+  CHECK(wait_reply(ack));
+  CHECK(file_is(new, new_len));
+  CHECK(read_file("~fs0.tmp", stored) == 0);
+
+  client_close();
+
+  // No chunk is streamed while a delta upload holds two files
+  if (client_connect())
+  {
+    frame_str('D', FILE_NAME);
+    sprintf(ack, "N%u|", frame_str('X', "print(1)"));
+    CHECK(wait_reply(ack));
+    client_close();
+  }
+  CHECK(read_file("~fs0.tmp", stored) == 0);
+
+  // Nor a file opened while a chunk is streamed
+  if (client_connect())
+  {
+    frame_str('X', "x = 1");
+    sprintf(ack, "N%u|", frame_str('O', "other.txt"));
+    CHECK(wait_reply(ack));
+    client_close();
+  }
+  CHECK(read_file("other.txt", stored) == 0);
+
+  // The N ack follows the ack of the frames before the failed one, then the
+  // connection closes and the frame behind it is dropped
+  if (client_connect())
+  {
+    unsigned good;
+    char nack[ 16 ];
+    const char *y, *n;
+
+    frame_str('O', "other.txt");
+    good = frame_str('W', "abc");
+    sprintf(ack, "Y%u|", good);
+    sprintf(nack, "N%u|", frame_str('C', "00000000"));
+    frame_str('W', "def");
+    CHECK(wait_reply(nack));
+    y = strstr(reply, ack);
+    n = strstr(reply, nack);
+    CHECK(y && n && y < n);
+    CHECK(!wait_reply("|"));
+    client_close();
+  }
+
+  // A frame across the wrap of system_get_time() takes no longer than others
+  if (client_connect())
+  {
+    char header[ 32 ];
+    int n;
+
+    host_time_offset = 0u - (uint32)host_time_us() - 2000;
+    n = sprintf(header, "O%u|%u|", ++sequence, (unsigned)strlen(FILE_NAME));
+    CHECK(send(client, header, n, 0) == n);
+    host_test_run(5000);
+    CHECK(send(client, FILE_NAME, strlen(FILE_NAME), 0) == (ssize_t)strlen(FILE_NAME));
+    sprintf(ack, "Y%u|", sequence);
+    CHECK(wait_reply(ack));
+    CHECK(host_test_dostring(L, "local _, _, _, max = file_server.stats() assert(max < 1000000, max)"));
+    client_close();
+    host_time_offset = 0;
+  }
+
+  host_test_dostring(L, "srv:stop() srv = nil");
+  return host_test_result();
+}
@@ -0,0 +1,76 @@
+/*
+ * Lua flash store: require() takes a module from the store unless spiffs
+ * has a .lc of it that differs from the stored copy.
+ *
+ * The store is written with luaN_store(), node.flashstore() would restart.
+ * package.loaders[2] is the loader of the store, it returns the chunk or
+ * the reason it has none.
+ */
+
+#include "host_test.h"
+
+#include "lflash.h"
+#include "host.h"
+
+static bool store(lua_State *L, const char *name)
+{
+  const char *files[] = { name };
+
+  if (luaN_store(L, files, 1) != LUAN_OK)
+  {
+    host_test_check(false, lua_tostring(L, -1), "luaN_store", 0);
+    lua_pop(L, 1);
+    return false;
+  }
+  return true;
+}
+
+static bool lua_true(lua_State *L, const char *chunk)
+{
+  bool ok = host_test_dostring(L, chunk) && (lua_getglobal(L, "ok"), lua_toboolean(L, -1));
+
+  lua_settop(L, 0);
+  return ok;
+}
+
+int main(void)
+{
+  lua_State *L;
+
+  host_test_init(100000);
+  host_test_init_flash();
+  L = host_test_lua();
+
+  host_test_dostring(L,
+    "function put(v)\n"
+    "  file.open('m.lua', 'w') file.write('return ' .. v) file.close()\n"
+    "  node.compile('m.lua')\n"
+    "end\n"
+    "function from_store() return type(package.loaders[2]('m')) == 'function' end\n"
+    "function get() package.loaded.m = nil return require('m') end\n"
+    "put(1)");
+  if (!store(L, "m.lc"))
+    return host_test_result();
+
+  // The same .lc in spiffs, the store wins
+  CHECK(lua_true(L, "ok = from_store() and get() == 1"));
+
+  // A .lua alone doesn't replace the stored module
+  CHECK(lua_true(L, "file.remove('m.lc') file.open('m.lua', 'w') file.write('return 9') file.close()\n"
+                    "ok = from_store() and get() == 1"));
+
+  // A newer .lc does, a .lc of the same size too
+  CHECK(lua_true(L, "put(2) ok = not from_store() and get() == 2"));
+  CHECK(lua_true(L, "local s = package.loaders[2]('m')\n"
+                    "ok = type(s) == 'string' and s:find('older than') ~= nil"));
+  CHECK(lua_true(L, "put(22) ok = not from_store() and get() == 22"));
+
+  // Storing it again makes the store current
+  if (store(L, "m.lc"))
+    CHECK(lua_true(L, "ok = from_store() and get() == 22"));
+
+  // node.flashindex() still returns the stored chunk
+  CHECK(lua_true(L, "put(3) ok = node.flashindex('m')() == 22 and get() == 3"));
+
+  return host_test_result();
+}
@@ -0,0 +1,85 @@
+/*
+ * gpio: level triggers don't keep the interrupt busy.
+ *
+ * host_gpio.c calls the GPIO interrupt again while a status bit is pending,
+ * like the chip does, and counts a storm where the watchdog would reset it.
+ * A level held on a pin has to reach the Lua callback once per run of the
+ * task and no more, until the callback changes the trigger. Edges, a
+ * debounced level and gpio.counter() are checked along.
+ */
+
+#include "host_test.h"
+
+#include "host.h"
+
+#define PIN             5               // GPIO14
+#define GPIO            14
+
+static int global_int(lua_State *L, const char *name)
+{
+  int value;
+
+  lua_getglobal(L, name);
+  value = lua_tointeger(L, -1);
+  lua_pop(L, 1);
+  return value;
+}
+
+int main(void)
+{
+  lua_State *L;
+
+  host_test_init(100000);
+  L = host_test_lua();
+  host_gpio_drive(GPIO, 1);
+
+  // Held low, the callback moves the trigger on after three calls
+  host_test_dostring(L,
+    "n = 0\n"
+    "gpio.mode(5, gpio.INT)\n"
+    "gpio.trig(5, 'low', function(level, time, edges)\n"
+    "  n = n + 1 lv = level\n"
+    "  if n == 3 then gpio.trig(5, 'high') elseif n == 4 then gpio.trig(5, 'up') end\n"
+    "end)");
+  host_gpio_drive(GPIO, 0);
+  CHECK(host_gpio_storms() == 0);
+  host_test_run(20000);
+  host_test_dostring(L, "queued, depth, overflow = gpio.stats()");
+  CHECK(global_int(L, "n") == 3 && global_int(L, "lv") == 0);
+  CHECK(global_int(L, "queued") == 3 && global_int(L, "overflow") == 0);
+
+  // High once, then an edge trigger
+  host_gpio_drive(GPIO, 1);
+  host_test_run(20000);
+  CHECK(global_int(L, "n") == 4 && global_int(L, "lv") == 1);
+  host_gpio_drive(GPIO, 0);
+  host_gpio_drive(GPIO, 1);
+  host_test_run(20000);
+  CHECK(global_int(L, "n") == 5);
+  CHECK(host_gpio_storms() == 0);
+
+  // A debounced level is re-armed after the window
+  host_test_dostring(L,
+    "m = 0\n"
+    "gpio.trig(5, 'low', function() m = m + 1 end, 50000)\n"
+    "_, _, _, bounced = gpio.stats()");
+  host_gpio_drive(GPIO, 0);
+  host_test_run(20000);
+  CHECK(global_int(L, "m") == 1);
+  host_test_run(100000);
+  host_test_dostring(L, "gpio.trig(5, 'none') _, _, overflow, b = gpio.stats() bounced = b - bounced");
+  CHECK(global_int(L, "m") >= 2 && global_int(L, "m") <= 3);
+  CHECK(global_int(L, "bounced") > 0 && global_int(L, "overflow") == 0);
+  CHECK(host_gpio_storms() == 0);
+
+  host_test_dostring(L,
+    "ok = pcall(gpio.counter, 5, 'low') ok = ok and 1 or 0\n"
+    "gpio.counter(5, 'down')");
+  CHECK(global_int(L, "ok") == 0);
+  host_gpio_drive(GPIO, 1);
+  host_gpio_drive(GPIO, 0);
+  host_test_dostring(L, "count = gpio.count(5)");
+  CHECK(global_int(L, "count") == 1);
+
+  return host_test_result();
+}
@@ -0,0 +1,282 @@
+/*
+ * lpd8806: the bit-banged and the HSPI output send the same bytes.
+ *
+ * The bit-banged strip is decoded from the GPIO levels, MOSI is sampled on
+ * the clock edge of the SPI mode. The HSPI strip is read from the SPI
+ * registers by host_spi.c. Both get the same colors in each of the four
+ * modes, on a strip of 60 LEDs and on one that doesn't fill the last word
+ * of a burst.
+ *
+ * An update sends the LEDs up to the last changed one and their latch, or
+ * nothing, as counted by get_stats(). set_colors() sets what the table
+ * form of set_color() does.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+
+#include "ets_sys.h"
+#include "lauxlib.h"
+#include "lpd8806.h"
+#include "pin_map.h"
+#include "driver/spi_register.h"
+#include "host.h"
+
+#define MAX_STREAM      1024
+
+#define BB_MOSI         1
+#define BB_CLK          2
+#define HSPI_ID         1
+
+typedef struct
+{
+  uint8 data[ MAX_STREAM ];
+  unsigned len;
+} stream_t;
+
+static stream_t bitbang, hspi;
+
+static uint32 mosi_bit, clk_bit;
+static bool sample_rising;
+static unsigned bits, byte;
+
+static void stream_add(stream_t *s, uint8 value)
+{
+  if (s->len < MAX_STREAM)
+    s->data[s->len++] = value;
+}
+
+static void stream_reset(void)
+{
+  bitbang.len = 0;
+  hspi.len = 0;
+  bits = 0;
+  byte = 0;
+}
+
+static void decode_gpio(uint32 old, uint32 now)
+{
+  if (!((old ^ now) & clk_bit) || !(now & clk_bit) != !sample_rising)
+    return;
+
+  byte = (byte << 1) | !!(now & mosi_bit);
+  if (++bits == 8)
+  {
+    stream_add(&bitbang, byte);
+    bits = 0;
+    byte = 0;
+  }
+}
+
+static void capture_spi(unsigned id, const uint8 *data, unsigned len)
+{
+  unsigned i;
+
+  if (id == HSPI_ID)
+  {
+    for (i = 0; i < len; i++)
+      stream_add(&hspi, data[i]);
+  }
+}
+
+static bool streams_equal(void)
+{
+  return bitbang.len == hspi.len && memcmp(bitbang.data, hspi.data, hspi.len) == 0;
+}
+
+// Encoded colors of LEDs 0..count-1 as the test sets them, then the latch
+static unsigned expected(uint8 *out, unsigned count, unsigned shift)
+{
+  unsigned i, len = 0;
+
+  for (i = 0; i < count; i++, len += 3)
+    encode_color(out + len, (i * 4 + shift) & 0xff, (i * 7) & 0xff, (i * 13) & 0xff);
+  memset(out + len, 0, ((count + 31) / 32) * 3);
+  return len + ((count + 31) / 32) * 3;
+}
+
+static void check_mode(lua_State *L, unsigned mode, unsigned length)
+{
+  unsigned cpol = mode == 2 || mode == 3;
+  unsigned cpha = mode == 0 || mode == 3;
+  uint8 want[ MAX_STREAM ];
+  unsigned len;
+  char chunk[ 256 ];
+
+  host_gpio_probe(NULL);
+  c_sprintf(chunk,
+    "b = lpd8806.setup(%u, %u, %u, %u, 0)\n"
+    "h = lpd8806.setup(7, 5, %u, %u, 0, lpd8806.HSPI)\n",
+    BB_MOSI, BB_CLK, length, mode, length, mode);
+  if (!host_test_dostring(L, chunk))
+    return;
+
+  // spi_master_init() sets the phase, the polarity is left to the idle level
+  CHECK(!!(READ_PERI_REG(SPI_USER(HSPI_ID)) & SPI_CK_OUT_EDGE) == cpha);
+
+  sample_rising = cpol == cpha;
+  stream_reset();
+  host_gpio_probe(decode_gpio);
+
+  // Every LED changes
+  host_test_dostring(L,
+    "for i = 0, b:get_length() - 1 do\n"
+    "  b:set_color(i, (i * 4) % 256, (i * 7) % 256, (i * 13) % 256)\n"
+    "  h:set_color(i, (i * 4) % 256, (i * 7) % 256, (i * 13) % 256)\n"
+    "end\n"
+    "b:update() h:update()");
+  len = expected(want, length, 0);
+  CHECK(streams_equal());
+  CHECK(hspi.len == len && memcmp(hspi.data, want, len) == 0);
+
+  // A forced update of an unchanged strip
+  stream_reset();
+  host_test_dostring(L, "b:update(true) h:update(true)");
+  CHECK(streams_equal());
+  CHECK(hspi.len == len && memcmp(hspi.data, want, len) == 0);
+
+  host_gpio_probe(NULL);
+  host_test_dostring(L, "b = nil h = nil collectgarbage()");
+}
+
+static int global_int(lua_State *L, const char *name)
+{
+  int value;
+
+  lua_getglobal(L, name);
+  value = lua_tointeger(L, -1);
+  lua_pop(L, 1);
+  return value;
+}
+
+// Update both strips, both have to send the first count LEDs of colors
+static void check_update(lua_State *L, const char *chunk, const uint8 *colors, unsigned count)
+{
+  uint8 want[ MAX_STREAM ];
+  unsigned i, len = 0;
+
+  for (i = 0; i < count; i++, len += 3)
+    encode_color(want + len, colors[i * 3], colors[i * 3 + 1], colors[i * 3 + 2]);
+  memset(want + len, 0, count ? ((count + 31) / 32) * 3 : 0);
+  len += count ? ((count + 31) / 32) * 3 : 0;
+
+  stream_reset();
+  host_test_dostring(L, chunk);
+  CHECK(streams_equal());
+  CHECK(hspi.len == len && memcmp(hspi.data, want, len) == 0);
+}
+
+static void check_dirty(lua_State *L)
+{
+  uint8 colors[ 60 * 3 ];
+
+  host_gpio_probe(NULL);
+  host_test_dostring(L,
+    "b = lpd8806.setup(1, 2, 60, 0, 0)\n"
+    "h = lpd8806.setup(7, 5, 60, 0, 0, lpd8806.HSPI)\n"
+    "updates, skipped = h:get_stats()");
+  CHECK(global_int(L, "updates") == 1 && global_int(L, "skipped") == 0);
+  memset(colors, 0, sizeof(colors));
+  sample_rising = false;
+  host_gpio_probe(decode_gpio);
+
+  // Nothing changed
+  check_update(L, "b:update() h:update()", colors, 0);
+
+  // One LED, the latch is that of the six sent
+  colors[5 * 3] = 200;
+  check_update(L, "b:set_color(5, 200, 0, 0) h:set_color(5, 200, 0, 0) b:update() h:update()", colors, 6);
+
+  // The same color again
+  check_update(L, "b:set_color(5, 200, 0, 0) h:set_color(5, 200, 0, 0) b:update() h:update()", colors, 0);
+
+  // Two LEDs, up to the last one
+  colors[2 * 3 + 1] = 100;
+  colors[9 * 3 + 2] = 50;
+  check_update(L,
+    "b:set_color(9, 0, 0, 50) h:set_color(9, 0, 0, 50)\n"
+    "b:set_color(2, 0, 100, 0) h:set_color(2, 0, 100, 0)\n"
+    "b:update() h:update()", colors, 10);
+
+  // Forced
+  check_update(L, "b:update(true) h:update(true)", colors, 60);
+
+  host_test_dostring(L, "updates, skipped = h:get_stats()");
+  CHECK(global_int(L, "updates") == 4 && global_int(L, "skipped") == 2);
+
+  host_gpio_probe(NULL);
+  host_test_dostring(L, "b = nil h = nil collectgarbage()");
+}
+
+static void check_set_colors(lua_State *L)
+{
+  uint8 colors[ 60 * 3 ];
+  unsigned i;
+
+  host_gpio_probe(NULL);
+  host_test_dostring(L,
+    "b = lpd8806.setup(1, 2, 60, 0, 0)\n"
+    "h = lpd8806.setup(7, 5, 60, 0, 0, lpd8806.HSPI)\n"
+    "function frame(n, shift)\n"
+    "  local bytes, idx, r, g, b = {}, {}, {}, {}, {}\n"
+    "  for i = 0, n - 1 do\n"
+    "    idx[i + 1] = i r[i + 1] = (i * 4 + shift) % 256 g[i + 1] = (i * 7) % 256 b[i + 1] = (i * 13) % 256\n"
+    "    bytes[i + 1] = string.char(r[i + 1], g[i + 1], b[i + 1])\n"
+    "  end\n"
+    "  return table.concat(bytes), idx, r, g, b\n"
+    "end");
+  sample_rising = false;
+  host_gpio_probe(decode_gpio);
+
+  for (i = 0; i < 60; i++)
+  {
+    colors[i * 3] = i * 4 + 1;
+    colors[i * 3 + 1] = i * 7;
+    colors[i * 3 + 2] = i * 13;
+  }
+  check_update(L, "s, idx, r, g, bl = frame(60, 1) b:set_colors(s) h:set_color(idx, r, g, bl) b:update() h:update()",
+               colors, 60);
+
+  // From an offset, past the end of the strip and a trailing partial LED
+  for (i = 0; i < 5; i++)
+  {
+    colors[(55 + i) * 3] = i * 4 + 2;
+    colors[(55 + i) * 3 + 1] = i * 7;
+    colors[(55 + i) * 3 + 2] = i * 13;
+  }
+  check_update(L,
+    "s, idx, r, g, bl = frame(8, 2)\n"
+    "b:set_colors(s .. 'xy', 55)\n"
+    "for i = 1, 5 do h:set_color(54 + i, r[i], g[i], bl[i]) end\n"
+    "b:update() h:update()", colors, 60);
+
+  // Unchanged colors don't mark the strip
+  check_update(L, "b:set_colors(s, 55) b:update() h:update()", colors, 0);
+
+  host_gpio_probe(NULL);
+  host_test_dostring(L, "b = nil h = nil collectgarbage()");
+}
+
+int main(void)
+{
+  lua_State *L;
+  unsigned mode;
+
+  host_test_init(100000);
+  mosi_bit = BIT(pin_num[BB_MOSI]);
+  clk_bit = BIT(pin_num[BB_CLK]);
+  host_spi_attach(HSPI_ID, capture_spi);
+  L = host_test_lua();
+
+  for (mode = 0; mode < 4; mode++)
+  {
+    check_mode(L, mode, 60);
+    check_mode(L, mode, 37);
+  }
+  check_dirty(L);
+  check_set_colors(L);
+
+  host_spi_attach(HSPI_ID, NULL);
+  return host_test_result();
+}
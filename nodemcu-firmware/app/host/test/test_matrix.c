@@ -0,0 +1,119 @@
+/*
+ * matrix: the lookup table of every order and rotation.
+ *
+ * The expected layout is built the long way: the strip indexes of the
+ * panel as wired, turned clockwise by 90 degrees as often as the rotation
+ * asks. The table has to match it for several panel sizes, and the default
+ * ticker layout has to stay the led_mapping[] of the first lpd_ticker.c.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+
+#include "matrix.h"
+
+#define MAX_LEDS        256
+
+// The panel as wired, row major
+static void wired(unsigned width, unsigned height, unsigned order, uint16_t *grid)
+{
+  unsigned x, y;
+
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+    {
+      if (order == MATRIX_SERPENTINE && (y & 1))
+        grid[y * width + x] = y * width + width - 1 - x;
+      else
+        grid[y * width + x] = y * width + x;
+    }
+  }
+}
+
+// Turn a width x height grid clockwise, it becomes height x width
+static void turn(unsigned width, unsigned height, uint16_t *grid)
+{
+  uint16_t turned[ MAX_LEDS ];
+  unsigned x, y;
+
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+      turned[x * height + (height - 1 - y)] = grid[y * width + x];
+  }
+  memcpy(grid, turned, sizeof(uint16_t) * width * height);
+}
+
+static void check_layout(unsigned width, unsigned height, unsigned order, unsigned rotation)
+{
+  uint16_t grid[ MAX_LEDS ];
+  unsigned char seen[ MAX_LEDS ];
+  unsigned w = width, h = height, turns, i;
+  matrix_t m;
+
+  wired(width, height, order, grid);
+  for (turns = rotation / 90; turns > 0; turns--)
+  {
+    turn(w, h, grid);
+    i = w;
+    w = h;
+    h = i;
+  }
+
+  if (!CHECK(matrix_init(&m, width, height, order, rotation)))
+    return;
+  CHECK(m.m_Width == w && m.m_Height == h);
+  CHECK(memcmp(m.m_Lut, grid, sizeof(uint16_t) * width * height) == 0);
+
+  // Every LED once
+  memset(seen, 0, sizeof(seen));
+  for (i = 0; i < width * height; i++)
+  {
+    if (m.m_Lut[i] < width * height)
+      seen[m.m_Lut[i]]++;
+  }
+  for (i = 0; i < width * height; i++)
+    CHECK(seen[i] == 1);
+
+  matrix_release(&m);
+  CHECK(m.m_Lut == NULL);
+}
+
+int main(void)
+{
+  static const unsigned sizes[][2] = { { 1, 1 }, { 10, 6 }, { 8, 8 }, { 5, 3 }, { 32, 8 }, { 1, 7 } };
+  static const uint16_t led_mapping[] = {
+    50, 51, 52, 53, 54, 55, 56, 57, 58, 59,
+    49, 48, 47, 46, 45, 44, 43, 42, 41, 40,
+    30, 31, 32, 33, 34, 35, 36, 37, 38, 39,
+    29, 28, 27, 26, 25, 24, 23, 22, 21, 20,
+    10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+     9,  8,  7,  6,  5,  4,  3,  2,  1,  0
+  };
+  unsigned s, order, rotation;
+  matrix_t m;
+
+  host_test_init(100000);
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    for (order = MATRIX_PROGRESSIVE; order <= MATRIX_SERPENTINE; order++)
+    {
+      for (rotation = 0; rotation < 360; rotation += 90)
+        check_layout(sizes[s][0], sizes[s][1], order, rotation);
+    }
+  }
+
+  CHECK(!matrix_init(&m, 10, 6, MATRIX_PROGRESSIVE, 45));
+
+  // The ticker on a plain strip, see ticker_setup()
+  if (CHECK(matrix_init(&m, 10, 6, MATRIX_SERPENTINE, 180)))
+  {
+    CHECK(memcmp(m.m_Lut, led_mapping, sizeof(led_mapping)) == 0);
+    matrix_release(&m);
+  }
+
+  return host_test_result();
+}
@@ -0,0 +1,119 @@
+/*
+ * node.output(): a failing callback doesn't stop the redirection, and
+ * neither does a socket that stops reporting sent batches.
+ *
+ * The error of the callback is reported on the UART, once, and the callback
+ * set next gets the output that follows. Output to a socket goes on after
+ * its "sent" callback was set to another function, and after the socket
+ * was closed nothing is held back for it.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "host.h"
+
+#define PORT            20124
+
+static bool lua_true(lua_State *L, const char *chunk)
+{
+  bool ok = host_test_dostring(L, chunk) && (lua_getglobal(L, "ok"), lua_toboolean(L, -1));
+
+  lua_settop(L, 0);
+  return ok;
+}
+
+// Run the firmware until the client got what, for up to ms
+static bool client_got(int client, const char *what, unsigned ms)
+{
+  static char got[1024];
+  static unsigned len;
+  ssize_t n;
+
+  for (; ms > 0; ms -= 10)
+  {
+    host_test_run(10000);
+    n = recv(client, got + len, sizeof(got) - 1 - len, MSG_DONTWAIT);
+    if (n > 0)
+    {
+      len += n;
+      got[len] = 0;
+    }
+    if (strstr(got, what))
+      return true;
+  }
+  return false;
+}
+
+static void check_socket(lua_State *L)
+{
+  struct sockaddr_in sa;
+  int client;
+
+  host_test_dostring(L,
+    "srv = net.createServer(net.TCP, 30)\n"
+    "srv:listen(20124, function(c) conn = c node.output(c, 0) end)");
+  client = socket(AF_INET, SOCK_STREAM, 0);
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(PORT + host_port_offset);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (!CHECK(connect(client, (struct sockaddr *)&sa, sizeof(sa)) == 0))
+    return;
+  host_test_run(10000);
+
+  host_test_dostring(L, "print('one')");
+  CHECK(client_got(client, "one", 500));
+
+  // The sent callback of the output is replaced, the next batch waits for
+  // it in vain until the timeout
+  host_test_dostring(L, "conn:on('sent', function() end) print('two')");
+  CHECK(client_got(client, "two", 500));
+  host_test_dostring(L, "print('three')");
+  CHECK(client_got(client, "three", 5000));
+
+  // A closed socket takes nothing, the output isn't held back
+  host_test_dostring(L, "node.output(conn, 0) conn:close()");
+  host_test_run(50000);
+  host_test_dostring(L, "print('lost')");
+  host_test_run(100000);
+  host_test_dostring(L, "print('lost too')");
+  host_test_run(100000);
+  CHECK(lua_true(L, "ok = node.outputstats() == 0"));
+  host_test_dostring(L, "node.output(nil) srv:close()");
+  close(client);
+}
+
+int main(void)
+{
+  lua_State *L;
+
+  host_port_offset = getpid() % 10000 + 10000;
+  host_test_init(100000);
+  L = host_test_lua();
+
+  host_test_dostring(L,
+    "fails = 0\n"
+    "node.output(function(s) fails = fails + 1 error('boom') end, 0)\n"
+    "print('lost')");
+  host_test_run(100000);
+  host_test_dostring(L,
+    "got = ''\n"
+    "node.output(function(s) got = got .. s end, 0)\n"
+    "print('kept')");
+  host_test_run(100000);
+  host_test_dostring(L,
+    "node.output(nil)\n"
+    "ok = fails == 1 and got == 'kept\\n'");
+  lua_getglobal(L, "ok");
+  CHECK(lua_toboolean(L, -1));
+  lua_pop(L, 1);
+
+  check_socket(L);
+  return host_test_result();
+}
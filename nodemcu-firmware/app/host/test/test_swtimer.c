@@ -0,0 +1,191 @@
+/*
+ * swtimer: the timing wheel of platform/swtimer.c on a fake clock.
+ *
+ * The wheel is built with SWTIMER_HOST_BUILD, the os_timer it arms is a
+ * deadline here: the clock jumps to it and swtimer_host_run() is called.
+ * Timers have to fire at their expiry and in its order, those further than
+ * one wheel turn away included, repeating ones have to keep their phase
+ * and a late wakeup must not fire missed periods. Timer functions arming
+ * and disarming timers, and an idle wheel, are checked along.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+
+#define SWTIMER_HOST_BUILD
+#include "swtimer.c"
+
+#define TIMERS          64
+#define MAX_FIRES       4096
+
+static uint32_t fake_us;
+static uint32_t hw_at;          // us the os_timer fires at
+static bool hw_pending;
+
+static swtimer_t timers[ TIMERS ];
+static uint32_t fired_at[ MAX_FIRES ];
+static unsigned fired_id[ MAX_FIRES ];
+static unsigned fires;
+
+uint32_t swtimer_host_time( void )
+{
+  return fake_us;
+}
+
+void swtimer_host_arm( uint32_t ms )
+{
+  hw_at = fake_us + ms * 1000;
+  hw_pending = true;
+}
+
+// Move the clock on by us, waking the wheel on the way
+static void run_until( uint32_t us )
+{
+  uint32_t end = fake_us + us;
+
+  while( hw_pending && ( int32_t )( hw_at - end ) <= 0 )
+  {
+    fake_us = hw_at;
+    hw_pending = false;
+    swtimer_host_run();
+  }
+  fake_us = end;
+}
+
+static void record( void *arg )
+{
+  unsigned id = ( unsigned )( uintptr_t )arg;
+
+  if( fires < MAX_FIRES )
+  {
+    fired_at[ fires ] = fake_us / 1000;
+    fired_id[ fires ] = id;
+    fires ++;
+  }
+}
+
+static void reset( void )
+{
+  unsigned i;
+
+  for( i = 0; i < TIMERS; i ++ )
+  {
+    swtimer_disarm( &timers[ i ] );
+    swtimer_setfn( &timers[ i ], record, ( void * )( uintptr_t )i );
+  }
+  run_until( 2000000 );
+  hw_pending = false;
+  fires = 0;
+  memset( &stats, 0, sizeof( stats ) );
+}
+
+// Single shots up to four wheel turns away fire at their expiry, in order
+static void check_order( void )
+{
+  uint32_t start, delay[ TIMERS ];
+  unsigned i;
+
+  reset();
+  start = fake_us / 1000;
+  srand( 2 );
+  for( i = 0; i < TIMERS; i ++ )
+  {
+    delay[ i ] = 1 + rand() % ( 4 * SWTIMER_SLOTS );
+    swtimer_arm( &timers[ i ], delay[ i ], false );
+  }
+  CHECK( stats.armed == TIMERS );
+  run_until( 4 * SWTIMER_SLOTS * 1000 + 1000 );
+
+  CHECK( fires == TIMERS && stats.armed == 0 );
+  for( i = 0; i < fires; i ++ )
+  {
+    CHECK( fired_at[ i ] == start + delay[ fired_id[ i ] ] );
+    if( i > 0 )
+      CHECK( fired_at[ i ] >= fired_at[ i - 1 ] );
+  }
+  // One wakeup per distinct expiry at most
+  CHECK( stats.wakeups <= TIMERS );
+  CHECK( !hw_pending );
+}
+
+// Repeating timers keep their phase, a late wakeup skips missed periods
+static void check_periodic( void )
+{
+  uint32_t start;
+  unsigned i, n7 = 0, n300 = 0;
+
+  reset();
+  start = fake_us / 1000;
+  swtimer_arm( &timers[ 0 ], 7, true );
+  swtimer_arm( &timers[ 1 ], 300, true );
+  run_until( 1000 * 1000 );
+  for( i = 0; i < fires; i ++ )
+  {
+    if( fired_id[ i ] == 0 )
+      CHECK( fired_at[ i ] == start + 7 * ++n7 );
+    else
+      CHECK( fired_at[ i ] == start + 300 * ++n300 );
+  }
+  CHECK( n7 == 1000 / 7 && n300 == 3 );
+  CHECK( stats.max_late == 0 );
+
+  // The os_timer comes 30 ms late, the 7 ms timer fires once and goes on from there
+  fires = 0;
+  hw_at += 30000;
+  run_until( 50 * 1000 );
+  CHECK( stats.max_late == 30 );
+  CHECK( fires >= 1 && fired_id[ 0 ] == 0 );
+  for( i = 1; i < fires && fired_id[ i ] == 0; i ++ )
+    CHECK( fired_at[ i ] == fired_at[ i - 1 ] + 7 );
+
+  swtimer_disarm( &timers[ 0 ] );
+  swtimer_disarm( &timers[ 1 ] );
+  CHECK( stats.armed == 0 );
+}
+
+static void rearm( void *arg )
+{
+  record( arg );
+  // Timer 0 disarms timer 1 that is due in the same run, and arms itself again
+  swtimer_disarm( &timers[ 1 ] );
+  if( fires < 4 )
+    swtimer_arm( &timers[ 0 ], 5, false );
+}
+
+static void check_callbacks( void )
+{
+  swtimer_stats_t s;
+
+  reset();
+  swtimer_setfn( &timers[ 0 ], rearm, ( void * )0 );
+  swtimer_arm( &timers[ 0 ], 10, false );
+  swtimer_arm( &timers[ 1 ], 10, false );
+  swtimer_arm( &timers[ 2 ], 12, false );
+  run_until( 100 * 1000 );
+
+  // 0 at 10, 2 at 12, 0 at 15 and 20, 1 never
+  CHECK( fires == 4 );
+  CHECK( fired_id[ 0 ] == 0 && fired_id[ 1 ] == 2 && fired_id[ 2 ] == 0 && fired_id[ 3 ] == 0 );
+  CHECK( fired_at[ 3 ] - fired_at[ 0 ] == 10 );
+  swtimer_get_stats( &s );
+  CHECK( s.armed == 0 && s.fired == 4 );
+
+  // An idle wheel leaves the os_timer off
+  CHECK( !hw_pending );
+  swtimer_arm( &timers[ 3 ], 3, false );
+  swtimer_disarm( &timers[ 3 ] );
+  run_until( 10 * 1000 );
+  CHECK( fires == 4 && !hw_pending );
+}
+
+int main( void )
+{
+  fake_us = 123456;
+  swtimer_init();
+
+  check_order();
+  check_periodic();
+  check_callbacks();
+  return host_test_result();
+}
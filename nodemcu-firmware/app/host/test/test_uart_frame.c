@@ -0,0 +1,68 @@
+/*
+ * uart.on("frame"): framing is turned off from a frame callback, with and
+ * without the nil argument, and the console takes input again. A failing
+ * frame callback is reported and framing goes on.
+ *
+ * The whole firmware runs, as nodemcu-host does, with the input below on
+ * stdin and stdout going to a temporary file that is checked afterwards.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include "host.h"
+
+static const char input[] =
+  "uart.on('frame', { start = '[', stop = ']', number = true }, function(v) got = v uart.on('frame') end, 0)\n"
+  "[123]print('got ' .. got)\n"
+  "uart.on('frame', { stop = ';' }, function(s) if s == 'off' then uart.on('frame', nil) else error('bad ' .. s) end end, 0)\n"
+  "x;off;print('alive')\n";
+
+int main(void)
+{
+  extern void user_init(void);
+  static char out[8192];
+  char path[] = "/tmp/test_uart_frame.XXXXXX";
+  int in[2], fd, saved;
+  ssize_t n;
+
+  if (pipe(in) != 0 || write(in[1], input, sizeof(input) - 1) != sizeof(input) - 1)
+    return 1;
+  close(in[1]);
+  dup2(in[0], 0);
+  close(in[0]);
+
+  fd = mkstemp(path);
+  if (fd < 0)
+    return 1;
+  unlink(path);
+  fflush(stdout);
+  saved = dup(1);
+  dup2(fd, 1);
+
+  if (!host_map_registers())
+    return 1;
+  host_os_init(100000);
+  if (!host_flash_open(NULL))
+    return 1;
+  host_gpio_init();
+  host_uart_open(true);
+  user_init();
+  host_init_done();
+  host_run(5000000);
+  host_uart_close();
+
+  fflush(stdout);
+  dup2(saved, 1);
+  close(saved);
+  n = pread(fd, out, sizeof(out) - 1, 0);
+  close(fd);
+  out[n > 0 ? n : 0] = 0;
+
+  if (!CHECK(strstr(out, "got 123") != NULL) | !CHECK(strstr(out, "bad x") != NULL) |
+      !CHECK(strstr(out, "alive") != NULL) | !CHECK(strstr(out, "PANIC") == NULL))
+    fprintf(stderr, "%s", out);
+  return host_test_result();
+}
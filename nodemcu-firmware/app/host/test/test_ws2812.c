@@ -0,0 +1,169 @@
+/*
+ * ws2812: the UART1 encoding of ws2812.send().
+ *
+ * The frames of ws2812_encode() are turned back into the level of the
+ * inverted TX line, 312.5 ns per UART bit at 3.2 Mbaud 6N1: start bit high,
+ * six inverted data bits LSB first, stop bit low. The pulses have to stay
+ * within the WS2812B timing and decode to the bytes sent. On the host,
+ * ws2812.send() then has to finish and call back, and a matrix on GPIO2
+ * has to send its frames the same way, one shown while the UART is busy
+ * once it is free again.
+ */
+
+#include "host_test.h"
+
+#include <string.h>
+
+#include "ets_sys.h"
+#include "ws2812.h"
+#include "matrix.h"
+#include "host.h"
+
+#define UART_BIT_NS     3125            // tenths of a ns
+#define MAX_BYTES       64
+
+// Line levels of one UART frame, 8 bits
+static void frame_levels(uint8 frame, uint8 *levels)
+{
+  unsigned i;
+
+  levels[0] = 1;
+  for (i = 0; i < 6; i++)
+    levels[1 + i] = !((frame >> i) & 1);
+  levels[7] = 0;
+}
+
+// Decode the frames into bytes, checking every pulse. Returns the byte count.
+static unsigned decode(const uint8 *frames, unsigned count, uint8 *out)
+{
+  uint8 levels[ MAX_BYTES * 4 * 8 ];
+  unsigned n = count * 8, i = 0, bits = 0, high, low;
+
+  for (i = 0; i < count; i++)
+    frame_levels(frames[i], levels + i * 8);
+
+  memset(out, 0, count / 4);
+  for (i = 0; i < n; bits++)
+  {
+    high = low = 0;
+    while (i < n && levels[i])
+      high++, i++;
+    while (i < n && !levels[i])
+      low++, i++;
+
+    // T0H 250..550 ns, T1H 650..950 ns, T0L 700..1000 ns, T1L 300..600 ns
+    if (high * UART_BIT_NS >= 2500 && high * UART_BIT_NS <= 5500)
+      CHECK(low * UART_BIT_NS >= 7000 && low * UART_BIT_NS <= 10000);
+    else if (high * UART_BIT_NS >= 6500 && high * UART_BIT_NS <= 9500)
+    {
+      CHECK(low * UART_BIT_NS >= 3000 && low * UART_BIT_NS <= 6000);
+      out[bits / 8] |= 0x80 >> (bits % 8);
+    }
+    else
+      CHECK(!"high pulse out of the WS2812B timing");
+  }
+  return bits / 8;
+}
+
+static void check_encode(void)
+{
+  static const uint8 pairs[] = { 0x1b };        // 00 01 10 11
+  static const uint8 table[] = { 0x37, 0x07, 0x34, 0x04 };
+  uint8 src[ MAX_BYTES ], frames[ MAX_BYTES * 4 ], out[ MAX_BYTES ];
+  unsigned i;
+
+  // The four bit pairs, most significant first
+  ws2812_encode(pairs, 1, frames);
+  CHECK(memcmp(frames, table, 4) == 0);
+
+  // Every pulse of every byte value
+  for (i = 0; i < 256; i++)
+  {
+    src[i % MAX_BYTES] = i;
+    if (i % MAX_BYTES == MAX_BYTES - 1)
+    {
+      ws2812_encode(src, MAX_BYTES, frames);
+      CHECK(decode(frames, MAX_BYTES * 4, out) == MAX_BYTES);
+      CHECK(memcmp(out, src, MAX_BYTES) == 0);
+    }
+  }
+}
+
+static bool global_true(lua_State *L, const char *name)
+{
+  bool value;
+
+  lua_getglobal(L, name);
+  value = lua_toboolean(L, -1);
+  lua_pop(L, 1);
+  return value;
+}
+
+// More frames than the TX FIFO holds, the busy flag has to clear
+static void check_send(void)
+{
+  lua_State *L = host_test_lua();
+
+  ETS_UART_INTR_ENABLE();
+  host_test_dostring(L,
+    "done = false\n"
+    "ws2812.send(string.char(0, 255, 0):rep(60), function() done = true end)\n"
+    "busy = ws2812.busy()");
+  CHECK(global_true(L, "busy"));
+  host_test_run(50000);
+  host_test_dostring(L, "busy = ws2812.busy()");
+  CHECK(global_true(L, "done"));
+  CHECK(!global_true(L, "busy"));
+
+  // And once more
+  host_test_dostring(L, "done = false ws2812.send(string.char(1, 2, 3), function() done = true end)");
+  host_test_run(50000);
+  CHECK(global_true(L, "done"));
+}
+
+static bool matrix_dirty(lua_State *L)
+{
+  matrix_t *m;
+
+  lua_getglobal(L, "m");
+  m = (matrix_t *)lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  return m->m_Dirty;
+}
+
+static void check_matrix(void)
+{
+  lua_State *L = host_test_lua();
+
+  host_test_dostring(L,
+    "m = matrix.setup(4, 8, 8)\n"
+    "m:set_pixel(0, 0, 255, 0, 0) m:show()\n"
+    "busy = ws2812.busy()");
+  CHECK(global_true(L, "busy"));
+  CHECK(!matrix_dirty(L));
+
+  // Shown while the first frame is on its way, sent after it
+  host_test_dostring(L, "m:set_pixel(1, 0, 0, 255, 0) m:show()");
+  CHECK(matrix_dirty(L));
+  host_test_run(50000);
+  host_test_dostring(L, "busy = ws2812.busy()");
+  CHECK(!matrix_dirty(L));
+  CHECK(!global_true(L, "busy"));
+
+  // A matrix collected while it waits is forgotten
+  host_test_dostring(L,
+    "ws2812.send(string.char(0, 0, 0):rep(64))\n"
+    "m:set_pixel(2, 0, 0, 0, 255) m:show() m = nil collectgarbage()");
+  host_test_run(50000);
+  host_test_dostring(L, "busy = ws2812.busy()");
+  CHECK(!global_true(L, "busy"));
+}
+
+int main(void)
+{
+  host_test_init(100000);
+  check_encode();
+  check_send();
+  check_matrix();
+  return host_test_result();
+}
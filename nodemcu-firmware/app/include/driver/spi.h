@@ -11,6 +11,9 @@
 #define SPI 			0
 #define HSPI			1
 
+/*size of the SPI_W0~SPI_W15 data buffer*/
+#define SPI_BUFFER_SIZE		64
+
 
 
 //lcd drive function
@@ -21,6 +24,8 @@ void spi_lcd_9bit_write(uint8 spi_no,uint8 high_bit,uint8 low_8bit);
 void spi_master_init(uint8 spi_no, unsigned cpol, unsigned cpha, unsigned databits, uint32_t clock);
 //use spi send 8bit data
 void spi_mast_byte_write(uint8 spi_no,uint8 *data);
+//use spi send a block of data in SPI_BUFFER_SIZE bursts
+void spi_mast_blk_write(uint8 spi_no, const uint8 *data, uint32 length);
 
 //transmit data to esp8266 slave buffer,which needs 16bit transmission ,
 //first byte is master command 0x04, second byte is master data
@@ -7,6 +7,7 @@
 
 #define RX_BUFF_SIZE    0x100
 #define TX_BUFF_SIZE    100
+#define UART_FIFO_LEN   128
 
 typedef enum {
     FIVE_BITS = 0x0,
@@ -100,7 +101,13 @@ typedef struct {
     int                      buff_uart_no;  //indicate which uart use tx/rx buffer
 } UartDevice;
 
+typedef void (*uart_tx_empty_handler)(void);
+typedef void (*uart_rx_handler)(void);
+
 void uart_init(UartBautRate uart0_br, UartBautRate uart1_br);
+void uart1_tx_empty_attach(uart_tx_empty_handler handler);
+void uart0_rx_attach(uart_rx_handler handler);
+bool uart0_rx_buffer_resize(uint32 size);
 void uart0_sendStr(const char *str);
 void uart0_putc(const char c);
 void uart0_tx_buffer(uint8 *buf, uint16 len);
@@ -79,6 +79,7 @@
 #define UART_RXFIFO_CNT_S 0
 
 #define UART_CONF0( i )                         (REG_UART_BASE( i ) + 0x20)
+#define UART_TXD_INV (BIT(22))
 #define UART_TXFIFO_RST (BIT(18))
 #define UART_RXFIFO_RST (BIT(17))
 #define UART_IRDA_EN (BIT(16))
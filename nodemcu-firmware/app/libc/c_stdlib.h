@@ -13,7 +13,9 @@
 #define EXIT_FAILURE 1
 #define EXIT_SUCCESS 0
 
+#ifndef __INT_MAX__
 #define __INT_MAX__ 2147483647
+#endif
 #undef __RAND_MAX
 #if __INT_MAX__ == 32767
 #define __RAND_MAX 32767
@@ -659,6 +659,8 @@ typedef struct LoadFSF {
 static const char *getFSF (lua_State *L, void *ud, size_t *size) {
   LoadFSF *lf = (LoadFSF *)ud;
   (void)L;
+  if (L == NULL && size == NULL) // direct mode check
+    return NULL;
   if (lf->extraline) {
     lf->extraline = 0;
     *size = 1;
@@ -472,8 +472,8 @@ static int luaB_newproxy (lua_State *L) {
   {LSTRKEY("gcinfo"), LFUNCVAL(luaB_gcinfo)},\
   {LSTRKEY("getfenv"), LFUNCVAL(luaB_getfenv)},\
   {LSTRKEY("getmetatable"), LFUNCVAL(luaB_getmetatable)},\
-  {LSTRKEY("loadfile"), LFUNCVAL(luaB_loadfile)},\
   {LSTRKEY("load"), LFUNCVAL(luaB_load)},\
+  {LSTRKEY("loadfile"), LFUNCVAL(luaB_loadfile)},\
   {LSTRKEY("loadstring"), LFUNCVAL(luaB_loadstring)},\
   {LSTRKEY("next"), LFUNCVAL(luaB_next)},\
   {LSTRKEY("pcall"), LFUNCVAL(luaB_pcall)},\
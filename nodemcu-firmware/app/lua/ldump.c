@@ -12,6 +12,7 @@
 
 #include "lua.h"
 
+#include "lfunc.h"
 #include "lobject.h"
 #include "lstate.h"
 #include "lundump.h"
@@ -229,7 +230,7 @@ static void DumpConstants(const Proto* f, DumpState* D)
 static void DumpDebug(const Proto* f, DumpState* D)
 {
  int i,n;
- n= (D->strip) ? 0 : f->sizelineinfo;
+ n= (D->strip>=LUAF_STRIP_LINES) ? 0 : f->sizelineinfo;
  DumpInt(n,D);
  Align4(D);
  for (i=0; i<n; i++)
@@ -237,7 +238,7 @@ static void DumpDebug(const Proto* f, DumpState* D)
   DumpInt(f->lineinfo[i],D);
  }
  
- n= (D->strip) ? 0 : f->sizelocvars;
+ n= (D->strip>=LUAF_STRIP_LOCALS) ? 0 : f->sizelocvars;
  DumpInt(n,D);
  for (i=0; i<n; i++)
  {
@@ -246,14 +247,14 @@ static void DumpDebug(const Proto* f, DumpState* D)
   DumpInt(f->locvars[i].endpc,D);
  }
 
- n= (D->strip) ? 0 : f->sizeupvalues;
+ n= (D->strip>=LUAF_STRIP_LOCALS) ? 0 : f->sizeupvalues;
  DumpInt(n,D);
  for (i=0; i<n; i++) DumpString(f->upvalues[i],D);
 }
 
 static void DumpFunction(const Proto* f, const TString* p, DumpState* D)
 {
- DumpString((f->source==p || D->strip) ? NULL : f->source,D);
+ DumpString((f->source==p) ? NULL : f->source,D);
  DumpInt(f->linedefined,D);
  DumpInt(f->lastlinedefined,D);
  DumpChar(f->nups,D);
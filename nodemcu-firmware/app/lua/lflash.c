@@ -0,0 +1,291 @@
+/* Lua flash store: precompiled chunks run in place from the flash */
+
+#include "c_string.h"
+#include "c_types.h"
+#include "flash_fs.h"
+#include "platform.h"
+
+#define lflash_c
+#define LUA_CORE
+
+#include "lua.h"
+
+#include "lflash.h"
+#include "lundump.h"
+
+/*
+** The store takes LUA_STORE_SEC_NUM sectors between the firmware and the
+** file system. It holds .lc files as node.compile() writes them, behind a
+** directory of their names:
+**
+**   StoreHeader | StoreEntry[count] | chunk | chunk | ...
+**
+** Chunks start at word boundaries, as their code does (see Align4() of
+** lundump.c), so luaU_undump() can leave the instructions where they are:
+** the store reader reports the mapped address of the chunk, which turns on
+** the direct mode of the loader. The bytes it parses go through a RAM
+** buffer, the ESP8266 only reads whole words from its mapped flash.
+**
+** The header is written last, a store cut short by a reset stays empty.
+*/
+
+#define LUAN_MAGIC            0x1b4c4653  /* "SFL\033" */
+#define LUAN_BUFFSIZE         256
+
+typedef struct {
+  uint32_t magic;
+  uint32_t size;              /* bytes used, this header included */
+  uint32_t count;             /* entries */
+} StoreHeader;
+
+typedef struct {
+  char name[LUAN_NAME_LEN + 1];
+  uint32_t offset;            /* of the chunk from the start of the store */
+  uint32_t size;
+} StoreEntry;
+
+typedef struct {
+  const char *base;           /* mapped address of the chunk */
+  uint32_t addr;              /* next byte to read */
+  uint32_t left;
+  uint32_t buff[LUAN_BUFFSIZE / sizeof(uint32_t)];
+} LoadN;
+
+#define align4(n)             (((n) + 3) & ~3)
+
+
+static uint32_t store_address (void) {
+  return platform_flash_get_lua_store_address(NULL);
+}
+
+
+unsigned luaN_size (void) {
+  uint32_t size = LUA_STORE_SEC_NUM * INTERNAL_FLASH_SECTOR_SIZE;
+  /* code runs from the store, it has to be in the mapped part */
+  if (store_address() + size >
+      INTERNAL_FLASH_START_ADDRESS + INTERNAL_FLASH_MAPPED_SIZE)
+    return 0;
+  return size;
+}
+
+
+static int read_header (StoreHeader *h) {
+  if (luaN_size() == 0)
+    return 0;
+  platform_flash_read(h, store_address(), sizeof(*h));
+  return h->magic == LUAN_MAGIC && h->size <= luaN_size();
+}
+
+
+static void read_entry (StoreEntry *e, unsigned i) {
+  platform_flash_read(e, store_address() + sizeof(StoreHeader) +
+                         i * sizeof(StoreEntry), sizeof(*e));
+}
+
+
+static const char *getN (lua_State *L, void *ud, size_t *size) {
+  LoadN *ln = (LoadN *)ud;
+  (void)L;
+  if (L == NULL && size == NULL)  /* direct mode check */
+    return ln->base;
+  if (ln->left == 0) return NULL;
+  *size = ln->left < sizeof(ln->buff) ? ln->left : sizeof(ln->buff);
+  platform_flash_read(ln->buff, ln->addr, *size);
+  ln->addr += *size;
+  ln->left -= *size;
+  return (const char *)ln->buff;
+}
+
+
+static int find_entry (StoreEntry *e, const char *name) {
+  StoreHeader h;
+  unsigned i;
+  if (!read_header(&h))
+    return 0;
+  for (i = 0; i < h.count; i++) {
+    read_entry(e, i);
+    if (c_strcmp(e->name, name) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+
+/*
+** Load the chunk of a module, LUAN_NOTFOUND with nothing pushed if the
+** store doesn't have it, otherwise the lua_load() result
+*/
+int luaN_load (lua_State *L, const char *name) {
+  StoreEntry e;
+  LoadN ln;
+  int status;
+  if (!find_entry(&e, name))
+    return LUAN_NOTFOUND;
+  ln.addr = store_address() + e.offset;
+  ln.base = (const char *)ln.addr;
+  ln.left = e.size;
+  lua_pushfstring(L, "=%s", name);
+  status = lua_load(L, getN, &ln, lua_tostring(L, -1));
+  lua_remove(L, -2);
+  return status;
+}
+
+
+/*
+** Whether the file system has a .lc file of the module other than the one
+** copied into the store, node.compile() or file_server.c wrote it since.
+** The chunks are compared, the file is read once at most.
+*/
+int luaN_shadowed (const char *name) {
+  uint32_t stored[LUAN_BUFFSIZE / sizeof(uint32_t)];
+  uint32_t file[LUAN_BUFFSIZE / sizeof(uint32_t)];
+  char path[LUAN_NAME_LEN + 4];
+  StoreEntry e;
+  uint32_t addr, left;
+  size_t n;
+  int fd, differs = 0;
+  if (c_strlen(name) > LUAN_NAME_LEN || !find_entry(&e, name))
+    return 0;
+  c_strcpy(path, name);
+  c_strcpy(path + c_strlen(name), ".lc");
+  fd = fs_open(path, FS_RDONLY);
+  if (fd < FS_OPEN_OK)
+    return 0;
+  fs_seek(fd, 0, FS_SEEK_END);
+  differs = (uint32_t)fs_tell(fd) != e.size;
+  fs_seek(fd, 0, FS_SEEK_SET);
+  addr = store_address() + e.offset;
+  for (left = e.size; !differs && left > 0; left -= n, addr += n) {
+    n = left < sizeof(file) ? left : sizeof(file);
+    platform_flash_read(stored, addr, n);
+    differs = fs_read(fd, file, n) != n || c_memcmp(stored, file, n) != 0;
+  }
+  fs_close(fd);
+  return differs;
+}
+
+
+/*
+** Push a table of the modules and their sizes, return the bytes used
+*/
+unsigned luaN_index (lua_State *L) {
+  StoreHeader h;
+  StoreEntry e;
+  unsigned i;
+  if (!read_header(&h)) {
+    lua_newtable(L);
+    return 0;
+  }
+  lua_createtable(L, 0, h.count);
+  for (i = 0; i < h.count; i++) {
+    read_entry(&e, i);
+    lua_pushinteger(L, e.size);
+    lua_setfield(L, -2, e.name);
+  }
+  return h.size;
+}
+
+
+static int store_error (lua_State *L, int status, const char *what,
+                        const char *file) {
+  lua_pushfstring(L, "%s %s", what, file);
+  return status;
+}
+
+
+/* Check a file and get its module name and size */
+static int check_file (lua_State *L, const char *file, StoreEntry *e) {
+  char h[LUAC_HEADERSIZE], s[LUAC_HEADERSIZE];
+  size_t len = c_strlen(file);
+  int fd;
+  if (len < 4 || c_strcmp(file + len - 3, ".lc") != 0)
+    return store_error(L, LUAN_ERRFILE, "not a .lc file:", file);
+  if (len - 3 > LUAN_NAME_LEN)
+    return store_error(L, LUAN_ERRFILE, "name too long:", file);
+  c_memset(e->name, 0, sizeof(e->name));
+  c_memcpy(e->name, file, len - 3);
+  fd = fs_open(file, FS_RDONLY);
+  if (fd < FS_OPEN_OK)
+    return store_error(L, LUAN_ERRFILE, "cannot open", file);
+  /* the code is used as it is, the chunk must be for this very target */
+  luaU_header(h);
+  if (fs_read(fd, s, sizeof(s)) != sizeof(s) || c_memcmp(h, s, sizeof(h)) != 0) {
+    fs_close(fd);
+    return store_error(L, LUAN_ERRFILE, "not compiled for this firmware:", file);
+  }
+  fs_seek(fd, 0, FS_SEEK_END);
+  e->size = fs_tell(fd);
+  fs_close(fd);
+  return LUAN_OK;
+}
+
+
+static int copy_file (lua_State *L, const char *file, uint32_t to, uint32_t size) {
+  uint32_t buff[LUAN_BUFFSIZE / sizeof(uint32_t)];
+  size_t n;
+  int fd = fs_open(file, FS_RDONLY);
+  if (fd < FS_OPEN_OK)
+    return store_error(L, LUAN_ERRFLASH, "cannot open", file);
+  while (size > 0) {
+    n = fs_read(fd, buff, size < sizeof(buff) ? size : sizeof(buff));
+    if (n == 0 || platform_flash_write(buff, to, n) != n) {
+      fs_close(fd);
+      return store_error(L, LUAN_ERRFLASH, "cannot copy", file);
+    }
+    to += n;
+    size -= n;
+  }
+  fs_close(fd);
+  return LUAN_OK;
+}
+
+
+/*
+** Replace the store with the given .lc files. Functions loaded from the
+** store run from the flash being rewritten: whatever the result, the Lua
+** state must go unless it is LUAN_ERRFILE. The error message is pushed.
+*/
+int luaN_store (lua_State *L, const char *const *files, int n) {
+  StoreHeader h;
+  StoreEntry e;
+  uint32_t base = store_address(), dir, sect, last;
+  int i, j, status;
+  h.magic = LUAN_MAGIC;
+  h.count = n;
+  h.size = sizeof(StoreHeader) + n * sizeof(StoreEntry);
+  for (i = 0; i < n; i++) {
+    if ((status = check_file(L, files[i], &e)) != LUAN_OK)
+      return status;
+    for (j = 0; j < i; j++)
+      if (c_strcmp(files[i], files[j]) == 0)
+        return store_error(L, LUAN_ERRFILE, "listed twice:", files[i]);
+    h.size += align4(e.size);
+  }
+  if (h.size > luaN_size()) {
+    lua_pushfstring(L, "%d bytes, the store has %d", (int)h.size, (int)luaN_size());
+    return LUAN_ERRFILE;
+  }
+
+  sect = platform_flash_get_sector_of_address(base);
+  last = platform_flash_get_sector_of_address(base + h.size - 1);
+  for (; sect <= last; sect++)
+    if (platform_flash_erase_sector(sect) == PLATFORM_ERR) {
+      lua_pushliteral(L, "cannot erase the store");
+      return LUAN_ERRFLASH;
+    }
+  dir = base + sizeof(StoreHeader);
+  e.offset = sizeof(StoreHeader) + n * sizeof(StoreEntry);
+  for (i = 0; i < n; i++) {
+    check_file(L, files[i], &e);
+    if ((status = copy_file(L, files[i], base + e.offset, e.size)) != LUAN_OK)
+      return status;
+    if (platform_flash_write(&e, dir + i * sizeof(e), sizeof(e)) != sizeof(e))
+      return store_error(L, LUAN_ERRFLASH, "cannot copy", files[i]);
+    e.offset += align4(e.size);
+  }
+  if (platform_flash_write(&h, base, sizeof(h)) != sizeof(h)) {
+    lua_pushliteral(L, "cannot write the store header");
+    return LUAN_ERRFLASH;
+  }
+  return LUAN_OK;
+}
@@ -0,0 +1,25 @@
+/* Lua flash store: precompiled chunks run in place from the flash */
+
+#ifndef lflash_h
+#define lflash_h
+
+#include "lua.h"
+
+/* Longest module name, the ".lc" of its file left out */
+#define LUAN_NAME_LEN         31
+
+/* luaN_load() result for a module that isn't in the store */
+#define LUAN_NOTFOUND         (-1)
+
+/* luaN_store() results */
+#define LUAN_OK               0
+#define LUAN_ERRFILE          1   /* a file is unusable, the store is unchanged */
+#define LUAN_ERRFLASH         2   /* writing failed, the store is empty */
+
+int luaN_load (lua_State *L, const char *name);
+int luaN_shadowed (const char *name);
+unsigned luaN_index (lua_State *L);
+unsigned luaN_size (void);
+int luaN_store (lua_State *L, const char *const *files, int n);
+
+#endif
@@ -17,6 +17,7 @@
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
+#include "lvm.h"
 
 
 
@@ -139,6 +140,7 @@ Proto *luaF_newproto (lua_State *L) {
 
 
 void luaF_freeproto (lua_State *L, Proto *f) {
+  luaV_flushrocache(L);  /* the cache is keyed by code addresses */
   luaM_freearray(L, f->p, f->sizep, Proto *);
   luaM_freearray(L, f->k, f->sizek, TValue);
   luaM_freearray(L, f->locvars, f->sizelocvars, struct LocVar);
@@ -151,6 +153,28 @@ void luaF_freeproto (lua_State *L, Proto *f) {
 }
 
 
+/*
+** Drop the debug info of a function that the strip level doesn't keep.
+** The source and the first line stay, a traceback still shows the function.
+*/
+void luaF_stripdebug (lua_State *L, Proto *f, int level) {
+  if (level >= LUAF_STRIP_LOCALS) {
+    luaM_freearray(L, f->locvars, f->sizelocvars, struct LocVar);
+    f->locvars = NULL;
+    f->sizelocvars = 0;
+    luaM_freearray(L, f->upvalues, f->sizeupvalues, TString *);
+    f->upvalues = NULL;
+    f->sizeupvalues = 0;
+  }
+  if (level >= LUAF_STRIP_LINES) {
+    if (!proto_is_readonly(f))
+      luaM_freearray(L, f->lineinfo, f->sizelineinfo, int);
+    f->lineinfo = NULL;
+    f->sizelineinfo = 0;
+  }
+}
+
+
 void luaF_freeclosure (lua_State *L, Closure *c) {
   int size = (c->c.isC) ? sizeCclosure(c->c.nupvalues) :
                           sizeLclosure(c->l.nupvalues);
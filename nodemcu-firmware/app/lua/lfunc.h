@@ -21,6 +21,11 @@
 #define proto_readonly(p) l_setbit((p)->marked, READONLYBIT)
 #define proto_is_readonly(p) testbit((p)->marked, READONLYBIT)
 
+/* debug info strip levels, each drops more */
+#define LUAF_STRIP_NONE    1   /* keep it all */
+#define LUAF_STRIP_LOCALS  2   /* drop local and upvalue names */
+#define LUAF_STRIP_LINES   3   /* drop line numbers too */
+
 LUAI_FUNC Proto *luaF_newproto (lua_State *L);
 LUAI_FUNC Closure *luaF_newCclosure (lua_State *L, int nelems, Table *e);
 LUAI_FUNC Closure *luaF_newLclosure (lua_State *L, int nelems, Table *e);
@@ -30,6 +35,7 @@ LUAI_FUNC void luaF_close (lua_State *L, StkId level);
 LUAI_FUNC void luaF_freeproto (lua_State *L, Proto *f);
 LUAI_FUNC void luaF_freeclosure (lua_State *L, Closure *c);
 LUAI_FUNC void luaF_freeupval (lua_State *L, UpVal *uv);
+LUAI_FUNC void luaF_stripdebug (lua_State *L, Proto *f, int level);
 LUAI_FUNC const char *luaF_getlocalname (const Proto *func, int local_number,
                                          int pc);
 
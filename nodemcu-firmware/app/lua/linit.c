@@ -21,7 +21,9 @@
 
 #if defined(LUA_MODULES_ROM)
 #undef _ROM
+#undef _ROT
 #define _ROM( name, openf, table ) extern int openf(lua_State *);
+#define _ROT( name, table )
 LUA_MODULES_ROM
 #endif
 
@@ -37,7 +39,9 @@ static const luaL_Reg lualibs[] = {
 #endif
 #if defined(LUA_MODULES_ROM)
 #undef _ROM
+#undef _ROT
 #define _ROM( name, openf, table ) { name, openf },
+#define _ROT( name, table )
   LUA_MODULES_ROM
 #endif
   {NULL, NULL}
@@ -51,25 +55,30 @@ extern const luaR_entry co_funcs[];
 // extern const luaR_entry math_map[];
 #if defined(LUA_MODULES_ROM) && LUA_OPTIMIZE_MEMORY == 2
 #undef _ROM
+#undef _ROT
 #define _ROM( name, openf, table ) extern const luaR_entry table[];
+#define _ROT( name, table ) extern const luaR_entry table[];
 LUA_MODULES_ROM
 #endif
+/* Sorted by name, see luaR_findglobal() */
 const luaR_table lua_rotable[] = 
 {
-#if LUA_OPTIMIZE_MEMORY > 0
-  {LUA_STRLIBNAME, strlib},
-  {LUA_TABLIBNAME, tab_funcs},
-  // {LUA_DBLIBNAME, dblib},
-  {LUA_COLIBNAME, co_funcs},
-  // {LUA_MATHLIBNAME, math_map},
 #if defined(LUA_MODULES_ROM) && LUA_OPTIMIZE_MEMORY == 2
 #undef _ROM
+#undef _ROT
 #define _ROM( name, openf, table ) { name, table },
+#define _ROT( name, table ) { name, table },
   LUA_MODULES_ROM
-#endif
+#elif LUA_OPTIMIZE_MEMORY > 0
+  {LUA_COLIBNAME, co_funcs},
+  // {LUA_DBLIBNAME, dblib},
+  // {LUA_MATHLIBNAME, math_map},
+  {LUA_STRLIBNAME, strlib},
+  {LUA_TABLIBNAME, tab_funcs},
 #endif
   {NULL, NULL}
 };
+const unsigned lua_rotable_count = sizeof(lua_rotable) / sizeof(lua_rotable[0]) - 1;
 
 LUALIB_API void luaL_openlibs (lua_State *L) {
   const luaL_Reg *lib = lualibs;
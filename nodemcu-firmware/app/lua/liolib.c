@@ -575,6 +575,11 @@ const luaL_Reg iolib[] = {
 #define MIN_OPT_LEVEL 1
 #include "lrodefs.h"
 const LUA_REG_TYPE flib[] = {
+  {LSTRKEY("__gc"), LFUNCVAL(io_gc)},
+#if LUA_OPTIMIZE_MEMORY > 0
+  {LSTRKEY("__index"), LROVAL(flib)},
+#endif
+  {LSTRKEY("__tostring"), LFUNCVAL(io_tostring)},
   {LSTRKEY("close"), LFUNCVAL(io_close)},
   {LSTRKEY("flush"), LFUNCVAL(f_flush)},
   {LSTRKEY("lines"), LFUNCVAL(f_lines)},
@@ -582,11 +587,6 @@ const LUA_REG_TYPE flib[] = {
   {LSTRKEY("seek"), LFUNCVAL(f_seek)},
   // {LSTRKEY("setvbuf"), LFUNCVAL(f_setvbuf)},
   {LSTRKEY("write"), LFUNCVAL(f_write)},
-  {LSTRKEY("__gc"), LFUNCVAL(io_gc)},
-  {LSTRKEY("__tostring"), LFUNCVAL(io_tostring)},
-#if LUA_OPTIMIZE_MEMORY > 0
-  {LSTRKEY("__index"), LROVAL(flib)},
-#endif
   {LNILKEY, LNILVAL}
 };
 
@@ -313,51 +313,53 @@ const LUA_REG_TYPE math_map[] = {
   {LSTRKEY("abs"),   LFUNCVAL(math_abs)},
   {LSTRKEY("ceil"),  LFUNCVAL(math_identity)},
   {LSTRKEY("floor"), LFUNCVAL(math_identity)},
+#if LUA_OPTIMIZE_MEMORY > 0
+  {LSTRKEY("huge"),  LNUMVAL(LONG_MAX)},
+#endif
   {LSTRKEY("max"),   LFUNCVAL(math_max)},
   {LSTRKEY("min"),   LFUNCVAL(math_min)},
   {LSTRKEY("pow"),   LFUNCVAL(math_pow)},
   {LSTRKEY("random"),     LFUNCVAL(math_random)},
   {LSTRKEY("randomseed"), LFUNCVAL(math_randomseed)},
   {LSTRKEY("sqrt"),  LFUNCVAL(math_sqrt)},
-#if LUA_OPTIMIZE_MEMORY > 0
-  {LSTRKEY("huge"),  LNUMVAL(LONG_MAX)},
-#endif
 #else
   {LSTRKEY("abs"),   LFUNCVAL(math_abs)},
   {LSTRKEY("acos"),  LFUNCVAL(math_acos)},
   {LSTRKEY("asin"),  LFUNCVAL(math_asin)},
-  {LSTRKEY("atan2"), LFUNCVAL(math_atan2)},
   {LSTRKEY("atan"),  LFUNCVAL(math_atan)},
+  {LSTRKEY("atan2"), LFUNCVAL(math_atan2)},
   {LSTRKEY("ceil"),  LFUNCVAL(math_ceil)},
-  {LSTRKEY("cosh"),  LFUNCVAL(math_cosh)},
   {LSTRKEY("cos"),   LFUNCVAL(math_cos)},
+  {LSTRKEY("cosh"),  LFUNCVAL(math_cosh)},
   {LSTRKEY("deg"),   LFUNCVAL(math_deg)},
   {LSTRKEY("exp"),   LFUNCVAL(math_exp)},
   {LSTRKEY("floor"), LFUNCVAL(math_floor)},
   {LSTRKEY("fmod"),  LFUNCVAL(math_fmod)},
-#if LUA_OPTIMIZE_MEMORY > 0 && defined(LUA_COMPAT_MOD)
-  {LSTRKEY("mod"),   LFUNCVAL(math_fmod)}, 
-#endif
   {LSTRKEY("frexp"), LFUNCVAL(math_frexp)},
+#if LUA_OPTIMIZE_MEMORY > 0
+  {LSTRKEY("huge"),  LNUMVAL(HUGE_VAL)},
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
   {LSTRKEY("ldexp"), LFUNCVAL(math_ldexp)},
-  {LSTRKEY("log10"), LFUNCVAL(math_log10)},
   {LSTRKEY("log"),   LFUNCVAL(math_log)},
+  {LSTRKEY("log10"), LFUNCVAL(math_log10)},
   {LSTRKEY("max"),   LFUNCVAL(math_max)},
   {LSTRKEY("min"),   LFUNCVAL(math_min)},
+#if LUA_OPTIMIZE_MEMORY > 0 && defined(LUA_COMPAT_MOD)
+  {LSTRKEY("mod"),   LFUNCVAL(math_fmod)},
+#endif
   {LSTRKEY("modf"),   LFUNCVAL(math_modf)},
+#if LUA_OPTIMIZE_MEMORY > 0
+  {LSTRKEY("pi"),    LNUMVAL(PI)},
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
   {LSTRKEY("pow"),   LFUNCVAL(math_pow)},
   {LSTRKEY("rad"),   LFUNCVAL(math_rad)},
   {LSTRKEY("random"),     LFUNCVAL(math_random)},
   {LSTRKEY("randomseed"), LFUNCVAL(math_randomseed)},
-  {LSTRKEY("sinh"),   LFUNCVAL(math_sinh)},
   {LSTRKEY("sin"),   LFUNCVAL(math_sin)},
+  {LSTRKEY("sinh"),   LFUNCVAL(math_sinh)},
   {LSTRKEY("sqrt"),  LFUNCVAL(math_sqrt)},
-  {LSTRKEY("tanh"),   LFUNCVAL(math_tanh)},
   {LSTRKEY("tan"),   LFUNCVAL(math_tan)},
-#if LUA_OPTIMIZE_MEMORY > 0
-  {LSTRKEY("pi"),    LNUMVAL(PI)},
-  {LSTRKEY("huge"),  LNUMVAL(HUGE_VAL)},
-#endif // #if LUA_OPTIMIZE_MEMORY > 0
+  {LSTRKEY("tanh"),   LFUNCVAL(math_tanh)},
 #endif // #ifdef LUA_NUMBER_INTEGRAL
   {LNILKEY, LNILVAL}
 };
@@ -22,6 +22,7 @@
 #include "lauxlib.h"
 #include "lualib.h"
 #include "lrotable.h"
+#include "lflash.h"
 
 /* prefix for open functions in C libraries */
 #define LUA_POF		"luaopen_"
@@ -399,6 +400,26 @@ static int loader_Lua (lua_State *L) {
 }
 
 
+static int loader_flash (lua_State *L) {
+  const char *name = luaL_checkstring(L, 1);
+  int status;
+  if (luaN_shadowed(name)) {  /* a newer .lc, loader_Lua finds it */
+    lua_pushfstring(L, "\n\tmodule " LUA_QS " in the flash store is older than "
+                       LUA_QL("%s.lc"), name, name);
+    return 1;
+  }
+  status = luaN_load(L, name);
+  if (status == LUAN_NOTFOUND) {
+    lua_pushfstring(L, "\n\tno module " LUA_QS " in the flash store", name);
+    return 1;
+  }
+  if (status != 0)
+    luaL_error(L, "error loading module " LUA_QS " from the flash store:\n\t%s",
+                  name, lua_tostring(L, -1));
+  return 1;  /* library loaded successfully */
+}
+
+
 static const char *mkfuncname (lua_State *L, const char *modname) {
   const char *funcname;
   const char *mark = c_strchr(modname, *LUA_IGMARK);
@@ -640,7 +661,7 @@ static const luaL_Reg ll_funcs[] = {
 
 
 static const lua_CFunction loaders[] =
-  {loader_preload, loader_Lua, loader_C, loader_Croot, NULL};
+  {loader_preload, loader_flash, loader_Lua, loader_C, loader_Croot, NULL};
 
 #if LUA_OPTIMIZE_MEMORY > 0
 #define MIN_OPT_LEVEL 1
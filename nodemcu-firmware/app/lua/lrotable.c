@@ -14,38 +14,97 @@
 
 /* Externally defined read-only table array */
 extern const luaR_table lua_rotable[];
+extern const unsigned lua_rotable_count;
 
-/* Find a global "read only table" in the constant lua_rotable array */
+#if LUA_ROKEYS_CACHE_SIZE > 0
+/* Number of string keys of a rotable, see luaR_strkeys */
+typedef struct {
+  const luaR_entry *pentries;
+  unsigned count;
+} luaR_keycount;
+
+static luaR_keycount luaR_keycounts[LUA_ROKEYS_CACHE_SIZE];
+#endif
+
+/* Find a global "read only table" in the constant lua_rotable array.
+   The array is sorted by name, see modules.h */
 void* luaR_findglobal(const char *name, unsigned len) {
-  unsigned i;
+  unsigned lo = 0, hi = lua_rotable_count, i;
+  const char *entry;
+  int res;
 
-  if (c_strlen(name) > LUA_MAX_ROTABLE_NAME)
+  if (len > LUA_MAX_ROTABLE_NAME)
     return NULL;
-  for (i=0; lua_rotable[i].name; i ++)
-    if (*lua_rotable[i].name != '\0' && c_strlen(lua_rotable[i].name) == len && !c_strncmp(lua_rotable[i].name, name, len)) {
+  while (lo < hi) {
+    i = (lo + hi) / 2;
+    entry = lua_rotable[i].name;
+    /* "name" is not terminated, it can be a part of a longer string */
+    res = c_strncmp(entry, name, len);
+    if (res == 0 && entry[len] != '\0')
+      res = 1;
+    if (res == 0)
       return (void*)(lua_rotable[i].pentries);
-    }
+    if (res < 0)
+      lo = i + 1;
+    else
+      hi = i;
+  }
   return NULL;
 }
 
-/* Find an entry in a rotable and return it */
+/* Number of string keys of a rotable, they come first.
+   The size of a rotable isn't stored, it is counted once and kept in the
+   slot picked by the address of the rotable. */
+static unsigned luaR_strkeys(const luaR_entry *pentry) {
+  unsigned n;
+#if LUA_ROKEYS_CACHE_SIZE > 0
+  luaR_keycount *slot = &luaR_keycounts[((size_t)pentry / sizeof(luaR_entry)) &
+                                        (LUA_ROKEYS_CACHE_SIZE - 1)];
+  if (slot->pentries == pentry)
+    return slot->count;
+#endif
+  for (n = 0; pentry[n].key.type == LUA_TSTRING; n ++);
+#if LUA_ROKEYS_CACHE_SIZE > 0
+  slot->pentries = pentry;
+  slot->count = n;
+#endif
+  return n;
+}
+
+/* Find an entry in a rotable and return it.
+   The string keys come first and are sorted (tools/rotable.py), they are
+   bisected. Number keys are searched in order. */
 static const TValue* luaR_auxfind(const luaR_entry *pentry, const char *strkey, luaR_numkey numkey, unsigned *ppos) {
-  const TValue *res = NULL;
-  unsigned i = 0;
+  unsigned lo, hi, i;
+  int res;
   
   if (pentry == NULL)
     return NULL;  
-  while(pentry->key.type != LUA_TNIL) {
-    if ((strkey && (pentry->key.type == LUA_TSTRING) && (!c_strcmp(pentry->key.id.strkey, strkey))) || 
-        (!strkey && (pentry->key.type == LUA_TNUMBER) && ((luaR_numkey)pentry->key.id.numkey == numkey))) {
-      res = &pentry->value;
-      break;
+  if (strkey) {
+    hi = luaR_strkeys(pentry);
+    lo = 0;
+    while (lo < hi) {
+      i = (lo + hi) / 2;
+      res = c_strcmp(pentry[i].key.id.strkey, strkey);
+      if (res == 0) {
+        if (ppos)
+          *ppos = i;
+        return &pentry[i].value;
+      }
+      if (res < 0)
+        lo = i + 1;
+      else
+        hi = i;
     }
-    i ++; pentry ++;
+    return NULL;
   }
-  if (res && ppos)
-    *ppos = i;   
-  return res;
+  for (i = 0; pentry[i].key.type != LUA_TNIL; i ++)
+    if (pentry[i].key.type == LUA_TNUMBER && (luaR_numkey)pentry[i].key.id.numkey == numkey) {
+      if (ppos)
+        *ppos = i;
+      return &pentry[i].value;
+    }
+  return NULL;
 }
 
 int luaR_findfunction(lua_State *L, const luaR_entry *ptable) {
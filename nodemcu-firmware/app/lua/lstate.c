@@ -22,6 +22,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "lvm.h"
 
 #define state_size(x)	(sizeof(x) + LUAI_EXTRASPACE)
 #define fromstate(l)	(cast(lu_byte *, (l)) - LUAI_EXTRASPACE)
@@ -193,7 +194,9 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
 #else
   g->memlimit = 0;
 #endif
+  g->stripdebug = LUA_STRIPDEBUG_DEFAULT;
   for (i=0; i<NUM_TAGS; i++) g->mt[i] = NULL;
+  luaV_flushrocache(L);
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != 0) {
     /* memory allocation error: free partial state */
     close_state(L);
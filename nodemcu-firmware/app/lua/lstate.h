@@ -62,6 +62,19 @@ typedef struct CallInfo {
 #define isLua(ci)	(ttisfunction((ci)->func) && f_isLua(ci))
 
 
+#if LUA_ROCACHE_SIZE > 0
+/*
+** inline cache slot of a rotable lookup, see luaV_getro
+*/
+typedef struct ROCacheSlot {
+  const Instruction *pc;  /* instruction after the lookup */
+  const void *rt;  /* receiver: a rotable, or the metatable of a userdata */
+  const TValue *res;  /* the value found, in the rotable */
+  lu_byte tt;  /* type of the receiver */
+} ROCacheSlot;
+#endif
+
+
 /*
 ** `global state', shared by all threads of this state
 */
@@ -88,12 +101,16 @@ typedef struct global_State {
   int gcpause;  /* size of pause between successive GCs */
   int gcstepmul;  /* GC `granularity' */
   int egcmode;    /* emergency garbage collection operation mode */
+  lu_byte stripdebug;  /* debug info kept by loaded chunks, LUAF_STRIP_* */
   lua_CFunction panic;  /* to be called in unprotected errors */
   TValue l_registry;
   struct lua_State *mainthread;
   UpVal uvhead;  /* head of double-linked list of all open upvalues */
   struct Table *mt[NUM_TAGS];  /* metatables for basic types */
   TString *tmname[TM_N];  /* array with tag-method names */
+#if LUA_ROCACHE_SIZE > 0
+  ROCacheSlot rocache[LUA_ROCACHE_SIZE];  /* inline cache of rotable lookups */
+#endif
 } global_State;
 
 
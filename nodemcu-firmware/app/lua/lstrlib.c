@@ -831,6 +831,9 @@ static int str_format (lua_State *L) {
 #define MIN_OPT_LEVEL 1
 #include "lrodefs.h"
 const LUA_REG_TYPE strlib[] = {
+#if LUA_OPTIMIZE_MEMORY > 0
+  {LSTRKEY("__index"), LROVAL(strlib)},
+#endif
   {LSTRKEY("byte"), LFUNCVAL(str_byte)},
   {LSTRKEY("char"), LFUNCVAL(str_char)},
   {LSTRKEY("dump"), LFUNCVAL(str_dump)},
@@ -850,9 +853,6 @@ const LUA_REG_TYPE strlib[] = {
   {LSTRKEY("reverse"), LFUNCVAL(str_reverse)},
   {LSTRKEY("sub"), LFUNCVAL(str_sub)},
   {LSTRKEY("upper"), LFUNCVAL(str_upper)},
-#if LUA_OPTIMIZE_MEMORY > 0
-  {LSTRKEY("__index"), LROVAL(strlib)},
-#endif
   {LNILKEY, LNILVAL}
 };
 
@@ -274,8 +274,8 @@ const LUA_REG_TYPE tab_funcs[] = {
   {LSTRKEY("foreach"), LFUNCVAL(foreach)},
   {LSTRKEY("foreachi"), LFUNCVAL(foreachi)},
   {LSTRKEY("getn"), LFUNCVAL(getn)},
-  {LSTRKEY("maxn"), LFUNCVAL(maxn)},
   {LSTRKEY("insert"), LFUNCVAL(tinsert)},
+  {LSTRKEY("maxn"), LFUNCVAL(maxn)},
   {LSTRKEY("remove"), LFUNCVAL(tremove)},
   {LSTRKEY("setn"), LFUNCVAL(setn)},
   {LSTRKEY("sort"), LFUNCVAL(sort)},
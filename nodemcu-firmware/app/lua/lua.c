@@ -22,7 +22,10 @@
 #include "os_type.h"
 
 os_timer_t lua_timer;
-LOCAL os_timer_t readline_timer;
+#ifdef DEVKIT_VERSION_0_9
+LOCAL os_timer_t key_led_timer;
+void update_key_led();
+#endif
 
 lua_State *globalL = NULL;
 
@@ -433,6 +436,7 @@ static int pmain (lua_State *L) {
 
 void dojob(lua_Load *load);
 void readline(lua_Load *load);
+extern void task_uart_notify(void);
 char line_buffer[LUA_MAXINPUT];
 
 #ifdef LUA_RPC
@@ -460,10 +464,15 @@ int lua_main (int argc, char **argv) {
   gLoad.line_position = 0;
   gLoad.prmt = get_prompt(L, 1);
 
-  // dojob(&gLoad);
-  os_timer_disarm(&lua_timer);
-  os_timer_setfn(&lua_timer, (os_timer_func_t *)dojob, &gLoad);
-  os_timer_arm(&lua_timer, READLINE_INTERVAL, 0);   // no repeat
+  // prints the first prompt, a timer firing later would drop a line in progress
+  dojob(&gLoad);
+
+#ifdef DEVKIT_VERSION_0_9
+  // the key and led are polled, console input is not
+  os_timer_disarm(&key_led_timer);
+  os_timer_setfn(&key_led_timer, (os_timer_func_t *)update_key_led, NULL);
+  os_timer_arm(&key_led_timer, READLINE_INTERVAL, 1);
+#endif
 
   NODE_DBG("Heap size::%d.\n",system_get_free_heap_size());
   legc_set_mode( L, EGC_ALWAYS, 4096 );
@@ -537,10 +546,9 @@ void dojob(lua_Load *load){
   load->done = 0;
   load->line_position = 0;
   c_memset(load->line, 0, load->len);
-  os_timer_disarm(&readline_timer);
-  os_timer_setfn(&readline_timer, (os_timer_func_t *)readline, load);
-  os_timer_arm(&readline_timer, READLINE_INTERVAL, 0);   // no repeat
   c_puts(load->prmt);
+  // input may have arrived while the chunk ran
+  task_uart_notify();
   // NODE_DBG("dojob() is called with firstline.\n");
 }
 
@@ -589,18 +597,27 @@ void update_key_led(){
 #define uart_putc uart0_putc
 #endif
 extern bool uart_on_data_cb(const char *buf, size_t len);
+extern bool uart_frame_char(char ch);
 extern bool uart0_echo;
 extern bool run_input;
 extern uint16_t need_len;
 extern int16_t end_char;
+// runs in the Lua task on SIG_UART, see task_uart_notify()
 void readline(lua_Load *load){
   // NODE_DBG("readline() is called.\n");
-#ifdef DEVKIT_VERSION_0_9
-  update_key_led();
-#endif
   char ch;
+  // a node.input() line waits for dojob(), which notifies again
+  if (load->done)
+    return;
   while (uart_getc(&ch))
   {
+    // frames are extracted in C, the interpreter only sees the bytes if it
+    // runs; a frame callback may turn it on, the byte ending the frame isn't
+    // for the interpreter all the same
+    bool console = run_input;
+    if (uart_frame_char(ch) && !console)
+      continue;
+
     if(run_input)
     {
       /* handle CR key */
@@ -643,14 +660,9 @@ void readline(lua_Load *load){
         {
           /* Get a empty line, then go to get a new line */
           c_puts(load->prmt);
-          os_timer_disarm(&readline_timer);
-          os_timer_setfn(&readline_timer, (os_timer_func_t *)readline, load);
-          os_timer_arm(&readline_timer, READLINE_INTERVAL, 0);   // no repeat
         } else {
           load->done = 1;
-          os_timer_disarm(&lua_timer);
-          os_timer_setfn(&lua_timer, (os_timer_func_t *)dojob, load);
-          os_timer_arm(&lua_timer, READLINE_INTERVAL, 0);   // no repeat
+          dojob(load);
         }
         continue;
       }
@@ -692,8 +704,4 @@ void readline(lua_Load *load){
     uart_on_data_cb(load->line, load->line_position);
     load->line_position = 0;
   }
-  // if there is no input from user, repeat readline()
-  os_timer_disarm(&readline_timer);
-  os_timer_setfn(&readline_timer, (os_timer_func_t *)readline, load);
-  os_timer_arm(&readline_timer, READLINE_INTERVAL, 0);   // no repeat
 }
@@ -881,6 +881,38 @@ union luai_Cast { double l_d; long l_l; };
 #define LUA_META_ROTABLES 
 #endif
 
+/* Slots of the inline cache of OP_GETTABLE / OP_SELF for constant keys
+   found in rotables (see lvm.c), a power of 2, 0 disables the cache.
+   A slot takes 16 bytes of RAM. Can be set from the compiler command line,
+   -DLUA_ROCACHE_SIZE=0 times the lookups without the cache.
+*/
+#if !defined(LUA_META_ROTABLES)
+#undef LUA_ROCACHE_SIZE
+#define LUA_ROCACHE_SIZE 0
+#elif !defined(LUA_ROCACHE_SIZE)
+#define LUA_ROCACHE_SIZE 16
+#endif
+
+/* Slots of the cache of the number of string keys of a rotable, which
+   luaR_findentry() needs to bisect them (see lrotable.c), a power of 2,
+   0 counts the keys on every lookup. A slot takes 8 bytes of RAM.
+*/
+#if !defined(LUA_ROKEYS_CACHE_SIZE)
+#define LUA_ROKEYS_CACHE_SIZE 16
+#endif
+
+/* Chunks loaded in direct mode (see lflash.c) run their code from the flash.
+   Define LUA_DIRECT_ROSTRINGS to leave their strings there too, as read-only
+   strings, where the flash can be read a byte at a time: the ESP8266 raises
+   an exception for byte loads from its mapped flash.
+*/
+/* #define LUA_DIRECT_ROSTRINGS */
+
+/* Debug info kept by chunks as they are loaded, see LUAF_STRIP_* in lfunc.h
+   and node.stripdebug()
+*/
+#define LUA_STRIPDEBUG_DEFAULT 1
+
 #if LUA_OPTIMIZE_MEMORY == 2 && defined(LUA_USE_POPEN)
 #error "Pipes not supported in aggresive optimization mode (LUA_OPTIMIZE_MEMORY=2)"
 #endif
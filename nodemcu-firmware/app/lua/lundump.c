@@ -17,6 +17,7 @@
 #include "lfunc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lstate.h"
 #include "lstring.h"
 #include "lundump.h"
 #include "lzio.h"
@@ -166,18 +167,26 @@ static TString* LoadString(LoadState* S)
  else
  {
   char* s;
-  if (!luaZ_direct_mode(S->Z)) {
-   s = luaZ_openspace(S->L,S->b,size);
-   LoadBlock(S,s,size);
-   return luaS_newlstr(S->L,s,size-1); /* remove trailing zero */
-  } else {
+#ifdef LUA_DIRECT_ROSTRINGS
+  if (luaZ_direct_mode(S->Z)) {
    s = (char*)luaZ_get_crt_address(S->Z);
    LoadBlock(S,NULL,size);
    return luaS_newrolstr(S->L,s,size-1);
   }
+#endif
+  s = luaZ_openspace(S->L,S->b,size);
+  LoadBlock(S,s,size);
+  return luaS_newlstr(S->L,s,size-1); /* remove trailing zero */
  }
 }
 
+static void SkipString(LoadState* S)
+{
+ int32_t size;
+ LoadVar(S,size);
+ LoadBlock(S,NULL,size);
+}
+
 static void LoadCode(LoadState* S, Proto* f)
 {
  int n=LoadInt(S);
@@ -234,9 +243,13 @@ static void LoadConstants(LoadState* S, Proto* f)
 static void LoadDebug(LoadState* S, Proto* f)
 {
  int i,n;
+ int level=G(S->L)->stripdebug;
  n=LoadInt(S);
  Align4(S);
- if (!luaZ_direct_mode(S->Z)) {
+ if (level>=LUAF_STRIP_LINES) {
+   LoadVector(S,NULL,n,sizeof(int));
+   n=0;
+ } else if (!luaZ_direct_mode(S->Z)) {
    f->lineinfo=luaM_newvector(S->L,n,int);
    LoadVector(S,f->lineinfo,n,sizeof(int));
  } else {
@@ -245,6 +258,17 @@ static void LoadDebug(LoadState* S, Proto* f)
  }
  f->sizelineinfo=n;
  n=LoadInt(S);
+ if (level>=LUAF_STRIP_LOCALS) {
+  for (i=0; i<n; i++)
+  {
+   SkipString(S);
+   LoadInt(S);
+   LoadInt(S);
+  }
+  n=LoadInt(S);
+  for (i=0; i<n; i++) SkipString(S);
+  return;
+ }
  f->locvars=luaM_newvector(S->L,n,LocVar);
  f->sizelocvars=n;
  for (i=0; i<n; i++) f->locvars[i].varname=NULL;
@@ -30,10 +30,10 @@ LUAI_FUNC Proto* luaU_undump (lua_State* L, ZIO* Z, Mbuffer* buff, const char* n
 /* make header; from lundump.c */
 LUAI_FUNC void luaU_header (char* h);
 
-/* dump one chunk to a different target; from ldump.c */
+/* dump one chunk to a different target, strip is a LUAF_STRIP_* level or 0; from ldump.c */
 int luaU_dump_crosscompile (lua_State* L, const Proto* f, lua_Writer w, void* data, int strip, DumpTargetInfo target);
 
-/* dump one chunk; from ldump.c */
+/* dump one chunk, strip as above; from ldump.c */
 LUAI_FUNC int luaU_dump (lua_State* L, const Proto* f, lua_Writer w, void* data, int strip);
 
 #ifdef luac_c
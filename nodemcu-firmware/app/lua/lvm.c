@@ -155,6 +155,49 @@ void luaV_gettable (lua_State *L, const TValue *t, TValue *key, StkId val) {
 }
 
 
+#if LUA_ROCACHE_SIZE > 0
+/*
+** Inline cache of the lookups of constant keys in rotables: `gpio.write',
+** `tmr:alarm' with a rotable metatable. Rotables don't change, so the value
+** found for the key of an instruction is good as long as the receiver is
+** the same. The slot is picked by the address of the instruction.
+*/
+void luaV_flushrocache (lua_State *L) {
+  c_memset(G(L)->rocache, 0, sizeof(G(L)->rocache));
+}
+
+
+static const TValue *luaV_getro (lua_State *L, const Instruction *pc,
+                                 const TValue *t, TValue *key) {
+  ROCacheSlot *slot = &G(L)->rocache[((size_t)pc / sizeof(Instruction)) &
+                                     (LUA_ROCACHE_SIZE - 1)];
+  const void *rt;
+  const TValue *res;
+  if (ttisrotable(t))
+    rt = rvalue(t);
+  else if (ttisuserdata(t) && luaR_isrotable(uvalue(t)->metatable))
+    rt = uvalue(t)->metatable;
+  else
+    return NULL;
+  if (slot->pc == pc && slot->rt == rt && slot->tt == ttype(t))
+    return slot->res;
+  res = ttisrotable(t) ? luaH_getstr_ro((void*)rt, rawtsvalue(key)) :
+                         luaH_getstr_ro((void*)rt, G(L)->tmname[TM_INDEX]);
+  if (ttisuserdata(t) && ttisrotable(res))  /* __index is a rotable? */
+    res = luaH_getstr_ro(rvalue(res), rawtsvalue(key));
+  else if (ttisuserdata(t))
+    return NULL;
+  if (ttisnil(res))  /* leave misses and other tag methods to luaV_gettable */
+    return NULL;
+  slot->pc = pc;
+  slot->rt = rt;
+  slot->res = res;
+  slot->tt = ttype(t);
+  return res;
+}
+#endif
+
+
 void luaV_settable (lua_State *L, const TValue *t, TValue *key, StkId val) {
   int loop;
   TValue temp;
@@ -489,6 +532,15 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         continue;
       }
       case OP_GETTABLE: {
+#if LUA_ROCACHE_SIZE > 0
+        if (ISK(GETARG_C(i)) && ttisstring(RKC(i))) {
+          const TValue *res = luaV_getro(L, pc, RB(i), RKC(i));
+          if (res) {
+            setobj2s(L, ra, res);
+            continue;
+          }
+        }
+#endif
         Protect(luaV_gettable(L, RB(i), RKC(i), ra));
         continue;
       }
@@ -521,6 +573,15 @@ void luaV_execute (lua_State *L, int nexeccalls) {
       case OP_SELF: {
         StkId rb = RB(i);
         setobjs2s(L, ra+1, rb);
+#if LUA_ROCACHE_SIZE > 0
+        if (ISK(GETARG_C(i)) && ttisstring(RKC(i))) {
+          const TValue *res = luaV_getro(L, pc, rb, RKC(i));
+          if (res) {
+            setobj2s(L, ra, res);
+            continue;
+          }
+        }
+#endif
         Protect(luaV_gettable(L, rb, RKC(i), ra));
         continue;
       }
@@ -32,5 +32,10 @@ LUAI_FUNC void luaV_settable (lua_State *L, const TValue *t, TValue *key,
                                             StkId val);
 LUAI_FUNC void luaV_execute (lua_State *L, int nexeccalls);
 LUAI_FUNC void luaV_concat (lua_State *L, int total, int last);
+#if LUA_ROCACHE_SIZE > 0
+LUAI_FUNC void luaV_flushrocache (lua_State *L);
+#else
+#define luaV_flushrocache(L)	((void)0)
+#endif
 
 #endif
@@ -99,7 +99,7 @@ static int doargs(int argc, char* argv[])
   else if (IS("-p"))			/* parse only */
    dumping=0;
   else if (IS("-s"))			/* strip debug information */
-   stripping=1;
+   stripping=LUAF_STRIP_LINES;
   else if (IS("-v"))			/* show version */
    ++version;
   else if (IS("-cci")) /* target integer size */
@@ -25,6 +25,9 @@ LUALIB_API int ( luaopen_dht )( lua_State *L );
 #define AUXLIB_LPD_TICKER "ticker"
 LUALIB_API int ( luaopen_ticker )( lua_State *L );
 
+#define AUXLIB_MATRIX "matrix"
+LUALIB_API int ( luaopen_matrix )( lua_State *L );
+
 #define AUXLIB_CAN      "can"
 LUALIB_API int ( luaopen_can )( lua_State *L );
 
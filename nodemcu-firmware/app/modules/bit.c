@@ -125,18 +125,18 @@ static int bit_clear( lua_State* L )
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
 const LUA_REG_TYPE bit_map[] = {
-  { LSTRKEY( "bnot" ),    LFUNCVAL( bit_bnot ) },
+  { LSTRKEY( "arshift" ), LFUNCVAL( bit_arshift ) },
   { LSTRKEY( "band" ),    LFUNCVAL( bit_band ) },
+  { LSTRKEY( "bit" ),     LFUNCVAL( bit_bit ) },
+  { LSTRKEY( "bnot" ),    LFUNCVAL( bit_bnot ) },
   { LSTRKEY( "bor" ),     LFUNCVAL( bit_bor ) },
   { LSTRKEY( "bxor" ),    LFUNCVAL( bit_bxor ) },
+  { LSTRKEY( "clear" ),   LFUNCVAL( bit_clear ) },
+  { LSTRKEY( "isclear" ), LFUNCVAL( bit_isclear ) },
+  { LSTRKEY( "isset" ),   LFUNCVAL( bit_isset ) },
   { LSTRKEY( "lshift" ),  LFUNCVAL( bit_lshift ) },
   { LSTRKEY( "rshift" ),  LFUNCVAL( bit_rshift ) },
-  { LSTRKEY( "arshift" ), LFUNCVAL( bit_arshift ) },
-  { LSTRKEY( "bit" ),     LFUNCVAL( bit_bit ) },
   { LSTRKEY( "set" ),     LFUNCVAL( bit_set ) },
-  { LSTRKEY( "clear" ),   LFUNCVAL( bit_clear ) },
-  { LSTRKEY( "isset" ),   LFUNCVAL( bit_isset ) },
-  { LSTRKEY( "isclear" ), LFUNCVAL( bit_isclear ) },
   { LNILKEY, LNILVAL}
 };
 
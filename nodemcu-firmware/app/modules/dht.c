@@ -257,10 +257,10 @@ static int dht_read(lua_State *L) {
  * DHT object functions
  */
 static const LUA_REG_TYPE dht_obj_map[] = {
-  { LSTRKEY("read"),          LFUNCVAL(dht_read) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY("__index"),       LROVAL(dht_obj_map) },
 #endif
+  { LSTRKEY("read"),          LFUNCVAL(dht_read) },
   { LNILKEY, LNILVAL }
 };
 
@@ -268,14 +268,14 @@ static const LUA_REG_TYPE dht_obj_map[] = {
  * DHT Namespace functions
  */
 const LUA_REG_TYPE dht_map[] = {
-  { LSTRKEY("setup"),       LFUNCVAL(dht_setup) },
 #if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "AM2301" ),    LNUMVAL( AM2301 ) },
   { LSTRKEY( "DHT11" ),     LNUMVAL( DHT11 ) },
-  { LSTRKEY( "DHT22" ),     LNUMVAL( DHT22 ) },
   { LSTRKEY( "DHT21" ),     LNUMVAL( DHT21 ) },
-  { LSTRKEY( "AM2301" ),    LNUMVAL( AM2301 ) },
+  { LSTRKEY( "DHT22" ),     LNUMVAL( DHT22 ) },
   { LSTRKEY("__metatable"), LROVAL(dht_map) },
 #endif
+  { LSTRKEY("setup"),       LFUNCVAL(dht_setup) },
   { LNILKEY, LNILVAL }
 };
 
@@ -11,41 +11,86 @@
 #include "flash_fs.h"
 #include "c_string.h"
 
-static volatile int file_fd = FS_OPEN_OK - 1;
+#define FILE_OBJECT "file.obj"
+#define FILE_INVALID (FS_OPEN_OK - 1)
 
-// Lua: open(filename, mode)
-static int file_open( lua_State* L )
+// file object, owns its own file descriptor
+typedef struct file_userdata {
+  int fd;
+} file_userdata;
+
+// file object used by the legacy single file API (the last opened one)
+static file_userdata *file_default = NULL;
+static int file_default_ref = LUA_NOREF;
+
+// descriptor of the default file object
+static int file_default_fd( void )
 {
-  size_t len;
-  if((FS_OPEN_OK - 1)!=file_fd){
-    fs_close(file_fd);
-    file_fd = FS_OPEN_OK - 1;
+  return file_default ? file_default->fd : FILE_INVALID;
+}
+
+// close the file of a file object
+static void file_obj_release( file_userdata *f )
+{
+  if(FILE_INVALID!=f->fd){
+    fs_close(f->fd);
+    f->fd = FILE_INVALID;
   }
+}
 
+// forget the default file object, it stays open as long as it is referenced
+static void file_release_default( lua_State* L )
+{
+  int ref = file_default_ref;
+  if(file_default){
+#if defined(BUILD_SPIFFS)
+    if(FILE_INVALID!=file_default->fd)
+      fs_flush(file_default->fd);
+#endif
+    // unref may run the collector, the object's __gc must not see it as the default any more
+    file_default_ref = LUA_NOREF;
+    file_default = NULL;
+    luaL_unref(L, LUA_REGISTRYINDEX, ref);
+  }
+}
+
+// Lua: open(filename, mode) -- returns a file object, nil on failure
+static int file_open( lua_State* L )
+{
+  size_t len;
   const char *fname = luaL_checklstring( L, 1, &len );
   if( len > FS_NAME_MAX_LENGTH )
     return luaL_error(L, "filename too long");
   const char *mode = luaL_optstring(L, 2, "r");
 
-  file_fd = fs_open(fname, fs_mode2flag(mode));
+  file_release_default(L);
 
-  if(file_fd < FS_OPEN_OK){
-    file_fd = FS_OPEN_OK - 1;
+  int fd = fs_open(fname, fs_mode2flag(mode));
+  if(fd < FS_OPEN_OK){
     lua_pushnil(L);
-  } else {
-    lua_pushboolean(L, 1);
+    return 1;
   }
-  return 1; 
+
+  file_userdata *f = (file_userdata *)lua_newuserdata(L, sizeof(file_userdata));
+  f->fd = fd;
+  luaL_getmetatable(L, FILE_OBJECT);
+  lua_setmetatable(L, -2);
+
+  // the new file becomes the default one
+  lua_pushvalue(L, -1);
+  file_default_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  file_default = f;
+  return 1;
 }
 
 // Lua: close()
 static int file_close( lua_State* L )
 {
-  if((FS_OPEN_OK - 1)!=file_fd){
-    fs_close(file_fd);
-    file_fd = FS_OPEN_OK - 1;
+  if(file_default){
+    file_obj_release(file_default);
+    file_release_default(L);
   }
-  return 0;  
+  return 0;
 }
 
 // Lua: format()
@@ -61,7 +106,7 @@ static int file_format( lua_State* L )
   else{
     NODE_ERR( "format done.\n" );
   }
-  return 0; 
+  return 0;
 }
 
 #if defined(BUILD_WOFS)
@@ -101,22 +146,29 @@ static int file_list( lua_State* L )
   return 1;
 }
 
-static int file_seek (lua_State *L) 
+// seek(whence, offset) with the arguments starting at index arg
+static int file_g_seek( lua_State* L, int fd, int arg )
 {
   static const int mode[] = {FS_SEEK_SET, FS_SEEK_CUR, FS_SEEK_END};
   static const char *const modenames[] = {"set", "cur", "end", NULL};
-  if((FS_OPEN_OK - 1)==file_fd)
+  if(FILE_INVALID==fd)
     return luaL_error(L, "open a file first");
-  int op = luaL_checkoption(L, 1, "cur", modenames);
-  long offset = luaL_optlong(L, 2, 0);
-  op = fs_seek(file_fd, offset, mode[op]);
+  int op = luaL_checkoption(L, arg, "cur", modenames);
+  long offset = luaL_optlong(L, arg + 1, 0);
+  op = fs_seek(fd, offset, mode[op]);
   if (op)
     lua_pushboolean(L, 1);  /* error */
   else
-    lua_pushinteger(L, fs_tell(file_fd));
+    lua_pushinteger(L, fs_tell(fd));
   return 1;
 }
 
+// Lua: seek(whence, offset)
+static int file_seek (lua_State *L)
+{
+  return file_g_seek(L, file_default_fd(), 1);
+}
+
 // Lua: remove(filename)
 static int file_remove( lua_State* L )
 {
@@ -126,20 +178,26 @@ static int file_remove( lua_State* L )
     return luaL_error(L, "filename too long");
   file_close(L);
   SPIFFS_remove(&fs, (char *)fname);
-  return 0;  
+  return 0;
 }
 
-// Lua: flush()
-static int file_flush( lua_State* L )
+// flush()
+static int file_g_flush( lua_State* L, int fd )
 {
-  if((FS_OPEN_OK - 1)==file_fd)
+  if(FILE_INVALID==fd)
     return luaL_error(L, "open a file first");
-  if(fs_flush(file_fd) == 0)
+  if(fs_flush(fd) == 0)
     lua_pushboolean(L, 1);
   else
     lua_pushnil(L);
   return 1;
 }
+
+// Lua: flush()
+static int file_flush( lua_State* L )
+{
+  return file_g_flush(L, file_default_fd());
+}
 #if 0
 // Lua: check()
 static int file_check( lua_State* L )
@@ -154,10 +212,7 @@ static int file_check( lua_State* L )
 static int file_rename( lua_State* L )
 {
   size_t len;
-  if((FS_OPEN_OK - 1)!=file_fd){
-    fs_close(file_fd);
-    file_fd = FS_OPEN_OK - 1;
-  }
+  file_close(L);
 
   const char *oldname = luaL_checklstring( L, 1, &len );
   if( len > FS_NAME_MAX_LENGTH )
@@ -178,36 +233,43 @@ static int file_rename( lua_State* L )
 #endif
 
 // g_read()
-static int file_g_read( lua_State* L, int n, int16_t end_char )
+static int file_g_read( lua_State* L, int fd, int n, int16_t end_char )
 {
-  if(n< 0 || n>LUAL_BUFFERSIZE) 
+  if(n< 0 || n>LUAL_BUFFERSIZE)
     n = LUAL_BUFFERSIZE;
   if(end_char < 0 || end_char >255)
     end_char = EOF;
-  int ec = (int)end_char;
-  
+
   luaL_Buffer b;
-  if((FS_OPEN_OK - 1)==file_fd)
+  if(FILE_INVALID==fd)
     return luaL_error(L, "open a file first");
 
   luaL_buffinit(L, &b);
   char *p = luaL_prepbuffer(&b);
-  int c = EOF;
   int i = 0;
 
-  do{
-    c = fs_getc(file_fd);
-    if(c==EOF){
-      break;
+  // read a whole block with one fs call instead of fs_getc() per byte
+  n = (int)fs_read(fd, p, n);
+  if(n < 0)
+    n = 0;
+
+  if(end_char != EOF){
+    // keep the end_char, give the rest back to the file
+    while( (i<n) && (p[i]!=(char)end_char) )
+      i++;
+    if(i<n){
+      if(n-i-1 > 0)
+        fs_seek(fd, -(n-i-1), FS_SEEK_CUR);
+      n = i + 1;
     }
-    p[i++] = (char)(0xFF & c);
-  }while((c!=EOF) && (c!=ec) && (i<n) );
+  }
+  i = n;
 
 #if 0
   if(i>0 && p[i-1] == '\n')
     i--;    /* do not include `eol' */
 #endif
-    
+
   if(i==0){
     luaL_pushresult(&b);  /* close buffer */
     return (lua_objlen(L, -1) > 0);  /* check whether read something */
@@ -215,115 +277,217 @@ static int file_g_read( lua_State* L, int n, int16_t end_char )
 
   luaL_addsize(&b, i);
   luaL_pushresult(&b);  /* close buffer */
-  return 1;  /* read at least an `eol' */ 
+  return 1;  /* read at least an `eol' */
 }
 
-// Lua: read()
-// file.read() will read all byte in file
-// file.read(10) will read 10 byte from file, or EOF is reached.
-// file.read('q') will read until 'q' or EOF is reached. 
-static int file_read( lua_State* L )
+// read() with the optional argument at index arg
+static int file_g_read_arg( lua_State* L, int fd, int arg )
 {
   unsigned need_len = LUAL_BUFFERSIZE;
   int16_t end_char = EOF;
   size_t el;
-  if( lua_type( L, 1 ) == LUA_TNUMBER )
+  if( lua_type( L, arg ) == LUA_TNUMBER )
   {
-    need_len = ( unsigned )luaL_checkinteger( L, 1 );
+    need_len = ( unsigned )luaL_checkinteger( L, arg );
     if( need_len > LUAL_BUFFERSIZE ){
       need_len = LUAL_BUFFERSIZE;
     }
   }
-  else if(lua_isstring(L, 1))
+  else if(lua_isstring(L, arg))
   {
-    const char *end = luaL_checklstring( L, 1, &el );
+    const char *end = luaL_checklstring( L, arg, &el );
     if(el!=1){
       return luaL_error( L, "wrong arg range" );
     }
     end_char = (int16_t)end[0];
   }
 
-  return file_g_read(L, need_len, end_char);
+  return file_g_read(L, fd, need_len, end_char);
+}
+
+// Lua: read()
+// file.read() will read all byte in file
+// file.read(10) will read 10 byte from file, or EOF is reached.
+// file.read('q') will read until 'q' or EOF is reached.
+static int file_read( lua_State* L )
+{
+  return file_g_read_arg(L, file_default_fd(), 1);
 }
 
 // Lua: readline()
 static int file_readline( lua_State* L )
 {
-  return file_g_read(L, LUAL_BUFFERSIZE, '\n');
+  return file_g_read(L, file_default_fd(), LUAL_BUFFERSIZE, '\n');
 }
 
-// Lua: write("string")
-static int file_write( lua_State* L )
+// write() of the string at index arg, optionally followed by a new line
+static int file_g_write( lua_State* L, int fd, int arg, bool newline )
 {
-  if((FS_OPEN_OK - 1)==file_fd)
+  if(FILE_INVALID==fd)
     return luaL_error(L, "open a file first");
-  size_t l, rl;
-  const char *s = luaL_checklstring(L, 1, &l);
-  rl = fs_write(file_fd, s, l);
-  if(rl==l)
+  size_t l;
+  const char *s = luaL_checklstring(L, arg, &l);
+  bool ok = (fs_write(fd, s, l)==l);
+  if(ok && newline)
+    ok = (fs_write(fd, "\n", 1)==1);
+  if(ok)
     lua_pushboolean(L, 1);
   else
     lua_pushnil(L);
   return 1;
 }
 
+// Lua: write("string")
+static int file_write( lua_State* L )
+{
+  return file_g_write(L, file_default_fd(), 1, false);
+}
+
 // Lua: writeline("string")
 static int file_writeline( lua_State* L )
 {
-  if((FS_OPEN_OK - 1)==file_fd)
-    return luaL_error(L, "open a file first");
-  size_t l, rl;
-  const char *s = luaL_checklstring(L, 1, &l);
-  rl = fs_write(file_fd, s, l);
-  if(rl==l){
-    rl = fs_write(file_fd, "\n", 1);
-    if(rl==1)
-      lua_pushboolean(L, 1);
-    else
-      lua_pushnil(L);
-  }
-  else{
-    lua_pushnil(L);
-  }
-  return 1;
+  return file_g_write(L, file_default_fd(), 1, true);
+}
+
+// file object methods
+static file_userdata *file_check_obj( lua_State* L )
+{
+  file_userdata *f = (file_userdata *)luaL_checkudata(L, 1, FILE_OBJECT);
+  luaL_argcheck(L, f, 1, FILE_OBJECT" expected");
+  return f;
+}
+
+// Lua: f:read([n | end_char])
+static int file_obj_read( lua_State* L )
+{
+  return file_g_read_arg(L, file_check_obj(L)->fd, 2);
+}
+
+// Lua: f:readline()
+static int file_obj_readline( lua_State* L )
+{
+  return file_g_read(L, file_check_obj(L)->fd, LUAL_BUFFERSIZE, '\n');
+}
+
+// Lua: f:write("string")
+static int file_obj_write( lua_State* L )
+{
+  return file_g_write(L, file_check_obj(L)->fd, 2, false);
+}
+
+// Lua: f:writeline("string")
+static int file_obj_writeline( lua_State* L )
+{
+  return file_g_write(L, file_check_obj(L)->fd, 2, true);
+}
+
+#if defined(BUILD_SPIFFS)
+// Lua: f:seek(whence, offset)
+static int file_obj_seek( lua_State* L )
+{
+  return file_g_seek(L, file_check_obj(L)->fd, 2);
+}
+
+// Lua: f:flush()
+static int file_obj_flush( lua_State* L )
+{
+  return file_g_flush(L, file_check_obj(L)->fd);
+}
+#endif
+
+// Lua: f:close(), also called by the collector
+static int file_obj_close( lua_State* L )
+{
+  file_userdata *f = file_check_obj(L);
+  file_obj_release(f);
+  if(f==file_default)
+    file_release_default(L);
+  return 0;
 }
 
 // Module function map
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
-const LUA_REG_TYPE file_map[] = 
+static const LUA_REG_TYPE file_obj_map[] =
 {
+  { LSTRKEY( "__gc" ), LFUNCVAL( file_obj_close ) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "__index" ), LROVAL( file_obj_map ) },
+#endif
+  { LSTRKEY( "close" ), LFUNCVAL( file_obj_close ) },
+#if defined(BUILD_SPIFFS)
+  { LSTRKEY( "flush" ), LFUNCVAL( file_obj_flush ) },
+#endif
+  { LSTRKEY( "read" ), LFUNCVAL( file_obj_read ) },
+  { LSTRKEY( "readline" ), LFUNCVAL( file_obj_readline ) },
+#if defined(BUILD_SPIFFS)
+  { LSTRKEY( "seek" ), LFUNCVAL( file_obj_seek ) },
+#endif
+  { LSTRKEY( "write" ), LFUNCVAL( file_obj_write ) },
+  { LSTRKEY( "writeline" ), LFUNCVAL( file_obj_writeline ) },
+  { LNILKEY, LNILVAL }
+};
+
+const LUA_REG_TYPE file_map[] =
+{
+  { LSTRKEY( "close" ), LFUNCVAL( file_close ) },
+#if defined(BUILD_WOFS)
+#elif defined(BUILD_SPIFFS)
+  { LSTRKEY( "flush" ), LFUNCVAL( file_flush ) },
+#endif
+  { LSTRKEY( "format" ), LFUNCVAL( file_format ) },
   { LSTRKEY( "list" ), LFUNCVAL( file_list ) },
   { LSTRKEY( "open" ), LFUNCVAL( file_open ) },
-  { LSTRKEY( "close" ), LFUNCVAL( file_close ) },
-  { LSTRKEY( "write" ), LFUNCVAL( file_write ) },
-  { LSTRKEY( "writeline" ), LFUNCVAL( file_writeline ) },
   { LSTRKEY( "read" ), LFUNCVAL( file_read ) },
   { LSTRKEY( "readline" ), LFUNCVAL( file_readline ) },
-  { LSTRKEY( "format" ), LFUNCVAL( file_format ) },
 #if defined(BUILD_WOFS)
 #elif defined(BUILD_SPIFFS)
   { LSTRKEY( "remove" ), LFUNCVAL( file_remove ) },
-  { LSTRKEY( "seek" ), LFUNCVAL( file_seek ) },
-  { LSTRKEY( "flush" ), LFUNCVAL( file_flush ) },
   // { LSTRKEY( "check" ), LFUNCVAL( file_check ) },
   { LSTRKEY( "rename" ), LFUNCVAL( file_rename ) },
+  { LSTRKEY( "seek" ), LFUNCVAL( file_seek ) },
 #endif
-  
+  { LSTRKEY( "write" ), LFUNCVAL( file_write ) },
+  { LSTRKEY( "writeline" ), LFUNCVAL( file_writeline ) },
 #if LUA_OPTIMIZE_MEMORY > 0
-
 #endif
   { LNILKEY, LNILVAL }
 };
 
+#if defined(BUILD_SPIFFS)
+// spiffs is out of descriptors: unreferenced file objects still hold theirs
+// until the collector runs, whoever opens a file (require, node.compile,
+// file_server) gets them back this way
+static void file_reclaim( void )
+{
+  lua_State *L = lua_getstate();
+  if(L)
+    lua_gc(L, LUA_GCCOLLECT, 0);   // does nothing while a collection runs
+}
+#endif
+
 LUALIB_API int luaopen_file( lua_State *L )
 {
+#if defined(BUILD_SPIFFS)
+  fs_set_reclaim(file_reclaim);
+#endif
 #if LUA_OPTIMIZE_MEMORY > 0
+  luaL_rometatable(L, FILE_OBJECT, (void *)file_obj_map);  // create metatable for file.obj
   return 0;
 #else // #if LUA_OPTIMIZE_MEMORY > 0
   luaL_register( L, AUXLIB_NODE, file_map );
   // Add constants
 
+  // create metatable
+  luaL_newmetatable(L, FILE_OBJECT);
+  // metatable.__index = metatable
+  lua_pushliteral(L, "__index");
+  lua_pushvalue(L,-2);
+  lua_rawset(L,-3);
+  // Setup the methods inside metatable
+  luaL_register(L, NULL, file_obj_map);
+  lua_pop(L, 1);
+
   return 1;
-#endif // #if LUA_OPTIMIZE_MEMORY > 0  
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
 }
@@ -17,9 +17,22 @@
 #include "c_stdlib.h"
 #include "espconn.h"
 #include "flash_fs.h"
+#include "user_interface.h"
 
 #define FS_OBJECT           "file_server.fs"
-#define MAX_BUFFER_SIZE     64
+#define MAX_BUFFER_SIZE     128
+#define MAX_V1_PAYLOAD      60
+#define MAX_HEADER_SIZE     24
+#define ACK_BUFFER_SIZE     16
+// A session keeps up to 2 of the SPIFFS_MAX_OPEN_FILES open (the new and the
+// previous version of a delta upload), SIGNATURE one more while it runs,
+// the rest is left for the file module
+#define MAX_SESSIONS        3
+#define DELTA_BLOCK_SIZE    256
+#define SENDING_ACK         1
+#define SENDING_REPLY       2
+#define SENDING_NACK        3   // the connection is closed once it is sent
+#define SEND_RETRY_MS       10  // a send the connection didn't take is retried
 #define LOCAL_ADDRESS       "0.0.0.0"
 #define FS_INVALID_FILE     (FS_OPEN_OK - 1)
 #define min(a,b)            ((a)<(b)?(a):(b))
@@ -27,6 +40,10 @@
 extern lua_Load gLoad;              //!< External Lua interpreter buffer (used in terminal input)
 extern void dojob(lua_Load *load);  //!< External processing function (used in terminal input)
 extern spiffs fs;                   //!< SPI File system reference
+extern int node_compile_file(lua_State *L, const char *fname, const char *output); //!< Lua compiler (node module)
+extern int node_stream_open(char *name);                                      //!< Open a chunk spool file (node module)
+extern void node_stream_close(int fd, const char *name);                     //!< Drop a spooled chunk (node module)
+extern int node_stream_exec(lua_State *L, int fd, const char *name);          //!< Run a spooled chunk (node module)
 
 /**
  * File server state enumeration
@@ -45,26 +62,157 @@ typedef enum fs_command {
    OPEN     = 'O',  //!< File open command received waiting for data
    WRITE    = 'W',  //!< Writing data
    CLOSE    = 'C',  //!< File close command received
-   RUN      = 'G'   //!< Execute a script command received
+   RUN      = 'G',  //!< Execute a script command received
+   SIGNATURE= 'S',  //!< Block signature of a file requested (v2 only)
+   DELTA    = 'D',  //!< Delta upload of a file started (v2 only)
+   COPY     = 'K',  //!< Copy blocks of the previous file version (v2 only)
+   STREAM   = 'X',  //!< Part of a Lua chunk to be executed (v2 only)
+   EXEC     = 'E'   //!< Execute the streamed Lua chunk (v2 only)
 } fs_command_t;
 
+/**
+ * A client connection of the file server
+ *
+ * Two frame formats are accepted:
+ *  - v1: "<command>|<size>|<payload>", answered with "Y|" or "N|" followed
+ *    by an echo of the whole frame.
+ *  - v2: "<command><sequence>|<size>|<payload>", answered with a compact
+ *    cumulative "Y<sequence>|" ack (or "N<sequence>|" followed by a disconnect
+ *    once it is sent, the data behind the failed frame is dropped).
+ *    The client may keep several frames in flight. WRITE payloads are written
+ *    into the file straight from the receive buffer and can be of any size,
+ *    CLOSE carries the CRC32 of the whole file as 8 hex digits.
+ *
+ * v2 also supports delta uploads. SIGNATURE returns the checksums of every
+ * DELTA_BLOCK_SIZE block of the current file as "S<sequence>|<size>|<data>",
+ * which acknowledges the frame. DELTA starts a new version of the file in a
+ * temporary file, assembled from WRITE payloads and COPY "<block>,<count>"
+ * ranges of the previous version. CLOSE replaces the file once the CRC matches.
+ *
+ * v2 STREAM payloads are appended to a Lua chunk of any size, which is spooled
+ * to flash as it arrives. EXEC compiles and runs it, see node.stream_exec().
+ * A chunk can't be streamed while a file is being uploaded and the other way
+ * round, so that a session never has more than two files open.
+ */
+typedef struct fs_session {
+   struct espconn   *m_pClient;         //!< Client connection socket, NULL for a free session
+   struct fs_userdata *m_pServer;       //!< File server the session belongs to
+   char m_Header[MAX_HEADER_SIZE];      //!< Received frame header
+   unsigned         m_HeaderLength;     //!< Actual size of the received header
+   char m_DataBuffer[MAX_BUFFER_SIZE + 1]; //!< Received payload buffer (all commands but v2 WRITE)
+   unsigned         m_DataLength;       //!< Actual size of the received payload
+   unsigned         m_Payload;          //!< Bytes to be received to complete a packet
+   fs_state_t       m_State;            //!< Current state of the parser
+   fs_command_t     m_Command;          //!< Current command
+   unsigned         m_Version;          //!< Current frame protocol version
+   unsigned         m_Sequence;         //!< Current frame sequence number (v2 only)
+   uint32_t         m_FrameStart;       //!< System time the current frame started at
+   unsigned         m_WriteFailed;      //!< Streamed WRITE payload could not be stored
+   int              m_File;             //!< File being uploaded
+   uint32_t         m_Crc;              //!< CRC32 of the data written into the open file
+   char m_FileName[FS_NAME_MAX_LENGTH + 1]; //!< Name of the open file
+   unsigned         m_Delta;            //!< m_File is a temporary file of a delta upload
+   int              m_Base;             //!< Previous version of the file (delta upload)
+   uint32_t         m_BaseSize;         //!< Size of the previous version
+   int              m_Stream;           //!< Spool file of a streamed chunk
+   char m_StreamName[FS_NAME_MAX_LENGTH + 1]; //!< Name of the spool file
+   char            *m_pReply;           //!< v2 signature reply to be sent
+   unsigned         m_ReplyLength;      //!< Size of the signature reply
+   char m_AckBuffer[ACK_BUFFER_SIZE];   //!< v2 acknowledge being sent
+   unsigned         m_AckSequence;      //!< Last v2 sequence number to be acknowledged
+   unsigned         m_AckPending;       //!< m_AckSequence has not been sent yet
+   unsigned         m_NackSequence;     //!< v2 sequence number of the failed frame
+   unsigned         m_NackPending;      //!< A frame failed, its N ack is still to be sent
+   unsigned         m_Sending;          //!< Waiting for the sent callback (SENDING_ACK, _REPLY or _NACK)
+   os_timer_t       m_RetryTimer;       //!< Retries a send the connection didn't take
+} fs_session_t;
 
 /**
  * A file server object
  */
 typedef struct fs_userdata {
    struct espconn   *m_pConnection;     //!< ESP Connection
-   char m_DataBuffer[MAX_BUFFER_SIZE];  //!< Received data buffer
-   unsigned         m_DataLength;       //!< Actual size of the received data
-   unsigned         m_ReadPoint;        //!< Read point within the data buffer
-   unsigned         m_Payload;          //!< Bytes to be received to complete a packet
-   fs_state_t       m_State;            //!< Current state of the file server
-   fs_command_t     m_Command;          //!< Current command
-   struct espconn   *m_pClient;         //!< Client connection socket (only one is allowed)
+   fs_session_t     m_Sessions[MAX_SESSIONS]; //!< Client connections pool
+   unsigned         m_Active;           //!< Number of sessions in use
+   uint32_t         m_BytesReceived;    //!< Total number of bytes received
+   uint32_t         m_Commands;         //!< Number of completed commands
+   uint32_t         m_LatencyTotal;     //!< Sum of command latencies (us)
+   uint32_t         m_LatencyMax;       //!< Maximal command latency (us)
 } fs_userdata_t;
 
 static fs_userdata_t *g_pServer = NULL;
-static volatile int file_fd = FS_OPEN_OK - 1;
+
+/**
+ * Reset the frame parser
+ * @param pSession  Client session
+ */
+static void fs_reset_frame(fs_session_t *pSession) {
+   pSession->m_HeaderLength = 0;
+   pSession->m_DataLength = 0;
+   pSession->m_Payload = 0;
+   pSession->m_State = NO_COMMAND;
+   pSession->m_Command = IDLE;
+   pSession->m_WriteFailed = 0;
+}
+
+/**
+ * Get the temporary file name used by delta uploads of a session
+ * @param pSession  Client session
+ * @param pName     Name buffer, at least FS_NAME_MAX_LENGTH + 1 bytes
+ */
+static void fs_temp_name(fs_session_t *pSession, char *pName) {
+   c_sprintf(pName, "~fs%u.tmp", (unsigned)(pSession - pSession->m_pServer->m_Sessions));
+}
+
+/**
+ * Close the file uploaded by a session. An unfinished delta upload is
+ * dropped and leaves the previous version of the file untouched.
+ * @param pSession  Client session
+ */
+static void fs_close_file(fs_session_t *pSession) {
+   char temp[FS_NAME_MAX_LENGTH + 1];
+
+   if (pSession->m_File != FS_INVALID_FILE) {
+      fs_flush(pSession->m_File);
+      fs_close(pSession->m_File);
+      pSession->m_File = FS_INVALID_FILE;
+
+      if (pSession->m_Delta) {
+         fs_temp_name(pSession, temp);
+         SPIFFS_remove(&fs, temp);
+      }
+   }
+
+   if (pSession->m_Base != FS_INVALID_FILE) {
+      fs_close(pSession->m_Base);
+      pSession->m_Base = FS_INVALID_FILE;
+   }
+
+   pSession->m_Delta = 0;
+}
+
+/**
+ * Drop an unfinished streamed chunk of a session
+ * @param pSession  Client session
+ */
+static void fs_close_stream(fs_session_t *pSession) {
+   if (pSession->m_Stream != FS_INVALID_FILE) {
+      node_stream_close(pSession->m_Stream, pSession->m_StreamName);
+      pSession->m_Stream = FS_INVALID_FILE;
+   }
+}
+
+/**
+ * Drop the signature reply of a session
+ * @param pSession  Client session
+ */
+static void fs_free_reply(fs_session_t *pSession) {
+   if (pSession->m_pReply) {
+      c_free(pSession->m_pReply);
+      pSession->m_pReply = NULL;
+   }
+}
+
 /**
  * Client disconnected callback.
  * @param pClient   ESP Connection
@@ -75,24 +223,23 @@ static void fs_client_disconnected(struct espconn *pClient) {
    if (!pClient)
       return;
 
-   fs_userdata_t *pServer = (fs_userdata_t *)pClient->reverse;
-   if (!pServer)
+   fs_session_t *pSession = (fs_session_t *)pClient->reverse;
+   if (!pSession)
       return;
 
    pClient->reverse = NULL;
 
-   pServer->m_pClient = NULL;
-   pServer->m_DataLength = 0;
-   pServer->m_ReadPoint = 0;
-   pServer->m_Payload = 0;
-   pServer->m_State = NO_COMMAND;
-   pServer->m_Command = IDLE;
-
-   if (file_fd != FS_INVALID_FILE) {
-      fs_flush(file_fd);
-      fs_close(file_fd);
-      file_fd = FS_INVALID_FILE;
-   }
+   pSession->m_pClient = NULL;
+   pSession->m_AckPending = 0;
+   pSession->m_NackPending = 0;
+   pSession->m_Sending = 0;
+   os_timer_disarm(&pSession->m_RetryTimer);
+   fs_reset_frame(pSession);
+   fs_close_file(pSession);
+   fs_close_stream(pSession);
+   fs_free_reply(pSession);
+
+   pSession->m_pServer->m_Active--;
 }
 
 /**
@@ -105,14 +252,7 @@ static void fs_server_reconnected(struct espconn *pClient, sint8_t err) {
    fs_client_disconnected(pClient);
 }
 
-static mem_move(char *pDest, char *pSource, size_t length) {
-   size_t i = 0;
-   for (; i != length; ++i) {
-      pDest[i] = pSource[i];
-   }
-}
-
-static size_t atoi(char *pStr, size_t lenght) {
+static size_t natoi(char *pStr, size_t lenght) {
    size_t result = 0, i;
    unsigned short digit;
 
@@ -129,179 +269,685 @@ static size_t atoi(char *pStr, size_t lenght) {
 }
 
 /**
- * Data received callback.
+ * Parse a hexadecimal number
+ * @param pStr      String
+ * @param length    String length
+ * @param pValue    Parsed value
+ * @return          1 on success, 0 if the string contains non-hex characters
+ */
+static int hextoi(const char *pStr, size_t length, uint32_t *pValue) {
+   uint32_t result = 0;
+   size_t i;
+   char c;
+
+   for (i = 0; i != length; ++i) {
+      c = pStr[i];
+      if (c >= '0' && c <= '9')      c = c - '0';
+      else if (c >= 'a' && c <= 'f') c = c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') c = c - 'A' + 10;
+      else
+         return 0;
+
+      result = (result << 4) | c;
+   }
+
+   *pValue = result;
+   return length != 0;
+}
+
+/**
+ * Update a CRC32 (IEEE 802.3) value, a nibble at a time to keep the table small
+ * @param crc       Current CRC value (0 for a new file)
+ * @param pData     Data
+ * @param length    Data length
+ * @return          Updated CRC value
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *pData, size_t length) {
+   static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+      0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+      0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+   };
+
+   crc = ~crc;
+   while (length--) {
+      crc ^= *pData++;
+      crc = (crc >> 4) ^ table[crc & 0x0F];
+      crc = (crc >> 4) ^ table[crc & 0x0F];
+   }
+   return ~crc;
+}
+
+static void fs_send_ack(fs_session_t *pSession);
+
+/**
+ * Retry timer callback
+ * @param arg       Client session
+ */
+static void fs_retry_send(void *arg) {
+   fs_send_ack((fs_session_t *)arg);
+}
+
+/**
+ * Start sending, the sent callback is waited for if the data was taken.
+ * Otherwise fs_send_ack() runs again after SEND_RETRY_MS, the client may be
+ * waiting for this very ack before it sends anything else.
+ * @param pSession  Client session
+ * @param pData     Data, has to stay until the sent callback
+ * @param length    Data length
+ * @param what      SENDING_ACK, SENDING_REPLY or SENDING_NACK
+ * @return          true if the connection took the data
+ */
+static bool fs_send(fs_session_t *pSession, char *pData, unsigned length, unsigned what) {
+   pSession->m_Sending = what;
+   if (espconn_sent(pSession->m_pClient, (unsigned char *)pData, length) == ESPCONN_OK)
+      return true;
+
+   pSession->m_Sending = 0;
+   os_timer_disarm(&pSession->m_RetryTimer);
+   os_timer_setfn(&pSession->m_RetryTimer, (os_timer_func_t *)fs_retry_send, pSession);
+   os_timer_arm(&pSession->m_RetryTimer, SEND_RETRY_MS, 0);
+   return false;
+}
+
+/**
+ * Send the pending v2 acknowledge unless a previous one is still in flight.
+ * Acknowledges are cumulative, so only the latest sequence number is sent.
+ * A pending signature reply is sent first, the N ack of a failed frame last.
+ * What the connection doesn't take stays pending, a failed N ack closes the
+ * connection right away.
+ * @param pSession  Client session
+ */
+static void fs_send_ack(fs_session_t *pSession) {
+   if (!pSession->m_pClient || pSession->m_Sending)
+      return;
+
+   if (pSession->m_pReply) {
+      fs_send(pSession, pSession->m_pReply, pSession->m_ReplyLength, SENDING_REPLY);
+      return;
+   }
+
+   if (pSession->m_AckPending) {
+      c_sprintf(pSession->m_AckBuffer, "Y%u|", pSession->m_AckSequence);
+      pSession->m_AckPending = !fs_send(pSession, pSession->m_AckBuffer, c_strlen(pSession->m_AckBuffer), SENDING_ACK);
+      return;
+   }
+
+   if (pSession->m_NackPending) {
+      c_sprintf(pSession->m_AckBuffer, "N%u|", pSession->m_NackSequence);
+      pSession->m_NackPending = 0;
+      if (!fs_send(pSession, pSession->m_AckBuffer, c_strlen(pSession->m_AckBuffer), SENDING_NACK))
+         espconn_disconnect(pSession->m_pClient);
+   }
+}
+
+/**
+ * Data sent callback.
  * @param pClient   ESP Client
- * @param pData     Received data
- * @param len       Received data length
  */
-static void fs_data_received(struct espconn *pClient, char *pData, unsigned short len){
-   // c_printf("fs_data_received\n");
+static void fs_data_sent(struct espconn *pClient) {
    if (!pClient)
       return;
 
-   fs_userdata_t *pServer = (fs_userdata_t *)pClient->reverse;
-   if (!pServer)
+   fs_session_t *pSession = (fs_session_t *)pClient->reverse;
+   if (!pSession)
       return;
 
-   // Close connection if not enough buffer space
-   size_t available = MAX_BUFFER_SIZE - pServer->m_DataLength;
-   size_t copied = min(len, available);
-   size_t i = 0, index;
+   if (pSession->m_Sending == SENDING_REPLY)
+      fs_free_reply(pSession);
 
-   if (copied == 0) {
+   if (pSession->m_Sending == SENDING_NACK) {
+      pSession->m_Sending = 0;
       espconn_disconnect(pClient);
       return;
    }
 
-   // Copy as much data as possible into internal buffer and adjust sizes and pointers
-   c_memcpy(pServer->m_DataBuffer + pServer->m_DataLength, pData, copied);
-   pServer->m_DataLength += copied;
-   pData += copied;
-   len -= copied;
+   pSession->m_Sending = 0;
+   fs_send_ack(pSession);
+}
+
+/**
+ * Check whether the received header is terminated, i.e. it ends with the
+ * separator following the size
+ * @param pSession  Client session
+ * @return          true if the whole header has been received
+ */
+static bool fs_header_complete(fs_session_t *pSession) {
+   unsigned i;
 
-   // Ready to get a new command
-   if (pServer->m_State == NO_COMMAND){
-      if (pServer->m_DataLength >= 2){
-         pServer->m_ReadPoint = 2;
-         pServer->m_Command = IDLE;
+   if (pSession->m_Header[pSession->m_HeaderLength - 1] != '|')
+      return false;
 
-         switch (pServer->m_DataBuffer[0]) {
-            case OPEN:  pServer->m_Command = OPEN;  break;
-            case WRITE: pServer->m_Command = WRITE; break;
-            case CLOSE: pServer->m_Command = CLOSE; break;
-            case RUN:   pServer->m_Command = RUN;   break;
-         }
+   for (i = 1; i < pSession->m_HeaderLength - 1; ++i) {
+      if (pSession->m_Header[i] == '|')
+         return true;
+   }
+   return false;
+}
 
-         if (pServer->m_Command != IDLE)
-            pServer->m_State = NO_SIZE;
-      }
-      else {
-         return;
+/**
+ * Parse a complete frame header
+ * @param pSession  Client session
+ * @return          true if the header is valid
+ */
+static bool fs_parse_header(fs_session_t *pSession) {
+   char *pHeader = pSession->m_Header;
+   unsigned length = pSession->m_HeaderLength;
+   unsigned separator;
+
+   pSession->m_Command = IDLE;
+   switch (pHeader[0]) {
+      case OPEN:  pSession->m_Command = OPEN;  break;
+      case WRITE: pSession->m_Command = WRITE; break;
+      case CLOSE: pSession->m_Command = CLOSE; break;
+      case RUN:   pSession->m_Command = RUN;   break;
+      case SIGNATURE: pSession->m_Command = SIGNATURE; break;
+      case DELTA: pSession->m_Command = DELTA; break;
+      case COPY:  pSession->m_Command = COPY;  break;
+      case STREAM: pSession->m_Command = STREAM; break;
+      case EXEC:  pSession->m_Command = EXEC;  break;
+      default:    return false;
+   }
+
+   // Header ends with '|', find the separator between sequence and size
+   for (separator = 1; separator < length - 1 && pHeader[separator] != '|'; ++separator)
+      ;
+
+   if (separator == length - 1)
+      return false;
+
+   pSession->m_Version = (separator == 1) ? 1 : 2;
+   pSession->m_Sequence = natoi(pHeader + 1, separator - 1);
+   pSession->m_Payload = natoi(pHeader + separator + 1, length - separator - 2);
+
+   // Delta uploads need compact acks and the signature reply, streamed chunks can't be echoed
+   if (pSession->m_Version == 1 &&
+       (pSession->m_Command == SIGNATURE || pSession->m_Command == DELTA || pSession->m_Command == COPY ||
+        pSession->m_Command == STREAM || pSession->m_Command == EXEC))
+      return false;
+
+   // v2 WRITE payload is streamed, everything else has to fit into the buffer
+   if (pSession->m_Version == 2 && pSession->m_Command == WRITE)
+      return pSession->m_File != FS_INVALID_FILE;
+
+   // The first STREAM frame of a chunk opens its spool file, not while a file is uploaded
+   if (pSession->m_Command == STREAM) {
+      if (pSession->m_Stream == FS_INVALID_FILE && pSession->m_File == FS_INVALID_FILE) {
+         pSession->m_Stream = node_stream_open(pSession->m_StreamName);
+         if (pSession->m_Stream < FS_OPEN_OK)
+            pSession->m_Stream = FS_INVALID_FILE;
       }
+      return pSession->m_Stream != FS_INVALID_FILE;
    }
 
-   // Try to get data size
-   if (pServer->m_State == NO_SIZE) {
-      index = -1;
-      for (i = pServer->m_ReadPoint; i != pServer->m_DataLength; ++i) {
-         if (pServer->m_DataBuffer[i] == '|') {
-            index = i;
-            break;
+   return pSession->m_Payload <= (pSession->m_Version == 1 ? MAX_V1_PAYLOAD : MAX_BUFFER_SIZE);
+}
+
+/**
+ * Compile an uploaded Lua file into a .lc file next to it, so require() does
+ * not have to parse the source at boot. The CRC32 of the source the .lc file
+ * was built from is kept in a .crc file and an unchanged file is not compiled
+ * again. init.lua is always run from the source and is skipped.
+ * @param pSession  Client session
+ */
+static void fs_compile(fs_session_t *pSession) {
+   char output[FS_NAME_MAX_LENGTH + 1];
+   char hash[FS_NAME_MAX_LENGTH + 1];
+   size_t len = c_strlen(pSession->m_FileName);
+   lua_State *L = lua_getstate();
+   uint32_t crc = 0;
+   bool cached = false;
+   int fd;
+
+   if (len < 4 || c_strcmp(pSession->m_FileName + len - 4, ".lua") != 0 ||
+       c_strcmp(pSession->m_FileName, "init.lua") == 0)
+      return;
+
+   c_strcpy(output, pSession->m_FileName);
+   c_strcpy(output + len - 3, "lc");
+   c_strcpy(hash, pSession->m_FileName);
+   c_strcpy(hash + len - 3, "crc");
+
+   fd = fs_open(hash, fs_mode2flag("r"));
+   if (fd >= FS_OPEN_OK) {
+      cached = (fs_read(fd, &crc, sizeof(crc)) == sizeof(crc) && crc == pSession->m_Crc);
+      fs_close(fd);
+   }
+
+   if (cached) {
+      fd = fs_open(output, fs_mode2flag("r"));
+      cached = (fd >= FS_OPEN_OK);
+      if (cached)
+         fs_close(fd);
+   }
+
+   if (cached)
+      return;
+
+   SPIFFS_remove(&fs, hash);
+
+   if (node_compile_file(L, pSession->m_FileName, output) != 0) {
+      // Leave no stale bytecode behind, require() falls back to the source
+      NODE_ERR("%s\n", lua_tostring(L, -1));
+      lua_pop(L, 1);
+      SPIFFS_remove(&fs, output);
+      return;
+   }
+
+   fd = fs_open(hash, fs_mode2flag("w+"));
+   if (fd >= FS_OPEN_OK) {
+      fs_write(fd, &pSession->m_Crc, sizeof(pSession->m_Crc));
+      fs_flush(fd);
+      fs_close(fd);
+   }
+}
+
+/**
+ * Build the signature reply of a file: the file size followed by a rolling
+ * (rsync style) checksum and a CRC32 of every DELTA_BLOCK_SIZE block, all as
+ * little endian 32 bit values. A missing file has the size 0.
+ * @param pSession  Client session
+ * @param pName     File name
+ * @return          true on success
+ */
+static bool fs_signature(fs_session_t *pSession, const char *pName) {
+   uint8_t buffer[MAX_BUFFER_SIZE];
+   uint32_t size = 0, offset, end, done, weak_a, weak_b, crc;
+   unsigned length, header;
+   char *pReply, *pData;
+   int fd, count, i;
+
+   // Previous reply has not been sent yet
+   if (pSession->m_pReply)
+      return false;
+
+   fd = fs_open(pName, fs_mode2flag("r"));
+   if (fd >= FS_OPEN_OK) {
+      fs_seek(fd, 0, FS_SEEK_END);
+      size = fs_tell(fd);
+      fs_seek(fd, 0, FS_SEEK_SET);
+   }
+
+   length = 4 + 8 * ((size + DELTA_BLOCK_SIZE - 1) / DELTA_BLOCK_SIZE);
+   pReply = (char *)c_malloc(MAX_HEADER_SIZE + length);
+   if (!pReply) {
+      if (fd >= FS_OPEN_OK)
+         fs_close(fd);
+      return false;
+   }
+
+   c_sprintf(pReply, "S%u|%u|", pSession->m_Sequence, length);
+   header = c_strlen(pReply);
+   pData = pReply + header;
+
+   c_memcpy(pData, &size, 4);
+   pData += 4;
+
+   for (offset = 0; offset < size; offset += DELTA_BLOCK_SIZE) {
+      end = min(size - offset, DELTA_BLOCK_SIZE);
+      weak_a = weak_b = crc = 0;
+
+      for (done = 0; done < end; done += count) {
+         count = fs_read(fd, buffer, min(end - done, sizeof(buffer)));
+         if (count <= 0) {
+            fs_close(fd);
+            c_free(pReply);
+            return false;
          }
-      }
 
-      if (index != -1) {
-         pServer->m_Payload = atoi(pServer->m_DataBuffer + pServer->m_ReadPoint, index - pServer->m_ReadPoint);
-         pServer->m_ReadPoint = index + 1;
-         pServer->m_State = NO_DATA;
-      }
-      else {
-         // No size data available - return
-         return;
+         crc = crc32_update(crc, buffer, count);
+         for (i = 0; i != count; ++i) {
+            weak_a += buffer[i];
+            weak_b += weak_a;
+         }
       }
+
+      weak_a = (weak_a & 0xFFFF) | (weak_b << 16);
+      c_memcpy(pData, &weak_a, 4);
+      c_memcpy(pData + 4, &crc, 4);
+      pData += 8;
    }
 
-   // We have both size and command - get data
-   if (pServer->m_DataLength - pServer->m_ReadPoint >= pServer->m_Payload){
-      // Make a NULL-terminated string inside of the buffer
-      uint16 packet_len = pServer->m_ReadPoint + pServer->m_Payload;
-      char backup = pServer->m_DataBuffer[packet_len];
-      pServer->m_DataBuffer[packet_len] = 0;
+   if (fd >= FS_OPEN_OK)
+      fs_close(fd);
+
+   pSession->m_pReply = pReply;
+   pSession->m_ReplyLength = header + length;
+   return true;
+}
+
+/**
+ * Copy blocks of the previous file version into a delta upload
+ * @param pSession  Client session
+ * @param pPayload  "<first block>,<block count>"
+ * @param length    Payload length
+ * @return          true on success
+ */
+static bool fs_copy_blocks(fs_session_t *pSession, char *pPayload, size_t length) {
+   uint8_t buffer[MAX_BUFFER_SIZE];
+   size_t separator;
+   uint32_t offset, end;
+   int count;
 
-      char *pPayload = pServer->m_DataBuffer + pServer->m_ReadPoint;
-      size_t payload_len = strlen(pPayload);
-      bool success = false;
+   if (!pSession->m_Delta || pSession->m_Base == FS_INVALID_FILE)
+      return false;
 
-      switch (pServer->m_Command) {
-         case OPEN: {
-            if (file_fd != FS_INVALID_FILE) {
-               fs_flush(file_fd);
-               fs_close(file_fd);
+   for (separator = 0; separator < length && pPayload[separator] != ','; ++separator)
+      ;
 
-               file_fd = FS_INVALID_FILE;
-            }
+   if (separator == length)
+      return false;
 
-            if (payload_len <= FS_NAME_MAX_LENGTH) {
-               file_fd = fs_open(pPayload, fs_mode2flag("w"));
-               fs_close(file_fd);
-               SPIFFS_remove(&fs, (char *)pPayload);
+   offset = natoi(pPayload, separator) * DELTA_BLOCK_SIZE;
+   end = offset + natoi(pPayload + separator + 1, length - separator - 1) * DELTA_BLOCK_SIZE;
+   end = min(end, pSession->m_BaseSize);
 
-               file_fd = fs_open(pPayload, fs_mode2flag("w+"));
-               if (file_fd < FS_OPEN_OK){
-                  file_fd = FS_INVALID_FILE;
-               }
-               else {
-                  success = true;
-               }
+   if (offset >= end || fs_seek(pSession->m_Base, offset, FS_SEEK_SET) != 0)
+      return false;
+
+   while (offset < end) {
+      count = fs_read(pSession->m_Base, buffer, min(end - offset, sizeof(buffer)));
+      if (count <= 0 || fs_write(pSession->m_File, buffer, count) != count)
+         return false;
+
+      pSession->m_Crc = crc32_update(pSession->m_Crc, buffer, count);
+      offset += count;
+   }
+
+   return true;
+}
+
+/**
+ * Execute a complete, buffered command
+ * @param pSession  Client session
+ * @return          true on success
+ */
+static bool fs_execute(fs_session_t *pSession) {
+   char *pPayload = pSession->m_DataBuffer;
+   size_t payload_len;
+   bool success = false;
+   uint32_t crc;
+   char temp[FS_NAME_MAX_LENGTH + 1];
+
+   pPayload[pSession->m_DataLength] = 0;
+   payload_len = c_strlen(pPayload);
+
+   switch (pSession->m_Command) {
+      case OPEN: {
+         fs_close_file(pSession);
+
+         if (payload_len <= FS_NAME_MAX_LENGTH && pSession->m_Stream == FS_INVALID_FILE) {
+            pSession->m_File = fs_open(pPayload, fs_mode2flag("w"));
+            fs_close(pSession->m_File);
+            SPIFFS_remove(&fs, (char *)pPayload);
+
+            pSession->m_File = fs_open(pPayload, fs_mode2flag("w+"));
+            if (pSession->m_File < FS_OPEN_OK){
+               pSession->m_File = FS_INVALID_FILE;
+            }
+            else {
+               c_strcpy(pSession->m_FileName, pPayload);
+               pSession->m_Crc = 0;
+               success = true;
             }
          }
-         break;
+      }
+      break;
 
-         case WRITE: {
-            if (file_fd != FS_INVALID_FILE) {
-               success = (fs_write(file_fd, pPayload, payload_len) == payload_len);
-            }
+      case WRITE: {
+         if (pSession->m_File != FS_INVALID_FILE) {
+            success = (fs_write(pSession->m_File, pPayload, payload_len) == payload_len);
+            pSession->m_Crc = crc32_update(pSession->m_Crc, (const uint8_t *)pPayload, payload_len);
          }
-         break;
+      }
+      break;
+
+      case CLOSE: {
+         if (pSession->m_File != FS_INVALID_FILE) {
+            size_t i = 0;
+            for (; i < 10 && !success; ++i) {
+               success = (fs_flush(pSession->m_File) == 0);
+            }
+            fs_close(pSession->m_File);
+
+            pSession->m_File = FS_INVALID_FILE;
 
-         case CLOSE: {
-            if (file_fd != FS_INVALID_FILE) {
-               size_t i = 0;
-               for (; i < 10 && !success; ++i) {
-                  success = (fs_flush(file_fd) == 0);
+            // v2 - verify the whole file, do not leave broken files behind
+            if (pSession->m_Version == 2) {
+               if (!hextoi(pPayload, payload_len, &crc) || crc != pSession->m_Crc) {
+                  success = false;
+               }
+            }
+
+            // Delta upload - replace the previous version, or keep it on failure
+            if (pSession->m_Delta) {
+               fs_temp_name(pSession, temp);
+               fs_close_file(pSession);
+
+               if (success) {
+                  SPIFFS_remove(&fs, pSession->m_FileName);
+                  success = (fs_rename(temp, pSession->m_FileName) == SPIFFS_OK);
                }
-               fs_close(file_fd);
 
-               file_fd = FS_INVALID_FILE;
+               if (!success)
+                  SPIFFS_remove(&fs, temp);
             }
+            else
+            if (!success && pSession->m_Version == 2) {
+               SPIFFS_remove(&fs, pSession->m_FileName);
+            }
+
+            if (success)
+               fs_compile(pSession);
          }
-         break;
+      }
+      break;
 
-         case RUN: {
-            lua_Load *load = &gLoad;
-            if (load->line_position == 0){
-               // c_printf("executing: %s\n", pPayload);
-               c_memcpy(load->line, pPayload, payload_len);
-               load->line[payload_len + 1] = 0;
-               load->line_position = c_strlen(load->line) + 1;
-               load->done = 1;
+      case SIGNATURE: {
+         if (payload_len <= FS_NAME_MAX_LENGTH)
+            success = fs_signature(pSession, pPayload);
+      }
+      break;
+
+      case DELTA: {
+         fs_close_file(pSession);
 
-               dojob(load);
+         if (payload_len <= FS_NAME_MAX_LENGTH && pSession->m_Stream == FS_INVALID_FILE) {
+            fs_temp_name(pSession, temp);
+            SPIFFS_remove(&fs, temp);
+
+            pSession->m_File = fs_open(temp, fs_mode2flag("w+"));
+            if (pSession->m_File < FS_OPEN_OK){
+               pSession->m_File = FS_INVALID_FILE;
+            }
+            else {
+               // A missing previous version is fine, the client sends it all
+               pSession->m_BaseSize = 0;
+               pSession->m_Base = fs_open(pPayload, fs_mode2flag("r"));
+               if (pSession->m_Base < FS_OPEN_OK) {
+                  pSession->m_Base = FS_INVALID_FILE;
+               }
+               else {
+                  fs_seek(pSession->m_Base, 0, FS_SEEK_END);
+                  pSession->m_BaseSize = fs_tell(pSession->m_Base);
+               }
 
+               c_strcpy(pSession->m_FileName, pPayload);
+               pSession->m_Crc = 0;
+               pSession->m_Delta = 1;
                success = true;
             }
          }
-         break;
       }
+      break;
 
-      // Restore NULL-terminator and send confirmation or failure message
-      pServer->m_DataBuffer[packet_len] = backup;
+      case COPY: {
+         success = fs_copy_blocks(pSession, pPayload, payload_len);
+      }
+      break;
+
+      case EXEC: {
+         int fd = pSession->m_Stream;
+         lua_State *L = lua_getstate();
+
+         if (fd != FS_INVALID_FILE) {
+            pSession->m_Stream = FS_INVALID_FILE;
+            success = (node_stream_exec(L, fd, pSession->m_StreamName) == 0);
+            if (!success) {
+               c_printf("%s\n", lua_tostring(L, -1));
+               lua_pop(L, 1);
+            }
+         }
+      }
+      break;
+
+      case RUN: {
+         lua_Load *load = &gLoad;
+         if (load->line_position == 0){
+            // c_printf("executing: %s\n", pPayload);
+            c_memcpy(load->line, pPayload, payload_len);
+            load->line[payload_len + 1] = 0;
+            load->line_position = c_strlen(load->line) + 1;
+            load->done = 1;
+
+            dojob(load);
+
+            success = true;
+         }
+      }
+      break;
+   }
+
+   return success;
+}
+
+/**
+ * Frame completed - update statistics and send the acknowledge
+ * @param pSession  Client session
+ * @param success   Command result
+ */
+static void fs_frame_done(fs_session_t *pSession, bool success) {
+   struct espconn *pClient = pSession->m_pClient;
+   fs_userdata_t *pServer = pSession->m_pServer;
+   // Unsigned difference, right across the wrap of the microsecond counter
+   uint32_t latency = (system_get_time() - pSession->m_FrameStart) & 0x7FFFFFFF;
+
+   pServer->m_Commands++;
+   pServer->m_LatencyTotal += latency;
+   if (latency > pServer->m_LatencyMax)
+      pServer->m_LatencyMax = latency;
+
+   if (pSession->m_Version == 1) {
       espconn_sent(pClient, (unsigned char *)(success ? "Y|" : "N|"), 2);
-      espconn_sent(pClient, (unsigned char *)pServer->m_DataBuffer, packet_len);
+      espconn_sent(pClient, (unsigned char *)pSession->m_Header, pSession->m_HeaderLength);
+      espconn_sent(pClient, (unsigned char *)pSession->m_DataBuffer, pSession->m_DataLength);
+   }
+   else
+   if (success) {
+      // Signature reply acknowledges the frame by itself
+      pSession->m_AckSequence = pSession->m_Sequence;
+      pSession->m_AckPending = (pSession->m_Command != SIGNATURE);
+   }
+   else {
+      // Sent after the acks of the frames before it, the connection is
+      // closed once it is out
+      pSession->m_NackSequence = pSession->m_Sequence;
+      pSession->m_NackPending = 1;
+   }
 
-      if (!success) {
-         espconn_disconnect(pClient);
+   fs_reset_frame(pSession);
+
+   if (!success && pSession->m_Version == 1) {
+      espconn_disconnect(pClient);
+   }
+}
+
+/**
+ * Data received callback.
+ * @param pClient   ESP Client
+ * @param pData     Received data
+ * @param len       Received data length
+ */
+static void fs_data_received(struct espconn *pClient, char *pData, unsigned short len){
+   // c_printf("fs_data_received\n");
+   if (!pClient)
+      return;
+
+   fs_session_t *pSession = (fs_session_t *)pClient->reverse;
+   if (!pSession)
+      return;
+
+   size_t chunk;
+
+   pSession->m_pServer->m_BytesReceived += len;
+
+   // A frame failed, the connection is closed once its N ack is out
+   if (pSession->m_NackPending || pSession->m_Sending == SENDING_NACK)
+      return;
+
+   while (len && pSession->m_pClient == pClient && !pSession->m_NackPending) {
+      // Collect the header: command, optional sequence number and size
+      if (pSession->m_State != NO_DATA) {
+         if (pSession->m_HeaderLength == MAX_HEADER_SIZE) {
+            espconn_disconnect(pClient);
+            return;
+         }
+
+         pSession->m_Header[pSession->m_HeaderLength++] = *pData++;
+         --len;
+
+         if (pSession->m_State == NO_COMMAND) {
+            pSession->m_FrameStart = system_get_time();
+            pSession->m_State = NO_SIZE;
+            continue;
+         }
+
+         // Header is complete when the size is terminated
+         if (!fs_header_complete(pSession))
+            continue;
+
+         if (!fs_parse_header(pSession)) {
+            fs_frame_done(pSession, false);
+            break;
+         }
+
+         pSession->m_State = NO_DATA;
       }
+      else {
+         chunk = min(len, pSession->m_Payload);
+
+         if (pSession->m_Version == 2 && pSession->m_Command == WRITE) {
+            // Store data straight from the receive buffer
+            if (!pSession->m_WriteFailed && fs_write(pSession->m_File, pData, chunk) != chunk)
+               pSession->m_WriteFailed = 1;
+
+            pSession->m_Crc = crc32_update(pSession->m_Crc, (const uint8_t *)pData, chunk);
+         }
+         else
+         if (pSession->m_Command == STREAM) {
+            if (!pSession->m_WriteFailed && fs_write(pSession->m_Stream, pData, chunk) != chunk)
+               pSession->m_WriteFailed = 1;
+         }
+         else {
+            c_memcpy(pSession->m_DataBuffer + pSession->m_DataLength, pData, chunk);
+            pSession->m_DataLength += chunk;
+         }
 
-      // Still have data in buffer
-      pServer->m_DataLength = pServer->m_DataLength - packet_len;
-      if (pServer->m_DataLength > 0) {
-         mem_move(pServer->m_DataBuffer,
-                  pServer->m_DataBuffer + packet_len,
-                  pServer->m_DataLength);
+         pSession->m_Payload -= chunk;
+         pData += chunk;
+         len -= chunk;
       }
 
-      // Reset state machine
-      pServer->m_Payload = 0;
-      pServer->m_ReadPoint = 0;
-      pServer->m_Command = IDLE;
-      pServer->m_State = NO_COMMAND;
+      if (pSession->m_State == NO_DATA && pSession->m_Payload == 0) {
+         if ((pSession->m_Version == 2 && pSession->m_Command == WRITE) || pSession->m_Command == STREAM)
+            fs_frame_done(pSession, !pSession->m_WriteFailed);
+         else
+            fs_frame_done(pSession, fs_execute(pSession));
+      }
    }
 
-   // Call this function again if still have unprocessed data
-   if (len) {
-      fs_data_received(pClient, pData, len);
-   }
+   fs_send_ack(pSession);
 }
 
 /**
@@ -313,8 +959,18 @@ static void fs_client_connected(struct espconn *pClient) {
    if (!pClient)
       return;
 
-   // Only single client allowed
-   if (g_pServer->m_pClient != NULL) {
+   fs_session_t *pSession = NULL;
+   size_t i;
+
+   // Find a free session
+   for (i = 0; i != MAX_SESSIONS; ++i) {
+      if (g_pServer->m_Sessions[i].m_pClient == NULL) {
+         pSession = &g_pServer->m_Sessions[i];
+         break;
+      }
+   }
+
+   if (!pSession) {
       NODE_ERR("MAX_CONNECT\n");
       pClient->reverse = NULL;   // Do not accept this connection
       if (pClient->proto.tcp->remote_port || pClient->proto.tcp->local_port)
@@ -322,10 +978,18 @@ static void fs_client_connected(struct espconn *pClient) {
       return;
    }
 
-   g_pServer->m_pClient = pClient;
-   pClient->reverse = g_pServer;
+   pSession->m_pClient = pClient;
+   pSession->m_Version = 1;
+   pSession->m_AckPending = 0;
+   pSession->m_NackPending = 0;
+   pSession->m_Sending = 0;
+   os_timer_disarm(&pSession->m_RetryTimer);
+   fs_reset_frame(pSession);
+   pClient->reverse = pSession;
+   g_pServer->m_Active++;
 
    espconn_regist_recvcb  (pClient, (espconn_recv_callback)fs_data_received);
+   espconn_regist_sentcb  (pClient, (espconn_sent_callback)fs_data_sent);
    espconn_regist_disconcb(pClient, (espconn_connect_callback)fs_client_disconnected);
    espconn_regist_reconcb (pClient, (espconn_reconnect_callback)fs_server_reconnected);
 }
@@ -342,6 +1006,7 @@ static int file_server_start(lua_State *L) {
    uint16_t timeout = 30;
    struct espconn *pConnection = NULL;
    ip_addr_t ipaddr;
+   size_t i;
 
    // Load and check parameters
    port = luaL_checkinteger(L, 1);
@@ -362,12 +1027,18 @@ static int file_server_start(lua_State *L) {
    if (!pConnection)
       return luaL_error(L, "not enough memory");
 
-   g_pServer->m_DataLength = 0;
-   g_pServer->m_ReadPoint = 0;
-   g_pServer->m_Payload = 0;
-   g_pServer->m_State = NO_COMMAND;
-   g_pServer->m_Command = IDLE;
-   g_pServer->m_pClient = NULL;
+   c_memset(g_pServer->m_Sessions, 0, sizeof(g_pServer->m_Sessions));
+   for (i = 0; i != MAX_SESSIONS; ++i) {
+      g_pServer->m_Sessions[i].m_pServer = g_pServer;
+      g_pServer->m_Sessions[i].m_File = FS_INVALID_FILE;
+      g_pServer->m_Sessions[i].m_Base = FS_INVALID_FILE;
+      g_pServer->m_Sessions[i].m_Stream = FS_INVALID_FILE;
+   }
+   g_pServer->m_Active = 0;
+   g_pServer->m_BytesReceived = 0;
+   g_pServer->m_Commands = 0;
+   g_pServer->m_LatencyTotal = 0;
+   g_pServer->m_LatencyMax = 0;
 
    pConnection->proto.tcp = NULL;
    pConnection->reverse = NULL;
@@ -403,6 +1074,23 @@ static int file_server_start(lua_State *L) {
  */
 static void stop(fs_userdata_t *pData){
    // c_printf("stop\n");
+   size_t i;
+
+   // Sessions live inside of the object - drop all clients
+   for (i = 0; i != MAX_SESSIONS; ++i) {
+      fs_session_t *pSession = &pData->m_Sessions[i];
+      os_timer_disarm(&pSession->m_RetryTimer);
+      if (pSession->m_pClient) {
+         pSession->m_pClient->reverse = NULL;
+         espconn_disconnect(pSession->m_pClient);
+         pSession->m_pClient = NULL;
+      }
+      fs_close_file(pSession);
+      fs_close_stream(pSession);
+      fs_free_reply(pSession);
+   }
+   pData->m_Active = 0;
+
    if (pData->m_pConnection) {
       if (pData->m_pConnection->proto.tcp) {
          c_free(pData->m_pConnection->proto.tcp);
@@ -437,6 +1125,34 @@ static int file_server_stop(lua_State *L) {
    return 0;
 }
 
+/**
+ * Get the file server statistics
+ *
+ * @param   L   Lua Sate
+ * @return      Number of return parameters on stack (always 4)
+ * @example     Lua: sessions, bytes, avg_latency, max_latency = file_server.stats()
+ *              Latencies are in microseconds, measured from the first byte of
+ *              a command to its acknowledge. All values are 0 if no server
+ *              is running.
+ */
+static int file_server_stats(lua_State *L) {
+   fs_userdata_t *pServer = g_pServer;
+
+   if (!pServer) {
+      lua_pushinteger(L, 0);
+      lua_pushinteger(L, 0);
+      lua_pushinteger(L, 0);
+      lua_pushinteger(L, 0);
+      return 4;
+   }
+
+   lua_pushinteger(L, pServer->m_Active);
+   lua_pushinteger(L, pServer->m_BytesReceived);
+   lua_pushinteger(L, pServer->m_Commands ? pServer->m_LatencyTotal / pServer->m_Commands : 0);
+   lua_pushinteger(L, pServer->m_LatencyMax);
+   return 4;
+}
+
 // Module function map
 #define MIN_OPT_LEVEL   2
 #include "lrodefs.h"
@@ -445,11 +1161,11 @@ static int file_server_stop(lua_State *L) {
  * file_server object functions
  */
 static const LUA_REG_TYPE file_server_obj_map[] = {
-  { LSTRKEY("stop"),          LFUNCVAL(file_server_stop) },
   { LSTRKEY("__gc"),          LFUNCVAL(file_server_stop) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY("__index"),       LROVAL(file_server_obj_map) },
 #endif
+  { LSTRKEY("stop"),          LFUNCVAL(file_server_stop) },
   { LNILKEY, LNILVAL }
 };
 
@@ -457,10 +1173,11 @@ static const LUA_REG_TYPE file_server_obj_map[] = {
  * file_server namespace functions
  */
 const LUA_REG_TYPE file_server_map[] = {
-  { LSTRKEY("start"),       LFUNCVAL(file_server_start) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY("__metatable"), LROVAL(file_server_map) },
 #endif
+  { LSTRKEY("start"),       LFUNCVAL(file_server_start) },
+  { LSTRKEY("stats"),       LFUNCVAL(file_server_stats) },
   { LNILKEY, LNILVAL }
 };
 
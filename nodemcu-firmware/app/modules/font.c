@@ -0,0 +1,605 @@
+/*
+ * font.c
+ *
+ * Bitmap fonts shared by the LED ticker and matrix modules.
+ * Glyphs are stored in flash as runs of columns of their own width,
+ * so narrow characters take less space both in flash and on the display.
+ *
+ *  Created on: Feb 21, 2015
+ *      Author: yowidin
+ */
+
+#include "c_types.h"
+#include "user_config.h"
+#include "flash_api.h"
+#include "font.h"
+
+//! Pack glyph column offset and width into a single glyph table entry
+#define GLYPH(offset, width)   (((offset) << 8) | (width))
+
+/**
+ * 4x6 font glyph columns, bit 0 is the top row
+ */
+static const uint8_t font_4x6_columns[] ICACHE_STORE_ATTR ICACHE_RODATA_ATTR = {
+      0x17,                              // 0x21 !
+      0x03, 0x00, 0x03,                  // 0x22 "
+      0x1F, 0x0A, 0x1F,                  // 0x23 #
+      0x14, 0x3F, 0x0A,                  // 0x24 $
+      0x09, 0x04, 0x12,                  // 0x25 %
+      0x1A, 0x15, 0x1E,                  // 0x26 &
+      0x03, 0x01,                        // 0x27 '
+      0x0E, 0x11,                        // 0x28 (
+      0x11, 0x0E,                        // 0x29 )
+      0x15, 0x0E, 0x15,                  // 0x2A *
+      0x04, 0x0E, 0x04,                  // 0x2B +
+      0x30, 0x10,                        // 0x2C ,
+      0x04, 0x04, 0x04,                  // 0x2D -
+      0x10,                              // 0x2E .
+      0x18, 0x04, 0x03,                  // 0x2F /
+      0x1E, 0x11, 0x0F,                  // 0x30 0
+      0x12, 0x1F, 0x10,                  // 0x31 1
+      0x19, 0x15, 0x12,                  // 0x32 2
+      0x11, 0x15, 0x0A,                  // 0x33 3
+      0x06, 0x04, 0x1F,                  // 0x34 4
+      0x17, 0x15, 0x09,                  // 0x35 5
+      0x0E, 0x15, 0x08,                  // 0x36 6
+      0x01, 0x1D, 0x03,                  // 0x37 7
+      0x0A, 0x15, 0x0A,                  // 0x38 8
+      0x02, 0x15, 0x0E,                  // 0x39 9
+      0x14,                              // 0x3A :
+      0x30, 0x14,                        // 0x3B ;
+      0x04, 0x0A, 0x11,                  // 0x3C <
+      0x14, 0x14, 0x14,                  // 0x3D =
+      0x11, 0x0A, 0x04,                  // 0x3E >
+      0x01, 0x15, 0x02,                  // 0x3F ?
+      0x1F, 0x11, 0x17,                  // 0x40 @
+      0x1E, 0x05, 0x1E,                  // 0x41 A
+      0x1F, 0x15, 0x0A,                  // 0x42 B
+      0x0E, 0x11, 0x11,                  // 0x43 C
+      0x1F, 0x11, 0x0E,                  // 0x44 D
+      0x1F, 0x15, 0x11,                  // 0x45 E
+      0x1F, 0x05, 0x01,                  // 0x46 F
+      0x0E, 0x11, 0x1D,                  // 0x47 G
+      0x1F, 0x04, 0x1F,                  // 0x48 H
+      0x11, 0x1F, 0x11,                  // 0x49 I
+      0x08, 0x10, 0x0F,                  // 0x4A J
+      0x1F, 0x04, 0x1B,                  // 0x4B K
+      0x1F, 0x10, 0x10,                  // 0x4C L
+      0x1F, 0x06, 0x1F,                  // 0x4D M
+      0x1F, 0x02, 0x1F,                  // 0x4E N
+      0x0E, 0x11, 0x0E,                  // 0x4F O
+      0x1F, 0x05, 0x02,                  // 0x50 P
+      0x0E, 0x11, 0x1E,                  // 0x51 Q
+      0x1F, 0x05, 0x1A,                  // 0x52 R
+      0x16, 0x15, 0x0D,                  // 0x53 S
+      0x01, 0x1F, 0x01,                  // 0x54 T
+      0x1F, 0x10, 0x1F,                  // 0x55 U
+      0x0F, 0x10, 0x0F,                  // 0x56 V
+      0x1F, 0x0C, 0x1F,                  // 0x57 W
+      0x1B, 0x04, 0x1B,                  // 0x58 X
+      0x03, 0x1C, 0x03,                  // 0x59 Y
+      0x19, 0x15, 0x13,                  // 0x5A Z
+      0x1F, 0x11,                        // 0x5B [
+      0x03, 0x04, 0x18,                  // 0x5C \ .
+      0x11, 0x1F,                        // 0x5D ]
+      0x02, 0x01, 0x02,                  // 0x5E ^
+      0x20, 0x20, 0x20, 0x20,            // 0x5F _
+      0x01, 0x03,                        // 0x60 `
+      0x18, 0x14, 0x1C,                  // 0x61 a
+      0x1F, 0x14, 0x08,                  // 0x62 b
+      0x08, 0x14, 0x14,                  // 0x63 c
+      0x08, 0x14, 0x1F,                  // 0x64 d
+      0x0C, 0x1C, 0x14,                  // 0x65 e
+      0x04, 0x1E, 0x05,                  // 0x66 f
+      0x2C, 0x24, 0x3C,                  // 0x67 g
+      0x1F, 0x04, 0x18,                  // 0x68 h
+      0x1D,                              // 0x69 i
+      0x20, 0x3D,                        // 0x6A j
+      0x1F, 0x08, 0x14,                  // 0x6B k
+      0x1F,                              // 0x6C l
+      0x1C, 0x0C, 0x1C,                  // 0x6D m
+      0x1C, 0x04, 0x18,                  // 0x6E n
+      0x08, 0x14, 0x08,                  // 0x6F o
+      0x3C, 0x14, 0x08,                  // 0x70 p
+      0x08, 0x14, 0x3C,                  // 0x71 q
+      0x1C, 0x04,                        // 0x72 r
+      0x10, 0x1C, 0x04,                  // 0x73 s
+      0x04, 0x1E, 0x14,                  // 0x74 t
+      0x1C, 0x10, 0x1C,                  // 0x75 u
+      0x0C, 0x10, 0x0C,                  // 0x76 v
+      0x1C, 0x18, 0x1C,                  // 0x77 w
+      0x14, 0x08, 0x14,                  // 0x78 x
+      0x2C, 0x10, 0x0C,                  // 0x79 y
+      0x04, 0x1C, 0x10,                  // 0x7A z
+      0x04, 0x1F, 0x11,                  // 0x7B {
+      0x1F,                              // 0x7C |
+      0x11, 0x1F, 0x04,                  // 0x7D }
+      0x02, 0x01, 0x02, 0x01,            // 0x7E ~
+};
+
+/**
+ * 4x6 font glyph table (column offset and width)
+ */
+static const uint32_t font_4x6_glyphs[] ICACHE_STORE_ATTR ICACHE_RODATA_ATTR = {
+      GLYPH(  0, 0),                     // 0x20
+      GLYPH(  0, 1),                     // 0x21 !
+      GLYPH(  1, 3),                     // 0x22 "
+      GLYPH(  4, 3),                     // 0x23 #
+      GLYPH(  7, 3),                     // 0x24 $
+      GLYPH( 10, 3),                     // 0x25 %
+      GLYPH( 13, 3),                     // 0x26 &
+      GLYPH( 16, 2),                     // 0x27 '
+      GLYPH( 18, 2),                     // 0x28 (
+      GLYPH( 20, 2),                     // 0x29 )
+      GLYPH( 22, 3),                     // 0x2A *
+      GLYPH( 25, 3),                     // 0x2B +
+      GLYPH( 28, 2),                     // 0x2C ,
+      GLYPH( 30, 3),                     // 0x2D -
+      GLYPH( 33, 1),                     // 0x2E .
+      GLYPH( 34, 3),                     // 0x2F /
+      GLYPH( 37, 3),                     // 0x30 0
+      GLYPH( 40, 3),                     // 0x31 1
+      GLYPH( 43, 3),                     // 0x32 2
+      GLYPH( 46, 3),                     // 0x33 3
+      GLYPH( 49, 3),                     // 0x34 4
+      GLYPH( 52, 3),                     // 0x35 5
+      GLYPH( 55, 3),                     // 0x36 6
+      GLYPH( 58, 3),                     // 0x37 7
+      GLYPH( 61, 3),                     // 0x38 8
+      GLYPH( 64, 3),                     // 0x39 9
+      GLYPH( 67, 1),                     // 0x3A :
+      GLYPH( 68, 2),                     // 0x3B ;
+      GLYPH( 70, 3),                     // 0x3C <
+      GLYPH( 73, 3),                     // 0x3D =
+      GLYPH( 76, 3),                     // 0x3E >
+      GLYPH( 79, 3),                     // 0x3F ?
+      GLYPH( 82, 3),                     // 0x40 @
+      GLYPH( 85, 3),                     // 0x41 A
+      GLYPH( 88, 3),                     // 0x42 B
+      GLYPH( 91, 3),                     // 0x43 C
+      GLYPH( 94, 3),                     // 0x44 D
+      GLYPH( 97, 3),                     // 0x45 E
+      GLYPH(100, 3),                     // 0x46 F
+      GLYPH(103, 3),                     // 0x47 G
+      GLYPH(106, 3),                     // 0x48 H
+      GLYPH(109, 3),                     // 0x49 I
+      GLYPH(112, 3),                     // 0x4A J
+      GLYPH(115, 3),                     // 0x4B K
+      GLYPH(118, 3),                     // 0x4C L
+      GLYPH(121, 3),                     // 0x4D M
+      GLYPH(124, 3),                     // 0x4E N
+      GLYPH(127, 3),                     // 0x4F O
+      GLYPH(130, 3),                     // 0x50 P
+      GLYPH(133, 3),                     // 0x51 Q
+      GLYPH(136, 3),                     // 0x52 R
+      GLYPH(139, 3),                     // 0x53 S
+      GLYPH(142, 3),                     // 0x54 T
+      GLYPH(145, 3),                     // 0x55 U
+      GLYPH(148, 3),                     // 0x56 V
+      GLYPH(151, 3),                     // 0x57 W
+      GLYPH(154, 3),                     // 0x58 X
+      GLYPH(157, 3),                     // 0x59 Y
+      GLYPH(160, 3),                     // 0x5A Z
+      GLYPH(163, 2),                     // 0x5B [
+      GLYPH(165, 3),                     // 0x5C \ .
+      GLYPH(168, 2),                     // 0x5D ]
+      GLYPH(170, 3),                     // 0x5E ^
+      GLYPH(173, 4),                     // 0x5F _
+      GLYPH(177, 2),                     // 0x60 `
+      GLYPH(179, 3),                     // 0x61 a
+      GLYPH(182, 3),                     // 0x62 b
+      GLYPH(185, 3),                     // 0x63 c
+      GLYPH(188, 3),                     // 0x64 d
+      GLYPH(191, 3),                     // 0x65 e
+      GLYPH(194, 3),                     // 0x66 f
+      GLYPH(197, 3),                     // 0x67 g
+      GLYPH(200, 3),                     // 0x68 h
+      GLYPH(203, 1),                     // 0x69 i
+      GLYPH(204, 2),                     // 0x6A j
+      GLYPH(206, 3),                     // 0x6B k
+      GLYPH(209, 1),                     // 0x6C l
+      GLYPH(210, 3),                     // 0x6D m
+      GLYPH(213, 3),                     // 0x6E n
+      GLYPH(216, 3),                     // 0x6F o
+      GLYPH(219, 3),                     // 0x70 p
+      GLYPH(222, 3),                     // 0x71 q
+      GLYPH(225, 2),                     // 0x72 r
+      GLYPH(227, 3),                     // 0x73 s
+      GLYPH(230, 3),                     // 0x74 t
+      GLYPH(233, 3),                     // 0x75 u
+      GLYPH(236, 3),                     // 0x76 v
+      GLYPH(239, 3),                     // 0x77 w
+      GLYPH(242, 3),                     // 0x78 x
+      GLYPH(245, 3),                     // 0x79 y
+      GLYPH(248, 3),                     // 0x7A z
+      GLYPH(251, 3),                     // 0x7B {
+      GLYPH(254, 1),                     // 0x7C |
+      GLYPH(255, 3),                     // 0x7D }
+      GLYPH(258, 4),                     // 0x7E ~
+};
+
+/**
+ * 5x7 font glyph columns, bit 0 is the top row
+ */
+static const uint8_t font_5x7_columns[] ICACHE_STORE_ATTR ICACHE_RODATA_ATTR = {
+      0x5F,                              // 0x21 !
+      0x07, 0x00, 0x07,                  // 0x22 "
+      0x14, 0x7F, 0x14, 0x7F, 0x14,      // 0x23 #
+      0x24, 0x2A, 0x7F, 0x2A, 0x12,      // 0x24 $
+      0x23, 0x13, 0x08, 0x64, 0x62,      // 0x25 %
+      0x36, 0x49, 0x55, 0x22, 0x50,      // 0x26 &
+      0x05, 0x03,                        // 0x27 '
+      0x1C, 0x22, 0x41,                  // 0x28 (
+      0x41, 0x22, 0x1C,                  // 0x29 )
+      0x14, 0x08, 0x3E, 0x08, 0x14,      // 0x2A *
+      0x08, 0x08, 0x3E, 0x08, 0x08,      // 0x2B +
+      0x50, 0x30,                        // 0x2C ,
+      0x08, 0x08, 0x08, 0x08, 0x08,      // 0x2D -
+      0x60, 0x60,                        // 0x2E .
+      0x20, 0x10, 0x08, 0x04, 0x02,      // 0x2F /
+      0x3E, 0x51, 0x49, 0x45, 0x3E,      // 0x30 0
+      0x42, 0x7F, 0x40,                  // 0x31 1
+      0x42, 0x61, 0x51, 0x49, 0x46,      // 0x32 2
+      0x21, 0x41, 0x45, 0x4B, 0x31,      // 0x33 3
+      0x18, 0x14, 0x12, 0x7F, 0x10,      // 0x34 4
+      0x27, 0x45, 0x45, 0x45, 0x39,      // 0x35 5
+      0x3C, 0x4A, 0x49, 0x49, 0x30,      // 0x36 6
+      0x01, 0x71, 0x09, 0x05, 0x03,      // 0x37 7
+      0x36, 0x49, 0x49, 0x49, 0x36,      // 0x38 8
+      0x06, 0x49, 0x49, 0x29, 0x1E,      // 0x39 9
+      0x36, 0x36,                        // 0x3A :
+      0x56, 0x36,                        // 0x3B ;
+      0x08, 0x14, 0x22, 0x41,            // 0x3C <
+      0x14, 0x14, 0x14, 0x14, 0x14,      // 0x3D =
+      0x41, 0x22, 0x14, 0x08,            // 0x3E >
+      0x02, 0x01, 0x51, 0x09, 0x06,      // 0x3F ?
+      0x32, 0x49, 0x79, 0x41, 0x3E,      // 0x40 @
+      0x7E, 0x11, 0x11, 0x11, 0x7E,      // 0x41 A
+      0x7F, 0x49, 0x49, 0x49, 0x36,      // 0x42 B
+      0x3E, 0x41, 0x41, 0x41, 0x22,      // 0x43 C
+      0x7F, 0x41, 0x41, 0x22, 0x1C,      // 0x44 D
+      0x7F, 0x49, 0x49, 0x49, 0x41,      // 0x45 E
+      0x7F, 0x09, 0x09, 0x09, 0x01,      // 0x46 F
+      0x3E, 0x41, 0x49, 0x49, 0x7A,      // 0x47 G
+      0x7F, 0x08, 0x08, 0x08, 0x7F,      // 0x48 H
+      0x41, 0x7F, 0x41,                  // 0x49 I
+      0x20, 0x40, 0x41, 0x3F, 0x01,      // 0x4A J
+      0x7F, 0x08, 0x14, 0x22, 0x41,      // 0x4B K
+      0x7F, 0x40, 0x40, 0x40, 0x40,      // 0x4C L
+      0x7F, 0x02, 0x0C, 0x02, 0x7F,      // 0x4D M
+      0x7F, 0x04, 0x08, 0x10, 0x7F,      // 0x4E N
+      0x3E, 0x41, 0x41, 0x41, 0x3E,      // 0x4F O
+      0x7F, 0x09, 0x09, 0x09, 0x06,      // 0x50 P
+      0x3E, 0x41, 0x51, 0x21, 0x5E,      // 0x51 Q
+      0x7F, 0x09, 0x19, 0x29, 0x46,      // 0x52 R
+      0x46, 0x49, 0x49, 0x49, 0x31,      // 0x53 S
+      0x01, 0x01, 0x7F, 0x01, 0x01,      // 0x54 T
+      0x3F, 0x40, 0x40, 0x40, 0x3F,      // 0x55 U
+      0x1F, 0x20, 0x40, 0x20, 0x1F,      // 0x56 V
+      0x3F, 0x40, 0x38, 0x40, 0x3F,      // 0x57 W
+      0x63, 0x14, 0x08, 0x14, 0x63,      // 0x58 X
+      0x07, 0x08, 0x70, 0x08, 0x07,      // 0x59 Y
+      0x61, 0x51, 0x49, 0x45, 0x43,      // 0x5A Z
+      0x7F, 0x41, 0x41,                  // 0x5B [
+      0x02, 0x04, 0x08, 0x10, 0x20,      // 0x5C \ .
+      0x41, 0x41, 0x7F,                  // 0x5D ]
+      0x04, 0x02, 0x01, 0x02, 0x04,      // 0x5E ^
+      0x40, 0x40, 0x40, 0x40, 0x40,      // 0x5F _
+      0x01, 0x02, 0x04,                  // 0x60 `
+      0x20, 0x54, 0x54, 0x54, 0x78,      // 0x61 a
+      0x7F, 0x48, 0x44, 0x44, 0x38,      // 0x62 b
+      0x38, 0x44, 0x44, 0x44, 0x20,      // 0x63 c
+      0x38, 0x44, 0x44, 0x48, 0x7F,      // 0x64 d
+      0x38, 0x54, 0x54, 0x54, 0x18,      // 0x65 e
+      0x08, 0x7E, 0x09, 0x01, 0x02,      // 0x66 f
+      0x0C, 0x52, 0x52, 0x52, 0x3E,      // 0x67 g
+      0x7F, 0x08, 0x04, 0x04, 0x78,      // 0x68 h
+      0x44, 0x7D, 0x40,                  // 0x69 i
+      0x20, 0x40, 0x44, 0x3D,            // 0x6A j
+      0x7F, 0x10, 0x28, 0x44,            // 0x6B k
+      0x41, 0x7F, 0x40,                  // 0x6C l
+      0x7C, 0x04, 0x18, 0x04, 0x78,      // 0x6D m
+      0x7C, 0x08, 0x04, 0x04, 0x78,      // 0x6E n
+      0x38, 0x44, 0x44, 0x44, 0x38,      // 0x6F o
+      0x7C, 0x14, 0x14, 0x14, 0x08,      // 0x70 p
+      0x08, 0x14, 0x14, 0x18, 0x7C,      // 0x71 q
+      0x7C, 0x08, 0x04, 0x04, 0x08,      // 0x72 r
+      0x48, 0x54, 0x54, 0x54, 0x20,      // 0x73 s
+      0x04, 0x3F, 0x44, 0x40, 0x20,      // 0x74 t
+      0x3C, 0x40, 0x40, 0x20, 0x7C,      // 0x75 u
+      0x1C, 0x20, 0x40, 0x20, 0x1C,      // 0x76 v
+      0x3C, 0x40, 0x30, 0x40, 0x3C,      // 0x77 w
+      0x44, 0x28, 0x10, 0x28, 0x44,      // 0x78 x
+      0x0C, 0x50, 0x50, 0x50, 0x3C,      // 0x79 y
+      0x44, 0x64, 0x54, 0x4C, 0x44,      // 0x7A z
+      0x08, 0x36, 0x41,                  // 0x7B {
+      0x7F,                              // 0x7C |
+      0x41, 0x36, 0x08,                  // 0x7D }
+      0x08, 0x04, 0x08, 0x10, 0x08,      // 0x7E ~
+};
+
+/**
+ * 5x7 font glyph table (column offset and width)
+ */
+static const uint32_t font_5x7_glyphs[] ICACHE_STORE_ATTR ICACHE_RODATA_ATTR = {
+      GLYPH(  0, 0),                     // 0x20
+      GLYPH(  0, 1),                     // 0x21 !
+      GLYPH(  1, 3),                     // 0x22 "
+      GLYPH(  4, 5),                     // 0x23 #
+      GLYPH(  9, 5),                     // 0x24 $
+      GLYPH( 14, 5),                     // 0x25 %
+      GLYPH( 19, 5),                     // 0x26 &
+      GLYPH( 24, 2),                     // 0x27 '
+      GLYPH( 26, 3),                     // 0x28 (
+      GLYPH( 29, 3),                     // 0x29 )
+      GLYPH( 32, 5),                     // 0x2A *
+      GLYPH( 37, 5),                     // 0x2B +
+      GLYPH( 42, 2),                     // 0x2C ,
+      GLYPH( 44, 5),                     // 0x2D -
+      GLYPH( 49, 2),                     // 0x2E .
+      GLYPH( 51, 5),                     // 0x2F /
+      GLYPH( 56, 5),                     // 0x30 0
+      GLYPH( 61, 3),                     // 0x31 1
+      GLYPH( 64, 5),                     // 0x32 2
+      GLYPH( 69, 5),                     // 0x33 3
+      GLYPH( 74, 5),                     // 0x34 4
+      GLYPH( 79, 5),                     // 0x35 5
+      GLYPH( 84, 5),                     // 0x36 6
+      GLYPH( 89, 5),                     // 0x37 7
+      GLYPH( 94, 5),                     // 0x38 8
+      GLYPH( 99, 5),                     // 0x39 9
+      GLYPH(104, 2),                     // 0x3A :
+      GLYPH(106, 2),                     // 0x3B ;
+      GLYPH(108, 4),                     // 0x3C <
+      GLYPH(112, 5),                     // 0x3D =
+      GLYPH(117, 4),                     // 0x3E >
+      GLYPH(121, 5),                     // 0x3F ?
+      GLYPH(126, 5),                     // 0x40 @
+      GLYPH(131, 5),                     // 0x41 A
+      GLYPH(136, 5),                     // 0x42 B
+      GLYPH(141, 5),                     // 0x43 C
+      GLYPH(146, 5),                     // 0x44 D
+      GLYPH(151, 5),                     // 0x45 E
+      GLYPH(156, 5),                     // 0x46 F
+      GLYPH(161, 5),                     // 0x47 G
+      GLYPH(166, 5),                     // 0x48 H
+      GLYPH(171, 3),                     // 0x49 I
+      GLYPH(174, 5),                     // 0x4A J
+      GLYPH(179, 5),                     // 0x4B K
+      GLYPH(184, 5),                     // 0x4C L
+      GLYPH(189, 5),                     // 0x4D M
+      GLYPH(194, 5),                     // 0x4E N
+      GLYPH(199, 5),                     // 0x4F O
+      GLYPH(204, 5),                     // 0x50 P
+      GLYPH(209, 5),                     // 0x51 Q
+      GLYPH(214, 5),                     // 0x52 R
+      GLYPH(219, 5),                     // 0x53 S
+      GLYPH(224, 5),                     // 0x54 T
+      GLYPH(229, 5),                     // 0x55 U
+      GLYPH(234, 5),                     // 0x56 V
+      GLYPH(239, 5),                     // 0x57 W
+      GLYPH(244, 5),                     // 0x58 X
+      GLYPH(249, 5),                     // 0x59 Y
+      GLYPH(254, 5),                     // 0x5A Z
+      GLYPH(259, 3),                     // 0x5B [
+      GLYPH(262, 5),                     // 0x5C \ .
+      GLYPH(267, 3),                     // 0x5D ]
+      GLYPH(270, 5),                     // 0x5E ^
+      GLYPH(275, 5),                     // 0x5F _
+      GLYPH(280, 3),                     // 0x60 `
+      GLYPH(283, 5),                     // 0x61 a
+      GLYPH(288, 5),                     // 0x62 b
+      GLYPH(293, 5),                     // 0x63 c
+      GLYPH(298, 5),                     // 0x64 d
+      GLYPH(303, 5),                     // 0x65 e
+      GLYPH(308, 5),                     // 0x66 f
+      GLYPH(313, 5),                     // 0x67 g
+      GLYPH(318, 5),                     // 0x68 h
+      GLYPH(323, 3),                     // 0x69 i
+      GLYPH(326, 4),                     // 0x6A j
+      GLYPH(330, 4),                     // 0x6B k
+      GLYPH(334, 3),                     // 0x6C l
+      GLYPH(337, 5),                     // 0x6D m
+      GLYPH(342, 5),                     // 0x6E n
+      GLYPH(347, 5),                     // 0x6F o
+      GLYPH(352, 5),                     // 0x70 p
+      GLYPH(357, 5),                     // 0x71 q
+      GLYPH(362, 5),                     // 0x72 r
+      GLYPH(367, 5),                     // 0x73 s
+      GLYPH(372, 5),                     // 0x74 t
+      GLYPH(377, 5),                     // 0x75 u
+      GLYPH(382, 5),                     // 0x76 v
+      GLYPH(387, 5),                     // 0x77 w
+      GLYPH(392, 5),                     // 0x78 x
+      GLYPH(397, 5),                     // 0x79 y
+      GLYPH(402, 5),                     // 0x7A z
+      GLYPH(407, 3),                     // 0x7B {
+      GLYPH(410, 1),                     // 0x7C |
+      GLYPH(411, 3),                     // 0x7D }
+      GLYPH(414, 5),                     // 0x7E ~
+};
+
+/**
+ * 3x5 digits font glyph columns, bit 0 is the top row
+ */
+static const uint8_t font_3x5_columns[] ICACHE_STORE_ATTR ICACHE_RODATA_ATTR = {
+      0x04, 0x04,                        // 0x2D -
+      0x10,                              // 0x2E .
+      0x18, 0x04, 0x03,                  // 0x2F /
+      0x1F, 0x11, 0x1F,                  // 0x30 0
+      0x12, 0x1F, 0x10,                  // 0x31 1
+      0x1D, 0x15, 0x17,                  // 0x32 2
+      0x15, 0x15, 0x1F,                  // 0x33 3
+      0x07, 0x04, 0x1F,                  // 0x34 4
+      0x17, 0x15, 0x1D,                  // 0x35 5
+      0x1F, 0x15, 0x1D,                  // 0x36 6
+      0x01, 0x01, 0x1F,                  // 0x37 7
+      0x1F, 0x15, 0x1F,                  // 0x38 8
+      0x17, 0x15, 0x1F,                  // 0x39 9
+      0x0A,                              // 0x3A :
+};
+
+/**
+ * 3x5 digits font glyph table (column offset and width)
+ */
+static const uint32_t font_3x5_glyphs[] ICACHE_STORE_ATTR ICACHE_RODATA_ATTR = {
+      GLYPH(  0, 0),                     // 0x20
+      GLYPH(  0, 0),                     // 0x21 !
+      GLYPH(  0, 0),                     // 0x22 "
+      GLYPH(  0, 0),                     // 0x23 #
+      GLYPH(  0, 0),                     // 0x24 $
+      GLYPH(  0, 0),                     // 0x25 %
+      GLYPH(  0, 0),                     // 0x26 &
+      GLYPH(  0, 0),                     // 0x27 '
+      GLYPH(  0, 0),                     // 0x28 (
+      GLYPH(  0, 0),                     // 0x29 )
+      GLYPH(  0, 0),                     // 0x2A *
+      GLYPH(  0, 0),                     // 0x2B +
+      GLYPH(  0, 0),                     // 0x2C ,
+      GLYPH(  0, 2),                     // 0x2D -
+      GLYPH(  2, 1),                     // 0x2E .
+      GLYPH(  3, 3),                     // 0x2F /
+      GLYPH(  6, 3),                     // 0x30 0
+      GLYPH(  9, 3),                     // 0x31 1
+      GLYPH( 12, 3),                     // 0x32 2
+      GLYPH( 15, 3),                     // 0x33 3
+      GLYPH( 18, 3),                     // 0x34 4
+      GLYPH( 21, 3),                     // 0x35 5
+      GLYPH( 24, 3),                     // 0x36 6
+      GLYPH( 27, 3),                     // 0x37 7
+      GLYPH( 30, 3),                     // 0x38 8
+      GLYPH( 33, 3),                     // 0x39 9
+      GLYPH( 36, 1),                     // 0x3A :
+};
+
+/**
+ * Registered fonts
+ */
+static const font_t fonts[FONT_COUNT] ICACHE_STORE_ATTR ICACHE_RODATA_ATTR = {
+   { 6, 0x20, sizeof(font_4x6_glyphs) / sizeof(font_4x6_glyphs[0]), 1, 2, font_4x6_glyphs, font_4x6_columns },
+   { 7, 0x20, sizeof(font_5x7_glyphs) / sizeof(font_5x7_glyphs[0]), 1, 3, font_5x7_glyphs, font_5x7_columns },
+   { 5, 0x20, sizeof(font_3x5_glyphs) / sizeof(font_3x5_glyphs[0]), 1, 1, font_3x5_glyphs, font_3x5_columns }
+};
+
+/**
+ * Character redefined at runtime (FONT_4X6 only)
+ */
+typedef struct custom_glyph {
+   unsigned m_Code;                      //!< Character code
+   unsigned m_Width;                     //!< Glyph width
+   uint8_t  m_Columns[FONT_WIDTH];       //!< Glyph columns, bit 0 is the top row
+} custom_glyph_t;
+
+//! Redefined characters
+static custom_glyph_t custom_glyphs[FONT_CUSTOM_GLYPHS] ICACHE_STORE_ATTR;
+
+//! Number of redefined characters
+static unsigned custom_count = 0;
+
+/**
+ * Get a registered font
+ * @param id   font id (see font_id)
+ * @return     font descriptor or NULL if there is no such font
+ */
+const font_t *font_get(unsigned id) {
+   if (id >= FONT_COUNT)
+      return NULL;
+
+   return &fonts[id];
+}
+
+/**
+ * Look up a glyph. Characters not present in the font are blank.
+ * @param pFont    font descriptor
+ * @param code     character code
+ * @param pGlyph   glyph to be filled
+ */
+void font_get_glyph(const font_t *pFont, unsigned code, glyph_t *pGlyph) {
+   unsigned i, entry;
+
+   pGlyph->m_Columns = NULL;
+   pGlyph->m_Offset = 0;
+   pGlyph->m_Width = pFont->m_BlankWidth;
+
+   if (pFont == &fonts[FONT_4X6]) {
+      for (i = 0; i < custom_count; ++i) {
+         if (custom_glyphs[i].m_Code == code) {
+            if (custom_glyphs[i].m_Width) {
+               pGlyph->m_Columns = custom_glyphs[i].m_Columns;
+               pGlyph->m_Width = custom_glyphs[i].m_Width;
+            }
+            return;
+         }
+      }
+   }
+
+   if (code < pFont->m_First || code - pFont->m_First >= pFont->m_Count)
+      return;
+
+   entry = pFont->m_Glyphs[code - pFont->m_First];
+   if (entry & 0xFF) {
+      pGlyph->m_Columns = pFont->m_Columns;
+      pGlyph->m_Offset = entry >> 8;
+      pGlyph->m_Width = entry & 0xFF;
+   }
+}
+
+/**
+ * Read a single glyph column
+ * @param pGlyph   glyph
+ * @param column   column index [0; m_Width)
+ * @return         column bits, bit 0 is the top row
+ */
+unsigned font_get_column(const glyph_t *pGlyph, unsigned column) {
+   if (!pGlyph->m_Columns || column >= pGlyph->m_Width)
+      return 0;
+
+   // Flash only supports aligned 32-bit reads
+   return byte_of_aligned_array(pGlyph->m_Columns, pGlyph->m_Offset + column);
+}
+
+/**
+ * Redefine a FONT_4X6 character.
+ * @param code   character code
+ * @param mask   4x6 character mask (4 bits per line, see GET_LINE_0)
+ * @return       1 on success, 0 if there are too many redefined characters
+ */
+int font_set_glyph(unsigned code, uint32_t mask) {
+   unsigned lines[FONT_HEIGHT];
+   unsigned i, row, column, value;
+   custom_glyph_t *pCustom = NULL;
+
+   for (i = 0; i < custom_count; ++i) {
+      if (custom_glyphs[i].m_Code == code)
+         pCustom = &custom_glyphs[i];
+   }
+
+   if (!pCustom) {
+      if (custom_count == FONT_CUSTOM_GLYPHS)
+         return 0;
+
+      pCustom = &custom_glyphs[custom_count++];
+      pCustom->m_Code = code;
+   }
+
+   lines[0] = GET_LINE_0(mask);
+   lines[1] = GET_LINE_1(mask);
+   lines[2] = GET_LINE_2(mask);
+   lines[3] = GET_LINE_3(mask);
+   lines[4] = GET_LINE_4(mask);
+   lines[5] = GET_LINE_5(mask);
+
+   // Custom glyphs keep their leading columns, only the trailing ones are dropped
+   pCustom->m_Width = 0;
+   for (column = 0; column < FONT_WIDTH; ++column) {
+      value = 0;
+      for (row = 0; row < FONT_HEIGHT; ++row)
+         value |= ((lines[row] >> (FONT_WIDTH - 1 - column)) & 0x1) << row;
+
+      pCustom->m_Columns[column] = value;
+      if (value)
+         pCustom->m_Width = column + 1;
+   }
+
+   return 1;
+}
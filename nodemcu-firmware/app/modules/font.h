@@ -0,0 +1,73 @@
+/*
+ * font.h
+ *
+ * Bitmap fonts shared by the LED ticker and matrix modules
+ *
+ *  Created on: Feb 21, 2015
+ *      Author: yowidin
+ */
+
+#ifndef APP_MODULES_FONT_H_
+#define APP_MODULES_FONT_H_
+
+#include "c_types.h"
+
+#define GET_LINE_0(x) ((x) >> 20) & 0xF
+#define GET_LINE_1(x) ((x) >> 16) & 0xF
+#define GET_LINE_2(x) ((x) >> 12) & 0xF
+#define GET_LINE_3(x) ((x) >>  8) & 0xF
+#define GET_LINE_4(x) ((x) >>  4) & 0xF
+#define GET_LINE_5(x) ((x)      ) & 0xF
+
+//! Character mask glyph width (in columns, see font_set_glyph)
+#define FONT_WIDTH      4
+
+//! Character mask glyph height (in rows, see font_set_glyph)
+#define FONT_HEIGHT     6
+
+//! Maximal glyph height (a column is stored in a single byte)
+#define FONT_MAX_HEIGHT 8
+
+//! Number of characters which can be redefined at runtime
+#define FONT_CUSTOM_GLYPHS 8
+
+/**
+ * List of the registered fonts
+ */
+enum font_id {
+   FONT_4X6        = 0, //!< Proportional 4x6 font (default)
+   FONT_5X7        = 1, //!< Proportional 5x7 font
+   FONT_3X5_DIGITS = 2, //!< 3x5 digits, ' ', '-', '.', '/' and ':' only
+   FONT_COUNT
+};
+
+/**
+ * Font descriptor.
+ * Descriptors and glyph data live in flash, so every field is 32 bits wide
+ * and glyph columns are only accessed with aligned reads (see font_get_column).
+ */
+typedef struct font {
+   unsigned m_Height;         //!< Glyph height (in rows)
+   unsigned m_First;          //!< First character code
+   unsigned m_Count;          //!< Number of glyphs
+   unsigned m_Spacing;        //!< Empty columns after every glyph
+   unsigned m_BlankWidth;     //!< Width of space and missing glyphs
+   const uint32_t *m_Glyphs;  //!< Column offset and width of every glyph
+   const uint8_t  *m_Columns; //!< Glyph columns, bit 0 is the top row
+} font_t;
+
+/**
+ * A single glyph
+ */
+typedef struct glyph {
+   const uint8_t *m_Columns;  //!< Aligned column storage (NULL for blank glyphs)
+   unsigned m_Offset;         //!< First column offset within m_Columns
+   unsigned m_Width;          //!< Glyph width (in columns, without spacing)
+} glyph_t;
+
+const font_t *font_get(unsigned id);
+void     font_get_glyph(const font_t *pFont, unsigned code, glyph_t *pGlyph);
+unsigned font_get_column(const glyph_t *pGlyph, unsigned column);
+int      font_set_glyph(unsigned code, uint32_t mask);
+
+#endif /* APP_MODULES_FONT_H_ */
@@ -9,6 +9,7 @@
 
 #include "c_types.h"
 #include "c_string.h"
+#include "event.h"
 
 #define PULLUP PLATFORM_GPIO_PULLUP
 #define FLOAT PLATFORM_GPIO_FLOAT
@@ -20,6 +21,39 @@
 
 
 #ifdef GPIO_INTERRUPT_ENABLE
+#include "user_interface.h"
+
+// Edge ring length, has to be a power of two
+#define GPIO_EDGE_QUEUE_LEN   32
+
+// What the ISR does with an edge on a pin
+#define GPIO_EDGE_NONE        0
+#define GPIO_EDGE_LUA         1   // queue it for the Lua callback
+#define GPIO_EDGE_COUNT       2   // only count it, see gpio.counter()
+
+typedef struct
+{
+  uint8_t pin;
+  uint8_t level;
+  uint32_t time;
+} gpio_edge_t;
+
+// Single producer (ISR) / single consumer (Lua task) ring,
+// the ISR only moves the head, the task only moves the tail
+static gpio_edge_t gpio_edges[GPIO_EDGE_QUEUE_LEN];
+static volatile uint32_t gpio_edge_head = 0;
+static volatile uint32_t gpio_edge_tail = 0;
+
+static uint8_t gpio_edge_mode[GPIO_PIN_NUM];
+static uint32_t gpio_debounce[GPIO_PIN_NUM];      // us, 0 = off
+static uint32_t gpio_last_edge[GPIO_PIN_NUM];
+static volatile uint32_t gpio_count[GPIO_PIN_NUM];
+
+static uint32_t gpio_queued = 0;      // edges put into the ring
+static uint32_t gpio_max_depth = 0;   // highest ring depth seen
+static uint32_t gpio_overflow = 0;    // edges lost because the ring was full
+static uint32_t gpio_bounced = 0;     // edges inside a debounce window
+
 static int gpio_cb_ref[GPIO_PIN_NUM];
 static lua_State* gL = NULL;
 
@@ -29,49 +63,138 @@ void lua_gpio_unref(unsigned pin){
       luaL_unref(gL, LUA_REGISTRYINDEX, gpio_cb_ref[pin]);
   }
   gpio_cb_ref[pin] = LUA_NOREF;
+  gpio_edge_mode[pin] = GPIO_EDGE_NONE;
+}
+
+// runs in the Lua task, see event_dispatch()
+// drains the edge ring and calls every pin's callback once per run with
+// the latest level, its timestamp and the number of edges since the last call
+static void gpio_intr_event( unsigned id, uint32_t arg, void *data )
+{
+  uint16_t edges[GPIO_PIN_NUM];
+  uint8_t level[GPIO_PIN_NUM];
+  uint32_t when[GPIO_PIN_NUM];
+  uint32_t tail = gpio_edge_tail;
+  unsigned pin;
+
+  c_memset(edges, 0, sizeof(edges));
+  while(tail != gpio_edge_head){
+    gpio_edge_t *e = &gpio_edges[tail & (GPIO_EDGE_QUEUE_LEN - 1)];
+    edges[e->pin]++;
+    level[e->pin] = e->level;
+    when[e->pin] = e->time;
+    tail++;
+  }
+  gpio_edge_tail = tail;
+
+  if(gL){
+    for(pin = 0; pin < GPIO_PIN_NUM; pin++){
+      if(edges[pin] == 0 || gpio_cb_ref[pin] == LUA_NOREF)
+        continue;
+      lua_rawgeti(gL, LUA_REGISTRYINDEX, gpio_cb_ref[pin]);
+      lua_pushinteger(gL, level[pin]);
+      lua_pushinteger(gL, when[pin]);
+      lua_pushinteger(gL, edges[pin]);
+      lua_call(gL, 3, 0);
+    }
+  }
+
+  // the ISR leaves a level trigger off, it may fire again once Lua has seen it
+  platform_gpio_intr_rearm();
 }
 
+// runs in the GPIO ISR, Lua must not be called from here
 void gpio_intr_callback( unsigned pin, unsigned level )
 {
-  NODE_DBG("pin:%d, level:%d \n", pin, level);
-  if(gpio_cb_ref[pin] == LUA_NOREF)
+  uint32_t now, head;
+
+  if(gpio_edge_mode[pin] == GPIO_EDGE_NONE)
     return;
-  if(!gL)
+
+  now = 0x7FFFFFFF & system_get_time();
+  if(gpio_debounce[pin]){
+    if(((now - gpio_last_edge[pin]) & 0x7FFFFFFF) < gpio_debounce[pin]){
+      gpio_bounced++;
+      // a level trigger is re-armed by the task
+      if(pin_int_type[pin] == GPIO_PIN_INTR_LOLEVEL || pin_int_type[pin] == GPIO_PIN_INTR_HILEVEL)
+        event_post(EVENT_GPIO_TRIG, 0, 0, NULL);
+      return;
+    }
+    gpio_last_edge[pin] = now;
+  }
+
+  if(gpio_edge_mode[pin] == GPIO_EDGE_COUNT){
+    gpio_count[pin]++;
+    return;
+  }
+
+  head = gpio_edge_head;
+  if(head - gpio_edge_tail >= GPIO_EDGE_QUEUE_LEN){
+    gpio_overflow++;
     return;
-  lua_rawgeti(gL, LUA_REGISTRYINDEX, gpio_cb_ref[pin]);
-  lua_pushinteger(gL, level);
-  lua_call(gL, 1, 0);
+  }
+  gpio_edges[head & (GPIO_EDGE_QUEUE_LEN - 1)].pin = pin;
+  gpio_edges[head & (GPIO_EDGE_QUEUE_LEN - 1)].level = level;
+  gpio_edges[head & (GPIO_EDGE_QUEUE_LEN - 1)].time = now;
+  gpio_edge_head = head + 1;
+
+  gpio_queued++;
+  if(head + 1 - gpio_edge_tail > gpio_max_depth)
+    gpio_max_depth = head + 1 - gpio_edge_tail;
+  // a single pending event is enough, it drains the whole ring
+  event_post(EVENT_GPIO_TRIG, 0, 0, NULL);
 }
 
-// Lua: trig( pin, type, function )
-static int lgpio_trig( lua_State* L )
+// parse the trigger type argument
+static unsigned gpio_trig_type( lua_State* L, int index )
 {
-  unsigned type;
-  unsigned pin;
   size_t sl;
-  
-  pin = luaL_checkinteger( L, 1 );
-  MOD_CHECK_ID( gpio, pin );
-  if(pin==0)
-    return luaL_error( L, "no interrupt for D0" );
-
-  const char *str = luaL_checklstring( L, 2, &sl );
+  const char *str = luaL_checklstring( L, index, &sl );
   if (str == NULL)
     return luaL_error( L, "wrong arg type" );
 
   if(sl == 2 && c_strcmp(str, "up") == 0){
-    type = GPIO_PIN_INTR_POSEDGE;
+    return GPIO_PIN_INTR_POSEDGE;
   }else if(sl == 4 && c_strcmp(str, "down") == 0){
-    type = GPIO_PIN_INTR_NEGEDGE;
+    return GPIO_PIN_INTR_NEGEDGE;
   }else if(sl == 4 && c_strcmp(str, "both") == 0){
-    type = GPIO_PIN_INTR_ANYEGDE;
+    return GPIO_PIN_INTR_ANYEGDE;
   }else if(sl == 3 && c_strcmp(str, "low") == 0){
-    type = GPIO_PIN_INTR_LOLEVEL;
+    return GPIO_PIN_INTR_LOLEVEL;
   }else if(sl == 4 && c_strcmp(str, "high") == 0){
-    type = GPIO_PIN_INTR_HILEVEL;
-  }else{
-    type = GPIO_PIN_INTR_DISABLE;
+    return GPIO_PIN_INTR_HILEVEL;
   }
+  return GPIO_PIN_INTR_DISABLE;
+}
+
+// set the edge mode and debounce window of a pin with its interrupt off
+static void gpio_edge_setup( unsigned pin, unsigned mode, uint32_t debounce )
+{
+  platform_gpio_intr_init(pin, GPIO_PIN_INTR_DISABLE);
+  gpio_edge_mode[pin] = mode;
+  gpio_debounce[pin] = debounce;
+  gpio_last_edge[pin] = (0x7FFFFFFF & system_get_time()) - debounce;
+  gpio_count[pin] = 0;
+}
+
+// Lua: trig( pin, type, function [, debounce] )
+// function( level, time, edges ) gets the latest level, its system time in us
+// and the number of edges since the previous call. A "low" or "high" trigger
+// is off from its interrupt until the callback has returned.
+static int lgpio_trig( lua_State* L )
+{
+  unsigned type;
+  unsigned pin;
+  uint32_t debounce = 0;
+  
+  pin = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( gpio, pin );
+  if(pin==0)
+    return luaL_error( L, "no interrupt for D0" );
+
+  type = gpio_trig_type( L, 2 );
+  if(lua_isnumber(L, 4))
+    debounce = lua_tointeger( L, 4 );
 
   // luaL_checkanyfunction(L, 3);
   if (lua_type(L, 3) == LUA_TFUNCTION || lua_type(L, 3) == LUA_TLIGHTFUNCTION){
@@ -81,9 +204,68 @@ static int lgpio_trig( lua_State* L )
     gpio_cb_ref[pin] = luaL_ref(L, LUA_REGISTRYINDEX);
   }
 
+  gpio_edge_setup(pin, gpio_cb_ref[pin] != LUA_NOREF ? GPIO_EDGE_LUA : GPIO_EDGE_NONE, debounce);
   platform_gpio_intr_init(pin, type);
   return 0;  
 }
+
+// Lua: counter( pin, type [, debounce] )
+// counts edges in the ISR without waking Lua, read them with gpio.count()
+static int lgpio_counter( lua_State* L )
+{
+  unsigned type;
+  unsigned pin;
+  uint32_t debounce = 0;
+
+  pin = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( gpio, pin );
+  if(pin==0)
+    return luaL_error( L, "no interrupt for D0" );
+
+  type = gpio_trig_type( L, 2 );
+  // counting doesn't wake the task that re-arms a level trigger
+  if(type == GPIO_PIN_INTR_LOLEVEL || type == GPIO_PIN_INTR_HILEVEL)
+    return luaL_error( L, "level can't be counted" );
+  if(lua_isnumber(L, 3))
+    debounce = lua_tointeger( L, 3 );
+
+  if(gpio_cb_ref[pin] != LUA_NOREF)
+    luaL_unref(L, LUA_REGISTRYINDEX, gpio_cb_ref[pin]);
+  gpio_cb_ref[pin] = LUA_NOREF;
+
+  gpio_edge_setup(pin, GPIO_EDGE_COUNT, debounce);
+  platform_gpio_intr_init(pin, type);
+  return 0;
+}
+
+// Lua: count = count( pin [, reset] )
+static int lgpio_count( lua_State* L )
+{
+  unsigned pin;
+  uint32_t count;
+
+  pin = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( gpio, pin );
+
+  ETS_GPIO_INTR_DISABLE();
+  count = gpio_count[pin];
+  if(lua_toboolean(L, 2))
+    gpio_count[pin] = 0;
+  ETS_GPIO_INTR_ENABLE();
+
+  lua_pushinteger( L, count );
+  return 1;
+}
+
+// Lua: queued, maxdepth, overflow, bounced = stats()
+static int lgpio_stats( lua_State* L )
+{
+  lua_pushinteger( L, gpio_queued );
+  lua_pushinteger( L, gpio_max_depth );
+  lua_pushinteger( L, gpio_overflow );
+  lua_pushinteger( L, gpio_bounced );
+  return 4;
+}
 #endif
 
 // Lua: mode( pin, mode, pullup )
@@ -110,6 +292,7 @@ static int lgpio_mode( lua_State* L )
       luaL_unref(L, LUA_REGISTRYINDEX, gpio_cb_ref[pin]);
     }
     gpio_cb_ref[pin] = LUA_NOREF;
+    gpio_edge_mode[pin] = GPIO_EDGE_NONE;
   }
 #endif
   int r = platform_gpio_mode( pin, mode, pullup );
@@ -151,23 +334,28 @@ static int lgpio_write( lua_State* L )
 #include "lrodefs.h"
 const LUA_REG_TYPE gpio_map[] = 
 {
-  { LSTRKEY( "mode" ), LFUNCVAL( lgpio_mode ) },
-  { LSTRKEY( "read" ), LFUNCVAL( lgpio_read ) },
-  { LSTRKEY( "write" ), LFUNCVAL( lgpio_write ) },
-#ifdef GPIO_INTERRUPT_ENABLE
-  { LSTRKEY( "trig" ), LFUNCVAL( lgpio_trig ) },
-#endif
 #if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "FLOAT" ), LNUMVAL( FLOAT ) },
+  { LSTRKEY( "HIGH" ), LNUMVAL( HIGH ) },
+  { LSTRKEY( "INPUT" ), LNUMVAL( INPUT ) },
 #ifdef GPIO_INTERRUPT_ENABLE
   { LSTRKEY( "INT" ), LNUMVAL( INTERRUPT ) },
 #endif
-  { LSTRKEY( "OUTPUT" ), LNUMVAL( OUTPUT ) },
-  { LSTRKEY( "INPUT" ), LNUMVAL( INPUT ) },
-  { LSTRKEY( "HIGH" ), LNUMVAL( HIGH ) },
   { LSTRKEY( "LOW" ), LNUMVAL( LOW ) },
-  { LSTRKEY( "FLOAT" ), LNUMVAL( FLOAT ) },
+  { LSTRKEY( "OUTPUT" ), LNUMVAL( OUTPUT ) },
   { LSTRKEY( "PULLUP" ), LNUMVAL( PULLUP ) },
 #endif
+#ifdef GPIO_INTERRUPT_ENABLE
+  { LSTRKEY( "count" ), LFUNCVAL( lgpio_count ) },
+  { LSTRKEY( "counter" ), LFUNCVAL( lgpio_counter ) },
+#endif
+  { LSTRKEY( "mode" ), LFUNCVAL( lgpio_mode ) },
+  { LSTRKEY( "read" ), LFUNCVAL( lgpio_read ) },
+#ifdef GPIO_INTERRUPT_ENABLE
+  { LSTRKEY( "stats" ), LFUNCVAL( lgpio_stats ) },
+  { LSTRKEY( "trig" ), LFUNCVAL( lgpio_trig ) },
+#endif
+  { LSTRKEY( "write" ), LFUNCVAL( lgpio_write ) },
   { LNILKEY, LNILVAL }
 };
 
@@ -177,7 +365,9 @@ LUALIB_API int luaopen_gpio( lua_State *L )
   int i;
   for(i=0;i<GPIO_PIN_NUM;i++){
     gpio_cb_ref[i] = LUA_NOREF;
+    gpio_edge_mode[i] = GPIO_EDGE_NONE;
   }
+  event_register(EVENT_GPIO_TRIG, gpio_intr_event, EVENT_COALESCE);
   platform_gpio_init(gpio_intr_callback);
 #endif
 
@@ -147,18 +147,18 @@ static int i2c_read( lua_State *L )
 #include "lrodefs.h"
 const LUA_REG_TYPE i2c_map[] = 
 {
-  { LSTRKEY( "setup" ),  LFUNCVAL( i2c_setup ) },
-  { LSTRKEY( "start" ), LFUNCVAL( i2c_start ) },
-  { LSTRKEY( "stop" ), LFUNCVAL( i2c_stop ) },
-  { LSTRKEY( "address" ), LFUNCVAL( i2c_address ) },
-  { LSTRKEY( "write" ), LFUNCVAL( i2c_write ) },
-  { LSTRKEY( "read" ), LFUNCVAL( i2c_read ) },
 #if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "RECEIVER" ), LNUMVAL( PLATFORM_I2C_DIRECTION_RECEIVER ) },
   // { LSTRKEY( "FAST" ), LNUMVAL( PLATFORM_I2C_SPEED_FAST ) },
   { LSTRKEY( "SLOW" ), LNUMVAL( PLATFORM_I2C_SPEED_SLOW ) },
   { LSTRKEY( "TRANSMITTER" ), LNUMVAL( PLATFORM_I2C_DIRECTION_TRANSMITTER ) },
-  { LSTRKEY( "RECEIVER" ), LNUMVAL( PLATFORM_I2C_DIRECTION_RECEIVER ) },
 #endif
+  { LSTRKEY( "address" ), LFUNCVAL( i2c_address ) },
+  { LSTRKEY( "read" ), LFUNCVAL( i2c_read ) },
+  { LSTRKEY( "setup" ),  LFUNCVAL( i2c_setup ) },
+  { LSTRKEY( "start" ), LFUNCVAL( i2c_start ) },
+  { LSTRKEY( "stop" ), LFUNCVAL( i2c_stop ) },
+  { LSTRKEY( "write" ), LFUNCVAL( i2c_write ) },
   { LNILKEY, LNILVAL }
 };
 
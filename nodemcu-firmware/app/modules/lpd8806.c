@@ -13,6 +13,18 @@
 //! SPI Bit-bang delay
 #define DELAY_US    1
 
+//! HSPI MOSI pin index (GPIO13)
+#define HSPI_MOSI   7
+
+//! HSPI CLK pin index (GPIO14)
+#define HSPI_CLK    5
+
+//! Hardware SPI module used for the strip output
+#define HSPI_ID     1
+
+//! Number of latch bytes following the LED data
+#define LATCH_LENGTH(length) ((((length) + 31) / 32) * 3)
+
 /**
  * List of the supported SPI modes, where
  * CPOL - Clock Polarity
@@ -25,6 +37,14 @@ enum spi_mode {
    CPOL1_CPHA1 = 3  //!< CPOL = 1, CPHA = 1
 };
 
+/**
+ * List of the supported output transports
+ */
+enum lpd_transport {
+   TRANSPORT_BITBANG = 0, //!< GPIO bit-bang, interrupts are locked during the update
+   TRANSPORT_HSPI    = 1  //!< HSPI peripheral, interrupts stay enabled between bursts
+};
+
 /**
  * Gamma correction table.
  * Since the LPD8806 strip is only able to represent 7-bit colors
@@ -99,26 +119,61 @@ static void transfer_byte(unsigned mosi, unsigned clk, uint8_t byte, unsigned de
    }
 }
 
+/**
+ * Mark a given LED as changed since the last update.
+ * @param pData an LED Strip object
+ * @param index index of the changed LED
+ */
+static void mark_dirty(lpd_userdata *pData, unsigned index) {
+   if (index >= pData->m_DirtyLength)
+      pData->m_DirtyLength = index + 1;
+}
+
 /**
  * Update a given LED strip.
  * i.e. push cached LED's state into LED strip
+ *
+ * Nothing is sent if the cache did not change since the last update.
+ * Otherwise only the LEDs up to the last changed one are shifted in,
+ * the LEDs behind it keep their state.
+ *
  * @param pData an LED Strip object
+ * @param force push the whole cache even if nothing changed
  */
-void update(lpd_userdata *pData) {
-   uint16_t length = pData->m_Length * 3;
-   uint16_t latch = ((pData->m_Length + 31) / 32) * 3;
+void update(lpd_userdata *pData, unsigned force) {
+   if (force)
+      pData->m_DirtyLength = pData->m_Length;
+
+   if (!pData->m_DirtyLength) {
+      ++pData->m_Skipped;
+      return;
+   }
+
+   uint16_t length = pData->m_DirtyLength * 3;
+   uint16_t latch = LATCH_LENGTH(pData->m_DirtyLength);
+   // Output buffer is followed by the (always zero) latch bytes
+   const uint8_t *pLatch = pData->m_OutputBuffer + pData->m_Length * 3;
    unsigned mosi = pData->m_Mosi;
    unsigned clk = pData->m_Clk;
    unsigned delay = pData->m_Delay;
    unsigned type = pData->m_Type;
    uint16_t i;
 
+   pData->m_DirtyLength = 0;
+   ++pData->m_Updates;
+
+   if (pData->m_Transport == TRANSPORT_HSPI) {
+      platform_spi_blk_write(HSPI_ID, pData->m_OutputBuffer, length);
+      platform_spi_blk_write(HSPI_ID, pLatch, latch);
+      return;
+   }
+
    os_intr_lock();
    for (i = 0; i < length; ++i)
       transfer_byte(mosi, clk, pData->m_OutputBuffer[i], delay, type);
 
    for (i = 0; i < latch; ++i)
-      transfer_byte(mosi, clk, 0, delay, type);
+      transfer_byte(mosi, clk, pLatch[i], delay, type);
    os_intr_unlock();
 }
 
@@ -133,15 +188,96 @@ void update(lpd_userdata *pData) {
  * @param b     B color component
  */
 void set_color(lpd_userdata *pData, unsigned index, unsigned r, unsigned g, unsigned b) {
+   uint8_t value[3];
+   uint8_t *pDest;
+
    index = index % pData->m_Length;
+   pDest = pData->m_OutputBuffer + 3 * index;
+
+   encode_color(value, r, g, b);
+   if (pDest[0] == value[0] && pDest[1] == value[1] && pDest[2] == value[2])
+      return;
+
+   pDest[0] = value[0];
+   pDest[1] = value[1];
+   pDest[2] = value[2];
+   mark_dirty(pData, index);
+}
+
+/**
+ * Convert an RGB value into the strip's native format.
+ * i.e. gamma corrected G, R, B 7-bit values with the MSB set.
+ *
+ * @param pDest destination buffer (3 bytes)
+ * @param r     R color component
+ * @param g     G color component
+ * @param b     B color component
+ */
+void encode_color(uint8_t *pDest, unsigned r, unsigned g, unsigned b) {
+   pDest[0] = gammaTable[g & 0xFF] | 0x80;
+   pDest[1] = gammaTable[r & 0xFF] | 0x80;
+   pDest[2] = gammaTable[b & 0xFF] | 0x80;
+}
+
+/**
+ * Copy already encoded LED values into a given LED strip's cache.
+ * Values are expected in the strip's native format (see encode_color),
+ * LEDs past the end of the strip are ignored.
+ *
+ * @param pData     an LED Strip object
+ * @param index     index of the first LED to be changed
+ * @param pSource   encoded values (3 bytes per LED)
+ * @param count     number of LEDs to be changed
+ */
+void set_raw(lpd_userdata *pData, unsigned index, const uint8_t *pSource, unsigned count) {
+   if (index >= pData->m_Length)
+      return;
+
+   if (count > pData->m_Length - index)
+      count = pData->m_Length - index;
+
+   if (!count || c_memcmp(pData->m_OutputBuffer + 3 * index, pSource, 3 * count) == 0)
+      return;
+
+   c_memcpy(pData->m_OutputBuffer + 3 * index, pSource, 3 * count);
+   mark_dirty(pData, index + count - 1);
+}
 
-   unsigned rn = gammaTable[r];
-   unsigned gn = gammaTable[g];
-   unsigned bn = gammaTable[b];
+/**
+ * Update a continuous range of LEDs of a given LED strip from packed
+ * R, G, B byte triplets. LEDs past the end of the strip are ignored.
+ *
+ * @param pData     an LED Strip object
+ * @param index     index of the first LED to be changed
+ * @param pSource   packed R, G, B values (3 bytes per LED)
+ * @param count     number of LEDs to be changed
+ */
+void set_colors(lpd_userdata *pData, unsigned index, const uint8_t *pSource, unsigned count) {
+   unsigned i, changed = 0;
+   uint8_t r, g, b, *pDest;
+
+   if (index >= pData->m_Length)
+      return;
+
+   if (count > pData->m_Length - index)
+      count = pData->m_Length - index;
+
+   pDest = pData->m_OutputBuffer + 3 * index;
+   for (i = 0; i < count; ++i, pDest += 3, pSource += 3) {
+      g = gammaTable[pSource[1]] | 0x80;
+      r = gammaTable[pSource[0]] | 0x80;
+      b = gammaTable[pSource[2]] | 0x80;
+
+      if (pDest[0] != g || pDest[1] != r || pDest[2] != b) {
+         pDest[0] = g;
+         pDest[1] = r;
+         pDest[2] = b;
+         changed = i + 1;
+      }
+   }
 
-   pData->m_OutputBuffer[3 * index + 0] = gn | 0x80;
-   pData->m_OutputBuffer[3 * index + 1] = rn | 0x80;
-   pData->m_OutputBuffer[3 * index + 2] = bn | 0x80;
+   if (changed)
+      mark_dirty(pData, index + changed - 1);
 }
 
 /**
@@ -157,18 +293,9 @@ void set_color(lpd_userdata *pData, unsigned index, unsigned r, unsigned g, unsi
 void set_color_n(lpd_userdata *pData, unsigned length, unsigned *indices,
                         unsigned *r, unsigned *g, unsigned *b)
 {
-   unsigned i, index, rn, gn, bn;
-   for (i = 0; i < length; ++i) {
-      index = indices[i] % pData->m_Length;
-
-      rn = gammaTable[r[i]];
-      gn = gammaTable[g[i]];
-      bn = gammaTable[b[i]];
-
-      pData->m_OutputBuffer[3 * index + 0] = gn | 0x80;
-      pData->m_OutputBuffer[3 * index + 1] = rn | 0x80;
-      pData->m_OutputBuffer[3 * index + 2] = bn | 0x80;
-   }
+   unsigned i;
+   for (i = 0; i < length; ++i)
+      set_color(pData, indices[i], r[i], g[i], b[i]);
 }
 
 /**
@@ -190,7 +317,8 @@ void clear(lpd_userdata *pData, unsigned r, unsigned g, unsigned b) {
  * Setup an LED strip
  * @param   L   Lua Sate
  * @return      Number of return parameters on stack (always 1)
- * @example     Lua: lpd = lpd8806.setup(mosi, clk, length [, type, delay])
+ * @example     Lua: lpd = lpd8806.setup(mosi, clk, length [, type, delay, transport])
+ * @example     Lua: lpd = lpd8806.setup(7, 5, 60, 0, 0, lpd8806.HSPI)
  */
 static int lpd_setup(lua_State *L) {
    unsigned mosi;
@@ -198,6 +326,7 @@ static int lpd_setup(lua_State *L) {
    unsigned length;
    unsigned type = 0;
    unsigned delay = 2;
+   unsigned transport = TRANSPORT_BITBANG;
    int result;
    lpd_userdata *pData = NULL;
 
@@ -210,17 +339,33 @@ static int lpd_setup(lua_State *L) {
 
    if (lua_isnumber(L, 4)) type  = lua_tointeger(L, 4);
    if (lua_isnumber(L, 5)) delay = lua_tointeger(L, 5);
+   if (lua_isnumber(L, 6)) transport = lua_tointeger(L, 6);
 
    MOD_CHECK_ID(gpio, mosi);
    MOD_CHECK_ID(gpio, clk);
 
-   result = platform_gpio_mode(mosi, PLATFORM_GPIO_OUTPUT, PLATFORM_GPIO_FLOAT);
-   if (result < 0)
-      return luaL_error(L, "Invalid MOSI pin.");
+   if (transport == TRANSPORT_HSPI) {
+      // HSPI pins are fixed
+      if (mosi != HSPI_MOSI || clk != HSPI_CLK)
+         return luaL_error(L, "HSPI requires MOSI=%d and CLK=%d.", HSPI_MOSI, HSPI_CLK);
 
-   result = platform_gpio_mode(clk, PLATFORM_GPIO_OUTPUT, PLATFORM_GPIO_FLOAT);
-   if (result < 0)
-      return luaL_error(L, "Invalid CLK pin.");
+      platform_spi_setup(HSPI_ID, PLATFORM_SPI_MASTER,
+                         (type == CPOL1_CPHA0 || type == CPOL1_CPHA1) ? PLATFORM_SPI_CPOL_HIGH : PLATFORM_SPI_CPOL_LOW,
+                         (type == CPOL0_CPHA1 || type == CPOL1_CPHA1) ? PLATFORM_SPI_CPHA_HIGH : PLATFORM_SPI_CPHA_LOW,
+                         PLATFORM_SPI_DATABITS_8, 0);
+   }
+   else
+   if (transport == TRANSPORT_BITBANG) {
+      result = platform_gpio_mode(mosi, PLATFORM_GPIO_OUTPUT, PLATFORM_GPIO_FLOAT);
+      if (result < 0)
+         return luaL_error(L, "Invalid MOSI pin.");
+
+      result = platform_gpio_mode(clk, PLATFORM_GPIO_OUTPUT, PLATFORM_GPIO_FLOAT);
+      if (result < 0)
+         return luaL_error(L, "Invalid CLK pin.");
+   }
+   else
+      return luaL_error(L, "Invalid transport.");
 
    // create an object
    pData = (lpd_userdata *)lua_newuserdata(L, sizeof(lpd_userdata));
@@ -234,8 +379,13 @@ static int lpd_setup(lua_State *L) {
    pData->m_OutputBuffer = NULL;
    pData->m_Type    = type;
    pData->m_Delay   = delay;
+   pData->m_Transport = transport;
+   pData->m_DirtyLength = 0;
+   pData->m_Updates = 0;
+   pData->m_Skipped = 0;
 
-   pData->m_OutputBuffer = c_zalloc(sizeof(uint8_t) * pData->m_Length * 3);
+   // LED data is followed by the latch bytes, so the whole buffer can be sent at once
+   pData->m_OutputBuffer = c_zalloc(sizeof(uint8_t) * (pData->m_Length * 3 + LATCH_LENGTH(pData->m_Length)));
    if (!pData->m_OutputBuffer)
       return luaL_error(L, "Out of memory (data).");
 
@@ -244,8 +394,8 @@ static int lpd_setup(lua_State *L) {
    lua_setmetatable(L, -2);
 
    // Bring strip into predictable state (cases single flash)
-   // clear(pData, 255, 255, 255); update(pData);
-   clear(pData,   0,   0,   0); update(pData);
+   // clear(pData, 255, 255, 255); update(pData, 1);
+   clear(pData,   0,   0,   0); update(pData, 1);
 
    NODE_DBG("LPD8806: Init info: MOSI=%d, CLK=%d, Length=%d\r\n", pData->m_Mosi, pData->m_Clk, pData->m_Length);
    return 1;
@@ -326,11 +476,45 @@ static int lpd_set_color(lua_State *L) {
    return 0;
 }
 
+/**
+ * Update a continuous range of LEDs of a given LED strip.
+ * i.e. write new RGB values into strip's cache.
+ *
+ * Colors are passed as a single string of R, G, B byte triplets,
+ * an incomplete trailing triplet is ignored.
+ *
+ * @param   L   Lua Sate
+ * @return      Number of return parameters on stack (always 0)
+ * @example     Lua: = lpd.set_colors(string.char(255, 0, 0, 0, 255, 0))
+ *                     lpd.set_colors(string.char(0, 0, 255):rep(10), 20)
+ */
+static int lpd_set_colors(lua_State *L) {
+   size_t length;
+   unsigned index = 0;
+   lpd_userdata *pData = NULL;
+   const char *pColors;
+
+   pData = (lpd_userdata *)luaL_checkudata(L, 1, "lpd8806.lpd");
+   luaL_argcheck(L, pData, 1, "lpd8806.lpd expected");
+   if(!pData) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   pColors = luaL_checklstring(L, 2, &length);
+   if (lua_isnumber(L, 3)) index = lua_tointeger(L, 3);
+
+   set_colors(pData, index, (const uint8_t *)pColors, length / 3);
+
+   return 0;
+}
+
 /**
  * Update a given LED strip. i.e. push cached LED's state into LED strip
+ * The update is skipped if nothing changed, unless forced.
  * @param   L   Lua Sate
  * @return      Number of return parameters on stack (always 0)
- * @example     Lua: = lpd.update()
+ * @example     Lua: = lpd.update([force])
  */
 static int lpd_update(lua_State *L) {
    lpd_userdata *pData = (lpd_userdata *)luaL_checkudata(L, 1, "lpd8806.lpd");
@@ -340,11 +524,29 @@ static int lpd_update(lua_State *L) {
       return 0;
    }
 
-   update(pData);
+   update(pData, lua_toboolean(L, 2));
 
    return 0;
 }
 
+/**
+ * Returns update statistics of a given LED strip
+ * @param   L   Lua state
+ * @return      Number of performed and skipped updates
+ * @example     Lua: performed, skipped = lpd.get_stats()
+ */
+static int lpd_get_stats(lua_State *L) {
+   lpd_userdata *pData = (lpd_userdata *)luaL_checkudata(L, 1, "lpd8806.lpd");
+   luaL_argcheck(L, pData, 1, "lpd8806.lpd expected");
+   if(!pData) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+   lua_pushinteger(L, pData->m_Updates);
+   lua_pushinteger(L, pData->m_Skipped);
+   return 2;
+}
+
 /**
  * Clear a given LED strip
  * @param   L   Lua State
@@ -367,7 +569,7 @@ static int lpd_clear(lua_State *L) {
    if (lua_isnumber(L, 4)) b = lua_tointeger(L, 4);
 
    clear(pData, r, g, b);
-   update(pData);
+   update(pData, 0);
 
    return 0;
 }
@@ -422,14 +624,16 @@ static int lpd_destroy(lua_State *L) {
  * LPD object functions
  */
 static const LUA_REG_TYPE lpd_map[] = {
-  { LSTRKEY("set_color"),     LFUNCVAL(lpd_set_color) },
-  { LSTRKEY("update"),        LFUNCVAL(lpd_update) },
-  { LSTRKEY("clear"),         LFUNCVAL(lpd_clear) },
-  { LSTRKEY("get_length"),    LFUNCVAL(lpd_get_length) },
   { LSTRKEY("__gc"),          LFUNCVAL(lpd_destroy) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY("__index"),       LROVAL(lpd_map) },
 #endif
+  { LSTRKEY("clear"),         LFUNCVAL(lpd_clear) },
+  { LSTRKEY("get_length"),    LFUNCVAL(lpd_get_length) },
+  { LSTRKEY("get_stats"),     LFUNCVAL(lpd_get_stats) },
+  { LSTRKEY("set_color"),     LFUNCVAL(lpd_set_color) },
+  { LSTRKEY("set_colors"),    LFUNCVAL(lpd_set_colors) },
+  { LSTRKEY("update"),        LFUNCVAL(lpd_update) },
   { LNILKEY, LNILVAL }
 };
 
@@ -437,10 +641,12 @@ static const LUA_REG_TYPE lpd_map[] = {
  * LPD Namespace functions
  */
 const LUA_REG_TYPE lpd8806_map[] = {
-  { LSTRKEY("setup"),         LFUNCVAL(lpd_setup) },
 #if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY("BITBANG"),       LNUMVAL(TRANSPORT_BITBANG) },
+  { LSTRKEY("HSPI"),          LNUMVAL(TRANSPORT_HSPI) },
   { LSTRKEY("__metatable"),   LROVAL(lpd8806_map) },
 #endif
+  { LSTRKEY("setup"),         LFUNCVAL(lpd_setup) },
   { LNILKEY, LNILVAL }
 };
 
@@ -459,6 +665,10 @@ LUALIB_API int luaopen_lpd8806(lua_State *L) {
    lua_pushvalue(L, -1);
    lua_setmetatable(L, -2);
 
+   // Module constants
+   MOD_REG_NUMBER(L, "BITBANG", TRANSPORT_BITBANG);
+   MOD_REG_NUMBER(L, "HSPI", TRANSPORT_HSPI);
+
    // create metatable
    luaL_newmetatable(L, "lpd8806.lpd");
    // metatable.__index = metatable
@@ -20,10 +20,20 @@ typedef struct lpd_userdata {
    unsigned m_Length;       //!< Length of the LED strip
    unsigned m_Type;         //!< SPI Transfer type
    unsigned m_Delay;        //!< SPI bit-bang delay
+   unsigned m_Transport;    //!< Output transport (bit-bang or hardware SPI)
+   unsigned m_DirtyLength;  //!< Number of LEDs (from the strip start) changed since the last update
+   unsigned m_Updates;      //!< Number of performed updates
+   unsigned m_Skipped;      //!< Number of skipped updates (nothing changed)
 } lpd_userdata;
 
-void update(lpd_userdata *pData);
+//! Gamma correction table (8-bit color into 7-bit LPD8806 value)
+extern const uint8_t gammaTable[];
+
+void update(lpd_userdata *pData, unsigned force);
+void encode_color(uint8_t *pDest, unsigned r, unsigned g, unsigned b);
 void set_color(lpd_userdata *pData, unsigned index, unsigned r, unsigned g, unsigned b);
+void set_raw(lpd_userdata *pData, unsigned index, const uint8_t *pSource, unsigned count);
+void set_colors(lpd_userdata *pData, unsigned index, const uint8_t *pSource, unsigned count);
 void set_color_n(lpd_userdata *pData, unsigned length, unsigned *indices,
                  unsigned *r, unsigned *g, unsigned *b);
 void clear(lpd_userdata *pData, unsigned r, unsigned g, unsigned b);
@@ -8,212 +8,124 @@
 #include "lualib.h"
 #include "lauxlib.h"
 #include "lpd8806.h"
+#include "matrix.h"
+#include "font.h"
+#include "event.h"
 #include "platform.h"
 #include "auxmods.h"
 #include "lrotable.h"
 #include "c_string.h"
 #include "c_stdlib.h"
 
-#define GET_LINE_0(x) ((x) >> 20) & 0xF
-#define GET_LINE_1(x) ((x) >> 16) & 0xF
-#define GET_LINE_2(x) ((x) >> 12) & 0xF
-#define GET_LINE_3(x) ((x) >>  8) & 0xF
-#define GET_LINE_4(x) ((x) >>  4) & 0xF
-#define GET_LINE_5(x) ((x)      ) & 0xF
-
-//! Number of rows in ticker
+//! Number of rows of the default (plain LED strip) layout
 #define NUM_ROWS    6
 
-//! Number of columns in ticker
+//! Number of columns of the default (plain LED strip) layout
 #define NUM_COLS    10
 
-//! Global Lua state - used to handle callback functions
-static lua_State *g_pLua = NULL;
-
-/**
- * Font ASCII table.
- * Each entry represents a single 4x6 character (4 bits per line)
- */
-uint32_t ascii_table[] = {
-      0,        // 0x00
-      0,        // 0x01
-      0,        // 0x02
-      0,        // 0x03
-      0,        // 0x04
-      0,        // 0x05
-      0,        // 0x06
-      0,        // 0x07
-      0,        // 0x08
-      0,        // 0x09
-      0,        // 0x0A
-      0,        // 0x0B
-      0,        // 0x0C
-      0,        // 0x0D
-      0,        // 0x0E
-      0,        // 0x0F
-      0,        // 0x10
-      0,        // 0x11
-      0,        // 0x12
-      0,        // 0x13
-      0,        // 0x14
-      0,        // 0x15
-      0,        // 0x16
-      0,        // 0x17
-      0,        // 0x18
-      0,        // 0x19
-      0,        // 0x1A
-      0,        // 0x1B
-      0,        // 0x1C
-      0,        // 0x1D
-      0,        // 0x1E
-      0,        // 0x1F
-      0,        // 0x20
-      2236448,  // 0x21 !
-      5570560,  // 0x22 "
-      5723984,  // 0x23 #
-      2319202,  // 0x24 $
-      4269072,  // 0x25 %
-      2438512,  // 0x26 &
-      6553600,  // 0x27 '
-      2376736,  // 0x28 (
-      4334144,  // 0x29 )
-      5403216,  // 0x2A *
-      160256,   // 0x2B +
-      50,       // 0x2C ,
-      28672,    // 0x2D -
-      32,       // 0x2E .
-      1123392,  // 0x2F /
-      3495264,  // 0x30 0
-      2499184,  // 0x31 1
-      6366320,  // 0x32 2
-      6365536,  // 0x33 3
-      1405200,  // 0x34 4
-      7627104,  // 0x35 5
-      2385184,  // 0x36 6
-      7414304,  // 0x37 7
-      2434336,  // 0x38 8
-      2437408,  // 0x39 9
-      8224,     // 0x3A :
-      8292,     // 0x3B ;
-      1196560,  // 0x3C <
-      28784,    // 0x3D =
-      4330048,  // 0x3E >
-      6365216,  // 0x3F ?
-      7689328,  // 0x40 @
-      2454864,  // 0x41 A
-      6645088,  // 0x42 B
-      3425328,  // 0x43 C
-      6640992,  // 0x44 D
-      7627888,  // 0x45 E
-      7627840,  // 0x46 F
-      3429680,  // 0x47 G
-      5600592,  // 0x48 H
-      7479920,  // 0x49 I
-      1119520,  // 0x4A J
-      5596496,  // 0x4B K
-      4473968,  // 0x4C L
-      5731664,  // 0x4D M
-      5723472,  // 0x4E N
-      2446624,  // 0x4F O
-      6644800,  // 0x50 P
-      2446640,  // 0x51 Q
-      6645072,  // 0x52 R
-      3436896,  // 0x53 S
-      7479840,  // 0x54 T
-      5592432,  // 0x55 U
-      5592352,  // 0x56 V
-      5601104,  // 0x57 W
-      5580112,  // 0x58 X
-      5579296,  // 0x59 Y
-      7414896,  // 0x5A Z
-      6571104,  // 0x5B [
-      4464912,  // 0x5C \ .
-      6431328,  // 0x5D ]
-      2424832,  // 0x5E ^
-      15,       // 0x5F _
-      6422528,  // 0x60 `
-      13680,    // 0x61 a
-      4482400,  // 0x62 b
-      13360,    // 0x63 c
-      1127728,  // 0x64 d
-      30256,    // 0x65 e
-      1208864,  // 0x66 f
-      29975,    // 0x67 g
-      4482384,  // 0x68 h
-      2105888,  // 0x69 i
-      2105894,  // 0x6A j
-      4478544,  // 0x6B k
-      2236960,  // 0x6C l
-      30544,    // 0x6D m
-      25936,    // 0x6E n
-      9504,     // 0x6F o
-      25956,    // 0x70 p
-      13617,    // 0x71 q
-      25664,    // 0x72 r
-      12896,    // 0x73 s
-      160304,   // 0x74 t
-      21872,    // 0x75 u
-      21792,    // 0x76 v
-      22384,    // 0x77 w
-      21072,    // 0x78 x
-      21796,    // 0x79 y
-      25136,    // 0x7A z
-      3301936,  // 0x7B {
-      2236960,  // 0x7C |
-      6435424,  // 0x7D }
-      5898240,  // 0x7E ~
-};
+//! Full ticker brightness (fixed point 1.0)
+#define FULL_BRIGHTNESS 256
 
-/**
- * Maps LED "snake" shape into matrix with upper
- * left [0; 0] corner
- */
-const uint8_t led_mapping[] = {
-    50, 51, 52, 53, 54, 55, 56, 57, 58, 59,
-    49, 48, 47, 46, 45, 44, 43, 42, 41, 40,
-    30, 31, 32, 33, 34, 35, 36, 37, 38, 39,
-    29, 28, 27, 26, 25, 24, 23, 22, 21, 20,
-    10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
-     9,  8,  7,  6,  5,  4,  3,  2,  1,  0
-};
+#define min(a,b)            ((a)<(b)?(a):(b))
 
+//! Global Lua state - used to handle callback functions
+static lua_State *g_pLua = NULL;
 
 /**
  * Ticker-related data
  */
 typedef struct ticker {
-   lpd_userdata *m_LedStrip;    //!< LED Strip associated with the ticker
-   int           m_StripRef;    //!< LED Strip reference (for lua counter)
+   matrix_t     *m_Matrix;      //!< LED matrix associated with the ticker
+   matrix_t      m_OwnMatrix;   //!< Default "snake" layout, used when set up with a plain LED strip
+   int           m_BackendRef;  //!< LED Strip or matrix reference (for lua counter)
+   unsigned m_Columns;          //!< Number of visible columns
+   unsigned m_Rows;             //!< Number of ticker rows
+   int      m_RowStep[FONT_MAX_HEIGHT];//!< Strip index step within a row (+1, -1 or 0 if not continuous)
+   uint8_t *m_Line;             //!< Row output buffer (two rows)
    unsigned m_Speed;            //!< Ticker scrolling speed (scroll interval in ms)
    unsigned m_Length;           //!< Ticker character buffer length (in columns * 3)
    unsigned m_Used;             //!< Occupied buffer length (in columns * 3)
    ETSTimer m_ScrollTimer;      //!< Ticker scroll timer
-   uint8_t *m_OutputBuffer;     //!< Cached ticker output
+   uint8_t *m_OutputBuffer;     //!< Cached ticker output (raw RGB values)
+   uint8_t *m_FrameBuffer;      //!< Encoded ticker output (gamma and brightness corrected GRB values)
    unsigned m_Position;         //!< Current position
-   double   m_Brightness;       //!< Ticker brightness [0:1]
+   unsigned m_Brightness;       //!< Ticker brightness [0:FULL_BRIGHTNESS]
    int      m_ScrollCallback;   //!< Scroll completion callback
 } ticker_t;
 
-static void add_letter(ticker_t *pTicker, uint32_t mask, unsigned r, unsigned g, unsigned b) {
-   static uint8_t lines[6];
-   lines[0] = GET_LINE_0(mask);
-   lines[1] = GET_LINE_1(mask);
-   lines[2] = GET_LINE_2(mask);
-   lines[3] = GET_LINE_3(mask);
-   lines[4] = GET_LINE_4(mask);
-   lines[5] = GET_LINE_5(mask);
-
-   unsigned column, row, value, start;
-   for (row = 0; row < 6; ++row){
-      start = pTicker->m_Used + pTicker->m_Length * row;
-      for (column = 0; column < 4; ++column) {
-         value = (lines[row] >> (3 - column)) & 0x1;
-         pTicker->m_OutputBuffer[start + column * 3 + 0] = value * r;
-         pTicker->m_OutputBuffer[start + column * 3 + 1] = value * g;
-         pTicker->m_OutputBuffer[start + column * 3 + 2] = value * b;
+/**
+ * Encode a single cached RGB value into the strip's native format,
+ * applying the ticker brightness.
+ * @param   pTicker   Ticker to be updated
+ * @param   offset    Value offset within the output buffer
+ */
+static void encode_cell(ticker_t *pTicker, unsigned offset) {
+   const uint8_t *pRaw = pTicker->m_OutputBuffer + offset;
+   unsigned brightness = pTicker->m_Brightness;
+
+   matrix_encode(pTicker->m_Matrix, pTicker->m_FrameBuffer + offset,
+                (pRaw[0] * brightness) >> 8,
+                (pRaw[1] * brightness) >> 8,
+                (pRaw[2] * brightness) >> 8);
+}
+
+/**
+ * Re-encode the whole used part of the ticker buffer.
+ * Has to be called on every brightness change.
+ * @param   pTicker   Ticker to be updated
+ */
+static void rebuild_frame(ticker_t *pTicker) {
+   unsigned row, column, start;
+   for (row = 0; row < pTicker->m_Rows; ++row) {
+      start = pTicker->m_Length * row;
+      for (column = 0; column < pTicker->m_Used; column += 3)
+         encode_cell(pTicker, start + column);
+   }
+}
+
+/**
+ * Get a font selected by an optional Lua argument
+ * @param   L       Lua state
+ * @param   index   Argument index
+ * @return          Font descriptor (FONT_4X6 if the argument is absent)
+ */
+static const font_t *check_font(lua_State *L, int index) {
+   const font_t *pFont = font_get(luaL_optinteger(L, index, FONT_4X6));
+   luaL_argcheck(L, pFont, index, "unknown font");
+   return pFont;
+}
+
+/**
+ * Append a single character to the ticker buffer, followed by the font spacing.
+ * Rows beyond the glyph height are left blank, rows beyond the ticker height are dropped.
+ * @param   pTicker   Ticker to be updated
+ * @param   pFont     Font
+ * @param   code      Character code
+ * @return            1 on success, 0 if the buffer is full
+ */
+static int add_letter(ticker_t *pTicker, const font_t *pFont, unsigned code, unsigned r, unsigned g, unsigned b) {
+   glyph_t glyph;
+   unsigned column, columns, row, value, bits, start;
+
+   font_get_glyph(pFont, code, &glyph);
+   columns = glyph.m_Width + pFont->m_Spacing;
+   if (pTicker->m_Length - pTicker->m_Used < columns * 3)
+      return 0;
+
+   for (column = 0; column < columns; ++column) {
+      bits = font_get_column(&glyph, column);
+      for (row = 0; row < pTicker->m_Rows; ++row) {
+         start = pTicker->m_Used + pTicker->m_Length * row + column * 3;
+         value = (bits >> row) & 0x1;
+         pTicker->m_OutputBuffer[start + 0] = value * r;
+         pTicker->m_OutputBuffer[start + 1] = value * g;
+         pTicker->m_OutputBuffer[start + 2] = value * b;
+         encode_cell(pTicker, start);
       }
    }
-   pTicker->m_Used += 12;
+   pTicker->m_Used += columns * 3;
+
+   return 1;
 }
 
 /**
@@ -239,20 +151,21 @@ static int ticker_clear(lua_State *L) {
    pTicker->m_Used = 0;
    pTicker->m_Position = 0;
 
-   clear(pTicker->m_LedStrip, 0, 0, 0);
-   update(pTicker->m_LedStrip);
+   matrix_clear(pTicker->m_Matrix, 0, 0, 0);
+   matrix_show(pTicker->m_Matrix);
 
    // Add some empty space at te start
    unsigned column, row, start;
-   for (row = 0; row < 6; ++row){
+   for (row = 0; row < pTicker->m_Rows; ++row){
       start = pTicker->m_Length * row;
-      for (column = 0; column < 10; ++column) {
+      for (column = 0; column < pTicker->m_Columns; ++column) {
          pTicker->m_OutputBuffer[start + column * 3 + 0] = 0;
          pTicker->m_OutputBuffer[start + column * 3 + 1] = 0;
          pTicker->m_OutputBuffer[start + column * 3 + 2] = 0;
+         encode_cell(pTicker, start + column * 3);
       }
    }
-   pTicker->m_Used += 30;
+   pTicker->m_Used += pTicker->m_Columns * 3;
 
    os_timer_setfn(&pTicker->m_ScrollTimer, ticker_scroll_cb, pTicker);
    os_timer_arm(&pTicker->m_ScrollTimer, pTicker->m_Speed, 1);
@@ -274,7 +187,12 @@ static int ticker_set_brightness(lua_State *L){
       return 0;
    }
 
-   pTicker->m_Brightness = lua_tonumber(L, 2);
+   lua_Number brightness = luaL_checknumber(L, 2);
+   if (brightness < 0) brightness = 0;
+   if (brightness > 1) brightness = 1;
+
+   pTicker->m_Brightness = (unsigned)(brightness * FULL_BRIGHTNESS);
+   rebuild_frame(pTicker);
 
    return 0;
 }
@@ -284,6 +202,7 @@ static int ticker_set_brightness(lua_State *L){
  * @param   L   Lua state
  * @example     Lua: t:add_text("Hello", 255, 0, 0)
  * @example     Lua: t:add_text({72, 101, 108, 108, 111}, 255, 0, 0)
+ * @example     Lua: t:add_text("12:30", 0, 255, 0, ticker.FONT_3X5_DIGITS)
  */
 static int ticker_add_text(lua_State *L) {
    ticker_t *pTicker = (ticker_t *)luaL_checkudata(L, 1, "ticker.tbl");
@@ -294,32 +213,30 @@ static int ticker_add_text(lua_State *L) {
    }
 
    unsigned r, g, b, len, i, letter;
+   const font_t *pFont;
    r = luaL_checkinteger(L, 3);
    g = luaL_checkinteger(L, 4);
    b = luaL_checkinteger(L, 5);
+   pFont = check_font(L, 6);
 
    if (lua_isstring(L, 2)) {
       const char *str = lua_tostring(L, 2);
       len = lua_strlen(L, 2);
       for (i = 0; i < len; ++i) {
-         if (pTicker->m_Length - pTicker->m_Used < 12)
+         if (!add_letter(pTicker, pFont, (uint8_t)str[i], r, g, b))
             return luaL_error(L, "Ticker buffer is full.");
-
-         add_letter(pTicker, ascii_table[str[i]], r, g, b);
       }
    }
    else
    if (lua_istable(L, 2)) {
       len = lua_objlen(L, 2);
       for (i = 0; i < len; ++i) {
-         if (pTicker->m_Length - pTicker->m_Used < 12)
-            return luaL_error(L, "Ticker buffer is full.");
-
          lua_rawgeti(L, 2, i + 1);
-         letter = luaL_checkinteger(L, -1) % (sizeof(ascii_table) / sizeof(ascii_table[0]));
+         letter = luaL_checkinteger(L, -1) & 0xFF;
          lua_pop(L, 1);
 
-         add_letter(pTicker, ascii_table[letter], r, g, b);
+         if (!add_letter(pTicker, pFont, letter, r, g, b))
+            return luaL_error(L, "Ticker buffer is full.");
       }
    }
    else
@@ -329,10 +246,10 @@ static int ticker_add_text(lua_State *L) {
 }
 
 /**
- * Set a numeric mask for a given character.
+ * Set a numeric mask for a given character of the default font.
  * Doesn't update text in buffer.
  * Since Lua does not support 32 bit integers we have to work
- * with 6 rows.
+ * with 6 rows. Up to FONT_CUSTOM_GLYPHS characters can be redefined.
  * @param   L   Lua state
  * @example     Lua: t:set_char_mask("a", {0, 7, 5, 3, 0, 0})
  * @example     Lua: t:set_char_mask(97,  {0, 7, 5, 3, 0, 0})
@@ -349,11 +266,11 @@ static int ticker_set_char_mask(lua_State *L) {
    }
 
    if (lua_isstring(L, 2)) {
-      index = lua_tostring(L, 2)[0];
+      index = (uint8_t)lua_tostring(L, 2)[0];
    }
    else
    if (lua_isnumber(L, 2)) {
-      index = lua_tointeger(L, 2) % (sizeof(ascii_table) / sizeof(ascii_table[0]));
+      index = lua_tointeger(L, 2) & 0xFF;
    }
    else
       return luaL_error(L, "String or numeric argument expected.");
@@ -369,7 +286,9 @@ static int ticker_set_char_mask(lua_State *L) {
       lua_pop(L, 1);
    }
 
-   ascii_table[index] = mask;
+   if (!font_set_glyph(index, mask))
+      return luaL_error(L, "Too many custom characters.");
+
    return 0;
 }
 
@@ -391,10 +310,10 @@ static int ticker_set_text(lua_State *L) {
  * @param   L   Lua Sate
  * @return      Number of return parameters on stack (always 0)
  * @example     Lua: = t.add_letter("a", 255, 0, 0)
- * @example     Lua: = t.add_letter(97, 255, 0, 0)
+ * @example     Lua: = t.add_letter(97, 255, 0, 0 [, font])
  */
 static int ticker_add_letter(lua_State *L) {
-   uint32_t mask = 0;
+   unsigned letter = 0;
 
    ticker_t *pTicker = (ticker_t *)luaL_checkudata(L, 1, "ticker.tbl");
    luaL_argcheck(L, pTicker, 1, "ticker.tbl expected");
@@ -403,16 +322,12 @@ static int ticker_add_letter(lua_State *L) {
       return 0;
    }
 
-   if (pTicker->m_Length - pTicker->m_Used < 12)
-      return luaL_error(L, "Ticker buffer is full.");
-
    if (lua_isstring(L, 2)) {
-      mask = ascii_table[lua_tostring(L, 2)[0]];
+      letter = (uint8_t)lua_tostring(L, 2)[0];
    }
    else
    if (lua_isnumber(L, 2)) {
-      mask = lua_tointeger(L, 2) % (sizeof(ascii_table) / sizeof(ascii_table[0]));
-      mask = ascii_table[mask];
+      letter = lua_tointeger(L, 2) & 0xFF;
    }
    else
       return luaL_error(L, "String or numeric argument expected.");
@@ -422,11 +337,30 @@ static int ticker_add_letter(lua_State *L) {
    g = luaL_checkinteger(L, 4);
    b = luaL_checkinteger(L, 5);
 
-   add_letter(pTicker, mask, r, g, b);
+   if (!add_letter(pTicker, check_font(L, 6), letter, r, g, b))
+      return luaL_error(L, "Ticker buffer is full.");
 
    return 0;
 }
 
+/**
+ * Copy a single visible row window out of the encoded ring buffer.
+ * @param   pRow      Encoded row data
+ * @param   columns   Number of used columns in the row
+ * @param   start     First visible column
+ * @param   pLine     Destination buffer
+ * @param   visible   Number of visible columns
+ */
+static void copy_window(const uint8_t *pRow, unsigned columns, unsigned start, uint8_t *pLine, unsigned visible) {
+   unsigned copied = 0, chunk;
+   while (copied < visible) {
+      chunk = min(visible - copied, columns - start);
+      c_memcpy(pLine + copied * 3, pRow + start * 3, chunk * 3);
+      copied += chunk;
+      start = 0;
+   }
+}
+
 /**
  * Ticker callback function.
  * Updates current ticker position
@@ -435,36 +369,68 @@ static int ticker_add_letter(lua_State *L) {
 static void ICACHE_FLASH_ATTR ticker_scroll_cb(ticker_t *pTicker) {
    if (!pTicker->m_Used) return;
 
-   unsigned column, row, r, g, b, index;
-   for (row = 0; row < 6; ++row) {
-      for (column = 0; column < 10; ++column) {
-         r = pTicker->m_OutputBuffer[(((pTicker->m_Position + column) * 3 + 0) % pTicker->m_Used) + row * pTicker->m_Length];
-         g = pTicker->m_OutputBuffer[(((pTicker->m_Position + column) * 3 + 1) % pTicker->m_Used) + row * pTicker->m_Length];
-         b = pTicker->m_OutputBuffer[(((pTicker->m_Position + column) * 3 + 2) % pTicker->m_Used) + row * pTicker->m_Length];
-
-         r = ((double)r * pTicker->m_Brightness);
-         g = ((double)g * pTicker->m_Brightness);
-         b = ((double)b * pTicker->m_Brightness);
-
-         set_color(pTicker->m_LedStrip, led_mapping[column + row * 10], r, g, b);
+   matrix_t *pMatrix = pTicker->m_Matrix;
+   unsigned visible = pTicker->m_Columns;
+   uint8_t *line = pTicker->m_Line;
+   uint8_t *reversed = pTicker->m_Line + visible * 3;
+   const uint16_t *pLut;
+   unsigned columns = pTicker->m_Used / 3;
+   unsigned start = pTicker->m_Position % columns;
+   unsigned column, row;
+   for (row = 0; row < pTicker->m_Rows; ++row) {
+      copy_window(pTicker->m_FrameBuffer + row * pTicker->m_Length, columns, start, line, visible);
+      pLut = pMatrix->m_Lut + row * pMatrix->m_Width;
+
+      // Most layouts map rows onto continuous strip segments running in either direction
+      if (pTicker->m_RowStep[row] > 0) {
+         matrix_set_raw(pMatrix, pLut[0], line, visible);
+      }
+      else
+      if (pTicker->m_RowStep[row] < 0) {
+         for (column = 0; column < visible; ++column) {
+            reversed[(visible - 1 - column) * 3 + 0] = line[column * 3 + 0];
+            reversed[(visible - 1 - column) * 3 + 1] = line[column * 3 + 1];
+            reversed[(visible - 1 - column) * 3 + 2] = line[column * 3 + 2];
+         }
+         matrix_set_raw(pMatrix, pLut[visible - 1], reversed, visible);
+      }
+      else {
+         for (column = 0; column < visible; ++column)
+            matrix_set_raw(pMatrix, pLut[column], line + column * 3, 1);
       }
    }
 
-   update(pTicker->m_LedStrip);
+   // Unchanged frames (e.g. static text) are not sent to the strip
+   matrix_show(pMatrix);
 
    // Scroll finish detected
    if ((pTicker->m_Position * 3) == pTicker->m_Used) {
       pTicker->m_Position = 0;
 
-      if(g_pLua && pTicker->m_ScrollCallback != LUA_NOREF){
-         lua_rawgeti(g_pLua, LUA_REGISTRYINDEX, pTicker->m_ScrollCallback);
-         lua_call(g_pLua, 0, 0);
-      }
+      // The callback runs in the Lua task, see ticker_scroll_event
+      if(pTicker->m_ScrollCallback != LUA_NOREF)
+         event_post(EVENT_TICKER_SCROLL, 0, 0, pTicker);
    }
 
    ++pTicker->m_Position;
 }
 
+/**
+ * Scroll finish event handler, calls the Lua callback.
+ * Repeated scroll finish events of a single ticker are merged while pending.
+ * @param   id        Unused
+ * @param   arg       Unused
+ * @param   data      Ticker object
+ */
+static void ticker_scroll_event(unsigned id, uint32_t arg, void *data) {
+   ticker_t *pTicker = (ticker_t *)data;
+
+   if(g_pLua && pTicker->m_ScrollCallback != LUA_NOREF){
+      lua_rawgeti(g_pLua, LUA_REGISTRYINDEX, pTicker->m_ScrollCallback);
+      lua_call(g_pLua, 0, 0);
+   }
+}
+
 /**
  * Update the ticker scrolling speed.
  * @param   L   Lua state
@@ -525,25 +491,106 @@ static int ticker_stop(lua_State *L) {
    return 0;
 }
 
+/**
+ * Get userdata of the given type without raising an error
+ * @param   L       Lua state
+ * @param   index   Stack index
+ * @param   name    Metatable name
+ * @return          Userdata pointer or NULL if the value has another type
+ */
+static void *test_udata(lua_State *L, int index, const char *name) {
+   void *p = lua_touserdata(L, index);
+   if (p && lua_getmetatable(L, index)) {
+      luaL_getmetatable(L, name);
+      if (!lua_rawequal(L, -1, -2))
+         p = NULL;
+      lua_pop(L, 2);
+      return p;
+   }
+   return NULL;
+}
+
+/**
+ * Find out how each ticker row maps onto the strip
+ * @param   pTicker   Ticker object
+ */
+static void build_row_steps(ticker_t *pTicker) {
+   const matrix_t *pMatrix = pTicker->m_Matrix;
+   const uint16_t *pLut;
+   unsigned row, column;
+   int step;
+
+   for (row = 0; row < pTicker->m_Rows; ++row) {
+      pLut = pMatrix->m_Lut + row * pMatrix->m_Width;
+      step = 0;
+      if (pTicker->m_Columns > 1)
+         step = (int)pLut[1] - (int)pLut[0];
+      if (step != 1 && step != -1)
+         step = 0;
+
+      for (column = 1; step && column < pTicker->m_Columns; ++column) {
+         if ((int)pLut[column] - (int)pLut[column - 1] != step)
+            step = 0;
+      }
+
+      pTicker->m_RowStep[row] = step;
+   }
+}
+
+/**
+ * Release ticker buffers
+ * @param   pTicker   Ticker object
+ */
+static void release_buffers(ticker_t *pTicker) {
+   if (pTicker->m_OutputBuffer) {
+      c_free(pTicker->m_OutputBuffer);
+      pTicker->m_OutputBuffer = NULL;
+   }
+
+   if (pTicker->m_FrameBuffer) {
+      c_free(pTicker->m_FrameBuffer);
+      pTicker->m_FrameBuffer = NULL;
+   }
+
+   if (pTicker->m_Line) {
+      c_free(pTicker->m_Line);
+      pTicker->m_Line = NULL;
+   }
+
+   matrix_release(&pTicker->m_OwnMatrix);
+}
+
 /**
  * Setup a LED ticker
+ *
+ * The ticker either draws on a matrix object (see matrix.setup) or on a
+ * plain lpd8806 strip, wired as a 10x6 "snake" starting in the lower right corner.
+ *
  * @param   L   Lua Sate
  * @return      Number of return parameters on stack (always 1)
  * @example     Lua: t = ticker.setup(lpd [scroll_speed, length, scroll_callback])
+ * @example     Lua: t = ticker.setup(matrix.setup(4, 32, 8), 50)
  */
 static int ticker_setup(lua_State *L) {
    lpd_userdata *pStrip = NULL;
+   matrix_t *pMatrix = NULL;
    ticker_t *pTicker = NULL;
    unsigned speed  = 100;
    unsigned length = 60;
 
    NODE_DBG("ticker_setup is called.\n");
 
-   pStrip = (lpd_userdata *)luaL_checkudata(L, 1, "lpd8806.lpd");
-   luaL_argcheck(L, pStrip, 1, "lpd8806.lpd expected");
-   if(!pStrip) {
-      NODE_DBG("userdata is nil.\n");
-      return 0;
+   pMatrix = (matrix_t *)test_udata(L, 1, MATRIX_OBJECT);
+   if (!pMatrix) {
+      pStrip = (lpd_userdata *)luaL_checkudata(L, 1, "lpd8806.lpd");
+      luaL_argcheck(L, pStrip, 1, "lpd8806.lpd or matrix.mtx expected");
+      if(!pStrip) {
+         NODE_DBG("userdata is nil.\n");
+         return 0;
+      }
+
+      if (pStrip->m_Length < NUM_COLS * NUM_ROWS)
+         return luaL_error(L, "LED strip is too short.");
    }
 
    if (lua_isnumber(L, 2)) speed  = lua_tointeger(L, 2);
@@ -554,17 +601,22 @@ static int ticker_setup(lua_State *L) {
    if (!pTicker) return luaL_error(L, "Out of memory (Ticker struct).");
 
    // Initialize ticker structure
-   pTicker->m_LedStrip      = pStrip;
+   pTicker->m_Matrix        = pMatrix;
+   pTicker->m_Rows          = pMatrix ? min(pMatrix->m_Height, FONT_MAX_HEIGHT) : NUM_ROWS;
+   pTicker->m_Line          = NULL;
    pTicker->m_Speed         = speed;
    pTicker->m_Length        = length * 12;
    pTicker->m_OutputBuffer  = NULL;
+   pTicker->m_FrameBuffer   = NULL;
    pTicker->m_Used          = 0;
    pTicker->m_Position      = 0;
-   pTicker->m_Brightness    = 1.0f;
-   pTicker->m_StripRef      = LUA_NOREF;
+   pTicker->m_Brightness    = FULL_BRIGHTNESS;
+   pTicker->m_BackendRef    = LUA_NOREF;
    pTicker->m_ScrollCallback= LUA_NOREF;
+   pTicker->m_OwnMatrix.m_Lut    = NULL;
+   pTicker->m_OwnMatrix.m_Buffer = NULL;
 
-   size_t size = sizeof(uint8_t) * pTicker->m_Length * NUM_ROWS;
+   size_t size = sizeof(uint8_t) * pTicker->m_Length * pTicker->m_Rows;
 
    pTicker->m_OutputBuffer = c_zalloc(size);
    if (!pTicker->m_OutputBuffer)
@@ -572,10 +624,37 @@ static int ticker_setup(lua_State *L) {
 
    c_memset(pTicker->m_OutputBuffer, 0, size);
 
+   pTicker->m_FrameBuffer = c_zalloc(size);
+   if (!pTicker->m_FrameBuffer) {
+      release_buffers(pTicker);
+      return luaL_error(L, "Out of memory (frame).");
+   }
+
+   // Plain strip - use the default layout
+   if (!pTicker->m_Matrix) {
+      if (!matrix_init(&pTicker->m_OwnMatrix, NUM_COLS, NUM_ROWS, MATRIX_SERPENTINE, 180)) {
+         release_buffers(pTicker);
+         return luaL_error(L, "Out of memory (lut).");
+      }
+
+      pTicker->m_OwnMatrix.m_Backend = MATRIX_LPD8806;
+      pTicker->m_OwnMatrix.m_Strip   = pStrip;
+      pTicker->m_Matrix = &pTicker->m_OwnMatrix;
+   }
+
+   pTicker->m_Columns = pTicker->m_Matrix->m_Width;
+   pTicker->m_Line = c_zalloc(sizeof(uint8_t) * pTicker->m_Columns * 3 * 2);
+   if (!pTicker->m_Line) {
+      release_buffers(pTicker);
+      return luaL_error(L, "Out of memory (line).");
+   }
+
+   build_row_steps(pTicker);
+
    // ticker_t in now on top of the stack
-   // We need a reference to the strip - its in the second slot
+   // We need a reference to the strip or matrix - its in the second slot
    lua_pushvalue(L, 1);
-   pTicker->m_StripRef = luaL_ref(L, LUA_REGISTRYINDEX);
+   pTicker->m_BackendRef = luaL_ref(L, LUA_REGISTRYINDEX);
 
    // Handle optional scroll finish callback
    if (lua_type(L, 4) == LUA_TFUNCTION || lua_type(L, 4) == LUA_TLIGHTFUNCTION) {
@@ -609,17 +688,15 @@ static int ticker_destroy(lua_State *L) {
    }
 
    os_timer_disarm(&pData->m_ScrollTimer);
+   event_cancel(EVENT_TICKER_SCROLL, pData);
 
-   // Release ticker buffer
-   if (pData->m_OutputBuffer) {
-      c_free(pData->m_OutputBuffer);
-      pData->m_OutputBuffer = NULL;
-   }
+   // Release ticker buffers
+   release_buffers(pData);
 
    lua_gc(L, LUA_GCSTOP, 0);
-   if (pData->m_StripRef != LUA_NOREF) {
-      luaL_unref(L, LUA_REGISTRYINDEX, pData->m_StripRef);
-      pData->m_StripRef = LUA_NOREF;
+   if (pData->m_BackendRef != LUA_NOREF) {
+      luaL_unref(L, LUA_REGISTRYINDEX, pData->m_BackendRef);
+      pData->m_BackendRef = LUA_NOREF;
    }
 
    if (pData->m_ScrollCallback != LUA_NOREF) {
@@ -640,19 +717,19 @@ static int ticker_destroy(lua_State *L) {
  * LPD object functions
  */
 static const LUA_REG_TYPE ticker_map[] = {
-  { LSTRKEY("set_text"),      LFUNCVAL(ticker_set_text) },
-  { LSTRKEY("add_text"),      LFUNCVAL(ticker_add_text) },
-  { LSTRKEY("add_letter"),    LFUNCVAL(ticker_add_letter) },
-  { LSTRKEY("start"),         LFUNCVAL(ticker_start) },
-  { LSTRKEY("stop"),          LFUNCVAL(ticker_stop) },
-  { LSTRKEY("clear"),         LFUNCVAL(ticker_clear) },
-  { LSTRKEY("set_speed"),     LFUNCVAL(ticker_set_speed) },
-  { LSTRKEY("set_char_mask"), LFUNCVAL(ticker_set_char_mask) },
-  { LSTRKEY("set_brightness"),LFUNCVAL(ticker_set_brightness) },
   { LSTRKEY("__gc"),          LFUNCVAL(ticker_destroy) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY("__index"),      LROVAL(ticker_map) },
 #endif
+  { LSTRKEY("add_letter"),    LFUNCVAL(ticker_add_letter) },
+  { LSTRKEY("add_text"),      LFUNCVAL(ticker_add_text) },
+  { LSTRKEY("clear"),         LFUNCVAL(ticker_clear) },
+  { LSTRKEY("set_brightness"),LFUNCVAL(ticker_set_brightness) },
+  { LSTRKEY("set_char_mask"), LFUNCVAL(ticker_set_char_mask) },
+  { LSTRKEY("set_speed"),     LFUNCVAL(ticker_set_speed) },
+  { LSTRKEY("set_text"),      LFUNCVAL(ticker_set_text) },
+  { LSTRKEY("start"),         LFUNCVAL(ticker_start) },
+  { LSTRKEY("stop"),          LFUNCVAL(ticker_stop) },
   { LNILKEY, LNILVAL }
 };
 
@@ -660,10 +737,13 @@ static const LUA_REG_TYPE ticker_map[] = {
  * LPD Namespace functions
  */
 const LUA_REG_TYPE lpdticker_map[] = {
-  { LSTRKEY("setup"),         LFUNCVAL(ticker_setup) },
 #if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY("FONT_3X5_DIGITS"),LNUMVAL(FONT_3X5_DIGITS) },
+  { LSTRKEY("FONT_4X6"),      LNUMVAL(FONT_4X6) },
+  { LSTRKEY("FONT_5X7"),      LNUMVAL(FONT_5X7) },
   { LSTRKEY("__metatable"),   LROVAL(lpdticker_map) },
 #endif
+  { LSTRKEY("setup"),         LFUNCVAL(ticker_setup) },
   { LNILKEY, LNILVAL }
 };
 
@@ -672,6 +752,8 @@ const LUA_REG_TYPE lpdticker_map[] = {
  * @param L Lua state to be initialized
  */
 LUALIB_API int luaopen_ticker(lua_State *L) {
+   event_register(EVENT_TICKER_SCROLL, ticker_scroll_event, EVENT_COALESCE);
+
 #if LUA_OPTIMIZE_MEMORY > 0
    luaL_rometatable(L, "ticker.tbl", (void *)ticker_map);  // create metatable for ticker.lpd
    return 0;
@@ -682,6 +764,11 @@ LUALIB_API int luaopen_ticker(lua_State *L) {
    lua_pushvalue(L, -1);
    lua_setmetatable(L, -2);
 
+   // Module constants
+   MOD_REG_NUMBER(L, "FONT_4X6", FONT_4X6);
+   MOD_REG_NUMBER(L, "FONT_5X7", FONT_5X7);
+   MOD_REG_NUMBER(L, "FONT_3X5_DIGITS", FONT_3X5_DIGITS);
+
    // create metatable
    luaL_newmetatable(L, "ticker.tbl");
    // metatable.__index = metatable
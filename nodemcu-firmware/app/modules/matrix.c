@@ -0,0 +1,585 @@
+/*
+ * matrix.c
+ *
+ * Module for driving LED matrices built out of a single LED strip.
+ * The strip layout (size, order and rotation) is converted into an index
+ * lookup table once, so every pixel access is a single table read.
+ *
+ *  Created on: Mar 10, 2015
+ *      Author: yowidin
+ */
+
+#include "lualib.h"
+#include "lauxlib.h"
+#include "matrix.h"
+#include "ws2812.h"
+#include "font.h"
+#include "platform.h"
+#include "auxmods.h"
+#include "lrotable.h"
+#include "c_string.h"
+#include "c_stdlib.h"
+
+/**
+ * Initialize matrix layout.
+ * Builds the index lookup table, backend has to be attached by the caller.
+ *
+ * @param pMatrix   matrix object
+ * @param width     physical panel width (LEDs per strip row)
+ * @param height    physical panel height (number of strip rows)
+ * @param order     strip order (see matrix_order)
+ * @param rotation  clockwise rotation in degrees (0, 90, 180 or 270)
+ * @return          1 on success, 0 if out of memory or invalid rotation
+ */
+int matrix_init(matrix_t *pMatrix, unsigned width, unsigned height, unsigned order, unsigned rotation) {
+   unsigned x, y, px, py;
+
+   pMatrix->m_Lut = NULL;
+   pMatrix->m_Buffer = NULL;
+   pMatrix->m_Strip = NULL;
+   pMatrix->m_StripRef = LUA_NOREF;
+   pMatrix->m_Dirty = 0;
+
+   if (rotation == 0 || rotation == 180) {
+      pMatrix->m_Width  = width;
+      pMatrix->m_Height = height;
+   }
+   else
+   if (rotation == 90 || rotation == 270) {
+      pMatrix->m_Width  = height;
+      pMatrix->m_Height = width;
+   }
+   else
+      return 0;
+
+   pMatrix->m_Lut = (uint16_t *)c_zalloc(sizeof(uint16_t) * width * height);
+   if (!pMatrix->m_Lut)
+      return 0;
+
+   for (y = 0; y < pMatrix->m_Height; ++y) {
+      for (x = 0; x < pMatrix->m_Width; ++x) {
+         switch (rotation) {
+            case 90:  px = y;             py = height - 1 - x; break;
+            case 180: px = width - 1 - x; py = height - 1 - y; break;
+            case 270: px = width - 1 - y; py = x;              break;
+            default:  px = x;             py = y;              break;
+         }
+
+         if (order == MATRIX_SERPENTINE && (py & 1))
+            px = width - 1 - px;
+
+         pMatrix->m_Lut[y * pMatrix->m_Width + x] = py * width + px;
+      }
+   }
+
+   return 1;
+}
+
+/**
+ * Release matrix buffers (the object itself is not freed)
+ * @param pMatrix   matrix object
+ */
+void matrix_release(matrix_t *pMatrix) {
+   ws2812_cancel_idle(pMatrix);
+
+   if (pMatrix->m_Lut) {
+      c_free(pMatrix->m_Lut);
+      pMatrix->m_Lut = NULL;
+   }
+
+   if (pMatrix->m_Buffer) {
+      c_free(pMatrix->m_Buffer);
+      pMatrix->m_Buffer = NULL;
+   }
+}
+
+/**
+ * Convert an RGB value into the backend's native format (3 bytes).
+ * @param pMatrix   matrix object
+ * @param pDest     destination buffer
+ * @param r         R color component
+ * @param g         G color component
+ * @param b         B color component
+ */
+void matrix_encode(const matrix_t *pMatrix, uint8_t *pDest, unsigned r, unsigned g, unsigned b) {
+   if (pMatrix->m_Backend == MATRIX_LPD8806) {
+      encode_color(pDest, r, g, b);
+   }
+   else {
+      pDest[0] = g;
+      pDest[1] = r;
+      pDest[2] = b;
+   }
+}
+
+/**
+ * Copy already encoded values into a continuous range of strip LEDs.
+ * @param pMatrix   matrix object
+ * @param index     strip index of the first LED
+ * @param pSource   encoded values (see matrix_encode)
+ * @param count     number of LEDs
+ */
+void matrix_set_raw(matrix_t *pMatrix, unsigned index, const uint8_t *pSource, unsigned count) {
+   unsigned length = pMatrix->m_Width * pMatrix->m_Height;
+
+   if (pMatrix->m_Backend == MATRIX_LPD8806) {
+      set_raw(pMatrix->m_Strip, index, pSource, count);
+      return;
+   }
+
+   if (index >= length)
+      return;
+
+   if (count > length - index)
+      count = length - index;
+
+   if (c_memcmp(pMatrix->m_Buffer + 3 * index, pSource, 3 * count) == 0)
+      return;
+
+   c_memcpy(pMatrix->m_Buffer + 3 * index, pSource, 3 * count);
+   pMatrix->m_Dirty = 1;
+}
+
+/**
+ * Set a single pixel, pixels outside of the matrix are ignored.
+ * @param pMatrix   matrix object
+ * @param x         column (logical)
+ * @param y         row (logical)
+ * @param r         R color component
+ * @param g         G color component
+ * @param b         B color component
+ */
+void matrix_set_pixel(matrix_t *pMatrix, unsigned x, unsigned y, unsigned r, unsigned g, unsigned b) {
+   uint8_t value[3];
+
+   if (x >= pMatrix->m_Width || y >= pMatrix->m_Height)
+      return;
+
+   matrix_encode(pMatrix, value, r, g, b);
+   matrix_set_raw(pMatrix, pMatrix->m_Lut[y * pMatrix->m_Width + x], value, 1);
+}
+
+/**
+ * Fill the whole matrix with a single color
+ * @param pMatrix   matrix object
+ * @param r         R color component
+ * @param g         G color component
+ * @param b         B color component
+ */
+void matrix_clear(matrix_t *pMatrix, unsigned r, unsigned g, unsigned b) {
+   unsigned length = pMatrix->m_Width * pMatrix->m_Height;
+   unsigned i;
+   uint8_t value[3];
+
+   matrix_encode(pMatrix, value, r, g, b);
+   for (i = 0; i < length; ++i)
+      matrix_set_raw(pMatrix, i, value, 1);
+}
+
+static void matrix_show_when_idle(void *pMatrix) {
+   matrix_show((matrix_t *)pMatrix);
+}
+
+/**
+ * Push the cached matrix state into the LED strip
+ *
+ * On GPIO2 a ws2812 frame goes out through UART1 (see ws2812_send_buffer())
+ * and the call returns at once. A frame shown while the previous one is on
+ * its way is sent when that one is done. Other pins are bit-banged with the
+ * interrupts locked until the whole strip is written.
+ *
+ * @param pMatrix   matrix object
+ */
+void matrix_show(matrix_t *pMatrix) {
+   size_t length = pMatrix->m_Width * pMatrix->m_Height * 3;
+
+   if (pMatrix->m_Backend == MATRIX_LPD8806) {
+      update(pMatrix->m_Strip, 0);
+      return;
+   }
+
+   if (!pMatrix->m_Dirty)
+      return;
+
+   if (pMatrix->m_Pin != WS2812_UART_PIN) {
+      pMatrix->m_Dirty = 0;
+      ws2812_write_buffer(pMatrix->m_Pin, pMatrix->m_Buffer, length);
+      return;
+   }
+
+   switch (ws2812_send_buffer(pMatrix->m_Buffer, length)) {
+      case WS2812_OK:
+         pMatrix->m_Dirty = 0;
+         break;
+      case WS2812_BUSY:
+         ws2812_when_idle(matrix_show_when_idle, pMatrix);
+         break;
+      default:
+         // Out of memory, the frame stays dirty for the next show
+         break;
+   }
+}
+
+/**
+ * Setup an LED matrix
+ *
+ * The backend is either an lpd8806 strip object or a ws2812 pin number.
+ * A ws2812 strip on pin 4 (GPIO2) is driven by UART1 without blocking, on
+ * any other pin show() blocks with the interrupts off, see matrix_show().
+ * Width and height describe the physical panel, i.e. the number of LEDs
+ * in every strip row and the number of strip rows. The strip starts in
+ * the upper left corner.
+ *
+ * @param   L   Lua Sate
+ * @return      Number of return parameters on stack (always 1)
+ * @example     Lua: m = matrix.setup(lpd, 10, 6, matrix.SERPENTINE, 180)
+ * @example     Lua: m = matrix.setup(4, 8, 8, matrix.PROGRESSIVE)
+ */
+static int matrix_setup(lua_State *L) {
+   unsigned width, height, order = MATRIX_PROGRESSIVE, rotation = 0;
+   lpd_userdata *pStrip = NULL;
+   matrix_t *pMatrix = NULL;
+
+   NODE_DBG("matrix_setup is called.\n");
+
+   width  = luaL_checkinteger(L, 2);
+   height = luaL_checkinteger(L, 3);
+   if (lua_isnumber(L, 4)) order    = lua_tointeger(L, 4);
+   if (lua_isnumber(L, 5)) rotation = lua_tointeger(L, 5);
+
+   if (!width || !height)
+      return luaL_error(L, "Invalid matrix size.");
+
+   if (order != MATRIX_PROGRESSIVE && order != MATRIX_SERPENTINE)
+      return luaL_error(L, "Invalid order.");
+
+   if (rotation != 0 && rotation != 90 && rotation != 180 && rotation != 270)
+      return luaL_error(L, "Invalid rotation.");
+
+   if (!lua_isnumber(L, 1)) {
+      pStrip = (lpd_userdata *)luaL_checkudata(L, 1, "lpd8806.lpd");
+      luaL_argcheck(L, pStrip, 1, "lpd8806.lpd expected");
+
+      if (pStrip->m_Length < width * height)
+         return luaL_error(L, "LED strip is too short.");
+   }
+   else {
+      MOD_CHECK_ID(gpio, lua_tointeger(L, 1));
+   }
+
+   // Create an object
+   pMatrix = (matrix_t *)lua_newuserdata(L, sizeof(matrix_t));
+   if (!pMatrix)
+      return luaL_error(L, "Out of memory (struct).");
+
+   if (!matrix_init(pMatrix, width, height, order, rotation))
+      return luaL_error(L, "Out of memory (lut).");
+
+   if (pStrip) {
+      pMatrix->m_Backend = MATRIX_LPD8806;
+      pMatrix->m_Strip = pStrip;
+
+      // Keep the strip alive as long as the matrix exists
+      lua_pushvalue(L, 1);
+      pMatrix->m_StripRef = luaL_ref(L, LUA_REGISTRYINDEX);
+   }
+   else {
+      pMatrix->m_Backend = MATRIX_WS2812;
+      pMatrix->m_Pin = lua_tointeger(L, 1);
+      pMatrix->m_Buffer = (uint8_t *)c_zalloc(width * height * 3);
+      if (!pMatrix->m_Buffer) {
+         matrix_release(pMatrix);
+         return luaL_error(L, "Out of memory (data).");
+      }
+   }
+
+   // Set metatable
+   luaL_getmetatable(L, MATRIX_OBJECT);
+   lua_setmetatable(L, -2);
+
+   return 1;
+}
+
+/**
+ * Set a single pixel
+ * @param   L   Lua state
+ * @return      Number of return parameters on stack (always 0)
+ * @example     Lua: m:set_pixel(x, y, r, g, b)
+ */
+static int matrix_lua_set_pixel(lua_State *L) {
+   matrix_t *pMatrix = (matrix_t *)luaL_checkudata(L, 1, MATRIX_OBJECT);
+   luaL_argcheck(L, pMatrix, 1, MATRIX_OBJECT" expected");
+   if(!pMatrix) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   matrix_set_pixel(pMatrix,
+                    luaL_checkinteger(L, 2), luaL_checkinteger(L, 3),
+                    luaL_checkinteger(L, 4), luaL_checkinteger(L, 5), luaL_checkinteger(L, 6));
+   return 0;
+}
+
+/**
+ * Draw a bitmap of R, G, B byte triplets (row major).
+ * Pixels outside of the matrix are clipped.
+ * @param   L   Lua state
+ * @return      Number of return parameters on stack (always 0)
+ * @example     Lua: m:bitmap(x, y, width, string.char(255, 0, 0):rep(4))
+ */
+static int matrix_bitmap(lua_State *L) {
+   size_t length;
+   unsigned x, y, width, height, column, row;
+   const uint8_t *pData;
+
+   matrix_t *pMatrix = (matrix_t *)luaL_checkudata(L, 1, MATRIX_OBJECT);
+   luaL_argcheck(L, pMatrix, 1, MATRIX_OBJECT" expected");
+   if(!pMatrix) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   x     = luaL_checkinteger(L, 2);
+   y     = luaL_checkinteger(L, 3);
+   width = luaL_checkinteger(L, 4);
+   pData = (const uint8_t *)luaL_checklstring(L, 5, &length);
+
+   if (!width)
+      return luaL_error(L, "Invalid bitmap width.");
+
+   height = length / (width * 3);
+   for (row = 0; row < height; ++row) {
+      for (column = 0; column < width; ++column, pData += 3)
+         matrix_set_pixel(pMatrix, x + column, y + row, pData[0], pData[1], pData[2]);
+   }
+
+   return 0;
+}
+
+/**
+ * Draw a text, only the glyph pixels are changed.
+ * @param   L   Lua state
+ * @return      Number of return parameters on stack (always 1, text width)
+ * @example     Lua: m:text(x, y, "Hello", r, g, b)
+ * @example     Lua: width = m:text(x, y, "12:30", r, g, b, ticker.FONT_3X5_DIGITS)
+ */
+static int matrix_text(lua_State *L) {
+   size_t length, i;
+   unsigned x, y, r, g, b, row, column, bits, start;
+   const char *pText;
+   const font_t *pFont;
+   glyph_t glyph;
+
+   matrix_t *pMatrix = (matrix_t *)luaL_checkudata(L, 1, MATRIX_OBJECT);
+   luaL_argcheck(L, pMatrix, 1, MATRIX_OBJECT" expected");
+   if(!pMatrix) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   x     = luaL_checkinteger(L, 2);
+   y     = luaL_checkinteger(L, 3);
+   pText = luaL_checklstring(L, 4, &length);
+   r     = luaL_checkinteger(L, 5);
+   g     = luaL_checkinteger(L, 6);
+   b     = luaL_checkinteger(L, 7);
+   pFont = font_get(luaL_optinteger(L, 8, FONT_4X6));
+   luaL_argcheck(L, pFont, 8, "unknown font");
+
+   start = x;
+   for (i = 0; i < length; ++i) {
+      font_get_glyph(pFont, (uint8_t)pText[i], &glyph);
+      for (column = 0; column < glyph.m_Width; ++column, ++x) {
+         bits = font_get_column(&glyph, column);
+         for (row = 0; bits; ++row, bits >>= 1) {
+            if (bits & 0x1)
+               matrix_set_pixel(pMatrix, x, y + row, r, g, b);
+         }
+      }
+      x += pFont->m_Spacing;
+   }
+
+   lua_pushinteger(L, x - start);
+   return 1;
+}
+
+/**
+ * Fill the whole matrix with a single color
+ * @param   L   Lua state
+ * @return      Number of return parameters on stack (always 0)
+ * @example     Lua: m:clear([r, g, b])
+ */
+static int matrix_lua_clear(lua_State *L) {
+   unsigned r = 0, g = 0, b = 0;
+
+   matrix_t *pMatrix = (matrix_t *)luaL_checkudata(L, 1, MATRIX_OBJECT);
+   luaL_argcheck(L, pMatrix, 1, MATRIX_OBJECT" expected");
+   if(!pMatrix) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   if (lua_isnumber(L, 2)) r = lua_tointeger(L, 2);
+   if (lua_isnumber(L, 3)) g = lua_tointeger(L, 3);
+   if (lua_isnumber(L, 4)) b = lua_tointeger(L, 4);
+
+   matrix_clear(pMatrix, r, g, b);
+   return 0;
+}
+
+/**
+ * Push the cached matrix state into the LED strip
+ * @param   L   Lua state
+ * @return      Number of return parameters on stack (always 0)
+ * @example     Lua: m:show()
+ */
+static int matrix_lua_show(lua_State *L) {
+   matrix_t *pMatrix = (matrix_t *)luaL_checkudata(L, 1, MATRIX_OBJECT);
+   luaL_argcheck(L, pMatrix, 1, MATRIX_OBJECT" expected");
+   if(!pMatrix) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   matrix_show(pMatrix);
+   return 0;
+}
+
+/**
+ * Returns strip index of a given pixel
+ * @param   L   Lua state
+ * @return      Strip index or nil if outside of the matrix
+ * @example     Lua: index = m:get_index(x, y)
+ */
+static int matrix_get_index(lua_State *L) {
+   unsigned x, y;
+
+   matrix_t *pMatrix = (matrix_t *)luaL_checkudata(L, 1, MATRIX_OBJECT);
+   luaL_argcheck(L, pMatrix, 1, MATRIX_OBJECT" expected");
+   if(!pMatrix) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   x = luaL_checkinteger(L, 2);
+   y = luaL_checkinteger(L, 3);
+   if (x >= pMatrix->m_Width || y >= pMatrix->m_Height)
+      return 0;
+
+   lua_pushinteger(L, pMatrix->m_Lut[y * pMatrix->m_Width + x]);
+   return 1;
+}
+
+/**
+ * Returns logical (rotated) matrix size
+ * @param   L   Lua state
+ * @return      Width and height
+ * @example     Lua: width, height = m:get_size()
+ */
+static int matrix_get_size(lua_State *L) {
+   matrix_t *pMatrix = (matrix_t *)luaL_checkudata(L, 1, MATRIX_OBJECT);
+   luaL_argcheck(L, pMatrix, 1, MATRIX_OBJECT" expected");
+   if(!pMatrix) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   lua_pushinteger(L, pMatrix->m_Width);
+   lua_pushinteger(L, pMatrix->m_Height);
+   return 2;
+}
+
+/**
+ * Function called by the Lua garbage collector then last reference on
+ * matrix object is removed.
+ *
+ * @param L Lua state
+ */
+static int matrix_destroy(lua_State *L) {
+   NODE_DBG("matrix_destroy is called.\n");
+
+   matrix_t *pMatrix = (matrix_t *)luaL_checkudata(L, 1, MATRIX_OBJECT);
+   luaL_argcheck(L, pMatrix, 1, MATRIX_OBJECT" expected");
+   if(!pMatrix) {
+      NODE_DBG("userdata is nil.\n");
+      return 0;
+   }
+
+   matrix_release(pMatrix);
+
+   if (pMatrix->m_StripRef != LUA_NOREF) {
+      lua_gc(L, LUA_GCSTOP, 0);
+      luaL_unref(L, LUA_REGISTRYINDEX, pMatrix->m_StripRef);
+      pMatrix->m_StripRef = LUA_NOREF;
+      lua_gc(L, LUA_GCRESTART, 0);
+   }
+
+   return 0;
+}
+
+// Module function map
+#define MIN_OPT_LEVEL   2
+#include "lrodefs.h"
+
+/**
+ * Matrix object functions
+ */
+static const LUA_REG_TYPE matrix_obj_map[] = {
+  { LSTRKEY("__gc"),          LFUNCVAL(matrix_destroy) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY("__index"),       LROVAL(matrix_obj_map) },
+#endif
+  { LSTRKEY("bitmap"),        LFUNCVAL(matrix_bitmap) },
+  { LSTRKEY("clear"),         LFUNCVAL(matrix_lua_clear) },
+  { LSTRKEY("get_index"),     LFUNCVAL(matrix_get_index) },
+  { LSTRKEY("get_size"),      LFUNCVAL(matrix_get_size) },
+  { LSTRKEY("set_pixel"),     LFUNCVAL(matrix_lua_set_pixel) },
+  { LSTRKEY("show"),          LFUNCVAL(matrix_lua_show) },
+  { LSTRKEY("text"),          LFUNCVAL(matrix_text) },
+  { LNILKEY, LNILVAL }
+};
+
+/**
+ * Matrix namespace functions
+ */
+const LUA_REG_TYPE matrix_map[] = {
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY("PROGRESSIVE"),   LNUMVAL(MATRIX_PROGRESSIVE) },
+  { LSTRKEY("SERPENTINE"),    LNUMVAL(MATRIX_SERPENTINE) },
+  { LSTRKEY("__metatable"),   LROVAL(matrix_map) },
+#endif
+  { LSTRKEY("setup"),         LFUNCVAL(matrix_setup) },
+  { LNILKEY, LNILVAL }
+};
+
+/**
+ * Initializer function
+ * @param L Lua state to be initialized
+ */
+LUALIB_API int luaopen_matrix(lua_State *L) {
+#if LUA_OPTIMIZE_MEMORY > 0
+   luaL_rometatable(L, MATRIX_OBJECT, (void *)matrix_obj_map);
+   return 0;
+#else // #if LUA_OPTIMIZE_MEMORY > 0
+   luaL_register(L, AUXLIB_MATRIX, matrix_map);
+
+   // Set it as its own metatable
+   lua_pushvalue(L, -1);
+   lua_setmetatable(L, -2);
+
+   // Module constants
+   MOD_REG_NUMBER(L, "PROGRESSIVE", MATRIX_PROGRESSIVE);
+   MOD_REG_NUMBER(L, "SERPENTINE", MATRIX_SERPENTINE);
+
+   // create metatable
+   luaL_newmetatable(L, MATRIX_OBJECT);
+   // metatable.__index = metatable
+   lua_pushliteral(L, "__index");
+   lua_pushvalue(L,-2);
+   lua_rawset(L,-3);
+   // Setup the methods inside metatable
+   luaL_register(L, NULL, matrix_obj_map);
+
+   return 1;
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
+}
@@ -0,0 +1,57 @@
+/*
+ * matrix.h
+ *
+ * Defines LED matrix layout related functions and structures
+ *
+ *  Created on: Mar 10, 2015
+ *      Author: yowidin
+ */
+
+#ifndef APP_MODULES_MATRIX_H_
+#define APP_MODULES_MATRIX_H_
+
+#include "lpd8806.h"
+
+//! Matrix object metatable name
+#define MATRIX_OBJECT   "matrix.mtx"
+
+/**
+ * List of the supported LED orders (how the strip runs through the panel)
+ */
+enum matrix_order {
+   MATRIX_PROGRESSIVE = 0, //!< Every row runs left to right
+   MATRIX_SERPENTINE  = 1  //!< Odd rows run right to left
+};
+
+/**
+ * List of the supported LED backends
+ */
+enum matrix_backend {
+   MATRIX_LPD8806 = 0,     //!< lpd8806 strip object
+   MATRIX_WS2812  = 1      //!< ws2812 strip on a GPIO pin
+};
+
+/**
+ * An LED matrix object
+ */
+typedef struct matrix {
+   unsigned m_Width;        //!< Logical (rotated) width
+   unsigned m_Height;       //!< Logical (rotated) height
+   uint16_t *m_Lut;         //!< Strip index of every logical pixel (row major)
+   unsigned m_Backend;      //!< Backend type
+   lpd_userdata *m_Strip;   //!< LPD8806 strip (MATRIX_LPD8806 only)
+   int      m_StripRef;     //!< LPD8806 strip reference (for lua counter)
+   unsigned m_Pin;          //!< WS2812 pin (MATRIX_WS2812 only)
+   uint8_t *m_Buffer;       //!< WS2812 G, R, B values (MATRIX_WS2812 only)
+   unsigned m_Dirty;        //!< WS2812 buffer changed since the last show
+} matrix_t;
+
+int  matrix_init(matrix_t *pMatrix, unsigned width, unsigned height, unsigned order, unsigned rotation);
+void matrix_release(matrix_t *pMatrix);
+void matrix_encode(const matrix_t *pMatrix, uint8_t *pDest, unsigned r, unsigned g, unsigned b);
+void matrix_set_raw(matrix_t *pMatrix, unsigned index, const uint8_t *pSource, unsigned count);
+void matrix_set_pixel(matrix_t *pMatrix, unsigned x, unsigned y, unsigned r, unsigned g, unsigned b);
+void matrix_clear(matrix_t *pMatrix, unsigned r, unsigned g, unsigned b);
+void matrix_show(matrix_t *pMatrix);
+
+#endif /* APP_MODULES_MATRIX_H_ */
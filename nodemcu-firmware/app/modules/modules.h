@@ -77,6 +77,14 @@
 #define ROM_MODULES_LPD_TICKER
 #endif
 
+#if defined(LUA_USE_MODULES_MATRIX)
+#define MODULES_MATRIX   "matrix"
+#define ROM_MODULES_MATRIX   \
+    _ROM(MODULES_MATRIX, luaopen_matrix, matrix_map)
+#else
+#define ROM_MODULES_MATRIX
+#endif
+
 #if defined(LUA_USE_MODULES_FILE_SERVER)
 #define MODULES_FILE_SERVER   "file_server"
 #define ROM_MODULES_FILE_SERVER   \
@@ -158,25 +166,39 @@
 #endif
 
 
+/* The rotables of the Lua libraries, they go into lua_rotable[] along with
+   the modules but have no open function of their own */
+#define ROM_LIB_COROUTINE   \
+    _ROT(LUA_COLIBNAME, co_funcs)
+#define ROM_LIB_STRING      \
+    _ROT(LUA_STRLIBNAME, strlib)
+#define ROM_LIB_TABLE       \
+    _ROT(LUA_TABLIBNAME, tab_funcs)
+
+/* Sorted by name, luaR_findglobal() bisects lua_rotable[] */
 #define LUA_MODULES_ROM     \
-        ROM_MODULES_GPIO    \
-        ROM_MODULES_PWM		\
-        ROM_MODULES_WIFI	\
-        ROM_MODULES_MQTT    \
-        ROM_MODULES_I2C     \
-        ROM_MODULES_SPI     \
-        ROM_MODULES_TMR     \
-        ROM_MODULES_NODE    \
-        ROM_MODULES_FILE    \
-        ROM_MODULES_NET     \
-        ROM_MODULES_ADC     \
-        ROM_MODULES_UART    \
-        ROM_MODULES_OW      \
-        ROM_MODULES_LPD8806 \
+        ROM_MODULES_ADC         \
+        ROM_MODULES_BIT         \
+        ROM_LIB_COROUTINE       \
+        ROM_MODULES_DHT         \
+        ROM_MODULES_FILE        \
         ROM_MODULES_FILE_SERVER \
-        ROM_MODULES_DHT     \
-        ROM_MODULES_LPD_TICKER \
-        ROM_MODULES_BIT		\
+        ROM_MODULES_GPIO        \
+        ROM_MODULES_I2C         \
+        ROM_MODULES_LPD8806     \
+        ROM_MODULES_MATRIX      \
+        ROM_MODULES_MQTT        \
+        ROM_MODULES_NET         \
+        ROM_MODULES_NODE        \
+        ROM_MODULES_OW          \
+        ROM_MODULES_PWM         \
+        ROM_MODULES_SPI         \
+        ROM_LIB_STRING          \
+        ROM_LIB_TABLE           \
+        ROM_MODULES_LPD_TICKER  \
+        ROM_MODULES_TMR         \
+        ROM_MODULES_UART        \
+        ROM_MODULES_WIFI        \
         ROM_MODULES_WS2812
 
 #endif
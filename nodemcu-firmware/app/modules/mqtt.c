@@ -1079,16 +1079,16 @@ static int mqtt_socket_publish( lua_State* L )
 
 static const LUA_REG_TYPE mqtt_socket_map[] =
 {
-	{ LSTRKEY( "lwt" ), LFUNCVAL ( mqtt_socket_lwt ) },
-  { LSTRKEY( "connect" ), LFUNCVAL ( mqtt_socket_connect ) },
-  { LSTRKEY( "close" ), LFUNCVAL ( mqtt_socket_close ) },
-  { LSTRKEY( "publish" ), LFUNCVAL ( mqtt_socket_publish ) },
-  { LSTRKEY( "subscribe" ), LFUNCVAL ( mqtt_socket_subscribe ) },
-  { LSTRKEY( "on" ), LFUNCVAL ( mqtt_socket_on ) },
   { LSTRKEY( "__gc" ), LFUNCVAL ( mqtt_delete ) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY( "__index" ), LROVAL ( mqtt_socket_map ) },
 #endif
+  { LSTRKEY( "close" ), LFUNCVAL ( mqtt_socket_close ) },
+  { LSTRKEY( "connect" ), LFUNCVAL ( mqtt_socket_connect ) },
+	{ LSTRKEY( "lwt" ), LFUNCVAL ( mqtt_socket_lwt ) },
+  { LSTRKEY( "on" ), LFUNCVAL ( mqtt_socket_on ) },
+  { LSTRKEY( "publish" ), LFUNCVAL ( mqtt_socket_publish ) },
+  { LSTRKEY( "subscribe" ), LFUNCVAL ( mqtt_socket_subscribe ) },
   { LNILKEY, LNILVAL }
 };
 
@@ -588,7 +588,7 @@ static void socket_connect(struct espconn *pesp_conn)
 }
 
 static void socket_dns_found(const char *name, ip_addr_t *ipaddr, void *arg);
-static dns_reconn_count = 0;
+static int dns_reconn_count = 0;
 static void socket_dns_found(const char *name, ip_addr_t *ipaddr, void *arg)
 {
   NODE_DBG("socket_dns_found is called.\n");
@@ -986,7 +986,8 @@ static int net_on( lua_State* L, const char* mt )
   return 0;  
 }
 
-// Lua: server/socket:send( string, function(sent) )
+// Lua: ok = server/socket:send( string, function(sent) )
+// ok is true once the data was handed to the connection, a sent callback follows
 static int net_send( lua_State* L, const char* mt )
 {
   // NODE_DBG("net_send is called.\n");
@@ -994,6 +995,7 @@ static int net_send( lua_State* L, const char* mt )
   struct espconn *pesp_conn = NULL;
   lnet_userdata *nud;
   size_t l;
+  sint8 res;
   
   nud = (lnet_userdata *)luaL_checkudata(L, 1, mt);
   luaL_argcheck(L, nud, 1, "Server/Socket expected");
@@ -1004,7 +1006,8 @@ static int net_send( lua_State* L, const char* mt )
 
   if(nud->pesp_conn == NULL){
     NODE_DBG("nud->pesp_conn is NULL.\n");
-    return 0;
+    lua_pushboolean(L, false);
+    return 1;
   }
   pesp_conn = nud->pesp_conn;
 
@@ -1044,12 +1047,13 @@ static int net_send( lua_State* L, const char* mt )
   }
 #ifdef CLIENT_SSL_ENABLE
   if(nud->secure)
-    espconn_secure_sent(pesp_conn, (unsigned char *)payload, l);
+    res = espconn_secure_sent(pesp_conn, (unsigned char *)payload, l);
   else
 #endif
-    espconn_sent(pesp_conn, (unsigned char *)payload, l);
+    res = espconn_sent(pesp_conn, (unsigned char *)payload, l);
 
-  return 0;  
+  lua_pushboolean(L, res == ESPCONN_OK);
+  return 1;  
 }
 
 // Lua: socket:dns( string, function(socket, ip) )
@@ -1281,32 +1285,32 @@ static int expose_array(lua_State* L, char *array, unsigned short len) {
 #include "lrodefs.h"
 static const LUA_REG_TYPE net_server_map[] =
 {
-  { LSTRKEY( "listen" ), LFUNCVAL ( net_server_listen ) },
-  { LSTRKEY( "close" ), LFUNCVAL ( net_server_close ) },
-  { LSTRKEY( "on" ), LFUNCVAL ( net_udpserver_on ) },
-  { LSTRKEY( "send" ), LFUNCVAL ( net_udpserver_send ) },
   // { LSTRKEY( "delete" ), LFUNCVAL ( net_server_delete ) },
   { LSTRKEY( "__gc" ), LFUNCVAL ( net_server_delete ) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY( "__index" ), LROVAL ( net_server_map ) },
 #endif
+  { LSTRKEY( "close" ), LFUNCVAL ( net_server_close ) },
+  { LSTRKEY( "listen" ), LFUNCVAL ( net_server_listen ) },
+  { LSTRKEY( "on" ), LFUNCVAL ( net_udpserver_on ) },
+  { LSTRKEY( "send" ), LFUNCVAL ( net_udpserver_send ) },
   { LNILKEY, LNILVAL }
 };
 
 static const LUA_REG_TYPE net_socket_map[] =
 {
-  { LSTRKEY( "connect" ), LFUNCVAL( net_socket_connect ) },
-  { LSTRKEY( "close" ), LFUNCVAL ( net_socket_close ) },
-  { LSTRKEY( "on" ), LFUNCVAL ( net_socket_on ) },
-  { LSTRKEY( "send" ), LFUNCVAL ( net_socket_send ) },
-  { LSTRKEY( "hold" ), LFUNCVAL ( net_socket_hold ) },
-  { LSTRKEY( "unhold" ), LFUNCVAL ( net_socket_unhold ) },
-  { LSTRKEY( "dns" ), LFUNCVAL ( net_socket_dns ) },
   // { LSTRKEY( "delete" ), LFUNCVAL ( net_socket_delete ) },
   { LSTRKEY( "__gc" ), LFUNCVAL ( net_socket_delete ) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY( "__index" ), LROVAL ( net_socket_map ) },
 #endif
+  { LSTRKEY( "close" ), LFUNCVAL ( net_socket_close ) },
+  { LSTRKEY( "connect" ), LFUNCVAL( net_socket_connect ) },
+  { LSTRKEY( "dns" ), LFUNCVAL ( net_socket_dns ) },
+  { LSTRKEY( "hold" ), LFUNCVAL ( net_socket_hold ) },
+  { LSTRKEY( "on" ), LFUNCVAL ( net_socket_on ) },
+  { LSTRKEY( "send" ), LFUNCVAL ( net_socket_send ) },
+  { LSTRKEY( "unhold" ), LFUNCVAL ( net_socket_unhold ) },
   { LNILKEY, LNILVAL }
 };
 #if 0
@@ -1319,14 +1323,13 @@ static const LUA_REG_TYPE net_array_map[] =
 #endif
 const LUA_REG_TYPE net_map[] = 
 {
-  { LSTRKEY( "createServer" ), LFUNCVAL ( net_createServer ) },
-  { LSTRKEY( "createConnection" ), LFUNCVAL ( net_createConnection ) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY( "TCP" ), LNUMVAL( TCP ) },
   { LSTRKEY( "UDP" ), LNUMVAL( UDP ) },
-
   { LSTRKEY( "__metatable" ), LROVAL( net_map ) },
 #endif
+  { LSTRKEY( "createConnection" ), LFUNCVAL ( net_createConnection ) },
+  { LSTRKEY( "createServer" ), LFUNCVAL ( net_createServer ) },
   { LNILKEY, LNILVAL }
 };
 
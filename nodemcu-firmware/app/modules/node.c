@@ -10,6 +10,7 @@
 #include "lopcodes.h"
 #include "lstring.h"
 #include "lundump.h"
+#include "lflash.h"
 
 #include "platform.h"
 #include "auxmods.h"
@@ -23,6 +24,7 @@
 #include "user_interface.h"
 #include "flash_api.h"
 #include "flash_fs.h"
+#include "event.h"
 
 // Lua: restart()
 static int node_restart( lua_State* L )
@@ -133,6 +135,18 @@ static int node_heap( lua_State* L )
   return 1;  
 }
 
+// Lua: depth, max_depth, dropped, coalesced = eventstats()
+static int node_eventstats( lua_State* L )
+{
+  event_stats_t stats;
+  event_get_stats( &stats );
+  lua_pushinteger(L, stats.depth);
+  lua_pushinteger(L, stats.max_depth);
+  lua_pushinteger(L, stats.dropped);
+  lua_pushinteger(L, stats.coalesced);
+  return 4;
+}
+
 static lua_State *gL = NULL;
 
 #ifdef DEVKIT_VERSION_0_9
@@ -268,13 +282,119 @@ static int node_input( lua_State* L )
   return 0;
 }
 
+// Redirected output is collected in a ring and handed to the callback, or sent
+// to the socket, in batches: once half of the ring or OUTPUT_FLUSH_LINES lines
+// are pending, otherwise OUTPUT_FLUSH_MS after the first byte. A socket gets
+// the next batch when the previous one was sent. Output that does not fit into
+// the ring is dropped and counted. A batch the socket didn't take, or one
+// whose sent callback doesn't come within OUTPUT_SENT_MS (the socket closed,
+// or its "sent" callback was set to another function), no longer holds up
+// the ones after it.
+#define OUTPUT_BUFFER_SIZE  256   // default ring size
+#define OUTPUT_BUFFER_MAX   1024  // a batch has to fit into one TCP send
+#define OUTPUT_FLUSH_LINES  4
+#define OUTPUT_FLUSH_MS     20
+#define OUTPUT_SENT_MS      3000
+
 static int output_redir_ref = LUA_NOREF;
 static int serial_debug = 1;
+static char *output_buf = NULL;
+static unsigned output_size = 0;
+static unsigned output_head = 0;      // free running, output_buf[output_head % output_size]
+static unsigned output_tail = 0;
+static unsigned output_lines = 0;     // newlines pending
+static bool output_socket = false;    // output_redir_ref is a socket
+static bool output_busy = false;      // socket send in flight
+static bool output_flushing = false;  // callback running
+static bool output_timer_armed = false;
+static os_timer_t output_timer;
+static uint32_t output_dropped = 0;
+static uint32_t output_flushes = 0;
+
+static void output_timer_cb( void *arg );
+
+// hand everything pending to the callback or socket as one string
+static void output_flush( void )
+{
+  unsigned len = output_head - output_tail;
+  unsigned start, first;
+
+  if(len == 0 || output_flushing || output_busy || output_redir_ref == LUA_NOREF || !gL)
+    return;
+
+  start = output_tail % output_size;
+  first = len < output_size - start ? len : output_size - start;
+
+  lua_rawgeti(gL, LUA_REGISTRYINDEX, output_redir_ref);
+  if(output_socket){
+    lua_getfield(gL, -1, "send");
+    lua_insert(gL, -2);   // send, socket
+  }
+  lua_pushlstring(gL, output_buf + start, first);
+  if(first < len){
+    lua_pushlstring(gL, output_buf, len - first);
+    lua_concat(gL, 2);
+  }
+  output_tail += len;
+  output_lines = 0;
+  output_flushes++;
+
+  // output of the callback itself is only buffered
+  output_flushing = true;
+  output_busy = output_socket;
+  if(lua_pcall(gL, output_socket ? 2 : 1, output_socket ? 1 : 0, 0) == 0){
+    if(output_socket){
+      // socket:send() is true once the data was handed to the connection
+      output_busy = lua_toboolean(gL, -1);
+      lua_pop(gL, 1);
+    }
+    if(output_busy){
+      output_timer_armed = true;
+      os_timer_disarm(&output_timer);
+      os_timer_setfn(&output_timer, (os_timer_func_t *)output_timer_cb, NULL);
+      os_timer_arm(&output_timer, OUTPUT_SENT_MS, 0);
+    }
+  }else{
+    // reported like the console does, but straight to the UART: through the
+    // redirection a failing callback would be called again for its own error
+    const char *msg = lua_tostring(gL, -1);
+    uart0_sendStr("lua: ");
+    uart0_sendStr(msg ? msg : "(error object is not a string)");
+    uart0_sendStr("\n");
+    lua_pop(gL, 1);
+    output_busy = false;
+  }
+  output_flushing = false;
+}
+
+// runs in the Lua task, see event_dispatch()
+static void output_flush_event( unsigned id, uint32_t arg, void *data )
+{
+  output_flush();
+}
+
+// A batch is due, or the sent callback of the last one didn't come
+static void output_timer_cb( void *arg )
+{
+  output_timer_armed = false;
+  output_busy = false;
+  event_post(EVENT_OUTPUT_FLUSH, 0, 0, NULL);
+}
+
+// socket:on("sent") - send the next batch
+static int output_sent( lua_State* L )
+{
+  if(output_socket){
+    os_timer_disarm(&output_timer);
+    output_timer_armed = false;
+    output_busy = false;
+    output_flush();
+  }
+  return 0;
+}
+
 void output_redirect(const char *str){
-  // if(c_strlen(str)>=TX_BUFF_SIZE){
-  //   NODE_ERR("output too long.\n");
-  //   return;
-  // }
+  unsigned pending;
 
   if(output_redir_ref == LUA_NOREF || !gL){
     uart0_sendStr(str);
@@ -285,25 +405,80 @@ void output_redirect(const char *str){
     uart0_sendStr(str);
   }
 
-  lua_rawgeti(gL, LUA_REGISTRYINDEX, output_redir_ref);
-  lua_pushstring(gL, str);
-  lua_call(gL, 1, 0);   // this call back function should never user output.
+  for(; *str; str++){
+    if(output_head - output_tail == output_size){
+      output_dropped += c_strlen(str);
+      break;
+    }
+    output_buf[output_head++ % output_size] = *str;
+    if(*str == '\n')
+      output_lines++;
+  }
+
+  pending = output_head - output_tail;
+  if(pending >= output_size / 2 || output_lines >= OUTPUT_FLUSH_LINES)
+    output_flush();
+
+  // a busy socket flushes from its sent callback
+  if(output_head != output_tail && !output_busy && !output_timer_armed){
+    output_timer_armed = true;
+    os_timer_disarm(&output_timer);
+    os_timer_setfn(&output_timer, (os_timer_func_t *)output_timer_cb, NULL);
+    os_timer_arm(&output_timer, OUTPUT_FLUSH_MS, 0);
+  }
+}
+
+// drop the redirection and whatever is pending
+static void output_reset( lua_State* L )
+{
+  if(output_redir_ref != LUA_NOREF)
+    luaL_unref(L, LUA_REGISTRYINDEX, output_redir_ref);
+  output_redir_ref = LUA_NOREF;
+  os_timer_disarm(&output_timer);
+  output_timer_armed = false;
+  output_head = output_tail = output_lines = 0;
+  output_socket = output_busy = output_flushing = false;
+  if(output_buf){
+    c_free(output_buf);
+    output_buf = NULL;
+  }
 }
 
-// Lua: output(function(c), debug)
+// Lua: output(function(c) or socket, debug, [buffer size])
+// A socket's "sent" callback is taken over for as long as it gets the output
 static int node_output( lua_State* L )
 {
+  unsigned size = OUTPUT_BUFFER_SIZE;
   gL = L;
+
+  if(lua_isnumber(L, 3)){
+    size = lua_tointeger(L, 3);
+    if(size < 16 || size > OUTPUT_BUFFER_MAX)
+      return luaL_error( L, "wrong arg range" );
+  }
+
   // luaL_checkanyfunction(L, 1);
-  if (lua_type(L, 1) == LUA_TFUNCTION || lua_type(L, 1) == LUA_TLIGHTFUNCTION){
+  if (lua_type(L, 1) == LUA_TFUNCTION || lua_type(L, 1) == LUA_TLIGHTFUNCTION || lua_isuserdata(L, 1)){
+    output_reset(L);
+    output_buf = (char *)c_malloc(size);
+    if(!output_buf)
+      return luaL_error( L, "not enough memory" );
+    output_size = size;
+    output_socket = lua_isuserdata(L, 1);
+    if(output_socket){
+      // batches are paced by the socket's sent callback, it takes the place
+      // of one set before and must not be set to another one while the
+      // output goes to the socket
+      lua_getfield(L, 1, "on");
+      lua_pushvalue(L, 1);
+      lua_pushliteral(L, "sent");
+      lua_pushcfunction(L, output_sent);
+      lua_call(L, 3, 0);
+    }
     lua_pushvalue(L, 1);  // copy argument (func) to the top of stack
-    if(output_redir_ref != LUA_NOREF)
-      luaL_unref(L, LUA_REGISTRYINDEX, output_redir_ref);
     output_redir_ref = luaL_ref(L, LUA_REGISTRYINDEX);
   } else {    // unref the key press function
-    if(output_redir_ref != LUA_NOREF)
-      luaL_unref(L, LUA_REGISTRYINDEX, output_redir_ref);
-    output_redir_ref = LUA_NOREF; 
+    output_reset(L);
     serial_debug = 1;
     return 0;
   }
@@ -320,6 +495,15 @@ static int node_output( lua_State* L )
   return 0; 
 }
 
+// Lua: pending, dropped, flushes = outputstats()
+static int node_outputstats( lua_State* L )
+{
+  lua_pushinteger(L, output_head - output_tail);
+  lua_pushinteger(L, output_dropped);
+  lua_pushinteger(L, output_flushes);
+  return 3;
+}
+
 static int writer(lua_State* L, const void* p, size_t size, void* u)
 {
   UNUSED(L);
@@ -335,13 +519,77 @@ static int writer(lua_State* L, const void* p, size_t size, void* u)
 }
 
 #define toproto(L,i) (clvalue(L->top+(i))->l.p)
-// Lua: compile(filename) -- compile lua file into lua bytecode, and save to .lc
-static int node_compile( lua_State* L )
+/**
+ * Compile a Lua source file into a bytecode file
+ * @param L       Lua state
+ * @param fname   Source file name
+ * @param output  Bytecode file name
+ * @param strip   Debug info to leave out, LUAF_STRIP_*. The chunk is loaded
+ *                first, it already lacks what node.stripdebug() drops.
+ * @return        0 on success, otherwise an error message is pushed onto the stack
+ */
+static int node_compile_strip( lua_State* L, const char *fname, const char *output, int strip )
 {
   Proto* f;
   int file_fd = FS_OPEN_OK - 1;
+  int result;
+
+  if (luaL_loadfsfile(L,fname)!=0){
+    return 1;
+  }
+
+  f = toproto(L,-1);
+
+  file_fd = fs_open(output, fs_mode2flag("w+"));
+  if(file_fd < FS_OPEN_OK)
+  {
+    lua_pop(L, 1);
+    lua_pushliteral(L, "cannot open/write to file");
+    return 1;
+  }
+
+  lua_lock(L);
+  result=luaU_dump(L,f,writer,&file_fd,strip);
+  lua_unlock(L);
+
+  fs_flush(file_fd);
+  fs_close(file_fd);
+  file_fd = FS_OPEN_OK - 1;
+  lua_pop(L, 1);
+
+  if (result==LUA_ERR_CC_INTOVERFLOW){
+    lua_pushliteral(L, "value too big or small for target integer type");
+    return 1;
+  }
+  if (result==LUA_ERR_CC_NOTINTEGER){
+    lua_pushliteral(L, "target lua_Number is integral but fractional value found");
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * Compile a Lua source file into a bytecode file (debug info stripped)
+ * @param L       Lua state
+ * @param fname   Source file name
+ * @param output  Bytecode file name
+ * @return        0 on success, otherwise an error message is pushed onto the stack
+ */
+int node_compile_file( lua_State* L, const char *fname, const char *output )
+{
+  return node_compile_strip(L, fname, output, LUAF_STRIP_LINES);
+}
+
+// Lua: compile(filename[, strip]) -- compile lua file into lua bytecode, and save to .lc
+// strip as in stripdebug(), the default leaves out all the debug info
+static int node_compile( lua_State* L )
+{
   size_t len;
   const char *fname = luaL_checklstring( L, 1, &len );
+  int strip = luaL_optinteger( L, 2, LUAF_STRIP_LINES );
+  if( strip < LUAF_STRIP_NONE || strip > LUAF_STRIP_LINES )
+    return luaL_error(L, "strip level must be 1-3");
   if( len > FS_NAME_MAX_LENGTH )
     return luaL_error(L, "filename too long");
 
@@ -355,74 +603,266 @@ static int node_compile( lua_State* L )
   output[c_strlen(output)-1] = '\0';
   NODE_DBG(output);
   NODE_DBG("\n");
-  if (luaL_loadfsfile(L,fname)!=0){
+  if (node_compile_strip(L, fname, output, strip)!=0){
     return luaL_error(L, lua_tostring(L,-1));
   }
 
-  f = toproto(L,-1);
+  return 0;
+}
 
-  int stripping = 1;      /* strip debug information? */
+// Lua: stripdebug([level]) -- debug info kept by chunks loaded from now on
+// 1 all of it, 2 no local and upvalue names, 3 no line numbers either
+// Returns the level in use
+static int node_stripdebug( lua_State* L )
+{
+  if( !lua_isnoneornil( L, 1 ) )
+  {
+    int level = luaL_checkinteger( L, 1 );
+    luaL_argcheck( L, level >= LUAF_STRIP_NONE && level <= LUAF_STRIP_LINES, 1, "must be 1-3" );
+    G(L)->stripdebug = level;
+  }
+  lua_pushinteger( L, G(L)->stripdebug );
+  return 1;
+}
 
-  file_fd = fs_open(output, fs_mode2flag("w+"));
-  if(file_fd < FS_OPEN_OK)
+// Lua: flashstore(file1.lc, file2.lc, ...) -- lay out compiled files in the
+// Lua flash store and restart, require() finds them there from then on.
+// The store comes before the file system: a module's .lua is ignored while
+// the store has the module, a .lc that differs from the stored copy is not.
+// Store the modules again to update them. Off unless user_config.h gives
+// LUA_STORE_SEC_NUM, see cpu_esp8266.h.
+static int node_flashstore( lua_State* L )
+{
+  int n = lua_gettop( L ), i, status;
+  const char **files = (const char **)lua_newuserdata( L, n * sizeof( char * ) );
+
+  for( i = 0; i < n; i++ )
+    files[i] = luaL_checkstring( L, i + 1 );
+  status = luaN_store( L, files, n );
+  if( status == LUAN_ERRFILE )
+    return luaL_error( L, lua_tostring( L, -1 ) );
+  if( status == LUAN_ERRFLASH )
+    NODE_ERR( "flashstore: %s\n", lua_tostring( L, -1 ) );
+  // Functions loaded from the store ran from the flash just rewritten
+  system_restart();
+  return 0;
+}
+
+// Lua: flashindex([module]) -- the chunk of a module in the flash store,
+// without a name a table of module sizes, the bytes used and the store size
+static int node_flashindex( lua_State* L )
+{
+  int status;
+
+  if( lua_isnoneornil( L, 1 ) )
   {
-    return luaL_error(L, "cannot open/write to file");
+    lua_pushinteger( L, luaN_index( L ) );
+    lua_pushinteger( L, luaN_size() );
+    return 3;
   }
+  status = luaN_load( L, luaL_checkstring( L, 1 ) );
+  if( status == LUAN_NOTFOUND )
+    lua_pushnil( L );
+  else if( status != 0 )
+    return lua_error( L );
+  return 1;
+}
 
-  lua_lock(L);
-  int result=luaU_dump(L,f,writer,&file_fd,stripping);
-  lua_unlock(L);
+#if defined( BUILD_SPIFFS )
+// Streamed chunks are spooled to a temporary file as they arrive and loaded
+// from there by luaL_loadfsfile() in LUAL_BUFFERSIZE blocks, so neither the
+// console buffer (LUA_MAXINPUT) nor the free heap limits their size.
+#define STREAM_OBJECT "node.stream"
+
+extern spiffs fs;
+static unsigned stream_count = 0;
+
+/**
+ * Open a new spool file for a streamed chunk
+ * @param name    Spool file name buffer, at least FS_NAME_MAX_LENGTH + 1 bytes
+ * @return        File descriptor, < FS_OPEN_OK on failure
+ */
+int node_stream_open( char *name )
+{
+  c_sprintf(name, "~exec%u.tmp", stream_count++ & 0xFF);
+  SPIFFS_remove(&fs, name);
+  return fs_open(name, fs_mode2flag("w+"));
+}
 
-  fs_flush(file_fd);
-  fs_close(file_fd);
-  file_fd = FS_OPEN_OK - 1;
+/**
+ * Drop a spooled chunk without running it
+ * @param fd      Spool file descriptor
+ * @param name    Spool file name
+ */
+void node_stream_close( int fd, const char *name )
+{
+  fs_close(fd);
+  SPIFFS_remove(&fs, (char *)name);
+}
 
-  if (result==LUA_ERR_CC_INTOVERFLOW){
-    return luaL_error(L, "value too big or small for target integer type");
+/**
+ * Compile and run a spooled chunk, the spool file is removed
+ * @param L       Lua state
+ * @param fd      Spool file descriptor
+ * @param name    Spool file name
+ * @return        0 on success, otherwise an error message is pushed onto the stack
+ */
+int node_stream_exec( lua_State* L, int fd, const char *name )
+{
+  int status;
+
+  fs_flush(fd);
+  fs_close(fd);
+  status = luaL_loadfsfile(L, name);
+  SPIFFS_remove(&fs, (char *)name);
+  if (status == 0)
+    status = lua_pcall(L, 0, 0, 0);
+  return status;
+}
+
+// a stream fed by a socket, see node.stream_exec()
+typedef struct
+{
+  int fd;
+  char name[FS_NAME_MAX_LENGTH + 1];
+} stream_userdata;
+
+static int node_stream_gc( lua_State* L )
+{
+  stream_userdata *s = (stream_userdata *)luaL_checkudata(L, 1, STREAM_OBJECT);
+  if (s->fd >= FS_OPEN_OK)
+    node_stream_close(s->fd, s->name);
+  s->fd = FS_OPEN_OK - 1;
+  return 0;
+}
+
+// socket:on("receive") - append to the spool file
+static int node_stream_receive( lua_State* L )
+{
+  stream_userdata *s = (stream_userdata *)lua_touserdata(L, lua_upvalueindex(1));
+  size_t len;
+  const char *data = luaL_checklstring(L, 2, &len);
+
+  if (s->fd < FS_OPEN_OK)
+    return 0;
+  if (fs_write(s->fd, data, len) != len){
+    node_stream_close(s->fd, s->name);
+    s->fd = FS_OPEN_OK - 1;
+    NODE_ERR("stream_exec: write failed\n");
   }
-  if (result==LUA_ERR_CC_NOTINTEGER){
-    return luaL_error(L, "target lua_Number is integral but fractional value found");
+  return 0;
+}
+
+// socket:on("disconnection") - run the chunk
+static int node_stream_done( lua_State* L )
+{
+  stream_userdata *s = (stream_userdata *)lua_touserdata(L, lua_upvalueindex(1));
+  int fd = s->fd;
+
+  if (fd < FS_OPEN_OK)
+    return 0;
+  s->fd = FS_OPEN_OK - 1;
+  // report like the console does, the socket callback is not protected
+  if (node_stream_exec(L, fd, s->name) != 0){
+    c_printf("%s\n", lua_tostring(L,-1));
+    lua_pop(L, 1);
   }
+  return 0;
+}
 
+// set socket:on(method, fn) with the stream userdata at the top of the stack as upvalue
+static void node_stream_on( lua_State* L, int socket, const char *method, lua_CFunction fn )
+{
+  lua_getfield(L, socket, "on");
+  lua_pushvalue(L, socket);
+  lua_pushstring(L, method);
+  lua_pushvalue(L, -4);
+  lua_pushcclosure(L, fn, 1);
+  lua_call(L, 3, 0);
+}
+
+// Lua: stream_exec(socket) -- run everything received on socket as one chunk once it disconnects
+static int node_stream_exec_socket( lua_State* L )
+{
+  stream_userdata *s;
+
+  if (lua_isnoneornil(L, 1))
+    return luaL_error(L, "socket expected");
+
+  s = (stream_userdata *)lua_newuserdata(L, sizeof(stream_userdata));
+  s->fd = node_stream_open(s->name);
+  if (s->fd < FS_OPEN_OK)
+    return luaL_error(L, "cannot open spool file");
+  luaL_getmetatable(L, STREAM_OBJECT);
+  lua_setmetatable(L, -2);
+
+  node_stream_on(L, 1, "receive", node_stream_receive);
+  node_stream_on(L, 1, "disconnection", node_stream_done);
   return 0;
 }
+#endif
 
 // Module function map
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
+#if defined( BUILD_SPIFFS )
+static const LUA_REG_TYPE node_stream_map[] =
+{
+  { LSTRKEY( "__gc" ), LFUNCVAL( node_stream_gc ) },
+  { LNILKEY, LNILVAL }
+};
+#endif
+
 const LUA_REG_TYPE node_map[] = 
 {
-  { LSTRKEY( "restart" ), LFUNCVAL( node_restart ) },
-  { LSTRKEY( "dsleep" ), LFUNCVAL( node_deepsleep ) },
-  { LSTRKEY( "info" ), LFUNCVAL( node_info ) },
   { LSTRKEY( "chipid" ), LFUNCVAL( node_chipid ) },
+  { LSTRKEY( "compile" ), LFUNCVAL( node_compile) },
+  { LSTRKEY( "dsleep" ), LFUNCVAL( node_deepsleep ) },
+  { LSTRKEY( "eventstats" ), LFUNCVAL( node_eventstats ) },
   { LSTRKEY( "flashid" ), LFUNCVAL( node_flashid ) },
+  { LSTRKEY( "flashindex" ), LFUNCVAL( node_flashindex ) },
   { LSTRKEY( "flashsize" ), LFUNCVAL( node_flashsize) },
+  { LSTRKEY( "flashstore" ), LFUNCVAL( node_flashstore ) },
   { LSTRKEY( "heap" ), LFUNCVAL( node_heap ) },
+  { LSTRKEY( "info" ), LFUNCVAL( node_info ) },
+  { LSTRKEY( "input" ), LFUNCVAL( node_input ) },
 #ifdef DEVKIT_VERSION_0_9
   { LSTRKEY( "key" ), LFUNCVAL( node_key ) },
   { LSTRKEY( "led" ), LFUNCVAL( node_led ) },
 #endif
-  { LSTRKEY( "input" ), LFUNCVAL( node_input ) },
   { LSTRKEY( "output" ), LFUNCVAL( node_output ) },
+  { LSTRKEY( "outputstats" ), LFUNCVAL( node_outputstats ) },
   { LSTRKEY( "readvdd33" ), LFUNCVAL( node_readvdd33) },
-  { LSTRKEY( "compile" ), LFUNCVAL( node_compile) },
-// Combined to dsleep(us, option)  
-// { LSTRKEY( "dsleepsetoption" ), LFUNCVAL( node_deepsleep_setoption) },
+  { LSTRKEY( "restart" ), LFUNCVAL( node_restart ) },
+#if defined( BUILD_SPIFFS )
+  { LSTRKEY( "stream_exec" ), LFUNCVAL( node_stream_exec_socket ) },
+#endif
+  { LSTRKEY( "stripdebug" ), LFUNCVAL( node_stripdebug ) },
 #if LUA_OPTIMIZE_MEMORY > 0
-
 #endif
+// Combined to dsleep(us, option)  
+// { LSTRKEY( "dsleepsetoption" ), LFUNCVAL( node_deepsleep_setoption) },
   { LNILKEY, LNILVAL }
 };
 
 LUALIB_API int luaopen_node( lua_State *L )
 {
+  event_register(EVENT_OUTPUT_FLUSH, output_flush_event, EVENT_COALESCE);
 #if LUA_OPTIMIZE_MEMORY > 0
+#if defined( BUILD_SPIFFS )
+  luaL_rometatable(L, STREAM_OBJECT, (void *)node_stream_map);  // create metatable for node.stream
+#endif
   return 0;
 #else // #if LUA_OPTIMIZE_MEMORY > 0
   luaL_register( L, AUXLIB_NODE, node_map );
   // Add constants
 
+#if defined( BUILD_SPIFFS )
+  luaL_newmetatable(L, STREAM_OBJECT);
+  luaL_register(L, NULL, node_stream_map);
+  lua_pop(L, 1);
+#endif
+
   return 1;
 #endif // #if LUA_OPTIMIZE_MEMORY > 0  
 }
@@ -286,29 +286,30 @@ static int ow_crc16( lua_State *L )
 #include "lrodefs.h"
 const LUA_REG_TYPE ow_map[] = 
 {
-  { LSTRKEY( "setup" ),  LFUNCVAL( ow_setup ) },
-  { LSTRKEY( "reset" ), LFUNCVAL( ow_reset ) },
-  { LSTRKEY( "skip" ), LFUNCVAL( ow_skip ) },
-  { LSTRKEY( "select" ), LFUNCVAL( ow_select ) },
-  { LSTRKEY( "write" ), LFUNCVAL( ow_write ) },
-  { LSTRKEY( "write_bytes" ), LFUNCVAL( ow_write_bytes ) },
+#if ONEWIRE_CRC
+#if ONEWIRE_CRC16
+  { LSTRKEY( "check_crc16" ), LFUNCVAL( ow_check_crc16 ) },
+  { LSTRKEY( "crc16" ), LFUNCVAL( ow_crc16 ) },
+#endif
+  { LSTRKEY( "crc8" ), LFUNCVAL( ow_crc8 ) },
+#endif
+  { LSTRKEY( "depower" ), LFUNCVAL( ow_depower ) },
   { LSTRKEY( "read" ), LFUNCVAL( ow_read ) },
   { LSTRKEY( "read_bytes" ), LFUNCVAL( ow_read_bytes ) },
-  { LSTRKEY( "depower" ), LFUNCVAL( ow_depower ) },
+  { LSTRKEY( "reset" ), LFUNCVAL( ow_reset ) },
 #if ONEWIRE_SEARCH
   { LSTRKEY( "reset_search" ), LFUNCVAL( ow_reset_search ) },
-  { LSTRKEY( "target_search" ), LFUNCVAL( ow_target_search ) },
   { LSTRKEY( "search" ), LFUNCVAL( ow_search ) },
 #endif
-#if ONEWIRE_CRC
-  { LSTRKEY( "crc8" ), LFUNCVAL( ow_crc8 ) },
-#if ONEWIRE_CRC16
-  { LSTRKEY( "check_crc16" ), LFUNCVAL( ow_check_crc16 ) },
-  { LSTRKEY( "crc16" ), LFUNCVAL( ow_crc16 ) },
-#endif
+  { LSTRKEY( "select" ), LFUNCVAL( ow_select ) },
+  { LSTRKEY( "setup" ),  LFUNCVAL( ow_setup ) },
+  { LSTRKEY( "skip" ), LFUNCVAL( ow_skip ) },
+#if ONEWIRE_SEARCH
+  { LSTRKEY( "target_search" ), LFUNCVAL( ow_target_search ) },
 #endif
+  { LSTRKEY( "write" ), LFUNCVAL( ow_write ) },
+  { LSTRKEY( "write_bytes" ), LFUNCVAL( ow_write_bytes ) },
 #if LUA_OPTIMIZE_MEMORY > 0
-
 #endif
   { LNILKEY, LNILVAL }
 };
@@ -129,16 +129,15 @@ static int lpwm_getduty( lua_State* L )
 #include "lrodefs.h"
 const LUA_REG_TYPE pwm_map[] = 
 {
-  { LSTRKEY( "setup" ), LFUNCVAL( lpwm_setup ) },
   { LSTRKEY( "close" ), LFUNCVAL( lpwm_close ) },
-  { LSTRKEY( "start" ), LFUNCVAL( lpwm_start ) },
-  { LSTRKEY( "stop" ), LFUNCVAL( lpwm_stop ) },
-  { LSTRKEY( "setclock" ), LFUNCVAL( lpwm_setclock ) },
   { LSTRKEY( "getclock" ), LFUNCVAL( lpwm_getclock ) },
-  { LSTRKEY( "setduty" ), LFUNCVAL( lpwm_setduty ) },
   { LSTRKEY( "getduty" ), LFUNCVAL( lpwm_getduty ) },
+  { LSTRKEY( "setclock" ), LFUNCVAL( lpwm_setclock ) },
+  { LSTRKEY( "setduty" ), LFUNCVAL( lpwm_setduty ) },
+  { LSTRKEY( "setup" ), LFUNCVAL( lpwm_setup ) },
+  { LSTRKEY( "start" ), LFUNCVAL( lpwm_start ) },
+  { LSTRKEY( "stop" ), LFUNCVAL( lpwm_stop ) },
 #if LUA_OPTIMIZE_MEMORY > 0
-
 #endif
   { LNILKEY, LNILVAL }
 };
@@ -127,19 +127,19 @@ static int spi_recv( lua_State *L )
 #include "lrodefs.h"
 const LUA_REG_TYPE spi_map[] = 
 {
-  { LSTRKEY( "setup" ),  LFUNCVAL( spi_setup ) },
-  { LSTRKEY( "send" ),   LFUNCVAL( spi_send ) },
-  { LSTRKEY( "recv" ),   LFUNCVAL( spi_recv ) },
 #if LUA_OPTIMIZE_MEMORY > 0
-  { LSTRKEY( "MASTER" ),    LNUMVAL( PLATFORM_SPI_MASTER ) },
-  { LSTRKEY( "SLAVE" ),     LNUMVAL( PLATFORM_SPI_SLAVE) },
-  { LSTRKEY( "CPHA_LOW" ),  LNUMVAL( PLATFORM_SPI_CPHA_LOW) },
   { LSTRKEY( "CPHA_HIGH" ), LNUMVAL( PLATFORM_SPI_CPHA_HIGH) },
-  { LSTRKEY( "CPOL_LOW" ),  LNUMVAL( PLATFORM_SPI_CPOL_LOW) },
+  { LSTRKEY( "CPHA_LOW" ),  LNUMVAL( PLATFORM_SPI_CPHA_LOW) },
   { LSTRKEY( "CPOL_HIGH" ), LNUMVAL( PLATFORM_SPI_CPOL_HIGH) },
-  { LSTRKEY( "DATABITS_8" ), LNUMVAL( PLATFORM_SPI_DATABITS_8) },
+  { LSTRKEY( "CPOL_LOW" ),  LNUMVAL( PLATFORM_SPI_CPOL_LOW) },
   { LSTRKEY( "DATABITS_16" ), LNUMVAL( PLATFORM_SPI_DATABITS_16) },
+  { LSTRKEY( "DATABITS_8" ), LNUMVAL( PLATFORM_SPI_DATABITS_8) },
+  { LSTRKEY( "MASTER" ),    LNUMVAL( PLATFORM_SPI_MASTER ) },
+  { LSTRKEY( "SLAVE" ),     LNUMVAL( PLATFORM_SPI_SLAVE) },
 #endif // #if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "recv" ),   LFUNCVAL( spi_recv ) },
+  { LSTRKEY( "send" ),   LFUNCVAL( spi_send ) },
+  { LSTRKEY( "setup" ),  LFUNCVAL( spi_setup ) },
   { LNILKEY, LNILVAL }
 };
 
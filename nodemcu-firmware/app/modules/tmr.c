@@ -8,61 +8,152 @@
 #include "lrotable.h"
 
 #include "c_types.h"
+#include "event.h"
 
-static os_timer_t alarm_timer[NUM_TMR];
-static int alarm_timer_cb_ref[NUM_TMR] = {LUA_NOREF,LUA_NOREF,LUA_NOREF,LUA_NOREF,LUA_NOREF,LUA_NOREF,LUA_NOREF};
+#include "swtimer.h"
 
-void alarm_timer_common(lua_State* L, unsigned id){
-  if(alarm_timer_cb_ref[id] == LUA_NOREF)
-    return;
-  lua_rawgeti(L, LUA_REGISTRYINDEX, alarm_timer_cb_ref[id]);
-  lua_call(L, 0, 0);
-}
+#define TMR_OBJECT "tmr.timer"
+// Callbacks run per event before the rest is posted again
+#define TMR_DISPATCH_BATCH 8
 
-void alarm_timer_cb0(void *arg){
-  if( !arg )
-    return;
-  alarm_timer_common((lua_State*)arg, 0);
-}
+// A tmr.create() object or one of the NUM_TMR tmr.alarm() ids. All of them
+// share the single os_timer of the swtimer wheel.
+typedef struct tmr_timer
+{
+  swtimer_t timer;
+  struct tmr_timer *fired_next;   // Expired, waiting for its callback
+  struct tmr_timer *fired_prev;
+  uint8_t fired;
+  uint8_t repeat;
+  uint32_t interval;
+  int cb_ref;
+  int self_ref;                   // Keeps an armed object alive, LUA_NOREF for ids
+} tmr_timer_t;
+
+static tmr_timer_t alarm_timer[NUM_TMR];
+static tmr_timer_t *fired_head = NULL;
+static tmr_timer_t *fired_tail = NULL;
 
-void alarm_timer_cb1(void *arg){
-  if( !arg )
+static void tmr_fired_remove(tmr_timer_t *t){
+  if(!t->fired)
     return;
-  alarm_timer_common((lua_State*)arg, 1);
+  if(t->fired_prev)
+    t->fired_prev->fired_next = t->fired_next;
+  else
+    fired_head = t->fired_next;
+  if(t->fired_next)
+    t->fired_next->fired_prev = t->fired_prev;
+  else
+    fired_tail = t->fired_prev;
+  t->fired_next = t->fired_prev = NULL;
+  t->fired = 0;
 }
 
-void alarm_timer_cb2(void *arg){
-  if( !arg )
+// runs in the timer context, a late alarm is merged with the pending one
+static void tmr_timer_fire(void *arg){
+  tmr_timer_t *t = (tmr_timer_t *)arg;
+  if(t->fired || t->cb_ref == LUA_NOREF)
     return;
-  alarm_timer_common((lua_State*)arg, 2);
+  t->fired = 1;
+  t->fired_next = NULL;
+  t->fired_prev = fired_tail;
+  if(fired_tail)
+    fired_tail->fired_next = t;
+  else
+    fired_head = t;
+  fired_tail = t;
+  // One event stands for the whole list, any number of timers fit the queue
+  event_post(EVENT_TMR_ALARM, 0, 0, NULL);
 }
 
-void alarm_timer_cb3(void *arg){
-  if( !arg )
+// runs in the Lua task, see event_dispatch()
+static void alarm_timer_event(unsigned id, uint32_t arg, void *data){
+  lua_State *L = lua_getstate();
+  tmr_timer_t *t;
+  int n = TMR_DISPATCH_BATCH;
+  int nargs;
+  if(!L)
     return;
-  alarm_timer_common((lua_State*)arg, 3);
+  while(n-- > 0 && (t = fired_head) != NULL){
+    tmr_fired_remove(t);
+    if(t->cb_ref == LUA_NOREF)
+      continue;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, t->cb_ref);
+    nargs = 0;
+    if(t->self_ref != LUA_NOREF){
+      // Objects get themselves, a single shot one is released
+      lua_rawgeti(L, LUA_REGISTRYINDEX, t->self_ref);
+      nargs = 1;
+      if(!swtimer_armed(&t->timer)){
+        luaL_unref(L, LUA_REGISTRYINDEX, t->self_ref);
+        t->self_ref = LUA_NOREF;
+      }
+    }
+    lua_call(L, nargs, 0);
+  }
+  // Let other events in before the rest
+  if(fired_head)
+    event_post(EVENT_TMR_ALARM, 0, 0, NULL);
 }
 
-void alarm_timer_cb4(void *arg){
-  if( !arg )
-    return;
-  alarm_timer_common((lua_State*)arg, 4);
+static void tmr_timer_init(tmr_timer_t *t){
+  swtimer_setfn(&t->timer, tmr_timer_fire, t);
+  t->fired_next = t->fired_prev = NULL;
+  t->fired = 0;
+  t->repeat = 0;
+  t->interval = 0;
+  t->cb_ref = LUA_NOREF;
+  t->self_ref = LUA_NOREF;
 }
 
-void alarm_timer_cb5(void *arg){
-  if( !arg )
-    return;
-  alarm_timer_common((lua_State*)arg, 5);
+static void tmr_timer_stop(lua_State* L, tmr_timer_t *t){
+  swtimer_disarm(&t->timer);
+  tmr_fired_remove(t);
+  if(t->self_ref != LUA_NOREF){
+    luaL_unref(L, LUA_REGISTRYINDEX, t->self_ref);
+    t->self_ref = LUA_NOREF;
+  }
 }
 
-void alarm_timer_cb6(void *arg){
-  if( !arg )
-    return;
-  alarm_timer_common((lua_State*)arg, 6);
+// Reads ( interval, repeat, function ) at stack into t, the function is optional
+static int tmr_timer_setup(lua_State* L, tmr_timer_t *t, int stack){
+  s32 interval;
+  unsigned repeat = 0;
+
+  interval = luaL_checkinteger( L, stack );
+  stack++;
+  if ( interval <= 0 )
+    return luaL_error( L, "wrong arg range" );
+
+  if ( lua_isnumber(L, stack) ){
+    repeat = lua_tointeger(L, stack);
+    stack++;
+    if ( repeat != 1 && repeat != 0 )
+      return luaL_error( L, "wrong arg type" );
+  }
+
+  // luaL_checkanyfunction(L, stack);
+  if (lua_type(L, stack) == LUA_TFUNCTION || lua_type(L, stack) == LUA_TLIGHTFUNCTION){
+    lua_pushvalue(L, stack);  // copy argument (func) to the top of stack
+    if(t->cb_ref != LUA_NOREF)
+      luaL_unref(L, LUA_REGISTRYINDEX, t->cb_ref);
+    t->cb_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+
+  t->interval = interval;
+  t->repeat = repeat;
+  return 0;
 }
 
-typedef void (*alarm_timer_callback)(void *arg);
-static alarm_timer_callback alarm_timer_cb[NUM_TMR] = {alarm_timer_cb0,alarm_timer_cb1,alarm_timer_cb2,alarm_timer_cb3,alarm_timer_cb4,alarm_timer_cb5,alarm_timer_cb6};
+// Arms t, an object at index obj is kept alive until it expires or is stopped
+static void tmr_timer_start(lua_State* L, tmr_timer_t *t, int obj){
+  tmr_fired_remove(t);
+  swtimer_arm(&t->timer, t->interval, t->repeat);
+  if(obj && t->self_ref == LUA_NOREF){
+    lua_pushvalue(L, obj);
+    t->self_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+}
 
 // Lua: delay( us )
 static int tmr_delay( lua_State* L )
@@ -94,37 +185,11 @@ static int tmr_now( lua_State* L )
 // Lua: alarm( id, interval, repeat, function )
 static int tmr_alarm( lua_State* L )
 {
-  s32 interval;
-  unsigned repeat = 0;
-  int stack = 1;
-  
-  unsigned id = luaL_checkinteger( L, stack );
-  stack++;
+  unsigned id = luaL_checkinteger( L, 1 );
   MOD_CHECK_ID( tmr, id );
 
-  interval = luaL_checkinteger( L, stack );
-  stack++;
-  if ( interval <= 0 )
-    return luaL_error( L, "wrong arg range" );
-
-  if ( lua_isnumber(L, stack) ){
-    repeat = lua_tointeger(L, stack);
-    stack++;
-    if ( repeat != 1 && repeat != 0 )
-      return luaL_error( L, "wrong arg type" );
-  }
-
-  // luaL_checkanyfunction(L, stack);
-  if (lua_type(L, stack) == LUA_TFUNCTION || lua_type(L, stack) == LUA_TLIGHTFUNCTION){
-    lua_pushvalue(L, stack);  // copy argument (func) to the top of stack
-    if(alarm_timer_cb_ref[id] != LUA_NOREF)
-      luaL_unref(L, LUA_REGISTRYINDEX, alarm_timer_cb_ref[id]);
-    alarm_timer_cb_ref[id] = luaL_ref(L, LUA_REGISTRYINDEX);
-  }
-
-  os_timer_disarm(&(alarm_timer[id]));
-  os_timer_setfn(&(alarm_timer[id]), (os_timer_func_t *)(alarm_timer_cb[id]), L);
-  os_timer_arm(&(alarm_timer[id]), interval, repeat); 
+  tmr_timer_setup( L, &alarm_timer[id], 2 );
+  tmr_timer_start( L, &alarm_timer[id], 0 );
   return 0;  
 }
 
@@ -134,10 +199,108 @@ static int tmr_stop( lua_State* L )
   unsigned id = luaL_checkinteger( L, 1 );
   MOD_CHECK_ID( tmr, id );
 
-  os_timer_disarm(&(alarm_timer[id]));
+  tmr_timer_stop( L, &alarm_timer[id] );
   return 0;  
 }
 
+// Lua: t = create()
+static int tmr_create( lua_State* L )
+{
+  tmr_timer_t *t = (tmr_timer_t *)lua_newuserdata(L, sizeof(tmr_timer_t));
+  tmr_timer_init(t);
+  luaL_getmetatable(L, TMR_OBJECT);
+  lua_setmetatable(L, -2);
+  return 1;
+}
+
+// Lua: armed, wakeups, fired, maxlate = stats()
+static int tmr_stats( lua_State* L )
+{
+  swtimer_stats_t stats;
+  swtimer_get_stats(&stats);
+  lua_pushinteger(L, stats.armed);
+  lua_pushinteger(L, stats.wakeups);
+  lua_pushinteger(L, stats.fired);
+  lua_pushinteger(L, stats.max_late);
+  return 4;
+}
+
+// Lua: t:register( interval, repeat, function )
+static int tmr_obj_register( lua_State* L )
+{
+  tmr_timer_t *t = (tmr_timer_t *)luaL_checkudata(L, 1, TMR_OBJECT);
+  tmr_timer_setup( L, t, 2 );
+  return 0;
+}
+
+// Lua: t:alarm( interval, repeat, function )
+static int tmr_obj_alarm( lua_State* L )
+{
+  tmr_timer_t *t = (tmr_timer_t *)luaL_checkudata(L, 1, TMR_OBJECT);
+  tmr_timer_setup( L, t, 2 );
+  if(t->cb_ref == LUA_NOREF)
+    return luaL_error( L, "timer not registered" );
+  tmr_timer_start( L, t, 1 );
+  return 0;
+}
+
+// Lua: t:start(), restarts an armed timer
+static int tmr_obj_start( lua_State* L )
+{
+  tmr_timer_t *t = (tmr_timer_t *)luaL_checkudata(L, 1, TMR_OBJECT);
+  if(t->cb_ref == LUA_NOREF)
+    return luaL_error( L, "timer not registered" );
+  tmr_timer_start( L, t, 1 );
+  return 0;
+}
+
+// Lua: running = t:stop()
+static int tmr_obj_stop( lua_State* L )
+{
+  tmr_timer_t *t = (tmr_timer_t *)luaL_checkudata(L, 1, TMR_OBJECT);
+  lua_pushboolean(L, swtimer_armed(&t->timer));
+  tmr_timer_stop( L, t );
+  return 1;
+}
+
+// Lua: t:interval( ms ), an armed timer is restarted with it
+static int tmr_obj_interval( lua_State* L )
+{
+  tmr_timer_t *t = (tmr_timer_t *)luaL_checkudata(L, 1, TMR_OBJECT);
+  s32 interval = luaL_checkinteger( L, 2 );
+  if ( interval <= 0 )
+    return luaL_error( L, "wrong arg range" );
+  t->interval = interval;
+  if(swtimer_armed(&t->timer))
+    swtimer_arm(&t->timer, t->interval, t->repeat);
+  return 0;
+}
+
+// Lua: running, repeat = t:state()
+static int tmr_obj_state( lua_State* L )
+{
+  tmr_timer_t *t = (tmr_timer_t *)luaL_checkudata(L, 1, TMR_OBJECT);
+  if(t->cb_ref == LUA_NOREF){
+    lua_pushnil(L);
+    return 1;
+  }
+  lua_pushboolean(L, swtimer_armed(&t->timer));
+  lua_pushinteger(L, t->repeat);
+  return 2;
+}
+
+// Lua: t:unregister(), also called by __gc
+static int tmr_obj_unregister( lua_State* L )
+{
+  tmr_timer_t *t = (tmr_timer_t *)luaL_checkudata(L, 1, TMR_OBJECT);
+  tmr_timer_stop( L, t );
+  if(t->cb_ref != LUA_NOREF){
+    luaL_unref(L, LUA_REGISTRYINDEX, t->cb_ref);
+    t->cb_ref = LUA_NOREF;
+  }
+  return 0;
+}
+
 // extern void update_key_led();
 // Lua: wdclr()
 static int tmr_wdclr( lua_State* L )
@@ -147,7 +310,7 @@ static int tmr_wdclr( lua_State* L )
   return 0;  
 }
 
-static os_timer_t rtc_timer_updator;
+static swtimer_t rtc_timer_updator;
 static uint64_t cur_count = 0;
 static uint64_t rtc_us = 0;
 void rtc_timer_update_cb(void *arg){
@@ -172,16 +335,33 @@ static int tmr_time( lua_State* L )
 // Module function map
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
+static const LUA_REG_TYPE tmr_obj_map[] =
+{
+  { LSTRKEY( "__gc" ), LFUNCVAL( tmr_obj_unregister ) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "__index" ), LROVAL( tmr_obj_map ) },
+#endif
+  { LSTRKEY( "alarm" ), LFUNCVAL( tmr_obj_alarm ) },
+  { LSTRKEY( "interval" ), LFUNCVAL( tmr_obj_interval ) },
+  { LSTRKEY( "register" ), LFUNCVAL( tmr_obj_register ) },
+  { LSTRKEY( "start" ), LFUNCVAL( tmr_obj_start ) },
+  { LSTRKEY( "state" ), LFUNCVAL( tmr_obj_state ) },
+  { LSTRKEY( "stop" ), LFUNCVAL( tmr_obj_stop ) },
+  { LSTRKEY( "unregister" ), LFUNCVAL( tmr_obj_unregister ) },
+  { LNILKEY, LNILVAL }
+};
+
 const LUA_REG_TYPE tmr_map[] = 
 {
+  { LSTRKEY( "alarm" ), LFUNCVAL( tmr_alarm ) },
+  { LSTRKEY( "create" ), LFUNCVAL( tmr_create ) },
   { LSTRKEY( "delay" ), LFUNCVAL( tmr_delay ) },
   { LSTRKEY( "now" ), LFUNCVAL( tmr_now ) },
-  { LSTRKEY( "alarm" ), LFUNCVAL( tmr_alarm ) },
+  { LSTRKEY( "stats" ), LFUNCVAL( tmr_stats ) },
   { LSTRKEY( "stop" ), LFUNCVAL( tmr_stop ) },
-  { LSTRKEY( "wdclr" ), LFUNCVAL( tmr_wdclr ) },
   { LSTRKEY( "time" ), LFUNCVAL( tmr_time ) },
+  { LSTRKEY( "wdclr" ), LFUNCVAL( tmr_wdclr ) },
 #if LUA_OPTIMIZE_MEMORY > 0
-
 #endif
   { LNILKEY, LNILVAL }
 };
@@ -189,21 +369,31 @@ const LUA_REG_TYPE tmr_map[] =
 LUALIB_API int luaopen_tmr( lua_State *L )
 {
   int i = 0;
-  for(i=0;i<NUM_TMR;i++){
-    os_timer_disarm(&(alarm_timer[i]));
-    os_timer_setfn(&(alarm_timer[i]), (os_timer_func_t *)(alarm_timer_cb[i]), L);
-  }
+  swtimer_init();
+  event_register(EVENT_TMR_ALARM, alarm_timer_event, EVENT_COALESCE);
+  for(i=0;i<NUM_TMR;i++)
+    tmr_timer_init(&alarm_timer[i]);
 
-  os_timer_disarm(&rtc_timer_updator);
-  os_timer_setfn(&rtc_timer_updator, (os_timer_func_t *)(rtc_timer_update_cb), NULL);
-  os_timer_arm(&rtc_timer_updator, 500, 1); 
+  swtimer_setfn(&rtc_timer_updator, rtc_timer_update_cb, NULL);
+  swtimer_arm(&rtc_timer_updator, 500, 1); 
 
 #if LUA_OPTIMIZE_MEMORY > 0
+  luaL_rometatable(L, TMR_OBJECT, (void *)tmr_obj_map);  // create metatable for tmr.timer
   return 0;
 #else // #if LUA_OPTIMIZE_MEMORY > 0
   luaL_register( L, AUXLIB_TMR, tmr_map );
   // Add constants
 
+  // create metatable
+  luaL_newmetatable(L, TMR_OBJECT);
+  // metatable.__index = metatable
+  lua_pushliteral(L, "__index");
+  lua_pushvalue(L,-2);
+  lua_rawset(L,-3);
+  // Setup the methods inside metatable
+  luaL_register(L, NULL, tmr_obj_map);
+  lua_pop(L, 1);
+
   return 1;
 #endif // #if LUA_OPTIMIZE_MEMORY > 0  
 }
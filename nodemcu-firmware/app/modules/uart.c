@@ -9,10 +9,25 @@
 
 #include "c_types.h"
 #include "c_string.h"
+#include "c_stdlib.h"
+#include "c_stdio.h"
 
 static lua_State *gL = NULL;
 static int uart_receive_rf = LUA_NOREF;
 bool run_input = true;
+
+// Run a callback with its argument on the stack. It runs from readline(),
+// outside of any protected call: an error is reported like the console
+// does and the input goes on.
+static void uart_callback( void )
+{
+  if( lua_pcall( gL, 1, 0, 0 ) != 0 ){
+    const char *msg = lua_tostring( gL, -1 );
+    c_printf( "lua: %s\n", msg ? msg : "(error object is not a string)" );
+    lua_pop( gL, 1 );
+  }
+}
+
 bool uart_on_data_cb(const char *buf, size_t len){
   if(!buf || len==0)
     return false;
@@ -22,13 +37,223 @@ bool uart_on_data_cb(const char *buf, size_t len){
     return false;
   lua_rawgeti(gL, LUA_REGISTRYINDEX, uart_receive_rf);
   lua_pushlstring(gL, buf, len);
-  lua_call(gL, 1, 0);
+  uart_callback();
   return !run_input;
 }
 
 uint16_t need_len = 0;
 int16_t end_char = -1;
+
+// Frame extractor, bytes are collected in C and only complete frames reach Lua
+#define FRAME_MAX_DEFAULT   64
+
+#define FRAME_START         0   // waiting for the start char
+#define FRAME_LENGTH        1   // reading the length prefix
+#define FRAME_PAYLOAD       2   // reading the payload
+
+typedef struct
+{
+  int16_t start;      // start char, -1 = none
+  int16_t stop;       // end char, -1 = none
+  uint16_t size;      // fixed payload size, 0 = none
+  uint8_t prefix;     // big endian length prefix bytes, 0 = none
+  uint8_t number;     // deliver decimal payloads as numbers
+  uint16_t max;       // payload buffer size
+  uint8_t state;
+  uint8_t got;        // length prefix bytes read
+  uint16_t need;      // payload length of the current frame, 0 = until stop
+  uint16_t pos;
+  char *buf;
+} uart_frame_t;
+
+static uart_frame_t *uart_frame = NULL;
+static int uart_frame_rf = LUA_NOREF;
+
+static void uart_frame_reset( uart_frame_t *f )
+{
+  f->pos = 0;
+  f->got = 0;
+  f->need = f->size;
+  if( f->start >= 0 )
+    f->state = FRAME_START;
+  else if( f->prefix )
+    f->state = FRAME_LENGTH;
+  else
+    f->state = FRAME_PAYLOAD;
+}
+
+// decimal integer with optional sign and surrounding spaces
+static bool uart_frame_number( const char *buf, size_t len, lua_Number *value )
+{
+  size_t i = 0;
+  bool negative = false, digits = false;
+  lua_Number n = 0;
+
+  while( i < len && buf[i] == ' ' )
+    i++;
+  if( i < len && ( buf[i] == '-' || buf[i] == '+' ) )
+    negative = ( buf[i++] == '-' );
+  while( i < len && buf[i] >= '0' && buf[i] <= '9' ){
+    n = n * 10 + ( buf[i++] - '0' );
+    digits = true;
+  }
+  while( i < len && ( buf[i] == ' ' || buf[i] == '\r' || buf[i] == '\n' ) )
+    i++;
+  if( !digits || i != len )
+    return false;
+  *value = negative ? -n : n;
+  return true;
+}
+
+// the payload is copied to the stack before the callback runs,
+// the callback may replace the extractor with uart.on("frame", ...)
+static void uart_frame_deliver( uart_frame_t *f )
+{
+  lua_Number value;
+
+  if( uart_frame_rf == LUA_NOREF || !gL ){
+    uart_frame_reset( f );
+    return;
+  }
+  if( !f->number ){
+    lua_rawgeti( gL, LUA_REGISTRYINDEX, uart_frame_rf );
+    lua_pushlstring( gL, f->buf, f->pos );
+  }else if( uart_frame_number( f->buf, f->pos, &value ) ){
+    lua_rawgeti( gL, LUA_REGISTRYINDEX, uart_frame_rf );
+    lua_pushnumber( gL, value );
+  }else{
+    uart_frame_reset( f );
+    return;
+  }
+  uart_frame_reset( f );
+  uart_callback();
+}
+
+// Feed one received byte to the frame extractor, returns false if it is off
+bool uart_frame_char( char ch )
+{
+  uart_frame_t *f = uart_frame;
+  if( !f )
+    return false;
+
+  switch( f->state ){
+    case FRAME_START:
+      if( ( unsigned char )ch == f->start )
+        f->state = f->prefix ? FRAME_LENGTH : FRAME_PAYLOAD;
+      break;
+
+    case FRAME_LENGTH:
+      f->need = ( f->need << 8 ) | ( unsigned char )ch;
+      if( ++f->got < f->prefix )
+        break;
+      if( f->need > f->max )
+        uart_frame_reset( f );
+      else if( f->need == 0 )
+        uart_frame_deliver( f );
+      else
+        f->state = FRAME_PAYLOAD;
+      break;
+
+    case FRAME_PAYLOAD:
+      if( f->stop >= 0 && ( unsigned char )ch == f->stop ){
+        uart_frame_deliver( f );
+        break;
+      }
+      // a start char inside a delimited frame starts it over
+      if( f->need == 0 && f->start >= 0 && ( unsigned char )ch == f->start ){
+        f->pos = 0;
+        break;
+      }
+      if( f->pos >= f->max ){   // too long, resync
+        uart_frame_reset( f );
+        break;
+      }
+      f->buf[f->pos++] = ch;
+      if( f->need && f->pos == f->need )
+        uart_frame_deliver( f );
+      break;
+  }
+  return true;
+}
+
+static void uart_frame_free( lua_State* L )
+{
+  if( uart_frame_rf != LUA_NOREF ){
+    luaL_unref( L, LUA_REGISTRYINDEX, uart_frame_rf );
+    uart_frame_rf = LUA_NOREF;
+  }
+  if( uart_frame ){
+    c_free( uart_frame->buf );
+    c_free( uart_frame );
+    uart_frame = NULL;
+  }
+}
+
+// read a single char field of the frame description, -1 if absent
+static int16_t uart_frame_char_field( lua_State* L, int table, const char *name )
+{
+  size_t len;
+  const char *str;
+  int16_t ch = -1;
+
+  lua_getfield( L, table, name );
+  if( !lua_isnil( L, -1 ) ){
+    str = luaL_checklstring( L, -1, &len );
+    if( len != 1 )
+      return luaL_error( L, "wrong arg range" );
+    ch = ( unsigned char )str[0];
+  }
+  lua_pop( L, 1 );
+  return ch;
+}
+
+static int uart_frame_int_field( lua_State* L, int table, const char *name, int def )
+{
+  int value = def;
+
+  lua_getfield( L, table, name );
+  if( !lua_isnil( L, -1 ) )
+    value = luaL_checkinteger( L, -1 );
+  lua_pop( L, 1 );
+  return value;
+}
+
+// Parse { start=, stop=, size=, prefix=, max=, number= } at index table
+static int uart_frame_setup( lua_State* L, int table )
+{
+  uart_frame_t f;
+  int modes;
+
+  luaL_checktype( L, table, LUA_TTABLE );
+  c_memset( &f, 0, sizeof( f ) );
+  f.start = uart_frame_char_field( L, table, "start" );
+  f.stop = uart_frame_char_field( L, table, "stop" );
+  f.size = uart_frame_int_field( L, table, "size", 0 );
+  f.prefix = uart_frame_int_field( L, table, "prefix", 0 );
+  f.max = uart_frame_int_field( L, table, "max", f.size ? f.size : FRAME_MAX_DEFAULT );
+  lua_getfield( L, table, "number" );
+  f.number = lua_toboolean( L, -1 );
+  lua_pop( L, 1 );
+
+  modes = ( f.stop >= 0 ) + ( f.size > 0 ) + ( f.prefix > 0 );
+  if( modes != 1 || f.prefix > 2 || f.max == 0 || f.size > f.max )
+    return luaL_error( L, "wrong arg range" );
+
+  uart_frame_free( L );
+  uart_frame = ( uart_frame_t * )c_malloc( sizeof( uart_frame_t ) );
+  if( uart_frame )
+    f.buf = ( char * )c_malloc( f.max );
+  if( !uart_frame || !f.buf ){
+    c_free( uart_frame );
+    uart_frame = NULL;
+    return luaL_error( L, "not enough memory" );
+  }
+  *uart_frame = f;
+  uart_frame_reset( uart_frame );
+  return 0;
+}
 // Lua: uart.on("method", [number/char], function, [run_input])
+// Lua: uart.on("frame", { start, stop, size, prefix, max, number }, function, [run_input])
 static int uart_on( lua_State* L )
 {
   size_t sl, el;
@@ -39,7 +264,17 @@ static int uart_on( lua_State* L )
   if (method == NULL)
     return luaL_error( L, "wrong arg type" );
 
-  if( lua_type( L, stack ) == LUA_TNUMBER )
+  if( sl == 5 && c_strcmp( method, "frame" ) == 0 )
+  {
+    if( lua_isnoneornil( L, stack ) ){    // uart.on("frame") turns the extractor off
+      uart_frame_free( L );
+      run_input = true;
+      return 0;
+    }
+    uart_frame_setup( L, stack );
+    stack++;
+  }
+  else if( lua_type( L, stack ) == LUA_TNUMBER )
   {
     need_len = ( uint16_t )luaL_checkinteger( L, stack );
     stack++;
@@ -83,6 +318,17 @@ static int uart_on( lua_State* L )
     } else {
       lua_pop(L, 1);
     }
+  }else if(sl == 5 && c_strcmp(method, "frame") == 0){
+    run_input = true;
+    if(!lua_isnil(L, -1)){
+      uart_frame_rf = luaL_ref(L, LUA_REGISTRYINDEX);
+      gL = L;
+      if(run==0)
+        run_input = false;
+    } else {
+      lua_pop(L, 1);
+      uart_frame_free(L);
+    }
   }else{
     lua_pop(L, 1);
     return luaL_error( L, "method not supported" );
@@ -91,7 +337,7 @@ static int uart_on( lua_State* L )
 }
 
 bool uart0_echo = true;
-// Lua: actualbaud = setup( id, baud, databits, parity, stopbits, echo )
+// Lua: actualbaud = setup( id, baud, databits, parity, stopbits, echo, rxsize )
 static int uart_setup( lua_State* L )
 {
   unsigned id, databits, parity, stopbits, echo = 1;
@@ -111,6 +357,11 @@ static int uart_setup( lua_State* L )
       uart0_echo = false;
   }
 
+  if(lua_isnumber(L,7)){
+    if( platform_uart_set_buffer( id, lua_tointeger(L,7) ) != PLATFORM_OK )
+      return luaL_error( L, "rx buffer not allocated" );
+  }
+
   res = platform_uart_setup( id, baud, databits, parity, stopbits );
   lua_pushinteger( L, res );
   return 1;
@@ -151,11 +402,10 @@ static int uart_write( lua_State* L )
 #include "lrodefs.h"
 const LUA_REG_TYPE uart_map[] = 
 {
+  { LSTRKEY( "on" ), LFUNCVAL( uart_on ) },
   { LSTRKEY( "setup" ),  LFUNCVAL( uart_setup ) },
   { LSTRKEY( "write" ), LFUNCVAL( uart_write ) },
-  { LSTRKEY( "on" ), LFUNCVAL( uart_on ) },
 #if LUA_OPTIMIZE_MEMORY > 0
-
 #endif
   { LNILKEY, LNILVAL }
 };
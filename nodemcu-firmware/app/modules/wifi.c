@@ -172,7 +172,7 @@ static int wifi_getmac( lua_State* L, uint8_t mode )
 // Lua: mac = wifi.xx.setmac()
 static int wifi_setmac( lua_State* L, uint8_t mode )
 {
-  unsigned len = 0;
+  size_t len = 0;
   const char *mac = luaL_checklstring( L, 1, &len );
   if(len!=6)
     return luaL_error( L, "wrong arg type" );
@@ -495,16 +495,16 @@ static int wifi_ap_config( lua_State* L )
 #include "lrodefs.h"
 static const LUA_REG_TYPE wifi_station_map[] =
 {
+  { LSTRKEY( "autoconnect" ), LFUNCVAL ( wifi_station_setauto ) },
   { LSTRKEY( "config" ), LFUNCVAL ( wifi_station_config ) },
   { LSTRKEY( "connect" ), LFUNCVAL ( wifi_station_connect4lua ) },
   { LSTRKEY( "disconnect" ), LFUNCVAL ( wifi_station_disconnect4lua ) },
-  { LSTRKEY( "autoconnect" ), LFUNCVAL ( wifi_station_setauto ) },
-  { LSTRKEY( "getip" ), LFUNCVAL ( wifi_station_getip ) },
-  { LSTRKEY( "setip" ), LFUNCVAL ( wifi_station_setip ) },
+  { LSTRKEY( "getap" ), LFUNCVAL ( wifi_station_listap ) },
   { LSTRKEY( "getbroadcast" ), LFUNCVAL ( wifi_station_getbroadcast) },
+  { LSTRKEY( "getip" ), LFUNCVAL ( wifi_station_getip ) },
   { LSTRKEY( "getmac" ), LFUNCVAL ( wifi_station_getmac ) },
+  { LSTRKEY( "setip" ), LFUNCVAL ( wifi_station_setip ) },
   { LSTRKEY( "setmac" ), LFUNCVAL ( wifi_station_setmac ) },
-  { LSTRKEY( "getap" ), LFUNCVAL ( wifi_station_listap ) },
   { LSTRKEY( "status" ), LFUNCVAL ( wifi_station_status ) },
   { LNILKEY, LNILVAL }
 };
@@ -512,43 +512,41 @@ static const LUA_REG_TYPE wifi_station_map[] =
 static const LUA_REG_TYPE wifi_ap_map[] =
 {
   { LSTRKEY( "config" ), LFUNCVAL( wifi_ap_config ) },
-  { LSTRKEY( "getip" ), LFUNCVAL ( wifi_ap_getip ) },
-  { LSTRKEY( "setip" ), LFUNCVAL ( wifi_ap_setip ) },
   { LSTRKEY( "getbroadcast" ), LFUNCVAL ( wifi_ap_getbroadcast) },
+  { LSTRKEY( "getip" ), LFUNCVAL ( wifi_ap_getip ) },
   { LSTRKEY( "getmac" ), LFUNCVAL ( wifi_ap_getmac ) },
+  { LSTRKEY( "setip" ), LFUNCVAL ( wifi_ap_setip ) },
   { LSTRKEY( "setmac" ), LFUNCVAL ( wifi_ap_setmac ) },
   { LNILKEY, LNILVAL }
 };
 
 const LUA_REG_TYPE wifi_map[] = 
 {
-  { LSTRKEY( "setmode" ), LFUNCVAL( wifi_setmode ) },
-  { LSTRKEY( "getmode" ), LFUNCVAL( wifi_getmode ) },
-  { LSTRKEY( "startsmart" ), LFUNCVAL( wifi_start_smart ) },
-  { LSTRKEY( "stopsmart" ), LFUNCVAL( wifi_exit_smart ) },
-  { LSTRKEY( "sleeptype" ), LFUNCVAL( wifi_sleeptype ) },
 #if LUA_OPTIMIZE_MEMORY > 0
-  { LSTRKEY( "sta" ), LROVAL( wifi_station_map ) },
-  { LSTRKEY( "ap" ), LROVAL( wifi_ap_map ) },
-
+  { LSTRKEY( "LIGHT_SLEEP" ), LNUMVAL( LIGHT_SLEEP_T ) },
+  { LSTRKEY( "MODEM_SLEEP" ), LNUMVAL( MODEM_SLEEP_T ) },
+  { LSTRKEY( "NONE_SLEEP" ), LNUMVAL( NONE_SLEEP_T ) },
+  { LSTRKEY( "SOFTAP" ), LNUMVAL( SOFTAP_MODE ) },
   // { LSTRKEY( "NULLMODE" ), LNUMVAL( NULL_MODE ) },
   { LSTRKEY( "STATION" ), LNUMVAL( STATION_MODE ) },
-  { LSTRKEY( "SOFTAP" ), LNUMVAL( SOFTAP_MODE ) },
   { LSTRKEY( "STATIONAP" ), LNUMVAL( STATIONAP_MODE ) },
-
-  { LSTRKEY( "NONE_SLEEP" ), LNUMVAL( NONE_SLEEP_T ) },
-  { LSTRKEY( "LIGHT_SLEEP" ), LNUMVAL( LIGHT_SLEEP_T ) },
-  { LSTRKEY( "MODEM_SLEEP" ), LNUMVAL( MODEM_SLEEP_T ) },
-
   // { LSTRKEY( "STA_IDLE" ), LNUMVAL( STATION_IDLE ) },
   // { LSTRKEY( "STA_CONNECTING" ), LNUMVAL( STATION_CONNECTING ) },
   // { LSTRKEY( "STA_WRONGPWD" ), LNUMVAL( STATION_WRONG_PASSWORD ) },
   // { LSTRKEY( "STA_APNOTFOUND" ), LNUMVAL( STATION_NO_AP_FOUND ) },
   // { LSTRKEY( "STA_FAIL" ), LNUMVAL( STATION_CONNECT_FAIL ) },
   // { LSTRKEY( "STA_GOTIP" ), LNUMVAL( STATION_GOT_IP ) },
-
   { LSTRKEY( "__metatable" ), LROVAL( wifi_map ) },
+  { LSTRKEY( "ap" ), LROVAL( wifi_ap_map ) },
+#endif
+  { LSTRKEY( "getmode" ), LFUNCVAL( wifi_getmode ) },
+  { LSTRKEY( "setmode" ), LFUNCVAL( wifi_setmode ) },
+  { LSTRKEY( "sleeptype" ), LFUNCVAL( wifi_sleeptype ) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "sta" ), LROVAL( wifi_station_map ) },
 #endif
+  { LSTRKEY( "startsmart" ), LFUNCVAL( wifi_start_smart ) },
+  { LSTRKEY( "stopsmart" ), LFUNCVAL( wifi_exit_smart ) },
   { LNILKEY, LNILVAL }
 };
 
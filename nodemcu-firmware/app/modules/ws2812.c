@@ -3,6 +3,10 @@
 #include "platform.h"
 #include "auxmods.h"
 #include "lrotable.h"
+#include "c_stdlib.h"
+#include "user_interface.h"
+#include "driver/uart.h"
+#include "ws2812.h"
 /**
  * All this code is mostly from http://www.esp8266.com/viewtopic.php?f=21&t=1143&sid=a620a377672cfe9f666d672398415fcb
  * from user Markus Gritsch.
@@ -35,22 +39,14 @@ static void ICACHE_FLASH_ATTR send_ws_1(uint8_t gpio) {
     GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, 1 << gpio);
 }
 
-// Lua: ws2812.write(pin, "string")
-// Byte triples in the string are interpreted as G R B values.
-// ws2812.write(4, string.char(0, 255, 0)) uses GPIO2 and sets the first LED red.
-// ws2812.write(3, string.char(0, 0, 255):rep(10)) uses GPIO0 and sets ten LEDs blue.
-// ws2812.write(4, string.char(255, 0, 0, 255, 255, 255)) first LED green, second LED white.
-static int ICACHE_FLASH_ATTR ws2812_write(lua_State* L) {
-  const uint8_t pin = luaL_checkinteger(L, 1);
-  size_t length;
-  const char *buffer = luaL_checklstring(L, 2, &length);
-
+// Send G R B byte triples to the strip on a given pin (blocking).
+void ICACHE_FLASH_ATTR ws2812_write_buffer(uint8_t pin, const uint8_t *buffer, size_t length) {
   platform_gpio_mode(pin, PLATFORM_GPIO_OUTPUT, PLATFORM_GPIO_FLOAT);
   platform_gpio_write(pin, 0);
   os_delay_us(10);
 
   os_intr_lock();
-  const char * const end = buffer + length;
+  const uint8_t * const end = buffer + length;
   while (buffer != end) {
     uint8_t mask = 0x80;
     while (mask) {
@@ -60,14 +56,215 @@ static int ICACHE_FLASH_ATTR ws2812_write(lua_State* L) {
     ++buffer;
   }
   os_intr_unlock();
+}
+
+// Lua: ws2812.write(pin, "string")
+// Byte triples in the string are interpreted as G R B values.
+// ws2812.write(4, string.char(0, 255, 0)) uses GPIO2 and sets the first LED red.
+// ws2812.write(3, string.char(0, 0, 255):rep(10)) uses GPIO0 and sets ten LEDs blue.
+// ws2812.write(4, string.char(255, 0, 0, 255, 255, 255)) first LED green, second LED white.
+static int ICACHE_FLASH_ATTR ws2812_write(lua_State* L) {
+  const uint8_t pin = luaL_checkinteger(L, 1);
+  size_t length;
+  const char *buffer = luaL_checklstring(L, 2, &length);
+
+  ws2812_write_buffer(pin, (const uint8_t *)buffer, length);
+
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+// -- Non-blocking output through UART1 TX (GPIO2)
+// The UART runs at 3.2 Mbaud with 6 data bits and inverted TX line, so every
+// UART frame (start bit, 6 data bits, stop bit) lasts 2.5 us and carries two
+// WS2812 bits of 1.25 us each: a 0 is one high UART bit followed by three low
+// ones, a 1 is three high bits followed by one low bit.
+// The whole buffer is encoded before the transfer starts and the TX FIFO is
+// refilled from the TX FIFO empty interrupt, interrupts are never locked.
+
+#define WS2812_UART         1
+#define WS2812_BAUD         3200000
+#define WS2812_FIFO_THRHD   32
+#define WS2812_TASK_PRIO    USER_TASK_PRIO_1
+#define WS2812_QUEUE_LEN    2
+#define WS2812_SIG_DONE     0
+
+// UART frames for two WS2812 bits (first bit is the most significant one)
+static const uint8_t ws2812_uart_bits[4] = { 0x37, 0x07, 0x34, 0x04 };
+
+static lua_State *gL = NULL;
+static os_event_t *ws2812_queue = NULL;
+static int ws2812_done_ref = LUA_NOREF;
+
+static uint8_t *ws2812_frames = NULL;     // encoded UART frames
+static volatile size_t ws2812_length = 0; // number of encoded UART frames
+static volatile size_t ws2812_pos = 0;    // number of frames put into TX FIFO
+static volatile uint8_t ws2812_busy = 0;
+static ws2812_idle_fn ws2812_idle = NULL;  // C code waiting for the UART
+static void *ws2812_idle_arg = NULL;
+static uint32_t ws2812_saved_conf0;
+static uint32_t ws2812_saved_clkdiv;
+
+// Encode a GRB buffer into UART frames, 4 frames per source byte.
+void ICACHE_FLASH_ATTR ws2812_encode(const uint8_t *src, size_t length, uint8_t *dst) {
+  const uint8_t * const end = src + length;
+  while (src != end) {
+    *dst++ = ws2812_uart_bits[(*src >> 6) & 3];
+    *dst++ = ws2812_uart_bits[(*src >> 4) & 3];
+    *dst++ = ws2812_uart_bits[(*src >> 2) & 3];
+    *dst++ = ws2812_uart_bits[*src & 3];
+    ++src;
+  }
+}
+
+// TX FIFO empty interrupt handler, runs in the interrupt context.
+static void ws2812_fill_fifo(void) {
+  uint32_t fifo_cnt;
+
+  fifo_cnt = (READ_PERI_REG(UART_STATUS(WS2812_UART)) >> UART_TXFIFO_CNT_S) & UART_TXFIFO_CNT;
+  while (fifo_cnt++ < UART_FIFO_LEN && ws2812_pos != ws2812_length)
+    WRITE_PERI_REG(UART_FIFO(WS2812_UART), ws2812_frames[ws2812_pos++]);
+
+  if (ws2812_pos == ws2812_length) {
+    // All frames are queued, the task waits for the FIFO to drain
+    CLEAR_PERI_REG_MASK(UART_INT_ENA(WS2812_UART), UART_TXFIFO_EMPTY_INT_ENA);
+    system_os_post(WS2812_TASK_PRIO, WS2812_SIG_DONE, 0);
+  }
+}
+
+// Transfer completion task, restores UART1 and notifies Lua.
+static void ICACHE_FLASH_ATTR ws2812_task(os_event_t *e) {
+  if (e->sig != WS2812_SIG_DONE)
+    return;
+
+  // Wait for the FIFO to drain (up to 320 us), then for the last frame to
+  // leave the shift register
+  while (READ_PERI_REG(UART_STATUS(WS2812_UART)) & (UART_TXFIFO_CNT << UART_TXFIFO_CNT_S));
+  os_delay_us(3);
+
+  uart1_tx_empty_attach(NULL);
+  WRITE_PERI_REG(UART_CONF0(WS2812_UART), ws2812_saved_conf0);
+  WRITE_PERI_REG(UART_CLKDIV(WS2812_UART), ws2812_saved_clkdiv);
+
+  c_free(ws2812_frames);
+  ws2812_frames = NULL;
+  ws2812_busy = 0;
+
+  if (gL != NULL && ws2812_done_ref != LUA_NOREF) {
+    int ref = ws2812_done_ref;
+    ws2812_done_ref = LUA_NOREF;
+    lua_rawgeti(gL, LUA_REGISTRYINDEX, ref);
+    luaL_unref(gL, LUA_REGISTRYINDEX, ref);
+    lua_call(gL, 0, 0);
+  }
+
+  // The Lua callback goes first, a waiting sender finding the UART busy
+  // again waits once more
+  if (ws2812_idle != NULL) {
+    ws2812_idle_fn fn = ws2812_idle;
+    ws2812_idle = NULL;
+    fn(ws2812_idle_arg);
+  }
+}
+
+// Call fn(arg) once the transfer in progress is done. There is one waiting
+// sender, a later call replaces it.
+void ICACHE_FLASH_ATTR ws2812_when_idle(ws2812_idle_fn fn, void *arg) {
+  ws2812_idle = fn;
+  ws2812_idle_arg = arg;
+}
+
+// Forget a waiting sender that is going away
+void ICACHE_FLASH_ATTR ws2812_cancel_idle(void *arg) {
+  if (ws2812_idle_arg == arg)
+    ws2812_idle = NULL;
+}
+
+// Start sending G R B byte triplets from GPIO2, WS2812_OK once the transfer
+// runs. The buffer is encoded right away and may change afterwards.
+int ICACHE_FLASH_ATTR ws2812_send_buffer(const uint8_t *buffer, size_t length) {
+  if (ws2812_busy)
+    return WS2812_BUSY;
+
+  if (length == 0)
+    return WS2812_OK;
+
+  ws2812_frames = (uint8_t *)c_malloc(length * 4);
+  if (ws2812_frames == NULL)
+    return WS2812_NOMEM;
+
+  ws2812_encode(buffer, length, ws2812_frames);
+  ws2812_length = length * 4;
+  ws2812_pos = 0;
+  ws2812_busy = 1;
 
+  if (ws2812_queue == NULL) {
+    ws2812_queue = (os_event_t *)c_malloc(sizeof(os_event_t) * WS2812_QUEUE_LEN);
+    system_os_task(ws2812_task, WS2812_TASK_PRIO, ws2812_queue, WS2812_QUEUE_LEN);
+  }
+
+  // UART1 is used for debug output otherwise - keep its configuration
+  ws2812_saved_conf0 = READ_PERI_REG(UART_CONF0(WS2812_UART));
+  ws2812_saved_clkdiv = READ_PERI_REG(UART_CLKDIV(WS2812_UART));
+
+  PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO2_U, FUNC_U1TXD_BK);
+  WRITE_PERI_REG(UART_CLKDIV(WS2812_UART), UART_CLK_FREQ / WS2812_BAUD);
+  WRITE_PERI_REG(UART_CONF0(WS2812_UART), UART_TXD_INV
+                 | (ONE_STOP_BIT << UART_STOP_BIT_NUM_S)
+                 | (SIX_BITS << UART_BIT_NUM_S));
+
+  SET_PERI_REG_MASK(UART_CONF0(WS2812_UART), UART_TXFIFO_RST);
+  CLEAR_PERI_REG_MASK(UART_CONF0(WS2812_UART), UART_TXFIFO_RST);
+
+  // The inverted line idles low, which also provides the reset pulse
+  os_delay_us(50);
+
+  CLEAR_PERI_REG_MASK(UART_CONF1(WS2812_UART), UART_TXFIFO_EMPTY_THRHD << UART_TXFIFO_EMPTY_THRHD_S);
+  SET_PERI_REG_MASK(UART_CONF1(WS2812_UART), WS2812_FIFO_THRHD << UART_TXFIFO_EMPTY_THRHD_S);
+
+  uart1_tx_empty_attach(ws2812_fill_fifo);
+  WRITE_PERI_REG(UART_INT_CLR(WS2812_UART), UART_TXFIFO_EMPTY_INT_CLR);
+  SET_PERI_REG_MASK(UART_INT_ENA(WS2812_UART), UART_TXFIFO_EMPTY_INT_ENA);
+
+  return WS2812_OK;
+}
+
+// Lua: ws2812.send("string" [, callback])
+// Same G R B byte triplets as ws2812.write, but the strip is always driven
+// from GPIO2 (pin 4) by UART1 and the call returns immediately.
+// The optional callback is called once the transfer is done.
+// ws2812.send(string.char(0, 255, 0):rep(60), function() print("done") end)
+static int ICACHE_FLASH_ATTR ws2812_send(lua_State* L) {
+  size_t length;
+  const char *buffer = luaL_checklstring(L, 1, &length);
+
+  switch (ws2812_send_buffer((const uint8_t *)buffer, length)) {
+    case WS2812_BUSY:
+      return luaL_error(L, "ws2812 is busy");
+    case WS2812_NOMEM:
+      return luaL_error(L, "not enough memory");
+  }
+
+  if (length > 0 && (lua_type(L, 2) == LUA_TFUNCTION || lua_type(L, 2) == LUA_TLIGHTFUNCTION)) {
+    gL = L;
+    lua_pushvalue(L, 2);
+    ws2812_done_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
   return 0;
 }
 
+// Lua: busy = ws2812.busy()
+static int ICACHE_FLASH_ATTR ws2812_is_busy(lua_State* L) {
+  lua_pushboolean(L, ws2812_busy);
+  return 1;
+}
+
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
 const LUA_REG_TYPE ws2812_map[] =
 {
+  { LSTRKEY( "busy" ), LFUNCVAL( ws2812_is_busy )},
+  { LSTRKEY( "send" ), LFUNCVAL( ws2812_send )},
   { LSTRKEY( "write" ), LFUNCVAL( ws2812_write )},
   { LNILKEY, LNILVAL}
 };
@@ -0,0 +1,26 @@
+/*
+ * ws2812.h
+ *
+ * Defines WS2812 related functions
+ */
+
+#ifndef APP_MODULES_WS2812_H_
+#define APP_MODULES_WS2812_H_
+
+// Pin of GPIO2, the UART1 TX line ws2812_send_buffer() drives
+#define WS2812_UART_PIN   4
+
+// ws2812_send_buffer() results
+#define WS2812_OK         0
+#define WS2812_BUSY       1   // a transfer is in progress
+#define WS2812_NOMEM      2
+
+typedef void (*ws2812_idle_fn)(void *arg);
+
+void ws2812_write_buffer(uint8_t pin, const uint8_t *buffer, size_t length);
+void ws2812_encode(const uint8_t *src, size_t length, uint8_t *dst);
+int ws2812_send_buffer(const uint8_t *buffer, size_t length);
+void ws2812_when_idle(ws2812_idle_fn fn, void *arg);
+void ws2812_cancel_idle(void *arg);
+
+#endif /* APP_MODULES_WS2812_H_ */
@@ -143,7 +143,8 @@ uint32_t platform_flash_get_num_sectors(void)
 #endif // #ifdef INTERNAL_FLASH_SECTOR_SIZE
 }
 
-uint32_t platform_flash_get_first_free_block_address( uint32_t *psect )
+// First block after the firmware image
+static uint32_t flashh_get_image_end( uint32_t *psect )
 {
   // Round the total used flash size to the closest flash block address
   uint32_t start, end, sect;
@@ -162,6 +163,20 @@ uint32_t platform_flash_get_first_free_block_address( uint32_t *psect )
   }
 }
 
+uint32_t platform_flash_get_lua_store_address( uint32_t *psect )
+{
+  return flashh_get_image_end( psect );
+}
+
+uint32_t platform_flash_get_first_free_block_address( uint32_t *psect )
+{
+  // The Lua flash store comes between the firmware and the file system
+  uint32_t sect, start = flashh_get_image_end( &sect );
+  if( psect )
+    *psect = sect + LUA_STORE_SEC_NUM;
+  return start + LUA_STORE_SEC_NUM * INTERNAL_FLASH_SECTOR_SIZE;
+}
+
 uint32_t platform_flash_write( const void *from, uint32_t toaddr, uint32_t size )
 {
 #ifndef INTERNAL_FLASH_WRITE_UNIT_SIZE
@@ -37,6 +37,14 @@
 #define SYS_PARAM_SEC_NUM 4
 #define SYS_PARAM_SEC_START (FLASH_SEC_NUM - SYS_PARAM_SEC_NUM)
 
+// Sectors of the Lua flash store (see lua/lflash.c), right after the
+// firmware. The file system starts after them, so turning the store on or
+// resizing it moves the file system and loses its files: it is off unless
+// user_config.h sets the sectors, 0x10 for a 64 KB store.
+#ifndef LUA_STORE_SEC_NUM
+#define LUA_STORE_SEC_NUM 0
+#endif
+
 // #define WOFS_SEC_START	0x80
 // #define WOFS_SEC_START	0x60
 // #define WOFS_SEC_END	(SYS_PARAM_SEC_START)
@@ -50,6 +58,8 @@
 
 #define INTERNAL_FLASH_SIZE             ( (SYS_PARAM_SEC_START) * INTERNAL_FLASH_SECTOR_SIZE )
 #define INTERNAL_FLASH_START_ADDRESS    0x40200000
+// Only the first MB of the flash is mapped at INTERNAL_FLASH_START_ADDRESS
+#define INTERNAL_FLASH_MAPPED_SIZE      0x100000
 
 // SpiFlashOpResult spi_flash_erase_sector(uint16 sec);
 // SpiFlashOpResult spi_flash_write(uint32 des_addr, uint32 *src_addr, uint32 size);
@@ -0,0 +1,162 @@
+// Central event queue used to defer Lua callbacks out of timer and ISR context
+//
+// Producers (timer callbacks, ISRs) append events at the head of a bounded ring,
+// serialized by a few instructions long interrupt lock. The single consumer (the
+// Lua task dispatcher in user_main.c) takes them from the tail without locking.
+// Define EVENT_HOST_BUILD to build the queue on a host, e.g. driven by a fake timer.
+
+#include "event.h"
+
+#ifdef EVENT_HOST_BUILD
+#define EVENT_LOCK()
+#define EVENT_UNLOCK()
+#else
+#include "ets_sys.h"
+#define EVENT_LOCK()    ETS_INTR_LOCK()
+#define EVENT_UNLOCK()  ETS_INTR_UNLOCK()
+#endif
+
+#define EVENT_QUEUE_MASK  ( EVENT_QUEUE_LEN - 1 )
+
+// Type of cancelled events
+#define EVENT_NONE        EVENT_TYPE_NUM
+
+typedef struct
+{
+  uint16_t type;
+  uint16_t id;
+  uint32_t arg;
+  void *data;
+} event_t;
+
+static event_t queue[ EVENT_QUEUE_LEN ];
+static volatile uint32_t head;          // Next free slot, only moved by producers
+static volatile uint32_t tail;          // Oldest pending event, only moved by the consumer
+static volatile uint8_t notified;       // Consumer has been notified and did not run yet
+static event_handler_fn_t handlers[ EVENT_TYPE_NUM ];
+static uint8_t type_options[ EVENT_TYPE_NUM ];
+static event_notify_fn_t notify_fn;
+static event_stats_t stats;
+
+// Set the function called once the queue becomes non-empty
+void event_init( event_notify_fn_t notify )
+{
+  notify_fn = notify;
+}
+
+// Set event type handler and options (EVENT_COALESCE)
+void event_register( unsigned type, event_handler_fn_t handler, unsigned options )
+{
+  if( type >= EVENT_TYPE_NUM )
+    return;
+  handlers[ type ] = handler;
+  type_options[ type ] = options;
+}
+
+// Queue an event, safe to call from ISRs
+// Returns 1 if the event was queued or merged into a pending one, 0 if dropped
+int event_post( unsigned type, unsigned id, uint32_t arg, void *data )
+{
+  uint32_t i;
+  event_t *e;
+  int wake = 0;
+
+  if( type >= EVENT_TYPE_NUM )
+    return 0;
+
+  EVENT_LOCK();
+  if( type_options[ type ] & EVENT_COALESCE && head - tail > 1 )
+  {
+    // The oldest event may be in the middle of being taken by the consumer,
+    // so it is never merged into
+    for( i = tail + 1; i != head; i ++ )
+    {
+      e = &queue[ i & EVENT_QUEUE_MASK ];
+      if( e->type == type && e->id == id && e->data == data )
+      {
+        e->arg = arg;
+        stats.coalesced ++;
+        EVENT_UNLOCK();
+        return 1;
+      }
+    }
+  }
+
+  if( head - tail >= EVENT_QUEUE_LEN )
+  {
+    stats.dropped ++;
+    EVENT_UNLOCK();
+    return 0;
+  }
+
+  e = &queue[ head & EVENT_QUEUE_MASK ];
+  e->type = type;
+  e->id = id;
+  e->arg = arg;
+  e->data = data;
+  head ++;
+
+  stats.posted ++;
+  if( head - tail > stats.max_depth )
+    stats.max_depth = head - tail;
+
+  if( !notified )
+  {
+    notified = 1;
+    wake = 1;
+  }
+  EVENT_UNLOCK();
+
+  if( wake && notify_fn )
+    notify_fn();
+  return 1;
+}
+
+// Drop all pending events of the given type referring to data (e.g. a deleted object)
+// Must not be called from ISRs
+void event_cancel( unsigned type, void *data )
+{
+  uint32_t i;
+  event_t *e;
+
+  EVENT_LOCK();
+  for( i = tail; i != head; i ++ )
+  {
+    e = &queue[ i & EVENT_QUEUE_MASK ];
+    if( e->type == type && e->data == data )
+      e->type = EVENT_NONE;
+  }
+  EVENT_UNLOCK();
+}
+
+// Run handlers of up to max pending events, returns the number of events left
+unsigned event_dispatch( unsigned max )
+{
+  event_t e;
+  unsigned pending;
+
+  while( max -- && tail != head )
+  {
+    e = queue[ tail & EVENT_QUEUE_MASK ];
+    tail ++;
+
+    if( e.type < EVENT_TYPE_NUM && handlers[ e.type ] )
+      handlers[ e.type ]( e.id, e.arg, e.data );
+  }
+
+  EVENT_LOCK();
+  pending = head - tail;
+  if( pending == 0 )
+    notified = 0;
+  EVENT_UNLOCK();
+  return pending;
+}
+
+// Get queue counters
+void event_get_stats( event_stats_t *out )
+{
+  EVENT_LOCK();
+  *out = stats;
+  out->depth = head - tail;
+  EVENT_UNLOCK();
+}
@@ -0,0 +1,46 @@
+// Central event queue used to defer Lua callbacks out of timer and ISR context
+
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+#include "c_types.h"
+
+// Queue length, has to be a power of two
+#define EVENT_QUEUE_LEN       32
+
+// Maximum number of events handled by a single dispatcher run
+#define EVENT_DISPATCH_BATCH  8
+
+// Event types, every type has a single handler
+enum
+{
+  EVENT_TMR_ALARM,      // tmr timers expired, see the fired list in tmr.c
+  EVENT_GPIO_TRIG,      // gpio.trig() edges queued, see gpio.c
+  EVENT_TICKER_SCROLL,  // ticker scroll finished, data = ticker
+  EVENT_OUTPUT_FLUSH,   // node.output() batch timer expired
+  EVENT_TYPE_NUM
+};
+
+// Event type options
+#define EVENT_COALESCE        1   // Merge with a pending event of the same type, id and data
+
+typedef void ( *event_handler_fn_t )( unsigned id, uint32_t arg, void *data );
+typedef void ( *event_notify_fn_t )( void );
+
+typedef struct
+{
+  uint32_t depth;       // Events waiting to be dispatched
+  uint32_t max_depth;   // Highest depth seen
+  uint32_t posted;      // Events queued
+  uint32_t coalesced;   // Events merged into a pending one
+  uint32_t dropped;     // Events lost because the queue was full
+} event_stats_t;
+
+void event_init( event_notify_fn_t notify );
+void event_register( unsigned type, event_handler_fn_t handler, unsigned options );
+int event_post( unsigned type, unsigned id, uint32_t arg, void *data );
+void event_cancel( unsigned type, void *data );
+unsigned event_dispatch( unsigned max );
+void event_get_stats( event_stats_t *stats );
+
+#endif // #ifndef __EVENT_H__
@@ -56,9 +56,11 @@ uint32_t flash_get_size_byte(void)
     case SIZE_32MBIT:
         // 32Mbit, 4MByte
         flash_size = 4 * 1024 * 1024;
+        break;
     case SIZE_64MBIT:
         // 64Mbit, 8MByte
         flash_size = 8 * 1024 * 1024;
+        break;
     case SIZE_128MBIT:
         // 128Mbit, 16MByte
         flash_size = 16 * 1024 * 1024;
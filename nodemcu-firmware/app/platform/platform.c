@@ -7,6 +7,10 @@
 #include "gpio.h"
 #include "user_interface.h"
 #include "driver/uart.h"
+#include "driver/gpio16.h"
+#include "driver/i2c_master.h"
+#include "driver/spi.h"
+#include "common.h"
 // Platform specific includes
 
 static void pwms_init();
@@ -151,7 +155,23 @@ static void platform_gpio_intr_dispatcher( platform_gpio_intr_handler_fn_t cb){
       if(cb){
         cb(i, level);
       }
+      // a level would fire again right away, see platform_gpio_intr_rearm()
+      if (pin_int_type[i] != GPIO_PIN_INTR_LOLEVEL && pin_int_type[i] != GPIO_PIN_INTR_HILEVEL)
+        gpio_pin_intr_state_set(GPIO_ID_PIN(pin_num[i]), pin_int_type[i]);
+    }
+  }
+}
+
+// Re-enable the level triggered pins the dispatcher left disabled,
+// called from a task once their level has been handled
+void platform_gpio_intr_rearm( void )
+{
+  uint8 i;
+  for (i = 0; i < GPIO_PIN_NUM; i++) {
+    if (pin_int_type[i] == GPIO_PIN_INTR_LOLEVEL || pin_int_type[i] == GPIO_PIN_INTR_HILEVEL) {
+      ETS_GPIO_INTR_DISABLE();
       gpio_pin_intr_state_set(GPIO_ID_PIN(pin_num[i]), pin_int_type[i]);
+      ETS_GPIO_INTR_ENABLE();
     }
   }
 }
@@ -259,6 +279,14 @@ uint32_t platform_uart_setup( unsigned id, uint32_t baud, int databits, int pari
   return baud;
 }
 
+// Resize the RX ring, only UART0 receives
+int platform_uart_set_buffer( unsigned id, unsigned size )
+{
+  if( id != 0 )
+    return PLATFORM_ERR;
+  return uart0_rx_buffer_resize( size ) ? PLATFORM_OK : PLATFORM_ERR;
+}
+
 // Send: version with and without mux
 void platform_uart_send( unsigned id, u8 data ) 
 {
@@ -453,8 +481,14 @@ uint32_t platform_spi_setup( unsigned id, int mode, unsigned cpol, unsigned cpha
 
 spi_data_type platform_spi_send_recv( unsigned id, spi_data_type data )
 {
-  spi_mast_byte_write(id, &data);
-  return data;
+  uint8 byte = data;
+  spi_mast_byte_write(id, &byte);
+  return byte;
+}
+
+void platform_spi_blk_write( unsigned id, const uint8_t *data, uint32_t len )
+{
+  spi_mast_blk_write(id, data, len);
 }
 
 // ****************************************************************************
@@ -39,17 +39,21 @@ uint8_t platform_key_led( uint8_t level);
 /* GPIO interrupt handler */
 typedef void (* platform_gpio_intr_handler_fn_t)( unsigned pin, unsigned level );
 
+int platform_gpio_exists( unsigned pin );
 int platform_gpio_mode( unsigned pin, unsigned mode, unsigned pull );
 int platform_gpio_write( unsigned pin, unsigned level );
 int platform_gpio_read( unsigned pin );
 void platform_gpio_init( platform_gpio_intr_handler_fn_t cb );
 int platform_gpio_intr_init( unsigned pin, GPIO_INT_TYPE type );
+void platform_gpio_intr_rearm( void );
 // *****************************************************************************
 // Timer subsection
 
 // Timer data type
 typedef uint32_t timer_data_type;
 
+int platform_tmr_exists( unsigned id );
+
 // *****************************************************************************
 // CAN subsection
 
@@ -102,6 +106,7 @@ typedef uint32_t spi_data_type;
 int platform_spi_exists( unsigned id );
 uint32_t platform_spi_setup( unsigned id, int mode, unsigned cpol, unsigned cpha, unsigned databits, uint32_t clock);
 spi_data_type platform_spi_send_recv( unsigned id, spi_data_type data );
+void platform_spi_blk_write( unsigned id, const uint8_t *data, uint32_t len );
 void platform_spi_select( unsigned id, int is_select );
 
 // *****************************************************************************
@@ -225,6 +230,7 @@ uint32_t platform_eth_get_elapsed_time(void);
 // Internal flash erase/write functions
 
 uint32_t platform_flash_get_first_free_block_address( uint32_t *psect );
+uint32_t platform_flash_get_lua_store_address( uint32_t *psect );
 uint32_t platform_flash_get_sector_of_address( uint32_t addr );
 uint32_t platform_flash_write( const void *from, uint32_t toaddr, uint32_t size );
 uint32_t platform_flash_read( void *to, uint32_t fromaddr, uint32_t size );
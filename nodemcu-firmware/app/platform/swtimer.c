@@ -0,0 +1,270 @@
+// Software timers multiplexed on a single os_timer
+//
+// Armed timers sit in a hashed timing wheel of SWTIMER_SLOTS one ms slots,
+// indexed by their expiry time, so arming and disarming is O(1). The os_timer
+// is not ticking: it is armed once for the next expiry and runs the due slots
+// when it fires, an idle wheel causes no wakeups at all. Timers further away
+// than one wheel turn share the slots and are skipped until their turn.
+// Timer functions run in the os_timer context.
+// Define SWTIMER_HOST_BUILD to build the wheel on a host, e.g. driven by a fake clock.
+
+#include "swtimer.h"
+
+#ifdef SWTIMER_HOST_BUILD
+#define SWTIMER_TIME_US()       swtimer_host_time()
+#define SWTIMER_HW_ARM( ms )    swtimer_host_arm( ms )
+#else
+#include "c_types.h"
+#include "user_interface.h"
+#include "osapi.h"
+#define SWTIMER_TIME_US()       system_get_time()
+#define SWTIMER_HW_ARM( ms )    do { os_timer_disarm( &hw_timer ); os_timer_arm( &hw_timer, ( ms ), 0 ); } while( 0 )
+static os_timer_t hw_timer;
+#endif
+
+#define SWTIMER_MASK      ( SWTIMER_SLOTS - 1 )
+#define SWTIMER_DUE       SWTIMER_SLOTS         // list of timers to be fired
+#define SWTIMER_NONE      ( SWTIMER_SLOTS + 1 ) // not armed
+#define SWTIMER_WORDS     ( SWTIMER_SLOTS / 32 )
+
+// Signed distance of two ms timestamps
+#define SWTIMER_DIFF( a, b )    ( ( int32_t )( ( a ) - ( b ) ) )
+
+static swtimer_t *lists[ SWTIMER_SLOTS + 1 ];
+static uint32_t used[ SWTIMER_WORDS ];  // Bitmap of non-empty slots
+static uint32_t last_us;                // Clock of the last swtimer_now()
+static uint32_t rest_us;                // us not yet counted in now_ms
+static uint32_t now_ms;
+static uint32_t wheel_ms;               // Slots up to this time were run
+static uint32_t hw_expiry;              // Time the os_timer is armed for
+static bool hw_armed;
+static bool running;                    // Inside swtimer_run()
+static swtimer_stats_t stats;
+
+// Milliseconds since the first call, follows the system clock
+uint32_t swtimer_now( void )
+{
+  uint32_t t = SWTIMER_TIME_US();
+
+  rest_us += t - last_us;
+  last_us = t;
+  now_ms += rest_us / 1000;
+  rest_us %= 1000;
+  return now_ms;
+}
+
+static void swtimer_link( swtimer_t *t, unsigned list )
+{
+  t->list = list;
+  t->prev = NULL;
+  t->next = lists[ list ];
+  if( t->next )
+    t->next->prev = t;
+  lists[ list ] = t;
+  if( list < SWTIMER_SLOTS )
+    used[ list / 32 ] |= 1UL << ( list % 32 );
+}
+
+static void swtimer_unlink( swtimer_t *t )
+{
+  unsigned list = t->list;
+
+  if( t->prev )
+    t->prev->next = t->next;
+  else
+    lists[ list ] = t->next;
+  if( t->next )
+    t->next->prev = t->prev;
+  if( list < SWTIMER_SLOTS && !lists[ list ] )
+    used[ list / 32 ] &= ~( 1UL << ( list % 32 ) );
+  t->list = SWTIMER_NONE;
+}
+
+// Next wheel slot in use at or after slot, SWTIMER_SLOTS if there is none
+static unsigned swtimer_next_used( unsigned slot, unsigned count )
+{
+  uint32_t bits;
+  unsigned done = 0, skip;
+
+  while( done < count )
+  {
+    bits = used[ ( slot & SWTIMER_MASK ) / 32 ] >> ( slot % 32 );
+    if( bits & 1 )
+      return done;
+    // Skip the empty rest of the word
+    skip = bits ? 1 : 32 - ( slot % 32 );
+    if( bits )
+      while( !( ( bits >>= 1 ) & 1 ) )
+        skip ++;
+    slot += skip;
+    done += skip;
+  }
+  return SWTIMER_SLOTS;
+}
+
+// Arm the os_timer for the earliest expiry, or leave it off
+static void swtimer_schedule( uint32_t now )
+{
+  uint32_t earliest = 0, at;
+  unsigned dist = 1, step;
+  bool found = false;
+  swtimer_t *t;
+
+  if( running )
+    return;
+
+  // The first slot holding a timer of the current wheel turn decides, the
+  // earliest of the timers seen on the way is the fallback
+  while( dist <= SWTIMER_SLOTS )
+  {
+    step = swtimer_next_used( now + dist, SWTIMER_SLOTS + 1 - dist );
+    if( step == SWTIMER_SLOTS )
+      break;
+    dist += step;
+    at = now + dist;
+    for( t = lists[ at & SWTIMER_MASK ]; t; t = t->next )
+    {
+      if( !found || SWTIMER_DIFF( t->expiry, earliest ) < 0 )
+        earliest = t->expiry;
+      found = true;
+    }
+    if( found && SWTIMER_DIFF( earliest, at ) <= 0 )
+      break;
+    dist ++;
+  }
+
+  if( !found )
+  {
+    hw_armed = false;
+    return;
+  }
+  if( SWTIMER_DIFF( earliest, now ) < 1 )
+    earliest = now + 1;
+  if( hw_armed && hw_expiry == earliest )
+    return;
+  hw_expiry = earliest;
+  hw_armed = true;
+  SWTIMER_HW_ARM( earliest - now );
+}
+
+// os_timer callback, fires everything due
+static void swtimer_run( void *arg )
+{
+  uint32_t now = swtimer_now();
+  uint32_t ticks = now - wheel_ms;
+  uint32_t tick;
+  swtimer_t *t, *next;
+
+  ( void )arg;
+  hw_armed = false;
+  running = true;
+  stats.wakeups ++;
+
+  if( ticks > SWTIMER_SLOTS )
+    ticks = SWTIMER_SLOTS;
+
+  // Move due timers off the wheel, their functions may arm and disarm any timer
+  for( tick = now - ticks + 1; tick != now + 1; tick ++ )
+  {
+    for( t = lists[ tick & SWTIMER_MASK ]; t; t = next )
+    {
+      next = t->next;
+      if( SWTIMER_DIFF( t->expiry, now ) <= 0 )
+      {
+        swtimer_unlink( t );
+        swtimer_link( t, SWTIMER_DUE );
+      }
+    }
+  }
+  wheel_ms = now;
+
+  while( ( t = lists[ SWTIMER_DUE ] ) != NULL )
+  {
+    if( ( uint32_t )SWTIMER_DIFF( now, t->expiry ) > stats.max_late )
+      stats.max_late = SWTIMER_DIFF( now, t->expiry );
+    swtimer_unlink( t );
+    if( t->period )
+    {
+      // Keep the phase, missed periods are not made up for
+      t->expiry += t->period;
+      if( SWTIMER_DIFF( t->expiry, now ) <= 0 )
+        t->expiry = now + t->period;
+      swtimer_link( t, t->expiry & SWTIMER_MASK );
+    }
+    else
+      stats.armed --;
+    stats.fired ++;
+    if( t->fn )
+      t->fn( t->arg );
+  }
+
+  running = false;
+  swtimer_schedule( now );
+}
+
+#ifdef SWTIMER_HOST_BUILD
+void swtimer_host_run( void )
+{
+  swtimer_run( NULL );
+}
+#endif
+
+void swtimer_init( void )
+{
+  last_us = SWTIMER_TIME_US();
+  wheel_ms = swtimer_now();
+#ifndef SWTIMER_HOST_BUILD
+  os_timer_disarm( &hw_timer );
+  os_timer_setfn( &hw_timer, ( os_timer_func_t * )swtimer_run, NULL );
+#endif
+}
+
+// Set the function of a timer, has to be called before anything else
+void swtimer_setfn( swtimer_t *t, swtimer_fn_t fn, void *arg )
+{
+  t->next = t->prev = NULL;
+  t->list = SWTIMER_NONE;
+  t->fn = fn;
+  t->arg = arg;
+}
+
+// (Re)start a timer, a repeating one keeps firing every ms
+void swtimer_arm( swtimer_t *t, uint32_t ms, bool repeat )
+{
+  uint32_t now;
+
+  swtimer_disarm( t );
+  if( ms == 0 )
+    ms = 1;
+
+  now = swtimer_now();
+  // Slots behind the wheel are not run before its next turn
+  if( !running && !hw_armed )
+    wheel_ms = now;
+  t->expiry = now + ms;
+  t->period = repeat ? ms : 0;
+  swtimer_link( t, t->expiry & SWTIMER_MASK );
+  stats.armed ++;
+
+  if( !hw_armed || SWTIMER_DIFF( t->expiry, hw_expiry ) < 0 )
+    swtimer_schedule( now );
+}
+
+// Stop a timer, the os_timer is left to expire on its own
+void swtimer_disarm( swtimer_t *t )
+{
+  if( t->list == SWTIMER_NONE )
+    return;
+  swtimer_unlink( t );
+  stats.armed --;
+}
+
+bool swtimer_armed( swtimer_t *t )
+{
+  return t->list != SWTIMER_NONE;
+}
+
+void swtimer_get_stats( swtimer_stats_t *out )
+{
+  *out = stats;
+}
@@ -0,0 +1,48 @@
+// Software timers multiplexed on a single os_timer
+
+#ifndef __SWTIMER_H__
+#define __SWTIMER_H__
+
+#include "c_types.h"
+
+// Wheel slots, one per ms, has to be a power of two
+#define SWTIMER_SLOTS         256
+
+typedef void ( *swtimer_fn_t )( void *arg );
+
+typedef struct swtimer
+{
+  struct swtimer *next;
+  struct swtimer *prev;
+  uint32_t expiry;      // ms, see swtimer_now()
+  uint32_t period;      // ms, 0 = single shot
+  uint16_t list;        // wheel slot, SWTIMER_SLOTS = due, SWTIMER_NONE = not armed
+  swtimer_fn_t fn;
+  void *arg;
+} swtimer_t;
+
+typedef struct
+{
+  uint32_t armed;       // Timers waiting to expire
+  uint32_t wakeups;     // os_timer callbacks
+  uint32_t fired;       // Timer functions called
+  uint32_t max_late;    // Highest delay of a timer function behind its expiry (ms)
+} swtimer_stats_t;
+
+void swtimer_init( void );
+void swtimer_setfn( swtimer_t *t, swtimer_fn_t fn, void *arg );
+void swtimer_arm( swtimer_t *t, uint32_t ms, bool repeat );
+void swtimer_disarm( swtimer_t *t );
+bool swtimer_armed( swtimer_t *t );
+uint32_t swtimer_now( void );
+void swtimer_get_stats( swtimer_stats_t *stats );
+
+#ifdef SWTIMER_HOST_BUILD
+// Provided by the host: free running us clock and the one shot wakeup,
+// which has to call swtimer_host_run() once it expires
+extern uint32_t swtimer_host_time( void );
+extern void swtimer_host_arm( uint32_t ms );
+void swtimer_host_run( void );
+#endif
+
+#endif // #ifndef __SWTIMER_H__
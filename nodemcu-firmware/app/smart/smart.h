@@ -78,6 +78,7 @@ typedef struct _my_addr_map smart_addr_map;
 typedef void (* smart_succeed)(void *arg);
 
 void smart_begin(int chnl, smart_succeed s, void *arg);
+void smart_end();
 void station_check_connect(bool smart);
 
 #ifdef __cplusplus
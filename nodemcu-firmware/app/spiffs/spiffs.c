@@ -1,14 +1,15 @@
 #include "c_stdio.h"
 #include "platform.h"
 #include "spiffs.h"
+#include "spiffs_nucleus.h"
   
 spiffs fs;
 
 #define LOG_PAGE_SIZE       256
   
 static u8_t spiffs_work_buf[LOG_PAGE_SIZE*2];
-static u8_t spiffs_fds[32*4];
-static u8_t spiffs_cache[(LOG_PAGE_SIZE+32)*4];
+static u8_t spiffs_fds[sizeof(spiffs_fd)*SPIFFS_MAX_OPEN_FILES + sizeof(void *)];  // + pointer alignment
+static u8_t spiffs_cache_buf[(LOG_PAGE_SIZE+32)*4];
 
 static s32_t my_spiffs_read(u32_t addr, u32_t size, u8_t *dst) {
   platform_flash_read(dst, addr, size);
@@ -62,8 +63,8 @@ void spiffs_mount() {
     spiffs_work_buf,
     spiffs_fds,
     sizeof(spiffs_fds),
-    spiffs_cache,
-    sizeof(spiffs_cache),
+    spiffs_cache_buf,
+    sizeof(spiffs_cache_buf),
     // myspiffs_check_callback);
     0);
   NODE_DBG("mount res: %i\n", res);
@@ -97,8 +98,20 @@ int myspiffs_check( void )
   // return res;
 }
 
+static void (*myspiffs_reclaim)( void ) = NULL;
+
+// fn frees descriptors nobody uses any more, it runs once when spiffs is out of them
+void myspiffs_set_reclaim( void (*fn)( void ) ){
+  myspiffs_reclaim = fn;
+}
+
 int myspiffs_open(const char *name, int flags){
-  return (int)SPIFFS_open(&fs, (char *)name, (spiffs_flags)flags, 0);
+  int fd = (int)SPIFFS_open(&fs, (char *)name, (spiffs_flags)flags, 0);
+  if (fd < 0 && SPIFFS_errno(&fs) == SPIFFS_ERR_OUT_OF_FILE_DESCS && myspiffs_reclaim) {
+    myspiffs_reclaim();
+    fd = (int)SPIFFS_open(&fs, (char *)name, (spiffs_flags)flags, 0);
+  }
+  return fd;
 }
 
 int myspiffs_close( int fd ){
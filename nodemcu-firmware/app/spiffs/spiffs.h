@@ -452,6 +452,7 @@ u32_t SPIFFS_buffer_bytes_for_cache(spiffs *fs, u32_t num_pages);
 #endif
 
 int myspiffs_open(const char *name, int flags);
+void myspiffs_set_reclaim( void (*fn)( void ) );
 int myspiffs_close( int fd );
 size_t myspiffs_write( int fd, const void* ptr, size_t len );
 size_t myspiffs_read( int fd, void* ptr, size_t len);
@@ -463,6 +464,7 @@ int myspiffs_ungetc( int c, int fd );
 int myspiffs_flush( int fd );
 int myspiffs_error( int fd );
 void myspiffs_clearerr( int fd );
+int myspiffs_format( void );
 int myspiffs_check( void );
 int myspiffs_rename( const char *old, const char *newname );
 
@@ -112,6 +112,12 @@ typedef uint8_t u8_t;
 #define SPIFFS_OBJ_NAME_LEN             (32)
 #endif
 
+// Number of files that can be open at the same time: file module objects
+// and file_server uploads (up to two files per session for delta uploads).
+#ifndef SPIFFS_MAX_OPEN_FILES
+#define SPIFFS_MAX_OPEN_FILES           (8)
+#endif
+
 // Size of buffer allocated on stack used when copying data.
 // Lower value generates more read/writes. No meaning having it bigger
 // than logical page size.
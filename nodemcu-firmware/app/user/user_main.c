@@ -21,11 +21,33 @@
 #include "ets_sys.h"
 #include "driver/uart.h"
 #include "mem.h"
+#include "event.h"
 
 #define SIG_LUA 0
+#define SIG_EVENT 1
+#define SIG_UART 2
 #define TASK_QUEUE_LEN 4
 os_event_t *taskQueue;
 
+extern lua_Load gLoad;
+extern void readline(lua_Load *load);
+
+static volatile bool uart_rx_posted = false;
+
+// Called by the event queue once it becomes non-empty, may run in an ISR
+static void task_event_notify(void){
+    system_os_post(USER_TASK_PRIO_0, SIG_EVENT, 0);
+}
+
+// Called by the UART RX interrupt once bytes arrived, and by dojob() to pick up
+// input received while a chunk ran. A single SIG_UART drains the whole RX ring.
+void task_uart_notify(void){
+    if(!uart_rx_posted){
+        uart_rx_posted = true;
+        system_os_post(USER_TASK_PRIO_0, SIG_UART, 0);
+    }
+}
+
 void task_lua(os_event_t *e){
     char* lua_argv[] = { (char *)"lua", (char *)"-i", NULL };
     NODE_DBG("Task task_lua started.\n");
@@ -33,6 +55,19 @@ void task_lua(os_event_t *e){
         case SIG_LUA:
             NODE_DBG("SIG_LUA received.\n");
             lua_main( 2, lua_argv );
+            // console input is event driven from now on
+            uart0_rx_attach(task_uart_notify);
+            task_uart_notify();
+            break;
+        case SIG_EVENT:
+            // Run a batch of deferred callbacks, let the system run before the next one
+            if( event_dispatch( EVENT_DISPATCH_BATCH ) )
+                system_os_post(USER_TASK_PRIO_0, SIG_EVENT, 0);
+            break;
+        case SIG_UART:
+            // clear first, bytes received while draining post again
+            uart_rx_posted = false;
+            readline(&gLoad);
             break;
         default:
             break;
@@ -42,6 +77,7 @@ void task_lua(os_event_t *e){
 void task_init(void){
     taskQueue = (os_event_t *)os_malloc(sizeof(os_event_t) * TASK_QUEUE_LEN);
     system_os_task(task_lua, USER_TASK_PRIO_0, taskQueue, TASK_QUEUE_LEN);
+    event_init(task_event_notify);
 }
 
 extern void spiffs_mount();
@@ -5,12 +5,8 @@ print("Wicon Server starting ......")
 
 function connected(conn)
    print("Wifi console connected.")
-   function s_output(str)
-      if (conn~=nil)    then
-         conn:send(str)
-      end
-   end
-   node.output(s_output,0)
+   -- output is batched in C and sent once the previous batch went out
+   node.output(conn,0)
    conn:on("receive", function(conn, pl) 
       node.input(pl) 
    end)
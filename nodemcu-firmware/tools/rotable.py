@@ -0,0 +1,325 @@
+#!/usr/bin/env python
+#
+# Keeps the read-only tables of the firmware sorted.
+#
+# luaR_findentry() and luaR_findglobal() bisect the string keys of a rotable,
+# so every LUA_REG_TYPE map, the *_FUNCLIST macros feeding them and the
+# LUA_MODULES_ROM list of modules.h have to be in strcmp() order once the
+# preprocessor is done with them. Entries under #if / #else keep their exact
+# conditions: a conditional block is split into as many copies as it takes
+# to put each of its entries at its place.
+#
+#   rotable.py [-c] [file|dir ...]
+#
+#   -c  only check, list the unsorted tables and exit with 1 if there are any
+#
+# Without arguments the app directory next to this script is processed.
+#
+
+import io
+import os
+import re
+import sys
+
+MAP_START = re.compile(r'^\s*(?:static\s+)?const\s+LUA_REG_TYPE\s+(\w+)\s*\[\]\s*=')
+LIST_START = re.compile(r'^#define\s+(\w+_FUNCLIST|LUA_MODULES_ROM)\s*\\\s*$')
+ENTRY_KEY = re.compile(r'L(?:RO_)?STRKEY\(\s*"([^"]*)"\s*\)')
+ROM_NAME = re.compile(r'^#define\s+(\w+)\s+(\w+|"[^"]*")\s*$')
+ROM_ITEM = re.compile(r'^\s*(ROM_\w+)')
+ROM_USE = re.compile(r'_RO[MT]\(\s*(\w+)')
+TERMINATOR = re.compile(r'^\s*\{\s*L(?:RO_)?NILKEY')
+DIRECTIVE = re.compile(r'^\s*#\s*(\w+)')
+TAIL = re.compile(r'(\s*,?\s*\\?\s*)$')
+
+
+class Entry(object):
+  def __init__(self, key, lines, tail):
+    self.key = key
+    self.lines = lines          # leading comments and the entry itself
+    self.tail = tail            # ',', ',\' or '\'
+
+  def keys(self):
+    return [] if self.key is None else [self.key]
+
+
+class Block(object):
+  """#if ... [#elif / #else ...] #endif, a branch is (directive, items)"""
+  def __init__(self, branches, endif):
+    self.branches = branches
+    self.endif = endif
+
+  def keys(self):
+    keys = []
+    for directive, items in self.branches:
+      for item in items:
+        keys.extend(item.keys())
+    return keys
+
+  def subset(self, keys):
+    branches = [(d, [i for i in select(items, keys)]) for d, items in self.branches]
+    return Block(branches, self.endif)
+
+
+def select(items, keys):
+  for item in items:
+    if isinstance(item, Entry):
+      if item.key is None or item.key in keys:
+        yield item
+    else:
+      if set(item.keys()) & keys:
+        yield item.subset(keys)
+
+
+def directive(line):
+  m = DIRECTIVE.match(line)
+  return m.group(1) if m else None
+
+
+def parse(lines, pos, keyof, top):
+  """Items up to the #else / #elif / #endif of the block, or the end"""
+  items = []
+  comments = []
+  while pos < len(lines):
+    line = lines[pos]
+    d = directive(line)
+    if d in ('if', 'ifdef', 'ifndef'):
+      branches = []
+      head = line
+      pos += 1
+      while True:
+        sub, pos = parse(lines, pos, keyof, False)
+        branches.append((head, sub))
+        if pos >= len(lines):
+          raise ValueError('unterminated ' + branches[0][0].strip())
+        head = lines[pos]
+        pos += 1
+        if directive(head) == 'endif':
+          break
+      items.append(Block(branches, head))
+      continue
+    if d in ('else', 'elif', 'endif'):
+      if top:
+        raise ValueError('unbalanced ' + line.strip())
+      break
+    key = keyof(line)
+    if key is None:
+      if line.strip():
+        comments.append(line)
+      pos += 1
+      continue
+    m = TAIL.search(line)
+    items.append(Entry(key, comments + [line[:m.start()]], m.group(1).rstrip()))
+    comments = []
+    pos += 1
+  if comments:
+    # Comments after the last entry stay at the end of their branch
+    items.append(Entry(None, comments, None))
+  return items, pos
+
+
+def arrange(items):
+  """The items in key order, blocks split where other keys fall in between"""
+  trailer = [i for i in items if isinstance(i, Entry) and i.key is None]
+  empty = [i for i in items if isinstance(i, Block) and not i.keys()]
+  items = [i for i in items if i not in trailer and i not in empty]
+
+  owner = {}
+  for n, item in enumerate(items):
+    for key in item.keys():
+      owner.setdefault(key, n)
+  keys = sorted(owner)
+
+  result = []
+  n = 0
+  while n < len(keys):
+    item = items[owner[keys[n]]]
+    if isinstance(item, Entry):
+      result.append(item)
+      n += 1
+      continue
+    run = set()
+    start = owner[keys[n]]
+    while n < len(keys) and owner[keys[n]] == start:
+      run.add(keys[n])
+      n += 1
+    piece = item.subset(run)
+    piece.branches = [(d, arrange(sub)) for d, sub in piece.branches]
+    result.append(piece)
+  return result + empty + trailer
+
+
+def render(items, tails):
+  out = []
+  for item in items:
+    if isinstance(item, Entry):
+      out.extend(item.lines[:-1])
+      if item.tail is None:
+        out.append(item.lines[-1])
+      elif tails is None:
+        out.append(item.lines[-1] + item.tail)
+      else:
+        out.append(item.lines[-1] + tails.pop(0))
+    else:
+      for head, sub in item.branches:
+        out.append(head)
+        out.extend(render(sub, tails))
+      out.append(item.endif)
+  return out
+
+
+def collect_tails(items):
+  tails = []
+  for item in items:
+    if isinstance(item, Entry):
+      if item.tail is not None:
+        tails.append(item.tail)
+    else:
+      for head, sub in item.branches:
+        tails.extend(collect_tails(sub))
+  return tails
+
+
+def sort_body(body, keyof, macro):
+  items, pos = parse(body, 0, keyof, True)
+  if not macro:
+    return render(arrange(items), None)
+  # The line continuations go by position, the last line of a macro has none
+  return render(arrange(items), collect_tails(items))
+
+
+def map_key(line):
+  m = ENTRY_KEY.search(line)
+  if m is None:
+    return None
+  # Commented out entries are comments
+  if line.lstrip().startswith('//') or line.lstrip().startswith('/*'):
+    return None
+  return m.group(1)
+
+
+def table_bounds(lines, start):
+  """First and last + 1 line of the entries of the map starting at start"""
+  pos = start
+  if LIST_START.match(lines[pos]):
+    pos += 1
+    end = pos
+    while end < len(lines) and lines[end].rstrip().endswith('\\'):
+      end += 1
+    return pos, end + 1
+  # The declarator may itself be conditional, see liolib.c
+  if lines[pos + 1].lstrip().startswith(('#else', '#elif')):
+    pos += 1
+    while directive(lines[pos]) != 'endif':
+      pos += 1
+  while '{' not in lines[pos]:
+    pos += 1
+  pos += 1
+  end = pos
+  while not TERMINATOR.match(lines[end]):
+    if lines[end].startswith('}'):
+      raise ValueError('no terminator')
+    end += 1
+  return pos, end
+
+
+def read(path):
+  # Bytes as they are, some sources aren't utf-8
+  with io.open(path, encoding='latin-1', newline='') as f:
+    return f.read()
+
+
+def rom_names(path):
+  """Module names of the ROM_* items of modules.h"""
+  names = {}
+  libnames = {}
+  lualib = os.path.join(os.path.dirname(path), '..', 'lua', 'lualib.h')
+  for f in (lualib, path):
+    if not os.path.exists(f):
+      continue
+    for line in read(f).split('\n'):
+      m = ROM_NAME.match(line)
+      if m:
+        libnames[m.group(1)] = m.group(2)
+  rom = None
+  for line in read(path).split('\n'):
+    m = re.match(r'^#define\s+(ROM_\w+)', line)
+    if m:
+      rom = m.group(1)
+    m = ROM_USE.search(line)
+    if m and rom:
+      value = m.group(1)
+      while value in libnames:
+        value = libnames[value]
+      names[rom] = value.strip('"')
+      rom = None
+  return names
+
+
+def process(path, check):
+  lines = read(path).split('\n')
+  names = None
+  unsorted = []
+  n = 0
+  while n < len(lines):
+    m = MAP_START.match(lines[n]) or LIST_START.match(lines[n])
+    if not m:
+      n += 1
+      continue
+    name = m.group(1)
+    if name == 'LUA_MODULES_ROM':
+      if names is None:
+        names = rom_names(path)
+      keyof = lambda line: names.get(ROM_ITEM.match(line).group(1)) if ROM_ITEM.match(line) else None
+    else:
+      keyof = map_key
+    try:
+      first, end = table_bounds(lines, n)
+      body = lines[first:end]
+      result = sort_body(body, keyof, name == 'LUA_MODULES_ROM' or name.endswith('_FUNCLIST'))
+    except ValueError as e:
+      sys.stderr.write('%s: %s: %s\n' % (path, name, e))
+      unsorted.append(name)
+      n += 1
+      continue
+    # Blank lines don't count, they only go when a table gets sorted
+    if [l for l in result if l.strip()] != [l for l in body if l.strip()]:
+      unsorted.append(name)
+      lines[first:end] = result
+      end = first + len(result)
+    n = end
+  if unsorted and not check:
+    with io.open(path, 'w', encoding='latin-1', newline='') as f:
+      f.write(u'\n'.join(lines))
+  return unsorted
+
+
+def sources(args):
+  for arg in args:
+    if os.path.isdir(arg):
+      for root, dirs, files in os.walk(arg):
+        dirs[:] = sorted(d for d in dirs if not d.startswith('not_'))
+        for f in sorted(files):
+          if f.endswith(('.c', '.h')):
+            yield os.path.join(root, f)
+    else:
+      yield arg
+
+
+def main(argv):
+  check = '-c' in argv
+  args = [a for a in argv if a != '-c']
+  if not args:
+    args = [os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'app')]
+  bad = 0
+  for path in sources(args):
+    for name in process(path, check):
+      print('%s: %s %s' % (os.path.normpath(path), name, 'is not sorted' if check else 'sorted'))
+      bad += 1
+  if check and bad:
+    print('run tools/rotable.py to sort them')
+    return 1
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv[1:]))